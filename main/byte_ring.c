@@ -0,0 +1,125 @@
+#include "byte_ring.h"
+
+#include <string.h>
+
+#include "sdkconfig.h"
+
+#include "esp_heap_caps.h"
+
+esp_err_t rs3_byte_ring_init(rs3_byte_ring_t *r, size_t cap)
+{
+    if (!r || cap < 64) return ESP_ERR_INVALID_ARG;
+    size_t pow2 = 64;
+    while (pow2 * 2 <= cap) pow2 *= 2;
+
+    uint8_t *buf = NULL;
+#if CONFIG_SPIRAM
+    buf = heap_caps_malloc(pow2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    if (!buf) buf = heap_caps_malloc(pow2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!buf) return ESP_ERR_NO_MEM;
+
+    r->buf = buf;
+    r->cap = pow2;
+    r->head = 0;
+    r->ready = 0;
+    r->floor = 0;
+    r->flying = 0;
+    portMUX_INITIALIZE(&r->lock);
+    return ESP_OK;
+}
+
+static inline void copy_in(rs3_byte_ring_t *r, uint64_t pos, const uint8_t *src, size_t len)
+{
+    const size_t off = (size_t)(pos & (r->cap - 1));
+    const size_t first = (len < r->cap - off) ? len : r->cap - off;
+    memcpy(r->buf + off, src, first);
+    if (first < len) memcpy(r->buf, src + first, len - first);
+}
+
+// Caller holds the lock. Readers may go up to the oldest copy still in flight; new reservations
+// start at head, so this never moves back.
+static void publish(rs3_byte_ring_t *r)
+{
+    uint64_t ready = r->head;
+    for (int i = 0; i < RS3_BYTE_RING_FLIGHTS; i++) {
+        if ((r->flying & (1u << i)) && r->flight[i] < ready) ready = r->flight[i];
+    }
+    r->ready = ready;
+}
+
+bool rs3_byte_ring_write2(rs3_byte_ring_t *r, const void *a, size_t a_len, const void *b, size_t b_len,
+                          uint64_t *end)
+{
+    if (!r->buf || a_len + b_len > r->cap) return false;
+    const uint64_t len = a_len + b_len;
+    // Reserve under the lock, copy outside it (PSRAM copies are slow; other writers and readers
+    // keep going). Moving head first makes readers of the overwritten span see the loss.
+    portENTER_CRITICAL(&r->lock);
+    const uint64_t pos = r->head;
+    r->head = pos + len;
+    int slot = 0;
+    while (slot < RS3_BYTE_RING_FLIGHTS && (r->flying & (1u << slot))) slot++;
+    if (slot == RS3_BYTE_RING_FLIGHTS) {
+        // Every slot taken: copy under the lock rather than track an unbounded set of copies.
+        if (a_len) copy_in(r, pos, (const uint8_t *)a, a_len);
+        if (b_len) copy_in(r, pos + a_len, (const uint8_t *)b, b_len);
+        publish(r);
+        portEXIT_CRITICAL(&r->lock);
+        if (end) *end = pos + len;
+        return true;
+    }
+    r->flight[slot] = pos;
+    r->flying |= 1u << slot;
+    portEXIT_CRITICAL(&r->lock);
+
+    if (a_len) copy_in(r, pos, (const uint8_t *)a, a_len);
+    if (b_len) copy_in(r, pos + a_len, (const uint8_t *)b, b_len);
+
+    portENTER_CRITICAL(&r->lock);
+    r->flying &= ~(1u << slot);
+    // Lapped while copying: newer records were reserved over these bytes and may have been
+    // copied before this late copy clobbered them. Nobody has read them yet (ready <= pos).
+    if (r->head - pos > r->cap) r->floor = r->head;
+    publish(r);
+    portEXIT_CRITICAL(&r->lock);
+    if (end) *end = pos + len;
+    return true;
+}
+
+uint64_t rs3_byte_ring_head(rs3_byte_ring_t *r)
+{
+    portENTER_CRITICAL(&r->lock);
+    const uint64_t ready = r->ready;
+    portEXIT_CRITICAL(&r->lock);
+    return ready;
+}
+
+uint64_t rs3_byte_ring_start(rs3_byte_ring_t *r)
+{
+    portENTER_CRITICAL(&r->lock);
+    const uint64_t start = (r->floor > r->ready) ? r->floor : r->ready;
+    portEXIT_CRITICAL(&r->lock);
+    return start;
+}
+
+uint64_t rs3_byte_ring_lost(rs3_byte_ring_t *r, uint64_t pos)
+{
+    portENTER_CRITICAL(&r->lock);
+    const uint64_t head = r->head;
+    const uint64_t floor = r->floor;
+    portEXIT_CRITICAL(&r->lock);
+    uint64_t oldest = (head > r->cap) ? head - r->cap : 0;
+    if (floor > oldest) oldest = floor;
+    return (pos < oldest) ? oldest - pos : 0;
+}
+
+size_t rs3_byte_ring_peek(const rs3_byte_ring_t *r, uint64_t pos, uint64_t head, const uint8_t **out)
+{
+    if (pos >= head) return 0;
+    const size_t off = (size_t)(pos & (r->cap - 1));
+    uint64_t avail = head - pos;
+    if (avail > r->cap - off) avail = r->cap - off;
+    *out = r->buf + off;
+    return (size_t)avail;
+}
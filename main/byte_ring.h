@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/**
+ * Overwriting byte ring for fan-out to independent readers.
+ *
+ * Writers append whole records and never wait: old data is overwritten. Positions are
+ * monotonic 64-bit byte counters, so each reader keeps its own cursor and can tell
+ * whether the bytes it wants are still in the ring (rs3_byte_ring_lost()).
+ *
+ * A writer reserves its record under the lock and copies it after releasing it (the ring may
+ * be in PSRAM); readers see bytes up to `ready`, the start of the oldest copy still in flight (or
+ * `head`). Loss is judged against `head`: a reservation already owns the bytes it will overwrite.
+ * A writer lapped by the ring during its copy (preempted for a whole ring's worth of records) has
+ * written over newer records: it raises `floor` to `head`, and everything before it counts as lost.
+ *
+ * Readers access ring memory directly (e.g. pass it to send()) without taking the lock.
+ * A writer on the other core may overwrite those bytes meanwhile, so readers must call
+ * rs3_byte_ring_lost() again *after* consuming a span and discard it if it reports loss.
+ */
+enum { RS3_BYTE_RING_FLIGHTS = 4 };  // copies outside the lock at once; more writers copy under it
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;              // power of two
+    volatile uint64_t head;  // total bytes ever reserved
+    volatile uint64_t ready; // readers stop here: every byte before it has been copied
+    uint64_t floor;          // bytes before it may be corrupt (a lapped copy)
+    uint64_t flight[RS3_BYTE_RING_FLIGHTS];  // start of each copy in flight
+    uint32_t flying;         // bit per busy flight[] slot
+    portMUX_TYPE lock;
+} rs3_byte_ring_t;
+
+/**
+ * @brief Allocate the ring (PSRAM when available). cap is rounded down to a power of two.
+ */
+esp_err_t rs3_byte_ring_init(rs3_byte_ring_t *r, size_t cap);
+
+/**
+ * @brief Append one record made of two parts (e.g. header + payload) atomically.
+ *
+ * The copy runs outside the lock when a flight slot is free. end (optional) gets the record's end
+ * position.
+ * Returns false if the record is larger than the ring.
+ */
+bool rs3_byte_ring_write2(rs3_byte_ring_t *r, const void *a, size_t a_len, const void *b, size_t b_len,
+                          uint64_t *end);
+
+/**
+ * @brief Readable end: every byte before it has been copied. Always a record boundary.
+ */
+uint64_t rs3_byte_ring_head(rs3_byte_ring_t *r);
+
+/**
+ * @brief Where a new or resyncing reader starts: the readable end, or the loss floor if a lapped
+ * copy put it further (the reader then waits there until the readable end catches up).
+ */
+uint64_t rs3_byte_ring_start(rs3_byte_ring_t *r);
+
+/**
+ * @brief Number of bytes at pos that have already been overwritten (0 if pos is still valid).
+ */
+uint64_t rs3_byte_ring_lost(rs3_byte_ring_t *r, uint64_t pos);
+
+/**
+ * @brief Contiguous readable span starting at pos, up to head or the end of the buffer.
+ *
+ * Returns the span length (0 if pos == head) and sets *out to ring memory.
+ */
+size_t rs3_byte_ring_peek(const rs3_byte_ring_t *r, uint64_t pos, uint64_t head, const uint8_t **out);
@@ -0,0 +1,324 @@
+#include "cbor_lite.h"
+
+#include <string.h>
+
+enum { SKIP_DEPTH_MAX = 8 };
+
+void rs3_cbor_writer_init(rs3_cbor_writer_t *w, uint8_t *buf, size_t cap)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = false;
+}
+
+static void put_raw(rs3_cbor_writer_t *w, const void *p, size_t n)
+{
+    if (w->overflow || n > w->cap - w->len) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, p, n);
+    w->len += n;
+}
+
+// Initial byte plus the shortest big-endian argument.
+static void put_head(rs3_cbor_writer_t *w, uint8_t major, uint64_t v)
+{
+    uint8_t h[9];
+    size_t n;
+    if (v < 24) {
+        h[0] = (uint8_t)(major << 5 | v);
+        n = 1;
+    } else if (v <= 0xFF) {
+        h[0] = (uint8_t)(major << 5 | 24);
+        h[1] = (uint8_t)v;
+        n = 2;
+    } else if (v <= 0xFFFF) {
+        h[0] = (uint8_t)(major << 5 | 25);
+        h[1] = (uint8_t)(v >> 8);
+        h[2] = (uint8_t)v;
+        n = 3;
+    } else if (v <= 0xFFFFFFFFu) {
+        h[0] = (uint8_t)(major << 5 | 26);
+        for (int i = 0; i < 4; i++) h[1 + i] = (uint8_t)(v >> (24 - 8 * i));
+        n = 5;
+    } else {
+        h[0] = (uint8_t)(major << 5 | 27);
+        for (int i = 0; i < 8; i++) h[1 + i] = (uint8_t)(v >> (56 - 8 * i));
+        n = 9;
+    }
+    put_raw(w, h, n);
+}
+
+void rs3_cbor_put_uint(rs3_cbor_writer_t *w, uint64_t v)
+{
+    put_head(w, RS3_CBOR_UINT, v);
+}
+
+void rs3_cbor_put_int(rs3_cbor_writer_t *w, int64_t v)
+{
+    if (v >= 0) {
+        put_head(w, RS3_CBOR_UINT, (uint64_t)v);
+    } else {
+        put_head(w, RS3_CBOR_NEGINT, (uint64_t)(-1 - v));
+    }
+}
+
+void rs3_cbor_put_bytes(rs3_cbor_writer_t *w, const void *p, size_t n)
+{
+    put_head(w, RS3_CBOR_BYTES, n);
+    put_raw(w, p, n);
+}
+
+void rs3_cbor_put_text_n(rs3_cbor_writer_t *w, const char *s, size_t n)
+{
+    put_head(w, RS3_CBOR_TEXT, n);
+    put_raw(w, s, n);
+}
+
+void rs3_cbor_put_text(rs3_cbor_writer_t *w, const char *s)
+{
+    rs3_cbor_put_text_n(w, s, strlen(s));
+}
+
+void rs3_cbor_put_array(rs3_cbor_writer_t *w, size_t n)
+{
+    put_head(w, RS3_CBOR_ARRAY, n);
+}
+
+void rs3_cbor_put_map(rs3_cbor_writer_t *w, size_t n)
+{
+    put_head(w, RS3_CBOR_MAP, n);
+}
+
+void rs3_cbor_put_bool(rs3_cbor_writer_t *w, bool v)
+{
+    const uint8_t b = v ? 0xF5 : 0xF4;
+    put_raw(w, &b, 1);
+}
+
+void rs3_cbor_put_null(rs3_cbor_writer_t *w)
+{
+    const uint8_t b = 0xF6;
+    put_raw(w, &b, 1);
+}
+
+void rs3_cbor_put_raw(rs3_cbor_writer_t *w, const void *p, size_t n)
+{
+    put_raw(w, p, n);
+}
+
+void rs3_cbor_reader_init(rs3_cbor_reader_t *r, const uint8_t *p, size_t len)
+{
+    r->p = p;
+    r->len = len;
+    r->off = 0;
+    r->error = false;
+}
+
+rs3_cbor_type_t rs3_cbor_peek(const rs3_cbor_reader_t *r)
+{
+    if (r->error) return RS3_CBOR_INVALID;
+    if (r->off >= r->len) return RS3_CBOR_END;
+    const uint8_t major = r->p[r->off] >> 5;
+    return (major == 6) ? RS3_CBOR_INVALID : (rs3_cbor_type_t)major;  // tags not supported
+}
+
+// Reads the head of an item of the given major type; on mismatch nothing is consumed.
+static bool get_head(rs3_cbor_reader_t *r, uint8_t major, uint64_t *arg)
+{
+    if (r->error || r->off >= r->len || (r->p[r->off] >> 5) != major) return false;
+    const uint8_t info = r->p[r->off] & 0x1F;
+    size_t n;
+    if (info < 24) {
+        *arg = info;
+        r->off++;
+        return true;
+    } else if (info <= 27) {
+        n = (size_t)1 << (info - 24);
+    } else {
+        r->error = true;  // indefinite lengths and reserved values
+        return false;
+    }
+    if (r->len - r->off - 1 < n) {
+        r->error = true;
+        return false;
+    }
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; i++) v = v << 8 | r->p[r->off + 1 + i];
+    r->off += 1 + n;
+    *arg = v;
+    return true;
+}
+
+bool rs3_cbor_get_uint(rs3_cbor_reader_t *r, uint64_t *out)
+{
+    return get_head(r, RS3_CBOR_UINT, out);
+}
+
+bool rs3_cbor_get_int(rs3_cbor_reader_t *r, int64_t *out)
+{
+    uint64_t v;
+    const size_t at = r->off;
+    if (get_head(r, RS3_CBOR_UINT, &v)) {
+        if (v > (uint64_t)INT64_MAX) {
+            r->off = at;
+            return false;
+        }
+        *out = (int64_t)v;
+        return true;
+    }
+    if (get_head(r, RS3_CBOR_NEGINT, &v)) {
+        if (v > (uint64_t)INT64_MAX) {
+            r->off = at;
+            return false;
+        }
+        *out = -1 - (int64_t)v;
+        return true;
+    }
+    return false;
+}
+
+static bool get_string(rs3_cbor_reader_t *r, uint8_t major, const uint8_t **p, size_t *n)
+{
+    uint64_t len;
+    const size_t at = r->off;
+    if (!get_head(r, major, &len)) return false;
+    if (len > r->len - r->off) {
+        r->off = at;
+        r->error = true;
+        return false;
+    }
+    *p = r->p + r->off;
+    *n = (size_t)len;
+    r->off += (size_t)len;
+    return true;
+}
+
+bool rs3_cbor_get_text(rs3_cbor_reader_t *r, const char **s, size_t *n)
+{
+    return get_string(r, RS3_CBOR_TEXT, (const uint8_t **)s, n);
+}
+
+bool rs3_cbor_get_bytes(rs3_cbor_reader_t *r, const uint8_t **p, size_t *n)
+{
+    return get_string(r, RS3_CBOR_BYTES, p, n);
+}
+
+bool rs3_cbor_get_array(rs3_cbor_reader_t *r, size_t *n)
+{
+    uint64_t v;
+    if (!get_head(r, RS3_CBOR_ARRAY, &v)) return false;
+    *n = (size_t)v;
+    return true;
+}
+
+bool rs3_cbor_get_map(rs3_cbor_reader_t *r, size_t *n)
+{
+    uint64_t v;
+    if (!get_head(r, RS3_CBOR_MAP, &v)) return false;
+    *n = (size_t)v;
+    return true;
+}
+
+bool rs3_cbor_get_bool(rs3_cbor_reader_t *r, bool *out)
+{
+    if (r->error || r->off >= r->len) return false;
+    const uint8_t b = r->p[r->off];
+    if (b != 0xF4 && b != 0xF5) return false;
+    *out = (b == 0xF5);
+    r->off++;
+    return true;
+}
+
+bool rs3_cbor_get_null(rs3_cbor_reader_t *r)
+{
+    if (r->error || r->off >= r->len || r->p[r->off] != 0xF6) return false;
+    r->off++;
+    return true;
+}
+
+static bool skip_depth(rs3_cbor_reader_t *r, int depth)
+{
+    if (depth > SKIP_DEPTH_MAX) {
+        r->error = true;
+        return false;
+    }
+    const uint8_t *p;
+    size_t n;
+    uint64_t v;
+    switch (rs3_cbor_peek(r)) {
+    case RS3_CBOR_UINT:
+        return get_head(r, RS3_CBOR_UINT, &v);
+    case RS3_CBOR_NEGINT:
+        return get_head(r, RS3_CBOR_NEGINT, &v);
+    case RS3_CBOR_BYTES:
+        return get_string(r, RS3_CBOR_BYTES, &p, &n);
+    case RS3_CBOR_TEXT:
+        return get_string(r, RS3_CBOR_TEXT, &p, &n);
+    case RS3_CBOR_ARRAY:
+    case RS3_CBOR_MAP: {
+        const bool map = (rs3_cbor_peek(r) == RS3_CBOR_MAP);
+        if (!get_head(r, map ? RS3_CBOR_MAP : RS3_CBOR_ARRAY, &v)) return false;
+        const uint64_t items = map ? v * 2 : v;
+        for (uint64_t i = 0; i < items; i++) {
+            if (!skip_depth(r, depth + 1)) return false;
+        }
+        return true;
+    }
+    case RS3_CBOR_SIMPLE:
+        if ((r->p[r->off] & 0x1F) >= 24) {
+            r->error = true;  // floats and extended simple values
+            return false;
+        }
+        r->off++;
+        return true;
+    default:
+        r->error = true;
+        return false;
+    }
+}
+
+bool rs3_cbor_skip(rs3_cbor_reader_t *r)
+{
+    return skip_depth(r, 0);
+}
+
+bool rs3_cbor_text_eq(const char *t, size_t n, const char *s)
+{
+    return strlen(s) == n && memcmp(t, s, n) == 0;
+}
+
+bool rs3_cbor_map_find(const rs3_cbor_reader_t *r, const char *key, rs3_cbor_reader_t *val)
+{
+    rs3_cbor_reader_t m = *r;
+    size_t n;
+    if (!rs3_cbor_get_map(&m, &n)) return false;
+    for (size_t i = 0; i < n; i++) {
+        const char *k;
+        size_t kn;
+        if (!rs3_cbor_get_text(&m, &k, &kn)) return false;
+        if (rs3_cbor_text_eq(k, kn, key)) {
+            *val = m;
+            return true;
+        }
+        if (!rs3_cbor_skip(&m)) return false;
+    }
+    return false;
+}
+
+bool rs3_cbor_get_text_z(rs3_cbor_reader_t *r, char *buf, size_t cap)
+{
+    const size_t at = r->off;
+    const char *s;
+    size_t n;
+    if (!rs3_cbor_get_text(r, &s, &n)) return false;
+    if (n >= cap) {
+        r->off = at;
+        return false;
+    }
+    memcpy(buf, s, n);
+    buf[n] = 0;
+    return true;
+}
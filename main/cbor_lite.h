@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Minimal CBOR (RFC 8949) for the RPC channel: unsigned/negative integers, byte and text strings,
+ * arrays, maps, false/true/null. Definite lengths only; no floats or tags.
+ *
+ * Writers and readers never fail mid-call: a writer that runs out of room sets overflow, a reader
+ * that meets something unexpected sets error; check the flag once at the end.
+ */
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+} rs3_cbor_writer_t;
+
+void rs3_cbor_writer_init(rs3_cbor_writer_t *w, uint8_t *buf, size_t cap);
+void rs3_cbor_put_uint(rs3_cbor_writer_t *w, uint64_t v);
+void rs3_cbor_put_int(rs3_cbor_writer_t *w, int64_t v);
+void rs3_cbor_put_bytes(rs3_cbor_writer_t *w, const void *p, size_t n);
+void rs3_cbor_put_text(rs3_cbor_writer_t *w, const char *s);
+void rs3_cbor_put_text_n(rs3_cbor_writer_t *w, const char *s, size_t n);
+void rs3_cbor_put_array(rs3_cbor_writer_t *w, size_t n);
+void rs3_cbor_put_map(rs3_cbor_writer_t *w, size_t n);
+void rs3_cbor_put_bool(rs3_cbor_writer_t *w, bool v);
+void rs3_cbor_put_null(rs3_cbor_writer_t *w);
+void rs3_cbor_put_raw(rs3_cbor_writer_t *w, const void *p, size_t n);   // already-encoded item(s)
+
+typedef enum {
+    RS3_CBOR_UINT = 0,
+    RS3_CBOR_NEGINT = 1,
+    RS3_CBOR_BYTES = 2,
+    RS3_CBOR_TEXT = 3,
+    RS3_CBOR_ARRAY = 4,
+    RS3_CBOR_MAP = 5,
+    RS3_CBOR_SIMPLE = 7,   // false/true/null
+    RS3_CBOR_END = 8,      // no more input
+    RS3_CBOR_INVALID = 9,
+} rs3_cbor_type_t;
+
+typedef struct {
+    const uint8_t *p;
+    size_t len;
+    size_t off;
+    bool error;
+} rs3_cbor_reader_t;
+
+void rs3_cbor_reader_init(rs3_cbor_reader_t *r, const uint8_t *p, size_t len);
+rs3_cbor_type_t rs3_cbor_peek(const rs3_cbor_reader_t *r);
+bool rs3_cbor_get_int(rs3_cbor_reader_t *r, int64_t *out);   // UINT (up to INT64_MAX) or NEGINT
+bool rs3_cbor_get_uint(rs3_cbor_reader_t *r, uint64_t *out);
+bool rs3_cbor_get_text(rs3_cbor_reader_t *r, const char **s, size_t *n);   // not NUL-terminated
+bool rs3_cbor_get_bytes(rs3_cbor_reader_t *r, const uint8_t **p, size_t *n);
+bool rs3_cbor_get_array(rs3_cbor_reader_t *r, size_t *n);
+bool rs3_cbor_get_map(rs3_cbor_reader_t *r, size_t *n);
+bool rs3_cbor_get_bool(rs3_cbor_reader_t *r, bool *out);
+bool rs3_cbor_get_null(rs3_cbor_reader_t *r);
+bool rs3_cbor_skip(rs3_cbor_reader_t *r);   // one whole item, nested ones included
+
+// Convenience: does the text item just read equal s?
+bool rs3_cbor_text_eq(const char *t, size_t n, const char *s);
+
+// Position val on the value of text key `key` in the map at r; r itself is not consumed.
+bool rs3_cbor_map_find(const rs3_cbor_reader_t *r, const char *key, rs3_cbor_reader_t *val);
+
+// Copy a text item into a NUL-terminated buffer; false (nothing consumed) if it does not fit.
+bool rs3_cbor_get_text_z(rs3_cbor_reader_t *r, char *buf, size_t cap);
@@ -1,22 +1,342 @@
 #include "cmd_tcp.h"
 
 #include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 #include "esp_check.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
 
+#include "crash_log.h"
+#include "fmt_fast.h"
+#include "log_tcp.h"
 #include "ota_update.h"
 #include "tcp_server.h"
 
 static const char *TAG = "cmd_tcp";
 
-static char s_line[256];
+enum { RS3_CMD_LINE_MAX = 256 };
+enum { RS3_CMD_QUEUE_LEN = 4 };
+enum { RS3_CMD_INDEX_MAX = 48 };   // names + aliases
+enum { RS3_CMD_ALIAS_MAX = 4 };
+
+typedef struct {
+    const char *name;   // points into cmd->name or cmd->aliases (not NUL-terminated for aliases)
+    uint8_t len;
+    const rs3_cmd_t *cmd;
+} cmd_entry_t;
+
+// Sorted by name: lookups are a binary search.
+static cmd_entry_t s_index[RS3_CMD_INDEX_MAX];
+static size_t s_index_len = 0;
+static portMUX_TYPE s_index_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static QueueHandle_t s_q = NULL;
+static TaskHandle_t s_task = NULL;
+
+// Only touched by the tcp_server task (rx callback).
+static char s_line[RS3_CMD_LINE_MAX];
 static size_t s_line_len = 0;
 
+static int entry_cmp(const char *name, size_t len, const cmd_entry_t *e)
+{
+    const int c = memcmp(name, e->name, (len < e->len) ? len : e->len);
+    if (c) return c;
+    return (len > e->len) - (len < e->len);
+}
+
+// Index of the entry, or -(insertion point) - 1. Caller holds s_index_lock.
+static int index_find(const char *name, size_t len)
+{
+    int lo = 0;
+    int hi = (int)s_index_len - 1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        const int c = entry_cmp(name, len, &s_index[mid]);
+        if (c == 0) return mid;
+        if (c < 0) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return -lo - 1;
+}
+
+static const rs3_cmd_t *cmd_lookup(const char *name)
+{
+    const size_t len = strlen(name);
+    const rs3_cmd_t *cmd = NULL;
+    portENTER_CRITICAL(&s_index_lock);
+    const int i = index_find(name, len);
+    if (i >= 0) cmd = s_index[i].cmd;
+    portEXIT_CRITICAL(&s_index_lock);
+    return cmd;
+}
+
+esp_err_t rs3_cmd_register(const rs3_cmd_t *cmd)
+{
+    if (!cmd || !cmd->name || !cmd->name[0] || !cmd->handler || cmd->min_args > cmd->max_args) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Name first, then each alias word.
+    const char *names[1 + RS3_CMD_ALIAS_MAX];
+    uint8_t lens[1 + RS3_CMD_ALIAS_MAX];
+    size_t count = 0;
+    names[count] = cmd->name;
+    lens[count++] = (uint8_t)strnlen(cmd->name, UINT8_MAX);
+    for (const char *p = cmd->aliases; p && *p;) {
+        while (*p == ' ') p++;
+        const char *w = p;
+        while (*p && *p != ' ') p++;
+        if (p == w) break;
+        if (count == 1 + RS3_CMD_ALIAS_MAX || p - w > UINT8_MAX) return ESP_ERR_INVALID_ARG;
+        names[count] = w;
+        lens[count++] = (uint8_t)(p - w);
+    }
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_index_lock);
+    if (s_index_len + count > RS3_CMD_INDEX_MAX) {
+        ret = ESP_ERR_NO_MEM;
+    }
+    for (size_t k = 0; k < count && ret == ESP_OK; k++) {
+        if (index_find(names[k], lens[k]) >= 0) ret = ESP_ERR_INVALID_STATE;
+    }
+    for (size_t k = 0; k < count && ret == ESP_OK; k++) {
+        const int at = -index_find(names[k], lens[k]) - 1;
+        memmove(&s_index[at + 1], &s_index[at], (s_index_len - (size_t)at) * sizeof(s_index[0]));
+        s_index[at] = (cmd_entry_t){.name = names[k], .len = lens[k], .cmd = cmd};
+        s_index_len++;
+    }
+    portEXIT_CRITICAL(&s_index_lock);
+    return ret;
+}
+
+static void send_usage(const rs3_cmd_t *cmd)
+{
+    char out[128];
+    snprintf(out, sizeof(out), "ERR: usage: %s%s%s\r\n", cmd->name, cmd->usage ? " " : "", cmd->usage ? cmd->usage : "");
+    rs3_tcp_server_send_str(out);
+}
+
+// help -> one line per command, in name order
+static void handle_help(char *arg, void *user_ctx)
+{
+    (void)arg;
+    (void)user_ctx;
+    char out[192];
+    for (size_t i = 0;; i++) {
+        cmd_entry_t e;
+        portENTER_CRITICAL(&s_index_lock);
+        const bool more = (i < s_index_len);
+        if (more) e = s_index[i];
+        portEXIT_CRITICAL(&s_index_lock);
+        if (!more) break;
+        if (e.name != e.cmd->name) continue;  // alias: listed with its command
+
+        int n = snprintf(out, sizeof(out), "  %-10s %-24s %s", e.cmd->name, e.cmd->usage ? e.cmd->usage : "",
+                         e.cmd->help ? e.cmd->help : "");
+        if (n > 0 && n < (int)sizeof(out) && e.cmd->aliases && e.cmd->aliases[0]) {
+            n += snprintf(out + n, sizeof(out) - (size_t)n, " (also: %s)", e.cmd->aliases);
+        }
+        if (n > 0 && n < (int)sizeof(out)) snprintf(out + n, sizeof(out) - (size_t)n, "\r\n");
+        rs3_tcp_server_send_str(out);
+    }
+}
+
+static void send_log_levels(void)
+{
+    char out[160];
+    int n = 0;
+    for (int i = 0; i < RS3_LOG_TAG_COUNT && n < (int)sizeof(out); i++) {
+        n += snprintf(out + n, sizeof(out) - (size_t)n, "%s=%s ", rs3_log_tag_name((rs3_log_tag_t)i),
+                      rs3_log_level_name((rs3_log_level_t)rs3_log_levels[i]));
+    }
+    if (n < (int)sizeof(out)) {
+        snprintf(out + n, sizeof(out) - (size_t)n, "(max=%s)\r\n", rs3_log_level_name((rs3_log_level_t)CONFIG_RS3_LOG_MAX_LEVEL));
+    }
+    rs3_tcp_server_send_str("LOG: ");
+    rs3_tcp_server_send_str(out);
+}
+
+// loglevel                      -> list
+// loglevel <tag|all> <level>    -> set (level: none/error/warn/info/debug/verbose or 0..5)
+static void handle_loglevel(char *arg, void *user_ctx)
+{
+    (void)user_ctx;
+    if (*arg == 0) {
+        send_log_levels();
+        return;
+    }
+    char *tag = arg;
+    char *lvl = arg;
+    while (*lvl && *lvl != ' ' && *lvl != '\t') lvl++;
+    if (*lvl) {
+        *lvl++ = 0;
+        while (*lvl == ' ' || *lvl == '\t') lvl++;
+    }
+    const bool all = (strcasecmp(tag, "all") == 0 || strcmp(tag, "*") == 0);
+    const int t = all ? 0 : rs3_log_tag_from_name(tag);
+    const int l = rs3_log_level_from_name(lvl);
+    if (t < 0 || l < 0) {
+        rs3_tcp_server_send_str("ERR: usage: loglevel [<ptp|raw|bt|ui|net|ota|seq|all> <none|error|warn|info|debug|verbose>]\r\n");
+        return;
+    }
+    // Levels above the build's maximum are compiled out; store the clamp so the listing is honest.
+    const uint8_t v = (uint8_t)((l > CONFIG_RS3_LOG_MAX_LEVEL) ? CONFIG_RS3_LOG_MAX_LEVEL : l);
+    for (int i = 0; i < RS3_LOG_TAG_COUNT; i++) {
+        if (all || i == t) rs3_log_levels[i] = v;
+    }
+    send_log_levels();
+}
+
+static void dmesg_emit(const char *data, size_t len, void *user_ctx)
+{
+    (void)user_ctx;
+    (void)rs3_tcp_server_send_raw(data, len);  // not mirrored: the dump would feed on itself
+}
+
+// dmesg -> previous boot's crash log (if any), then this boot's
+static void handle_dmesg(char *arg, void *user_ctx)
+{
+    (void)arg;
+    (void)user_ctx;
+#if CONFIG_RS3_CRASHLOG_ENABLE
+    rs3_crash_log_dump_prev(dmesg_emit, NULL);
+    rs3_crash_log_dump_current(dmesg_emit, NULL);
+    // The dump's binary records moved the decoder's clock: the live stream must not continue in deltas.
+    rs3_blog_restamp();
+#else
+    rs3_tcp_server_send_str("ERR: crash log disabled (CONFIG_RS3_CRASHLOG_ENABLE)\r\n");
+#endif
+}
+
+// benchfmt -> ns per call of newlib snprintf vs fmt_fast for the log/UI hot paths
+enum { BENCH_ITERS = 4000 };
+
+static void bench_report(const char *what, int64_t slow_us, int64_t fast_us)
+{
+    char out[96];
+    const uint32_t slow_ns = (uint32_t)(slow_us * 1000 / BENCH_ITERS);
+    const uint32_t fast_ns = (uint32_t)(fast_us * 1000 / BENCH_ITERS);
+    snprintf(out, sizeof(out), "BENCH: %-6s snprintf=%5" PRIu32 " ns  fast=%5" PRIu32 " ns  (x%" PRIu32 ".%" PRIu32 ")\r\n",
+             what, slow_ns, fast_ns, fast_ns ? slow_ns / fast_ns : 0, fast_ns ? (slow_ns * 10 / fast_ns) % 10 : 0);
+    rs3_tcp_server_send_str(out);
+}
+
+static void handle_benchfmt(char *arg, void *user_ctx)
+{
+    (void)arg;
+    (void)user_ctx;
+    static const uint8_t bytes[8] = {0x1C, 0x00, 0x00, 0x00, 0x01, 0x00, 0x07, 0x92};
+    char buf[64];
+    volatile size_t sink = 0;  // keeps the loops from being optimized away
+    rs3_fmt_t f;
+    int64_t t0, t1, t2;
+
+    // "[mmmmmm.uuu] " line prefix
+    t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+        const uint64_t us = (uint64_t)t0 + i * 1237u;
+        sink += (size_t)snprintf(buf, sizeof(buf), "[%06" PRIu32 ".%03" PRIu32 "] ", (uint32_t)(us / 1000ULL),
+                                 (uint32_t)(us % 1000ULL));
+    }
+    t1 = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+        rs3_fmt_init(&f, buf, sizeof(buf));
+        rs3_fmt_ts(&f, (uint64_t)t0 + i * 1237u);
+        sink += f.len;
+    }
+    t2 = esp_timer_get_time();
+    bench_report("ts", t1 - t0, t2 - t1);
+
+    // log_hex8(): 8 bytes "1C 00 00 ..."
+    t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+        size_t off = 0;
+        for (int k = 0; k < 8; k++) off += (size_t)snprintf(buf + off, sizeof(buf) - off, "%02X%s", bytes[k], (k < 7) ? " " : "");
+        sink += off;
+    }
+    t1 = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+        rs3_fmt_init(&f, buf, sizeof(buf));
+        rs3_fmt_hex_bytes(&f, bytes, sizeof(bytes), ' ');
+        sink += f.len;
+    }
+    t2 = esp_timer_get_time();
+    bench_report("hex8", t1 - t0, t2 - t1);
+
+    // Decimal + hex field, like "op=0x9207 tid=123456"
+    t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+        sink += (size_t)snprintf(buf, sizeof(buf), "op=0x%04X tid=%" PRIu32, (unsigned)(0x9200 + (i & 0xF)), 100000 + i);
+    }
+    t1 = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+        rs3_fmt_init(&f, buf, sizeof(buf));
+        rs3_fmt_str(&f, "op=0x");
+        rs3_fmt_hex(&f, 0x9200 + (i & 0xF), 4);
+        rs3_fmt_str(&f, " tid=");
+        rs3_fmt_u32(&f, 100000 + i, 0, ' ');
+        sink += f.len;
+    }
+    t2 = esp_timer_get_time();
+    bench_report("fields", t1 - t0, t2 - t1);
+    (void)sink;
+}
+
+static void handle_ota(char *arg, void *user_ctx)
+{
+    (void)user_ctx;
+    esp_err_t ret = rs3_ota_start((*arg) ? arg : NULL);
+    if (ret == ESP_OK) {
+        rs3_tcp_server_send_str("OTA: started\r\n");
+    } else {
+        rs3_tcp_server_send_str("OTA: failed to start\r\n");
+    }
+}
+
+static void handle_reboot(char *arg, void *user_ctx)
+{
+    (void)arg;
+    (void)user_ctx;
+    rs3_tcp_server_send_str("OK: rebooting\r\n");
+    vTaskDelay(pdMS_TO_TICKS(150));  // worker task: the server keeps draining the reply meanwhile
+    esp_restart();
+}
+
+static const rs3_cmd_t s_builtin[] = {
+    {.name = "help", .aliases = "?", .help = "list commands", .handler = handle_help},
+    {.name = "ota", .usage = "[<url>]", .help = "pull-OTA update (default CONFIG_RS3_OTA_URL)", .max_args = 1,
+     .handler = handle_ota},
+    {.name = "loglevel", .usage = "[<tag|all> <level>]", .help = "show/set per-tag log level", .max_args = 2,
+     .handler = handle_loglevel},
+    {.name = "dmesg", .help = "crash log: previous boot, then this one", .handler = handle_dmesg},
+    {.name = "benchfmt", .help = "snprintf vs fmt_fast, ns per call", .handler = handle_benchfmt},
+    {.name = "reboot", .aliases = "restart reset", .help = "reboot the MCU", .handler = handle_reboot},
+};
+
+static size_t count_words(const char *s)
+{
+    size_t n = 0;
+    while (*s) {
+        while (*s == ' ' || *s == '\t') s++;
+        if (!*s) break;
+        n++;
+        while (*s && *s != ' ' && *s != '\t') s++;
+    }
+    return n;
+}
+
 static void handle_line(char *line)
 {
     // trim leading spaces
@@ -34,28 +354,33 @@ static void handle_line(char *line)
         *arg++ = 0;
         while (*arg == ' ' || *arg == '\t') arg++;
     }
+    size_t arg_len = strlen(arg);
+    while (arg_len && (arg[arg_len - 1] == ' ' || arg[arg_len - 1] == '\t')) arg[--arg_len] = 0;
 
-    if (strcmp(cmd, "ota") == 0) {
-        const char *url = (*arg) ? arg : NULL;
-        esp_err_t ret = rs3_ota_start(url);
-        if (ret == ESP_OK) {
-            rs3_tcp_server_send_str("OTA: started\r\n");
-        } else {
-            rs3_tcp_server_send_str("OTA: failed to start\r\n");
-        }
+    const rs3_cmd_t *c = cmd_lookup(cmd);
+    if (!c) {
+        rs3_tcp_server_send_str("ERR: unknown cmd (try: help)\r\n");
         return;
     }
-
-    if (strcmp(cmd, "reboot") == 0 || strcmp(cmd, "restart") == 0 || strcmp(cmd, "reset") == 0) {
-        rs3_tcp_server_send_str("OK: rebooting\r\n");
-        vTaskDelay(pdMS_TO_TICKS(150));
-        esp_restart();
+    const size_t argc = count_words(arg);
+    if (argc < c->min_args || (c->max_args != RS3_CMD_ARGS_ANY && argc > c->max_args)) {
+        send_usage(c);
         return;
     }
+    c->handler(arg, c->user_ctx);
+}
 
-    rs3_tcp_server_send_str("ERR: unknown cmd\r\n");
+static void cmd_task(void *arg)
+{
+    (void)arg;
+    char line[RS3_CMD_LINE_MAX];
+    while (1) {
+        if (xQueueReceive(s_q, line, portMAX_DELAY) != pdTRUE) continue;
+        handle_line(line);
+    }
 }
 
+// tcp_server task: only split lines and hand them over; never run a command here.
 static void rx_cb(const uint8_t *data, size_t len, void *user_ctx)
 {
     (void)user_ctx;
@@ -63,7 +388,9 @@ static void rx_cb(const uint8_t *data, size_t len, void *user_ctx)
         char c = (char)data[i];
         if (c == '\n') {
             s_line[s_line_len] = 0;
-            handle_line(s_line);
+            if (s_line_len && xQueueSend(s_q, s_line, 0) != pdTRUE) {
+                rs3_tcp_server_send_str("ERR: busy\r\n");
+            }
             s_line_len = 0;
             continue;
         }
@@ -76,9 +403,15 @@ static void rx_cb(const uint8_t *data, size_t len, void *user_ctx)
 
 esp_err_t rs3_cmd_tcp_start(void)
 {
+    if (s_task) return ESP_OK;
+    for (size_t i = 0; i < sizeof(s_builtin) / sizeof(s_builtin[0]); i++) {
+        ESP_RETURN_ON_ERROR(rs3_cmd_register(&s_builtin[i]), TAG, "register %s", s_builtin[i].name);
+    }
+    s_q = xQueueCreate(RS3_CMD_QUEUE_LEN, RS3_CMD_LINE_MAX);
+    if (!s_q) return ESP_ERR_NO_MEM;
+    // Below tcp_server (4): command work never delays log draining.
+    if (xTaskCreate(cmd_task, "cmd_tcp", 4096, NULL, 3, &s_task) != pdPASS) return ESP_ERR_NO_MEM;
     rs3_tcp_server_set_rx_cb(rx_cb, NULL);
-    ESP_LOGI(TAG, "TCP command handler ready (send: ota <url>, reboot)");
+    ESP_LOGI(TAG, "TCP command handler ready (send: help)");
     return ESP_OK;
 }
-
-
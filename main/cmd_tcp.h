@@ -1,10 +1,52 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "esp_err.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
- * @brief Register TCP command handler (listens for "ota" commands on the TCP server connection).
+ * Console command registry.
+ *
+ * Lines received on the TCP console are queued (a few lines deep) to a worker task that looks the
+ * first word up in a sorted name table and runs the handler there, so slow commands never stall
+ * log draining or accept in the tcp_server task. A full queue answers "ERR: busy".
+ *
+ * Handlers reply with rs3_tcp_server_send_str() (goes to every console client). Modules register
+ * their own commands, before or after rs3_cmd_tcp_start(); `help` lists them all.
  */
-esp_err_t rs3_cmd_tcp_start(void);
 
+#define RS3_CMD_ARGS_ANY 0xFF  // max_args: no upper limit (rest of the line is free text)
+
+typedef void (*rs3_cmd_handler_t)(char *arg, void *user_ctx);
+
+typedef struct {
+    const char *name;       // lowercase, one word
+    const char *aliases;    // optional, space-separated ("restart reset")
+    const char *usage;      // argument schema for help and usage errors ("[<url>]"); NULL = none
+    const char *help;       // one line
+    uint8_t min_args;       // whitespace-separated words after the name, checked before dispatch
+    uint8_t max_args;
+    rs3_cmd_handler_t handler;  // arg: rest of the line, trimmed ("" when none); writable
+    void *user_ctx;
+} rs3_cmd_t;
+
+/**
+ * @brief Add a command (and its aliases) to the registry. The descriptor is kept by pointer.
+ *
+ * @return ESP_ERR_INVALID_STATE if a name is already taken, ESP_ERR_NO_MEM if the table is full.
+ */
+esp_err_t rs3_cmd_register(const rs3_cmd_t *cmd);
+
+/**
+ * @brief Start the command worker and hook it to the TCP server; registers the built-in commands
+ *        (help, ota, loglevel, dmesg, benchfmt, reboot).
+ */
+esp_err_t rs3_cmd_tcp_start(void);
 
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,294 @@
+#include "crash_log.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+
+#ifndef CONFIG_RS3_CRASHLOG_SIZE
+#define CONFIG_RS3_CRASHLOG_SIZE 4096
+#endif
+
+static const char *TAG = "crash_log";
+
+enum { CL_MAGIC = 0x52533344 };  // "RS3D": framed units (was "RS3C", raw bytes)
+enum { CL_EMIT_CHUNK = 512 };    // keeps each console record small
+enum { CL_UNIT_HDR = 2 };        // u16 LE length in front of every unit
+enum { CL_BLOG_SYNC = 0x1E, CL_BLOG_TS_OFF = 6 };  // binary record: 0x1E, len, u32 id, time varint
+
+// The ring holds units: one console write each (a text line or a whole binary record), framed by
+// its length so the oldest surviving unit is always known. Replay starts on a unit boundary, and
+// binary records keep a time base: base_us is the time of the last binary record pushed out.
+typedef struct {
+    uint32_t magic;
+    uint32_t gen;         // boot generation, counts software resets since the last power-on
+    uint32_t gen_check;   // ~gen: random power-on contents match magic and this only by chance
+    uint32_t head;        // bytes written in this generation (units and their headers)
+    uint32_t tail;        // start of the oldest unit still in the ring
+    uint64_t base_us;     // time of the newest binary record before tail (0: none yet)
+    char buf[CONFIG_RS3_CRASHLOG_SIZE];
+} crash_ring_t;
+
+static RTC_NOINIT_ATTR crash_ring_t s_rtc;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_ready = false;
+
+static char *s_prev = NULL;   // previous generation, oldest byte first
+static size_t s_prev_len = 0;
+static uint32_t s_prev_gen = 0;
+static esp_reset_reason_t s_reason = ESP_RST_UNKNOWN;
+
+static const char *reset_name(esp_reset_reason_t r)
+{
+    switch (r) {
+    case ESP_RST_POWERON: return "power-on";
+    case ESP_RST_EXT: return "external pin";
+    case ESP_RST_SW: return "esp_restart";
+    case ESP_RST_PANIC: return "panic";
+    case ESP_RST_INT_WDT: return "interrupt watchdog";
+    case ESP_RST_TASK_WDT: return "task watchdog";
+    case ESP_RST_WDT: return "watchdog";
+    case ESP_RST_DEEPSLEEP: return "deep sleep";
+    case ESP_RST_BROWNOUT: return "brownout";
+    case ESP_RST_SDIO: return "sdio";
+    default: return "unknown";
+    }
+}
+
+// Room for the unit payloads plus a first binary record whose delta time becomes absolute.
+enum { CL_COPY_MAX = CONFIG_RS3_CRASHLOG_SIZE + 16 };
+
+static inline uint8_t ring_at(const crash_ring_t *r, uint32_t pos)
+{
+    return (uint8_t)r->buf[pos % CONFIG_RS3_CRASHLOG_SIZE];
+}
+
+static void ring_get(char *dst, const crash_ring_t *r, uint32_t pos, size_t len)
+{
+    const size_t size = CONFIG_RS3_CRASHLOG_SIZE;
+    const size_t off = pos % size;
+    const size_t first = (len < size - off) ? len : size - off;
+    memcpy(dst, r->buf + off, first);
+    if (first < len) memcpy(dst + first, r->buf, len - first);
+}
+
+static uint32_t unit_len(const crash_ring_t *r, uint32_t pos)
+{
+    return (uint32_t)ring_at(r, pos) | ((uint32_t)ring_at(r, pos + 1) << 8);
+}
+
+// Time field of the binary record at pos (a unit's payload): raw varint value, length in *n.
+static uint64_t blog_time(const crash_ring_t *r, uint32_t pos, uint32_t len, size_t *n)
+{
+    uint64_t v = 0;
+    *n = 0;
+    for (uint32_t i = CL_BLOG_TS_OFF; i < len && *n < 10; i++) {
+        const uint8_t b = ring_at(r, pos + i);
+        v |= (uint64_t)(b & 0x7F) << (7 * (*n)++);
+        if (!(b & 0x80)) break;
+    }
+    return v;
+}
+
+static uint64_t blog_time_after(uint64_t base_us, uint64_t t)
+{
+    return (t & 1) ? (t >> 1) : base_us + (t >> 1);
+}
+
+static size_t put_varint(uint8_t *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+// Copy the units of a ring, oldest first, without their headers (dst: CL_COPY_MAX bytes). Once
+// older units were pushed out, the first binary record may carry a delta time whose base is gone:
+// it is rewritten with its absolute time. Returns the number of bytes copied.
+static size_t ring_copy_out(char *dst, const crash_ring_t *r)
+{
+    size_t n = 0;
+    bool based = false;
+    for (uint32_t pos = r->tail; pos + CL_UNIT_HDR <= r->head;) {
+        const uint32_t len = unit_len(r, pos);
+        const uint32_t at = pos + CL_UNIT_HDR;
+        pos = at + len;
+        if (pos > r->head) break;  // torn unit (reset mid-write)
+        if (!based && len > CL_BLOG_TS_OFF && ring_at(r, at) == CL_BLOG_SYNC) {
+            based = true;
+            size_t tn = 0;
+            const uint64_t t = blog_time(r, at, len, &tn);
+            uint8_t ts[10];
+            const size_t ts_len = put_varint(ts, (blog_time_after(r->base_us, t) << 1) | 1);
+            const size_t rec_len = ring_at(r, at + 1) + ts_len - tn;  // record length byte
+            if (!(t & 1) && tn && rec_len <= 0xFF) {
+                ring_get(dst + n, r, at, CL_BLOG_TS_OFF);
+                dst[n + 1] = (char)rec_len;
+                memcpy(dst + n + CL_BLOG_TS_OFF, ts, ts_len);
+                n += CL_BLOG_TS_OFF + ts_len;
+                const uint32_t rest = len - CL_BLOG_TS_OFF - (uint32_t)tn;
+                ring_get(dst + n, r, at + len - rest, rest);
+                n += rest;
+                continue;
+            }
+        }
+        ring_get(dst + n, r, at, len);
+        n += len;
+    }
+    return n;
+}
+
+static char *alloc_buf(size_t n)
+{
+    char *p = NULL;
+#if CONFIG_SPIRAM
+    p = heap_caps_malloc(n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    if (!p) p = heap_caps_malloc(n, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    return p;
+}
+
+esp_err_t rs3_crash_log_init(void)
+{
+#if !CONFIG_RS3_CRASHLOG_ENABLE
+    return ESP_OK;
+#else
+    if (s_ready) return ESP_OK;
+
+    s_reason = esp_reset_reason();
+    const bool valid = (s_reason != ESP_RST_POWERON) && s_rtc.magic == CL_MAGIC && s_rtc.gen_check == ~s_rtc.gen;
+    if (valid && s_rtc.head > s_rtc.tail && s_rtc.head - s_rtc.tail <= CONFIG_RS3_CRASHLOG_SIZE) {
+        const size_t n = CL_COPY_MAX;
+        s_prev = alloc_buf(n);
+        if (s_prev) {
+            s_prev_len = ring_copy_out(s_prev, &s_rtc);
+            s_prev_gen = s_rtc.gen;
+        } else {
+            ESP_LOGW(TAG, "no memory for the previous boot's log (%u bytes)", (unsigned)n);
+        }
+    }
+
+    s_rtc.gen = valid ? s_rtc.gen + 1 : 1;
+    s_rtc.gen_check = ~s_rtc.gen;
+    s_rtc.head = 0;
+    s_rtc.tail = 0;
+    s_rtc.base_us = 0;
+    s_rtc.magic = CL_MAGIC;
+    s_ready = true;
+    ESP_LOGI(TAG, "boot %" PRIu32 " (reset: %s), previous log %u bytes", s_rtc.gen, reset_name(s_reason),
+             (unsigned)s_prev_len);
+    return ESP_OK;
+#endif
+}
+
+static void ring_put(const void *src, size_t len)
+{
+    const size_t size = CONFIG_RS3_CRASHLOG_SIZE;
+    const size_t off = s_rtc.head % size;
+    const size_t first = (len < size - off) ? len : size - off;
+    memcpy(s_rtc.buf + off, src, first);
+    if (first < len) memcpy(s_rtc.buf, (const char *)src + first, len - first);
+    s_rtc.head += (uint32_t)len;
+}
+
+void rs3_crash_log_write(const char *data, size_t len)
+{
+    if (!s_ready || !data || len == 0) return;
+    const size_t room = CONFIG_RS3_CRASHLOG_SIZE - CL_UNIT_HDR;
+    if (len > room) {
+        data += len - room;  // only text gets this long: keep its end
+        len = room;
+    }
+    const uint8_t hdr[CL_UNIT_HDR] = {(uint8_t)len, (uint8_t)(len >> 8)};
+    taskENTER_CRITICAL(&s_lock);
+    // Push out whole units until this one fits; binary ones carry the time base forward.
+    while (s_rtc.head + CL_UNIT_HDR + len - s_rtc.tail > CONFIG_RS3_CRASHLOG_SIZE) {
+        const uint32_t at = s_rtc.tail + CL_UNIT_HDR;
+        const uint32_t ulen = unit_len(&s_rtc, s_rtc.tail);
+        if (ulen > CL_BLOG_TS_OFF && ring_at(&s_rtc, at) == CL_BLOG_SYNC) {
+            size_t tn;
+            s_rtc.base_us = blog_time_after(s_rtc.base_us, blog_time(&s_rtc, at, ulen, &tn));
+        }
+        s_rtc.tail = at + ulen;
+    }
+    ring_put(hdr, sizeof(hdr));
+    ring_put(data, len);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+bool rs3_crash_log_has_prev(void)
+{
+    return s_prev_len > 0;
+}
+
+static void emit_chunks(rs3_crash_log_emit_t emit, void *user_ctx, const char *p, size_t n)
+{
+    while (n) {
+        const size_t k = (n < CL_EMIT_CHUNK) ? n : CL_EMIT_CHUNK;
+        emit(p, k, user_ctx);
+        p += k;
+        n -= k;
+    }
+}
+
+static void emit_marker(rs3_crash_log_emit_t emit, void *user_ctx, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static void emit_marker(rs3_crash_log_emit_t emit, void *user_ctx, const char *fmt, ...)
+{
+    char line[128];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n > 0) emit(line, ((size_t)n < sizeof(line)) ? (size_t)n : sizeof(line) - 1, user_ctx);
+}
+
+// The end marker starts on a line of its own even if the log was cut mid-line.
+static const char *eol_fix(const char *p, size_t n)
+{
+    return (n && p[n - 1] == '\n') ? "" : "\r\n";
+}
+
+void rs3_crash_log_dump_prev(rs3_crash_log_emit_t emit, void *user_ctx)
+{
+    if (!s_prev_len) {
+        emit_marker(emit, user_ctx, "[CRASHLOG] no log from a previous boot\r\n");
+        return;
+    }
+    emit_marker(emit, user_ctx, "[CRASHLOG] ---- boot %" PRIu32 " (ended by: %s), last %u bytes ----\r\n",
+                s_prev_gen, reset_name(s_reason), (unsigned)s_prev_len);
+    emit_chunks(emit, user_ctx, s_prev, s_prev_len);
+    emit_marker(emit, user_ctx, "%s[CRASHLOG] ---- end of boot %" PRIu32 " ----\r\n", eol_fix(s_prev, s_prev_len), s_prev_gen);
+}
+
+void rs3_crash_log_dump_current(rs3_crash_log_emit_t emit, void *user_ctx)
+{
+    if (!s_ready) {
+        emit_marker(emit, user_ctx, "[CRASHLOG] disabled\r\n");
+        return;
+    }
+    char *tmp = alloc_buf(CL_COPY_MAX);
+    if (!tmp) {
+        emit_marker(emit, user_ctx, "[CRASHLOG] no memory\r\n");
+        return;
+    }
+    // Snapshot under the lock, emit without it: producers are not held off by the dump.
+    taskENTER_CRITICAL(&s_lock);
+    const uint32_t gen = s_rtc.gen;
+    const size_t n = ring_copy_out(tmp, &s_rtc);
+    taskEXIT_CRITICAL(&s_lock);
+
+    emit_marker(emit, user_ctx, "[CRASHLOG] ---- boot %" PRIu32 " (current), last %u bytes ----\r\n", gen, (unsigned)n);
+    emit_chunks(emit, user_ctx, tmp, n);
+    emit_marker(emit, user_ctx, "%s[CRASHLOG] ---- end of boot %" PRIu32 " so far ----\r\n", eol_fix(tmp, n), gen);
+    heap_caps_free(tmp);
+}
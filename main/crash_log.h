@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifndef CONFIG_RS3_CRASHLOG_ENABLE
+#define CONFIG_RS3_CRASHLOG_ENABLE 0
+#endif
+
+/**
+ * Crash-surviving copy of the TCP console log.
+ *
+ * Every byte that goes to the console (already formatted) is also appended to a ring in
+ * RTC no-init memory, which keeps its contents across panics, watchdog resets and esp_restart()
+ * (not across power loss). At boot the previous generation is copied aside; the console replays
+ * it once to the first client and `dmesg` prints it (and the current one) on demand.
+ */
+
+typedef void (*rs3_crash_log_emit_t)(const char *data, size_t len, void *user_ctx);
+
+/**
+ * @brief Adopt the previous boot's log (if the RTC ring is valid) and start a new generation.
+ * Call early in app_main(), before anything logs.
+ */
+esp_err_t rs3_crash_log_init(void);
+
+/**
+ * @brief Append one console write as a unit (called by rs3_tcp_server_send()/_enqueue()). Cheap: a
+ * memcpy under a spinlock, plus pushing out the oldest units once the ring is full.
+ */
+void rs3_crash_log_write(const char *data, size_t len);
+
+/**
+ * @brief True if a previous boot's log was recovered.
+ */
+bool rs3_crash_log_has_prev(void);
+
+/**
+ * @brief Emit the previous boot's log between "[CRASHLOG] ---- boot N ..." markers.
+ */
+void rs3_crash_log_dump_prev(rs3_crash_log_emit_t emit, void *user_ctx);
+
+/**
+ * @brief Emit what this boot has logged so far (the part still in the ring).
+ */
+void rs3_crash_log_dump_current(rs3_crash_log_emit_t emit, void *user_ctx);
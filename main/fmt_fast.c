@@ -0,0 +1,116 @@
+#include "fmt_fast.h"
+
+#include <string.h>
+
+static const char s_hex[16] = "0123456789ABCDEF";
+
+// "00".."99": one table lookup per two decimal digits.
+static const char s_dec2[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9',
+};
+
+void rs3_fmt_init(rs3_fmt_t *f, char *buf, size_t cap)
+{
+    f->buf = buf;
+    f->cap = cap;
+    f->len = 0;
+    f->overflow = (cap == 0);
+    if (cap) buf[0] = 0;
+}
+
+// Room for n more characters (plus the NUL); clips n and flags overflow if it does not fit.
+static inline size_t room(rs3_fmt_t *f, size_t n)
+{
+    const size_t left = (f->cap > f->len) ? f->cap - f->len - 1 : 0;
+    if (n > left) {
+        f->overflow = true;
+        return left;
+    }
+    return n;
+}
+
+void rs3_fmt_mem(rs3_fmt_t *f, const char *s, size_t n)
+{
+    n = room(f, n);
+    if (!n) return;
+    memcpy(f->buf + f->len, s, n);
+    f->len += n;
+    f->buf[f->len] = 0;
+}
+
+void rs3_fmt_str(rs3_fmt_t *f, const char *s)
+{
+    if (s) rs3_fmt_mem(f, s, strlen(s));
+}
+
+void rs3_fmt_char(rs3_fmt_t *f, char c)
+{
+    rs3_fmt_mem(f, &c, 1);
+}
+
+void rs3_fmt_u32(rs3_fmt_t *f, uint32_t v, unsigned width, char pad)
+{
+    char tmp[10];  // 4294967295
+    char *p = tmp + sizeof(tmp);
+    while (v >= 100) {
+        const unsigned i = (v % 100) * 2;
+        v /= 100;
+        *--p = s_dec2[i + 1];
+        *--p = s_dec2[i];
+    }
+    if (v >= 10) {
+        *--p = s_dec2[v * 2 + 1];
+        *--p = s_dec2[v * 2];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    const size_t n = (size_t)(tmp + sizeof(tmp) - p);
+    for (size_t k = n; k < width; k++) rs3_fmt_char(f, pad);
+    rs3_fmt_mem(f, p, n);
+}
+
+void rs3_fmt_i32(rs3_fmt_t *f, int32_t v)
+{
+    if (v < 0) {
+        rs3_fmt_char(f, '-');
+        rs3_fmt_u32(f, 0u - (uint32_t)v, 0, ' ');
+    } else {
+        rs3_fmt_u32(f, (uint32_t)v, 0, ' ');
+    }
+}
+
+void rs3_fmt_hex(rs3_fmt_t *f, uint32_t v, unsigned digits)
+{
+    char tmp[8];
+    if (digits < 1) digits = 1;
+    if (digits > 8) digits = 8;
+    for (unsigned i = digits; i-- > 0; v >>= 4) tmp[i] = s_hex[v & 0xF];
+    rs3_fmt_mem(f, tmp, digits);
+}
+
+void rs3_fmt_hex_bytes(rs3_fmt_t *f, const uint8_t *p, size_t n, char sep)
+{
+    for (size_t i = 0; i < n; i++) {
+        char tmp[3] = { s_hex[p[i] >> 4], s_hex[p[i] & 0xF], sep };
+        rs3_fmt_mem(f, tmp, (sep && i + 1 < n) ? 3 : 2);
+        if (f->overflow) return;
+    }
+}
+
+void rs3_fmt_ts(rs3_fmt_t *f, uint64_t us)
+{
+    rs3_fmt_char(f, '[');
+    rs3_fmt_u32(f, (uint32_t)(us / 1000ULL), 6, '0');
+    rs3_fmt_char(f, '.');
+    rs3_fmt_u32(f, (uint32_t)(us % 1000ULL), 3, '0');
+    rs3_fmt_mem(f, "] ", 2);
+}
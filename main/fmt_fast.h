@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Small formatting primitives for hot logging and UI paths.
+ *
+ * A builder appends straight into the caller's buffer and keeps it NUL-terminated; output that
+ * does not fit is cut off and sets `overflow` (like snprintf, but without parsing a format string
+ * or going through newlib's locale/stdio machinery). Hex is table-driven, decimal converts two
+ * digits per step.
+ *
+ *   char line[64];
+ *   rs3_fmt_t f;
+ *   rs3_fmt_init(&f, line, sizeof(line));
+ *   rs3_fmt_str(&f, "op=0x");
+ *   rs3_fmt_hex(&f, op, 4);
+ *   send(line, f.len);
+ */
+typedef struct {
+    char *buf;
+    size_t cap;     // including the NUL
+    size_t len;     // characters written, excluding the NUL
+    bool overflow;
+} rs3_fmt_t;
+
+/**
+ * @brief Start building into buf (cap >= 1).
+ */
+void rs3_fmt_init(rs3_fmt_t *f, char *buf, size_t cap);
+
+void rs3_fmt_mem(rs3_fmt_t *f, const char *s, size_t n);
+void rs3_fmt_str(rs3_fmt_t *f, const char *s);
+void rs3_fmt_char(rs3_fmt_t *f, char c);
+
+/**
+ * @brief Unsigned decimal, right-aligned in at least `width` characters padded with `pad`
+ * (width 0 = as many digits as needed).
+ */
+void rs3_fmt_u32(rs3_fmt_t *f, uint32_t v, unsigned width, char pad);
+void rs3_fmt_i32(rs3_fmt_t *f, int32_t v);
+
+/**
+ * @brief Upper-case hex with exactly `digits` digits (1..8), like "%0*X".
+ */
+void rs3_fmt_hex(rs3_fmt_t *f, uint32_t v, unsigned digits);
+
+/**
+ * @brief Bytes as upper-case hex pairs separated by `sep` (0 = no separator): "01 A2 FF".
+ */
+void rs3_fmt_hex_bytes(rs3_fmt_t *f, const uint8_t *p, size_t n, char sep);
+
+/**
+ * @brief Log line prefix "[mmmmmm.uuu] " (milliseconds since boot, microsecond fraction), the
+ * same text rs3_tcp_vlogf() used to produce with "[%06" PRIu32 ".%03" PRIu32 "] ".
+ */
+void rs3_fmt_ts(rs3_fmt_t *f, uint64_t us);
@@ -3,35 +3,128 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <string.h>
+#include <strings.h>
 
+#include "crash_log.h"
+#include "esp_log.h"
 #include "esp_timer.h"
+#include "fmt_fast.h"
+#include "freertos/FreeRTOS.h"
 #include "tcp_server.h"
 
-void rs3_tcp_vlogf(const char *fmt, va_list ap)
+// -----------------------------
+// Tags / levels
+// -----------------------------
+
+uint8_t rs3_log_levels[RS3_LOG_TAG_COUNT] = {
+    [0 ... RS3_LOG_TAG_COUNT - 1] = CONFIG_RS3_LOG_DEFAULT_LEVEL,
+};
+
+static const char *const s_tag_names[RS3_LOG_TAG_COUNT] = {
+    [RS3_LOG_TAG_PTP] = "ptp",
+    [RS3_LOG_TAG_RAW] = "raw",
+    [RS3_LOG_TAG_BT] = "bt",
+    [RS3_LOG_TAG_UI] = "ui",
+    [RS3_LOG_TAG_NET] = "net",
+    [RS3_LOG_TAG_OTA] = "ota",
+    [RS3_LOG_TAG_SEQ] = "seq",
+};
+
+static const char *const s_level_names[] = {"none", "error", "warn", "info", "debug", "verbose"};
+
+const char *rs3_log_tag_name(rs3_log_tag_t tag)
+{
+    return ((unsigned)tag < RS3_LOG_TAG_COUNT) ? s_tag_names[tag] : NULL;
+}
+
+const char *rs3_log_level_name(rs3_log_level_t level)
+{
+    return ((unsigned)level <= RS3_LOG_VERBOSE) ? s_level_names[level] : NULL;
+}
+
+int rs3_log_tag_from_name(const char *name)
 {
-    char msg[256];
-    int n = vsnprintf(msg, sizeof(msg), fmt, ap);
-    if (n <= 0) return;
-    if (n > (int)sizeof(msg)) n = (int)sizeof(msg);
+    for (int i = 0; i < RS3_LOG_TAG_COUNT; i++) {
+        if (strcasecmp(name, s_tag_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+int rs3_log_level_from_name(const char *name)
+{
+    if (name[0] >= '0' && name[0] <= '5' && name[1] == 0) return name[0] - '0';
+    for (int i = 0; i <= RS3_LOG_VERBOSE; i++) {
+        if (strcasecmp(name, s_level_names[i]) == 0) return i;
+    }
+    return -1;
+}
 
+// -----------------------------
+// Text lines
+// -----------------------------
+
+// Format one console line: "[ms.us] " + message; returns its length (0: nothing to send).
+// crlf: end it in exactly one "\r\n" (ESP_LOGx output ends in a bare "\n"; truncated lines get
+// one too).
+static size_t format_line(char *out, size_t cap, const char *fmt, va_list ap, bool crlf)
+{
     // Prefix every line with milliseconds since boot to spot timing gaps/timeouts easily.
     // Example: "[012345.678] ..."
-    char out[300];
-    const uint64_t us = (uint64_t)esp_timer_get_time();
-    const uint32_t ms = (uint32_t)(us / 1000ULL);
-    const uint32_t frac = (uint32_t)(us % 1000ULL);
-    int h = snprintf(out, sizeof(out), "[%06" PRIu32 ".%03" PRIu32 "] ", ms, frac);
-    if (h < 0) return;
-    if (h > (int)sizeof(out)) h = (int)sizeof(out);
+    rs3_fmt_t f;
+    rs3_fmt_init(&f, out, cap);
+    rs3_fmt_ts(&f, (uint64_t)esp_timer_get_time());
 
-    size_t to_copy = (size_t)n;
-    if ((size_t)h + to_copy > sizeof(out)) {
-        to_copy = sizeof(out) - (size_t)h;
+    // The message goes straight behind the prefix: no second buffer, no copy.
+    int n = vsnprintf(out + f.len, cap - f.len, fmt, ap);
+    if (n <= 0) return 0;
+    size_t len = f.len + (size_t)n;
+    if (len > cap - 1) len = cap - 1;
+    if (crlf) {
+        if (len > cap - 2) len = cap - 2;
+        while (len > f.len && (out[len - 1] == '\n' || out[len - 1] == '\r')) len--;
+        out[len++] = '\r';
+        out[len++] = '\n';
     }
-    memcpy(out + h, msg, to_copy);
-    (void)rs3_tcp_server_send(out, (size_t)h + to_copy);
+    return len;
 }
 
+static void vlog_line(const char *fmt, va_list ap, bool crlf)
+{
+    char out[300];
+    const size_t len = format_line(out, sizeof(out), fmt, ap, crlf);
+    if (len) (void)rs3_tcp_server_send(out, len);
+}
+
+bool rs3_log_uart_wanted(void)
+{
+    return rs3_tcp_server_client_id() == 0;
+}
+
+void rs3_log_uart_fallback(const char *fmt, ...)
+{
+    char out[300];
+    va_list ap;
+    va_start(ap, fmt);
+    const size_t len = format_line(out, sizeof(out), fmt, ap, false);
+    va_end(ap);
+    if (!len) return;
+    // Same line for the console side: the crash log, or a client that connected since the check.
+    const bool client = rs3_tcp_server_client_id() != 0;
+    if (client || CONFIG_RS3_CRASHLOG_ENABLE) (void)rs3_tcp_server_send(out, len);
+    // Someone is on the console: it gets the line, and the UART would only stall the caller.
+    if (!client) (void)fwrite(out, 1, len, stdout);  // stdout, not esp_log: the capture hook would queue it again
+}
+
+void rs3_tcp_vlogf(const char *fmt, va_list ap)
+{
+    // Nobody listening: skip the formatting too, unless the crash log keeps the line.
+    if (!rs3_tcp_server_client_id() && !CONFIG_RS3_CRASHLOG_ENABLE) return;
+    vlog_line(fmt, ap, false);
+}
+
+// In binary mode rs3_tcp_logf is a macro for call sites; the function stays for everything else.
+#undef rs3_tcp_logf
+
 void rs3_tcp_logf(const char *fmt, ...)
 {
     va_list ap;
@@ -40,4 +133,175 @@ void rs3_tcp_logf(const char *fmt, ...)
     va_end(ap);
 }
 
+// -----------------------------
+// ESP_LOGx capture (CONFIG_RS3_LOG_ESP_LOG)
+// -----------------------------
+
+#if CONFIG_RS3_LOG_ESP_LOG
+static vprintf_like_t s_esp_log_uart = NULL;
+static __thread bool s_in_esp_log = false;  // per task: set while this task's line is being queued
+
+static int esp_log_vprintf(const char *fmt, va_list ap)
+{
+    const bool client = rs3_tcp_server_client_id() != 0;
+    int ret = 0;
+    // UART only when nobody is on the console (or asked for): it blocks the logging task.
+    if (s_esp_log_uart && (!client || CONFIG_RS3_LOG_ESP_LOG_UART || s_in_esp_log)) {
+        va_list ap2;
+        va_copy(ap2, ap);
+        ret = s_esp_log_uart(fmt, ap2);
+        va_end(ap2);
+    }
+    // A log call from inside the console path would loop back here: UART only.
+    if (s_in_esp_log || (!client && !CONFIG_RS3_CRASHLOG_ENABLE)) return ret;
+
+    s_in_esp_log = true;
+    vlog_line(fmt, ap, true);
+    s_in_esp_log = false;
+    return ret;
+}
+#endif
+
+void rs3_tcp_log_capture_esp_log(void)
+{
+#if CONFIG_RS3_LOG_ESP_LOG
+    if (s_esp_log_uart) return;
+    s_esp_log_uart = esp_log_set_vprintf(esp_log_vprintf);
+#endif
+}
+
+// -----------------------------
+// Rate limiting
+// -----------------------------
+
+enum {
+    RL_INTERVAL_US = 1000000 / CONFIG_RS3_LOG_RL_PER_SEC,
+    RL_SLACK_US = (CONFIG_RS3_LOG_RL_BURST - 1) * RL_INTERVAL_US,
+};
+
+static portMUX_TYPE s_rl_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool rs3_log_rl_take(rs3_log_rl_t *rl, rs3_log_tag_t tag)
+{
+    // Nobody would see the line: leave the budget and the counter alone.
+    if (!rs3_tcp_server_client_id() && !CONFIG_RS3_CRASHLOG_ENABLE) return false;
+
+    const uint64_t now = (uint64_t)esp_timer_get_time();
+    uint32_t report = 0;
+    bool ok;
+    taskENTER_CRITICAL(&s_rl_lock);
+    if (rl->tat_us < now) rl->tat_us = now;
+    ok = (rl->tat_us - now <= RL_SLACK_US);
+    if (ok) {
+        rl->tat_us += RL_INTERVAL_US;
+        report = rl->suppressed;
+        rl->suppressed = 0;
+    } else {
+        rl->suppressed++;
+    }
+    taskEXIT_CRITICAL(&s_rl_lock);
+
+    if (report) rs3_tcp_logf("[LOG] %s: suppressed %" PRIu32 " similar\r\n", rs3_log_tag_name(tag), report);
+    return ok;
+}
+
+// -----------------------------
+// Binary records (CONFIG_RS3_LOG_BINARY)
+// -----------------------------
+
+enum { BLOG_ABS_EVERY_US = 1000000 };
+
+static portMUX_TYPE s_blog_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint64_t s_blog_last_us = 0;
+static uint64_t s_blog_abs_us = 0;
+static uint32_t s_blog_client = 0;  // connection the last record went to
+static bool s_blog_restamp = false;
 
+bool rs3_blog_begin(rs3_blog_t *w)
+{
+    if (!rs3_tcp_server_client_id() && !CONFIG_RS3_CRASHLOG_ENABLE) return false;
+    w->n = RS3_BLOG_HDR_ROOM;
+    w->overflow = false;
+    return true;
+}
+
+void rs3_blog_f(rs3_blog_t *w, double v)
+{
+    if (w->n + sizeof(v) > sizeof(w->buf)) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->n, &v, sizeof(v));  // Xtensa/RISC-V are little-endian
+    w->n += sizeof(v);
+}
+
+void rs3_blog_s(rs3_blog_t *w, const char *s)
+{
+    size_t len = s ? strnlen(s, RS3_BLOG_STR_MAX) : 0;
+    if (w->n + 1 + len > sizeof(w->buf)) {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->n++] = (uint8_t)len;  // varint: RS3_BLOG_STR_MAX < 128 fits in one byte
+    if (len) memcpy(w->buf + w->n, s, len);
+    w->n += len;
+}
+
+void rs3_blog_check_fmt(const char *fmt, ...)
+{
+    (void)fmt;
+}
+
+static size_t put_varint(uint8_t *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+void rs3_blog_end(rs3_blog_t *w, uint32_t id)
+{
+    if (w->overflow) return;  // a truncated record could not be decoded
+
+    uint8_t ts[10];
+    taskENTER_CRITICAL(&s_blog_lock);
+    const uint32_t client = rs3_tcp_server_client_id();
+    const uint64_t now = (uint64_t)esp_timer_get_time();
+    // Absolute time for the first record of a connection and then once a second; deltas otherwise.
+    const bool abs = (client != s_blog_client) || s_blog_restamp || (now - s_blog_abs_us >= BLOG_ABS_EVERY_US);
+    const size_t ts_len = put_varint(ts, abs ? ((now << 1) | 1) : ((now - s_blog_last_us) << 1));
+
+    uint8_t *p = w->buf + RS3_BLOG_HDR_ROOM - (2 + 4 + ts_len);
+    p[0] = 0x1E;
+    p[1] = (uint8_t)(w->buf + w->n - p - 2);
+    p[2] = (uint8_t)id;
+    p[3] = (uint8_t)(id >> 8);
+    p[4] = (uint8_t)(id >> 16);
+    p[5] = (uint8_t)(id >> 24);
+    memcpy(p + 6, ts, ts_len);
+    // Stamp and enqueue under one lock so records reach the ring in timestamp order; the server
+    // task is woken after the lock is released (the eventfd write must not run in a critical section).
+    // Without a client the record still reached the crash log, whose stream needs the same timeline.
+    const esp_err_t err = rs3_tcp_server_enqueue((const char *)p, (size_t)(w->buf + w->n - p));
+    if (err == ESP_OK || CONFIG_RS3_CRASHLOG_ENABLE) {
+        s_blog_last_us = now;
+        if (abs) {
+            s_blog_abs_us = now;
+            s_blog_client = client;
+            s_blog_restamp = false;
+        }
+    }
+    taskEXIT_CRITICAL(&s_blog_lock);
+    if (err == ESP_OK) rs3_tcp_server_wake();
+}
+
+void rs3_blog_restamp(void)
+{
+    taskENTER_CRITICAL(&s_blog_lock);
+    s_blog_restamp = true;
+    taskEXIT_CRITICAL(&s_blog_lock);
+}
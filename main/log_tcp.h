@@ -1,6 +1,36 @@
 #pragma once
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#ifndef CONFIG_RS3_LOG_BINARY
+#define CONFIG_RS3_LOG_BINARY 0
+#endif
+#ifndef CONFIG_RS3_LOG_MAX_LEVEL
+#define CONFIG_RS3_LOG_MAX_LEVEL 5
+#endif
+#ifndef CONFIG_RS3_LOG_DEFAULT_LEVEL
+#define CONFIG_RS3_LOG_DEFAULT_LEVEL CONFIG_RS3_LOG_MAX_LEVEL
+#endif
+#ifndef CONFIG_RS3_LOG_ESP_LOG
+#define CONFIG_RS3_LOG_ESP_LOG 0
+#endif
+#ifndef CONFIG_RS3_LOG_ESP_LOG_UART
+#define CONFIG_RS3_LOG_ESP_LOG_UART 0
+#endif
+#ifndef CONFIG_RS3_LOG_UART_FALLBACK
+#define CONFIG_RS3_LOG_UART_FALLBACK 0
+#endif
+#ifndef CONFIG_RS3_LOG_RL_PER_SEC
+#define CONFIG_RS3_LOG_RL_PER_SEC 20
+#endif
+#ifndef CONFIG_RS3_LOG_RL_BURST
+#define CONFIG_RS3_LOG_RL_BURST 10
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -8,16 +38,272 @@ extern "C" {
 
 /**
  * @brief Best-effort printf to the current TCP client (non-blocking, drops if no client).
+ *
+ * With CONFIG_RS3_LOG_BINARY this name is a macro (see below): the format string must be a
+ * literal and the arguments are only evaluated while a client is connected.
  */
 void rs3_tcp_logf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
 
 /**
- * @brief va_list variant.
+ * @brief va_list variant (always formatted on the device).
  */
 void rs3_tcp_vlogf(const char *fmt, va_list ap);
 
+/**
+ * @brief Send ESP_LOGx output (IDF components, NimBLE, our own modules) down the same path, so the
+ * console has every subsystem on one timeline (CONFIG_RS3_LOG_ESP_LOG; no-op otherwise).
+ *
+ * Lines are queued without blocking. UART keeps getting them only while no console client is
+ * connected (or with CONFIG_RS3_LOG_ESP_LOG_UART). Call once, early in app_main().
+ */
+void rs3_tcp_log_capture_esp_log(void);
+
+/*
+ * Tagged log levels.
+ *
+ *   RS3_LOGI(BT, "[BT] connected handle=%u\r\n", h);
+ *
+ * Levels above CONFIG_RS3_LOG_MAX_LEVEL are compiled out (format string and argument evaluation
+ * included); the rest are checked against a per-tag runtime threshold (`loglevel` TCP command).
+ * The "[TAG]" text prefix stays in the format: rs3_log_analyze.py keys on it.
+ */
+typedef enum {
+    RS3_LOG_NONE = 0,
+    RS3_LOG_ERROR,
+    RS3_LOG_WARN,
+    RS3_LOG_INFO,
+    RS3_LOG_DEBUG,    // per-transaction / per-packet lines
+    RS3_LOG_VERBOSE,  // hex dumps
+} rs3_log_level_t;
+
+typedef enum {
+    RS3_LOG_TAG_PTP = 0,  // PTP emulation, USB device, REC events
+    RS3_LOG_TAG_RAW,      // raw PTP proxy bulk path
+    RS3_LOG_TAG_BT,       // Nikon BLE remote
+    RS3_LOG_TAG_UI,       // touch/LCD
+    RS3_LOG_TAG_NET,      // proxy/tap TCP servers
+    RS3_LOG_TAG_OTA,
+    RS3_LOG_TAG_SEQ,      // on-device sequence runner
+    RS3_LOG_TAG_COUNT,
+} rs3_log_tag_t;
+
+extern uint8_t rs3_log_levels[RS3_LOG_TAG_COUNT];
+
+/** @brief Tag/level names ("ptp", "debug", ...); NULL when out of range. */
+const char *rs3_log_tag_name(rs3_log_tag_t tag);
+const char *rs3_log_level_name(rs3_log_level_t level);
+
+/** @brief Case-insensitive lookup; -1 if unknown. Levels also accept a digit 0..5. */
+int rs3_log_tag_from_name(const char *name);
+int rs3_log_level_from_name(const char *name);
+
+/**
+ * @brief RS3_LOGx line (error..info) while no TCP console client is connected
+ * (CONFIG_RS3_LOG_UART_FALLBACK): with Wi-Fi or the console down, UART is the only place
+ * connect/disconnect and failure lines can be seen. Formats the line once for UART and for
+ * whatever rs3_tcp_logf() would have fed (the crash log, a client that just connected).
+ */
+void rs3_log_uart_fallback(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/** @brief True while error..info lines should take rs3_log_uart_fallback(): no console client. */
+bool rs3_log_uart_wanted(void);
+
+#define rs3_log_enabled(tag, level)                                                             \
+    ((level) <= CONFIG_RS3_LOG_MAX_LEVEL && (level) <= rs3_log_levels[RS3_LOG_TAG_##tag])
+
+// One of the two calls runs: the arguments are evaluated once.
+#define RS3_LOG_AT(tag, level, fmt, ...) do {                                                   \
+    if (rs3_log_enabled(tag, level)) {                                                          \
+        if (CONFIG_RS3_LOG_UART_FALLBACK && (level) <= RS3_LOG_INFO && rs3_log_uart_wanted()) { \
+            rs3_log_uart_fallback(fmt, ##__VA_ARGS__);                                          \
+        } else {                                                                                \
+            rs3_tcp_logf(fmt, ##__VA_ARGS__);                                                   \
+        }                                                                                       \
+    }                                                                                           \
+} while (0)
+
+#define RS3_LOGE(tag, fmt, ...) RS3_LOG_AT(tag, RS3_LOG_ERROR, fmt, ##__VA_ARGS__)
+#define RS3_LOGW(tag, fmt, ...) RS3_LOG_AT(tag, RS3_LOG_WARN, fmt, ##__VA_ARGS__)
+#define RS3_LOGI(tag, fmt, ...) RS3_LOG_AT(tag, RS3_LOG_INFO, fmt, ##__VA_ARGS__)
+#define RS3_LOGD(tag, fmt, ...) RS3_LOG_AT(tag, RS3_LOG_DEBUG, fmt, ##__VA_ARGS__)
+#define RS3_LOGV(tag, fmt, ...) RS3_LOG_AT(tag, RS3_LOG_VERBOSE, fmt, ##__VA_ARGS__)
+
+/*
+ * Rate-limited variants for lines that fire per packet or per poll.
+ *
+ *   RS3_LOGD_RL(RAW, "[RAW] <- OUT bytes=%u\r\n", n);
+ *
+ * Every call site has its own token bucket: CONFIG_RS3_LOG_RL_PER_SEC lines per second on average,
+ * bursts of up to CONFIG_RS3_LOG_RL_BURST. Lines over budget are only counted; the site's next line
+ * is preceded by "[LOG] <tag>: suppressed N similar". RS3_LOG_RL_PASS() puts a group of lines (a line
+ * and its hex dump) under one budget:
+ *
+ *   if (RS3_LOG_RL_PASS(RAW, RS3_LOG_DEBUG)) { RS3_LOGD(RAW, ...); log_hex8(...); }
+ */
+typedef struct {
+    uint64_t tat_us;      // earliest time the bucket is full again (GCRA "theoretical arrival time")
+    uint32_t suppressed;  // lines dropped since the last one that went out
+} rs3_log_rl_t;
+
+/** @brief Take a token for this call site; false = suppress the line. Reports earlier suppressions. */
+bool rs3_log_rl_take(rs3_log_rl_t *rl, rs3_log_tag_t tag);
+
+#define RS3_LOG_RL_PASS(tag, level) __extension__({                                             \
+    static rs3_log_rl_t rs3_log_rl_;                                                            \
+    rs3_log_enabled(tag, level) && rs3_log_rl_take(&rs3_log_rl_, RS3_LOG_TAG_##tag);            \
+})
+
+#define RS3_LOG_RL_AT(tag, level, fmt, ...) do {                                                \
+    if (RS3_LOG_RL_PASS(tag, level)) rs3_tcp_logf(fmt, ##__VA_ARGS__);                          \
+} while (0)
+
+#define RS3_LOGE_RL(tag, fmt, ...) RS3_LOG_RL_AT(tag, RS3_LOG_ERROR, fmt, ##__VA_ARGS__)
+#define RS3_LOGW_RL(tag, fmt, ...) RS3_LOG_RL_AT(tag, RS3_LOG_WARN, fmt, ##__VA_ARGS__)
+#define RS3_LOGI_RL(tag, fmt, ...) RS3_LOG_RL_AT(tag, RS3_LOG_INFO, fmt, ##__VA_ARGS__)
+#define RS3_LOGD_RL(tag, fmt, ...) RS3_LOG_RL_AT(tag, RS3_LOG_DEBUG, fmt, ##__VA_ARGS__)
+#define RS3_LOGV_RL(tag, fmt, ...) RS3_LOG_RL_AT(tag, RS3_LOG_VERBOSE, fmt, ##__VA_ARGS__)
+
+/*
+ * Binary deferred logging (CONFIG_RS3_LOG_BINARY).
+ *
+ * A call site sends its id (RS3_BLOG_FILE_ID << 16 | __LINE__) and the raw argument values; the
+ * text is rebuilt on the PC by scripts/rs3_blog_decode.py from the dictionary that
+ * scripts/rs3_blog_dict.py extracts from the sources at build time (build/rs3_blog_dict.json).
+ *
+ * Record on the TCP console stream (between ordinary text):
+ *   0x1E               record start (ASCII RS, never part of log text)
+ *   u8                 length of the rest
+ *   u32 LE             id
+ *   varint             time: (abs_us << 1) | 1, or (delta_us from the previous record) << 1
+ *   per argument       integers: zigzag varint, strings: varint length + bytes, doubles: 8 bytes LE
+ */
+enum {
+    RS3_BLOG_HDR_ROOM = 16,  // 0x1E + len + id + longest time varint
+    RS3_BLOG_ARGS_MAX = 160,
+    RS3_BLOG_STR_MAX = 64,
+};
+
+typedef struct {
+    uint8_t buf[RS3_BLOG_HDR_ROOM + RS3_BLOG_ARGS_MAX];
+    size_t n;
+    bool overflow;
+} rs3_blog_t;
+
+/** @brief Start a record; false (skip the arguments) when nobody is connected. */
+bool rs3_blog_begin(rs3_blog_t *w);
+/** @brief Stamp and queue the record. */
+void rs3_blog_end(rs3_blog_t *w, uint32_t id);
+/** @brief Give the next record an absolute time (after a dump with its own time base, e.g. dmesg). */
+void rs3_blog_restamp(void);
+
+static inline void rs3_blog_varint(rs3_blog_t *w, uint64_t v)
+{
+    if (w->n + 10 > sizeof(w->buf)) {
+        w->overflow = true;
+        return;
+    }
+    while (v >= 0x80) {
+        w->buf[w->n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    w->buf[w->n++] = (uint8_t)v;
+}
+
+static inline void rs3_blog_i(rs3_blog_t *w, int64_t v)
+{
+    rs3_blog_varint(w, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static inline void rs3_blog_u(rs3_blog_t *w, uint64_t v)
+{
+    rs3_blog_varint(w, v << 1);
+}
+
+static inline void rs3_blog_p(rs3_blog_t *w, const void *p)
+{
+    rs3_blog_varint(w, (uint64_t)(uintptr_t)p << 1);
+}
+
+void rs3_blog_f(rs3_blog_t *w, double v);
+void rs3_blog_s(rs3_blog_t *w, const char *s);
+
+/** @brief Never called: lets the compiler keep checking binary-mode formats against arguments. */
+void rs3_blog_check_fmt(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifndef RS3_BLOG_FILE_ID
+#define RS3_BLOG_FILE_ID 0  // set per source file by main/CMakeLists.txt
+#endif
+
 #ifdef __cplusplus
+#include <type_traits>
+
+template <typename T>
+static inline void rs3_blog_put(rs3_blog_t *w, T v)
+{
+    if constexpr (std::is_enum_v<T>) {
+        rs3_blog_put(w, static_cast<std::underlying_type_t<T>>(v));
+    } else if constexpr (std::is_same_v<T, bool> || (std::is_integral_v<T> && std::is_unsigned_v<T>)) {
+        rs3_blog_u(w, (uint64_t)v);
+    } else if constexpr (std::is_integral_v<T>) {
+        rs3_blog_i(w, (int64_t)v);
+    } else if constexpr (std::is_floating_point_v<T>) {
+        rs3_blog_f(w, (double)v);
+    } else if constexpr (std::is_convertible_v<T, const char *>) {
+        rs3_blog_s(w, v);
+    } else {
+        rs3_blog_p(w, (const void *)v);
+    }
+}
+
+template <typename... A>
+static inline void rs3_blog_put_all(rs3_blog_t *w, A... a)
+{
+    (rs3_blog_put(w, a), ...);
+    (void)w;
 }
+
+#define RS3_BLOG_EACH(w, ...) rs3_blog_put_all(w, ##__VA_ARGS__);
+#else
+#define RS3_BLOG_PUT(w, x) _Generic((x),                                                          \
+    _Bool: rs3_blog_u, char: rs3_blog_i, signed char: rs3_blog_i, unsigned char: rs3_blog_u,      \
+    short: rs3_blog_i, unsigned short: rs3_blog_u, int: rs3_blog_i, unsigned int: rs3_blog_u,     \
+    long: rs3_blog_i, unsigned long: rs3_blog_u, long long: rs3_blog_i,                           \
+    unsigned long long: rs3_blog_u, float: rs3_blog_f, double: rs3_blog_f,                        \
+    char *: rs3_blog_s, const char *: rs3_blog_s, default: rs3_blog_p)((w), (x));
+
+#define RS3_BLOG_NARGS(...) RS3_BLOG_NARGS_(0, ##__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define RS3_BLOG_NARGS_(z, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, n, ...) n
+#define RS3_BLOG_CAT(a, b) RS3_BLOG_CAT_(a, b)
+#define RS3_BLOG_CAT_(a, b) a##b
+#define RS3_BLOG_EACH(w, ...) RS3_BLOG_CAT(RS3_BLOG_EACH_, RS3_BLOG_NARGS(__VA_ARGS__))(w, ##__VA_ARGS__)
+#define RS3_BLOG_EACH_0(w)
+#define RS3_BLOG_EACH_1(w, a) RS3_BLOG_PUT(w, a)
+#define RS3_BLOG_EACH_2(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_1(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_3(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_2(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_4(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_3(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_5(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_4(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_6(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_5(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_7(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_6(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_8(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_7(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_9(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_8(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_10(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_9(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_11(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_10(w, __VA_ARGS__)
+#define RS3_BLOG_EACH_12(w, a, ...) RS3_BLOG_PUT(w, a) RS3_BLOG_EACH_11(w, __VA_ARGS__)
 #endif
 
+#define RS3_BLOG(fmt, ...) do {                                                     \
+    rs3_blog_t rs3_blog_w_;                                                         \
+    if (rs3_blog_begin(&rs3_blog_w_)) {                                             \
+        RS3_BLOG_EACH(&rs3_blog_w_, ##__VA_ARGS__)                                  \
+        rs3_blog_end(&rs3_blog_w_, ((uint32_t)(RS3_BLOG_FILE_ID) << 16) | __LINE__); \
+    }                                                                               \
+    if (0) rs3_blog_check_fmt(fmt, ##__VA_ARGS__);                                  \
+} while (0)
 
+#if CONFIG_RS3_LOG_BINARY
+#define rs3_tcp_logf(fmt, ...) RS3_BLOG(fmt, ##__VA_ARGS__)
+#endif
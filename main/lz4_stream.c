@@ -0,0 +1,138 @@
+#include "lz4_stream.h"
+
+#include <string.h>
+
+#include "sdkconfig.h"
+
+#include "esp_heap_caps.h"
+
+enum {
+    HASH_BITS = 10,
+    MIN_MATCH = 4,
+    LAST_LITERALS = 5,   // LZ4 block rules: the last 5 bytes are literals...
+    MF_LIMIT = 12,       // ...and the last match starts at least 12 bytes before the end
+    HIST_CAP = RS3_LZ4S_WINDOW + RS3_LZ4S_BLOCK,
+};
+
+_Static_assert(HIST_CAP < 0xFFFF, "hash table stores 16-bit positions");
+
+static void *alloc_fast(size_t n)
+{
+    // Internal RAM first: the compressor touches every byte and the table at random.
+    void *p = heap_caps_malloc(n, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#if CONFIG_SPIRAM
+    if (!p) p = heap_caps_malloc(n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    return p;
+}
+
+esp_err_t rs3_lz4s_init(rs3_lz4s_t *z)
+{
+    z->hist = alloc_fast(HIST_CAP);
+    z->table = alloc_fast(sizeof(uint16_t) << HASH_BITS);
+    if (!z->hist || !z->table) {
+        rs3_lz4s_free(z);
+        return ESP_ERR_NO_MEM;
+    }
+    z->hist_len = 0;
+    memset(z->table, 0, sizeof(uint16_t) << HASH_BITS);
+    return ESP_OK;
+}
+
+void rs3_lz4s_free(rs3_lz4s_t *z)
+{
+    heap_caps_free(z->hist);
+    heap_caps_free(z->table);
+    z->hist = NULL;
+    z->table = NULL;
+    z->hist_len = 0;
+}
+
+uint8_t *rs3_lz4s_begin(rs3_lz4s_t *z)
+{
+    if (z->hist_len + RS3_LZ4S_BLOCK > HIST_CAP) {
+        const size_t shift = z->hist_len - RS3_LZ4S_WINDOW;
+        memmove(z->hist, z->hist + shift, RS3_LZ4S_WINDOW);
+        z->hist_len = RS3_LZ4S_WINDOW;
+        for (size_t i = 0; i < ((size_t)1 << HASH_BITS); i++) {
+            z->table[i] = (z->table[i] > shift) ? (uint16_t)(z->table[i] - shift) : 0;
+        }
+    }
+    return z->hist + z->hist_len;
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash4(const uint8_t *p)
+{
+    return (read32(p) * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static uint8_t *put_len(uint8_t *op, size_t len)
+{
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t *put_sequence(uint8_t *op, const uint8_t *lit, size_t lit_len, size_t offset, size_t match_len)
+{
+    uint8_t *token = op++;
+    *token = (uint8_t)(((lit_len >= 15) ? 15 : lit_len) << 4);
+    if (lit_len >= 15) op = put_len(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (match_len == 0) return op;  // last sequence: literals only
+
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    const size_t ml = match_len - MIN_MATCH;
+    *token |= (uint8_t)((ml >= 15) ? 15 : ml);
+    if (ml >= 15) op = put_len(op, ml - 15);
+    return op;
+}
+
+size_t rs3_lz4s_end(rs3_lz4s_t *z, size_t n, uint8_t *dst)
+{
+    uint8_t *const h = z->hist;
+    const size_t start = z->hist_len;
+    const size_t end = start + n;
+    size_t ip = start;
+    size_t anchor = start;
+    uint8_t *op = dst;
+
+    if (n >= MF_LIMIT + 1) {
+        const size_t match_limit = end - LAST_LITERALS;
+        while (ip + MF_LIMIT <= end) {
+            const uint32_t hv = hash4(h + ip);
+            const size_t ref1 = z->table[hv];
+            z->table[hv] = (uint16_t)(ip + 1);
+            if (ref1 == 0 || read32(h + ref1 - 1) != read32(h + ip)) {
+                ip++;
+                continue;
+            }
+            size_t ref = ref1 - 1;
+            // Grow the match backwards over pending literals, then forwards.
+            while (ip > anchor && ref > 0 && h[ip - 1] == h[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            size_t len = MIN_MATCH;
+            while (ip + len < match_limit && h[ref + len] == h[ip + len]) len++;
+
+            op = put_sequence(op, h + anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+            // Keep the table fresh inside long matches without hashing every byte.
+            if (ip + MF_LIMIT <= end) z->table[hash4(h + ip - 2)] = (uint16_t)(ip - 2 + 1);
+        }
+    }
+    op = put_sequence(op, h + anchor, end - anchor, 0, 0);
+    z->hist_len = end;
+    return (size_t)(op - dst);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/**
+ * Streaming LZ4 compressor for the console (`zlog on`).
+ *
+ * Input is compressed in blocks of up to RS3_LZ4S_BLOCK bytes; every block is a standard LZ4 block
+ * (token/literals/offset/match sequences) whose matches may also reach back into the previous
+ * RS3_LZ4S_WINDOW bytes of the stream, so a decoder keeps the tail of what it has output as the
+ * dictionary (lz4.block.decompress(..., dict=...) or scripts/rs3_zlog.py). Repetitive log text
+ * ("[RAW] -> IN bytes=...") mostly turns into matches against the previous lines.
+ *
+ * RAM: RS3_LZ4S_WINDOW + RS3_LZ4S_BLOCK of history and a 2 KiB hash table per stream.
+ *
+ * Usage: write up to RS3_LZ4S_BLOCK new bytes at rs3_lz4s_begin(), then rs3_lz4s_end() compresses
+ * them into dst (at least RS3_LZ4S_BOUND bytes).
+ */
+#ifndef RS3_LZ4S_WINDOW
+#define RS3_LZ4S_WINDOW 2048
+#endif
+#define RS3_LZ4S_BLOCK 1024
+#define RS3_LZ4S_BOUND (RS3_LZ4S_BLOCK + RS3_LZ4S_BLOCK / 255 + 16)
+
+typedef struct {
+    uint8_t *hist;     // [RS3_LZ4S_WINDOW + RS3_LZ4S_BLOCK]: dictionary, then the block being compressed
+    size_t hist_len;
+    uint16_t *table;   // hash of 4 bytes -> hist position + 1 (0 = empty)
+} rs3_lz4s_t;
+
+esp_err_t rs3_lz4s_init(rs3_lz4s_t *z);
+void rs3_lz4s_free(rs3_lz4s_t *z);
+
+/**
+ * @brief Where the next block's bytes go (room for RS3_LZ4S_BLOCK). Slides the window if needed.
+ */
+uint8_t *rs3_lz4s_begin(rs3_lz4s_t *z);
+
+/**
+ * @brief Compress the n bytes written at rs3_lz4s_begin() into dst; returns the compressed size.
+ */
+size_t rs3_lz4s_end(rs3_lz4s_t *z, size_t n, uint8_t *dst);
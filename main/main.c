@@ -10,12 +10,16 @@
 #include "ui_status.h"
 #include "tcp_server.h"
 #include "cmd_tcp.h"
+#include "rpc_server.h"
+#include "seq_runner.h"
+#include "time_sync.h"
 #include "ota_update.h"
 #include "usb_ptp_cam.h"
 #include "ptp_proxy_server.h"
 #include "rec_events.h"
 #include "nikon_bt.h"
 #include "log_tcp.h"
+#include "crash_log.h"
 
 #include "esp_chip_info.h"
 #include "esp_flash.h"
@@ -43,8 +47,8 @@ static void rec_bt_cb(const rs3_rec_event_t *ev, void *ctx)
     // Trigger Nikon shutter on each RS3 REC button full-press (PTP 0x9207).
     // RS3 sends alternating START/STOP events; we want a shutter click on both.
     if (ev->kind == RS3_REC_EVT_START || ev->kind == RS3_REC_EVT_STOP) {
-        rs3_tcp_logf("[REC] %s -> BT shutter\r\n",
-                     (ev->kind == RS3_REC_EVT_START) ? "start" : "stop");
+        RS3_LOGI(PTP, "[REC] %s -> BT shutter\r\n",
+                      (ev->kind == RS3_REC_EVT_START) ? "start" : "stop");
         (void)rs3_nikon_bt_shutter_click();
     }
 }
@@ -55,6 +59,9 @@ void app_main(void)
     ESP_LOGI(TAG, "Target: %s", CONFIG_IDF_TARGET);
 
     // ---- System services ----
+    // First: adopts the previous boot's console log before anything overwrites it.
+    ESP_ERROR_CHECK(rs3_crash_log_init());
+    rs3_tcp_log_capture_esp_log();
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_ERROR_CHECK(nvs_flash_erase());
@@ -138,6 +145,13 @@ void app_main(void)
     ESP_ERROR_CHECK(rs3_tcp_server_start());
     ESP_ERROR_CHECK(rs3_cmd_tcp_start());
 
+    // ---- RPC control channel (separate port) ----
+    ESP_ERROR_CHECK(rs3_rpc_server_start());
+    ESP_ERROR_CHECK(rs3_time_sync_start());
+
+    // ---- Sequence runner (timed action scripts; `seq` / seq.*) ----
+    ESP_ERROR_CHECK(rs3_seq_start());
+
     // ---- PTP proxy TCP (separate port) ----
     ESP_ERROR_CHECK(rs3_ptp_proxy_server_start());
 
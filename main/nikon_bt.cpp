@@ -1,14 +1,16 @@
 #include "nikon_bt.h"
 
 #include <inttypes.h>
-#include <stdarg.h>
 #include <stddef.h>
 #include <string.h>
 
 #include "esp_err.h"
 #include "esp_log.h"
 
+#include "cmd_tcp.h"
 #include "log_tcp.h"
+#include "rpc_server.h"
+#include "tcp_server.h"
 #include "ui_status.h"
 
 #include "esp_random.h"
@@ -145,6 +147,7 @@ typedef enum {
     CMD_SHUTTER_CLICK,
     CMD_CONNECT_CANDIDATE,
     CMD_REMOTE_SESSION_INIT,
+    CMD_CONNECT_LAST,
 } nikon_cmd_kind_t;
 
 typedef struct {
@@ -161,27 +164,12 @@ static void ui_bt_line(const char *s)
     (void)rs3_ui_status_bt_line(s);
 }
 
-static void bt_tcp_vlogf(const char *fmt, va_list ap)
-{
-    rs3_tcp_vlogf(fmt, ap);
-}
-
-static void bt_tcp_logf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
-static void bt_tcp_logf(const char *fmt, ...)
-{
-    va_list ap;
-    va_start(ap, fmt);
-    bt_tcp_vlogf(fmt, ap);
-    va_end(ap);
-}
-
 static void nvs_save_last_peer(const ble_addr_t &peer)
 {
     nvs_handle_t h = 0;
     esp_err_t err = nvs_open(kNvsNs, NVS_READWRITE, &h);
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "nvs_open failed: %s", esp_err_to_name(err));
-        bt_tcp_logf("[BT] nvs_open failed: %s\r\n", esp_err_to_name(err));
+        RS3_LOGW(BT, "[BT] nvs_open failed: %s\r\n", esp_err_to_name(err));
         return;
     }
 
@@ -195,16 +183,14 @@ static void nvs_save_last_peer(const ble_addr_t &peer)
 
     err = nvs_set_blob(h, kNvsKeyLastPeer, &sp, sizeof(sp));
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "nvs_set_blob failed: %s", esp_err_to_name(err));
-        bt_tcp_logf("[BT] nvs_set_blob failed: %s\r\n", esp_err_to_name(err));
+        RS3_LOGW(BT, "[BT] nvs_set_blob failed: %s\r\n", esp_err_to_name(err));
         (void)nvs_close(h);
         return;
     }
 
     err = nvs_commit(h);
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "nvs_commit failed: %s", esp_err_to_name(err));
-        bt_tcp_logf("[BT] nvs_commit failed: %s\r\n", esp_err_to_name(err));
+        RS3_LOGW(BT, "[BT] nvs_commit failed: %s\r\n", esp_err_to_name(err));
     }
     nvs_close(h);
 }
@@ -253,8 +239,7 @@ static void log_addr(const char *prefix, const ble_addr_t &a)
              "%02X:%02X:%02X:%02X:%02X:%02X (t=%u)",
              a.val[5], a.val[4], a.val[3], a.val[2], a.val[1], a.val[0],
              (unsigned)a.type);
-    ESP_LOGI(TAG, "%s%s", prefix, buf);
-    bt_tcp_logf("[BT] %s%s\r\n", prefix, buf);
+    RS3_LOGI(BT, "[BT] %s%s\r\n", prefix, buf);
 }
 
 static void schedule_reconnect(uint32_t delay_ms);
@@ -306,8 +291,7 @@ static int gap_event(struct ble_gap_event *event, void *arg)
             s_backoff_ms = 1000;
             s_fast_connect_attempt = false;
             s_remote_session_ready = false;
-            ESP_LOGI(TAG, "connected (handle=%u)", s_conn_handle);
-            bt_tcp_logf("[BT] connected handle=%u\r\n", s_conn_handle);
+            RS3_LOGI(BT, "[BT] connected handle=%u\r\n", s_conn_handle);
             ui_bt_line("BT: connected");
             stop_reconnect();
 
@@ -333,11 +317,10 @@ static int gap_event(struct ble_gap_event *event, void *arg)
             const bool was_fast = s_fast_connect_attempt;
             s_fast_connect_attempt = false;
             s_last_connect_status = event->connect.status;
-            ESP_LOGW(TAG, "connect failed: status=%d", event->connect.status);
-            bt_tcp_logf("[BT] connect failed status=%d\r\n", event->connect.status);
+            RS3_LOGW(BT, "[BT] connect failed status=%d\r\n", event->connect.status);
             ui_bt_line("BT: connect failed");
             if (was_fast) {
-                bt_tcp_logf("[BT] fast connect failed -> scan\r\n");
+                RS3_LOGW(BT, "[BT] fast connect failed -> scan\r\n");
                 start_scan_for_nikon(30000);
             } else {
                 schedule_reconnect(s_backoff_ms);
@@ -347,8 +330,7 @@ static int gap_event(struct ble_gap_event *event, void *arg)
         return 0;
     }
     case BLE_GAP_EVENT_DISCONNECT: {
-        ESP_LOGW(TAG, "disconnected: reason=%d", event->disconnect.reason);
-        bt_tcp_logf("[BT] disconnected reason=%d\r\n", event->disconnect.reason);
+        RS3_LOGW(BT, "[BT] disconnected reason=%d\r\n", event->disconnect.reason);
         s_conn_handle = BLE_HS_CONN_HANDLE_NONE;
         s_pairing_in_progress = false;
         s_remote_session_ready = false;
@@ -416,8 +398,7 @@ static int gap_event(struct ble_gap_event *event, void *arg)
 
             log_addr("scan match, addr=", s_scan_candidate);
             if (has_dev_id) {
-                ESP_LOGI(TAG, "scan match device_id_le=0x%08" PRIx32, dev_id_le);
-                bt_tcp_logf("[BT] scan match device_id_le=0x%08" PRIx32 "\r\n", dev_id_le);
+                RS3_LOGI(BT, "[BT] scan match device_id_le=0x%08" PRIx32 "\r\n", dev_id_le);
             }
 
             // Stop any pending reconnect loop now that we have a candidate.
@@ -437,7 +418,7 @@ static int gap_event(struct ble_gap_event *event, void *arg)
         if (!s_scan_have_candidate) {
             // No candidate found — try again with backoff.
             ui_bt_line("BT: scan timeout");
-            bt_tcp_logf("[BT] scan timeout\r\n");
+            RS3_LOGW(BT, "[BT] scan timeout\r\n");
             schedule_reconnect(s_backoff_ms);
             s_backoff_ms = (s_backoff_ms < 30000) ? (s_backoff_ms * 2) : 30000;
         }
@@ -453,8 +434,8 @@ static int gap_event(struct ble_gap_event *event, void *arg)
             (void)os_mbuf_copydata(n->om, 0, rx.len, &rx.msg);
             // Always log first bytes for debugging.
             uint8_t b0 = rx.msg.stage;
-            bt_tcp_logf("[BT] notify_rx handle=%u len=%u b0=0x%02X\r\n",
-                        (unsigned)n->attr_handle, (unsigned)OS_MBUF_PKTLEN(n->om), b0);
+            RS3_LOGD_RL(BT, "[BT] notify_rx handle=%u len=%u b0=0x%02X\r\n",
+                            (unsigned)n->attr_handle, (unsigned)OS_MBUF_PKTLEN(n->om), b0);
 
             if (n->attr_handle == s_pair_val_handle && s_pair_rx_q != nullptr) {
                 (void)xQueueSend(s_pair_rx_q, &rx, 0);
@@ -463,8 +444,7 @@ static int gap_event(struct ble_gap_event *event, void *arg)
         return 0;
     }
     case BLE_GAP_EVENT_ENC_CHANGE:
-        ESP_LOGI(TAG, "encryption changed: status=%d", event->enc_change.status);
-        bt_tcp_logf("[BT] enc_change status=%d\r\n", event->enc_change.status);
+        RS3_LOGI(BT, "[BT] enc_change status=%d\r\n", event->enc_change.status);
         s_last_enc_status = event->enc_change.status;
         if (s_enc_sem) {
             xSemaphoreGive(s_enc_sem);
@@ -486,8 +466,7 @@ static int connect_peer(const ble_addr_t &peer)
 static int connect_peer_timeout(const ble_addr_t &peer, uint32_t timeout_ms)
 {
     if (s_conn_handle != BLE_HS_CONN_HANDLE_NONE) {
-        ESP_LOGI(TAG, "already connected (handle=%u)", s_conn_handle);
-        bt_tcp_logf("[BT] already connected handle=%u\r\n", s_conn_handle);
+        RS3_LOGI(BT, "[BT] already connected handle=%u\r\n", s_conn_handle);
         return 0;
     }
 
@@ -508,8 +487,7 @@ static int connect_peer_timeout(const ble_addr_t &peer, uint32_t timeout_ms)
     log_addr("connecting to: ", peer);
     int rc = ble_gap_connect(s_own_addr_type, &peer, (int32_t)timeout_ms, &params, gap_event, nullptr);
     if (rc != 0) {
-        ESP_LOGW(TAG, "ble_gap_connect rc=%d", rc);
-        bt_tcp_logf("[BT] ble_gap_connect rc=%d\r\n", rc);
+        RS3_LOGW(BT, "[BT] ble_gap_connect rc=%d\r\n", rc);
     }
     return rc;
 }
@@ -520,7 +498,7 @@ static bool fast_connect_last_peer(uint32_t timeout_ms)
     if (s_mode_pairing) return false;
     if (!s_have_last_peer) return false;
 
-    bt_tcp_logf("[BT] fast connect last peer timeout=%" PRIu32 "ms\r\n", timeout_ms);
+    RS3_LOGI(BT, "[BT] fast connect last peer timeout=%" PRIu32 "ms\r\n", timeout_ms);
     s_fast_connect_attempt = true;
     s_last_connect_status = -1;
     int rc = connect_peer_timeout(s_last_peer, timeout_ms);
@@ -555,7 +533,7 @@ static void stop_reconnect(void)
 static void schedule_reconnect(uint32_t delay_ms)
 {
     if (!kBtAutoReconnectEnabled) {
-        bt_tcp_logf("[BT] reconnect suppressed (auto disabled)\r\n");
+        RS3_LOGW(BT, "[BT] reconnect suppressed (auto disabled)\r\n");
         return;
     }
     if (s_reconnect_timer == nullptr) {
@@ -570,8 +548,7 @@ static void schedule_reconnect(uint32_t delay_ms)
     }
 
     (void)esp_timer_stop(s_reconnect_timer);
-    ESP_LOGI(TAG, "reconnect in %" PRIu32 " ms", delay_ms);
-    bt_tcp_logf("[BT] reconnect in %" PRIu32 " ms\r\n", delay_ms);
+    RS3_LOGI(BT, "[BT] reconnect in %" PRIu32 " ms\r\n", delay_ms);
     ESP_ERROR_CHECK(esp_timer_start_once(s_reconnect_timer, (uint64_t)delay_ms * 1000ULL));
 }
 
@@ -591,24 +568,20 @@ static void start_scan_for_nikon(uint32_t duration_ms)
     params.window = 0x0010;
     params.filter_duplicates = 1;
 
-    ESP_LOGI(TAG, "scan for Nikon (%" PRIu32 " ms)%s%s", duration_ms,
-             s_mode_pairing ? " [pairing]" : "",
-             (!s_mode_pairing && s_pref_has_device_id) ? " [match last device_id]" : "");
     ui_bt_line(s_mode_pairing ? "BT: scanning (pair)" : "BT: scanning");
-    bt_tcp_logf("[BT] scan start duration=%" PRIu32 "ms%s%s\r\n",
-                duration_ms,
-                s_mode_pairing ? " pairing" : "",
-                (!s_mode_pairing && s_pref_has_device_id) ? " match_last_device_id" : "");
+    RS3_LOGI(BT, "[BT] scan start duration=%" PRIu32 "ms%s%s\r\n",
+                 duration_ms,
+                 s_mode_pairing ? " pairing" : "",
+                 (!s_mode_pairing && s_pref_has_device_id) ? " match_last_device_id" : "");
 
     int rc = ble_gap_disc(s_own_addr_type, (int32_t)duration_ms, &params, gap_event, nullptr);
     if (rc == BLE_HS_EALREADY) {
         // Scan already active; treat as success.
-        bt_tcp_logf("[BT] scan already active\r\n");
+        RS3_LOGI(BT, "[BT] scan already active\r\n");
         return;
     }
     if (rc != 0) {
-        ESP_LOGW(TAG, "ble_gap_disc rc=%d", rc);
-        bt_tcp_logf("[BT] ble_gap_disc rc=%d\r\n", rc);
+        RS3_LOGW(BT, "[BT] ble_gap_disc rc=%d\r\n", rc);
         schedule_reconnect(s_backoff_ms);
         s_backoff_ms = (s_backoff_ms < 30000) ? (s_backoff_ms * 2) : 30000;
     }
@@ -626,11 +599,11 @@ static void on_sync(void)
     // Useful name for debugging / system menus.
     ble_svc_gap_device_name_set("rs3proxy");
 
-    bt_tcp_logf("[BT] cfg: SECURITY_ENABLE=%d SM_LEGACY=%d SM_SC=%d NVS_PERSIST=%d\r\n",
-                (int)CONFIG_BT_NIMBLE_SECURITY_ENABLE,
-                (int)CONFIG_BT_NIMBLE_SM_LEGACY,
-                (int)CONFIG_BT_NIMBLE_SM_SC,
-                (int)CONFIG_BT_NIMBLE_NVS_PERSIST);
+    RS3_LOGI(BT, "[BT] cfg: SECURITY_ENABLE=%d SM_LEGACY=%d SM_SC=%d NVS_PERSIST=%d\r\n",
+                 (int)CONFIG_BT_NIMBLE_SECURITY_ENABLE,
+                 (int)CONFIG_BT_NIMBLE_SM_LEGACY,
+                 (int)CONFIG_BT_NIMBLE_SM_SC,
+                 (int)CONFIG_BT_NIMBLE_NVS_PERSIST);
 
     // Load last peer/device_id preference (if present), then scan+connect.
     ble_addr_t peer{};
@@ -639,8 +612,7 @@ static void on_sync(void)
         s_have_last_peer = true;
         log_addr("last peer (nvs): ", s_last_peer);
         if (s_pref_has_device_id) {
-            ESP_LOGI(TAG, "last device_id_le=0x%08" PRIx32, s_pref_device_id_le);
-            bt_tcp_logf("[BT] last device_id_le=0x%08" PRIx32 "\r\n", s_pref_device_id_le);
+            RS3_LOGI(BT, "[BT] last device_id_le=0x%08" PRIx32 "\r\n", s_pref_device_id_le);
         }
     }
     if (!fast_connect_last_peer(9000)) {
@@ -650,8 +622,7 @@ static void on_sync(void)
 
 static void on_reset(int reason)
 {
-    ESP_LOGE(TAG, "reset; reason=%d", reason);
-    bt_tcp_logf("[BT] reset reason=%d\r\n", reason);
+    RS3_LOGE(BT, "[BT] reset reason=%d\r\n", reason);
 }
 
 static void host_task(void *param)
@@ -669,8 +640,7 @@ public:
         // In ESP-IDF 6.x, nimble_port_init() handles controller init internally.
         int rc = nimble_port_init();
         if (rc != 0) {
-            ESP_LOGE(TAG, "nimble_port_init failed: rc=%d", rc);
-            bt_tcp_logf("[BT] nimble_port_init failed rc=%d\r\n", rc);
+            RS3_LOGE(BT, "[BT] nimble_port_init failed rc=%d\r\n", rc);
             return ESP_FAIL;
         }
 
@@ -711,9 +681,8 @@ public:
         }
 
         nimble_port_freertos_init(host_task);
-        ESP_LOGI(TAG, "nimble started");
         ui_bt_line("BT: init");
-        bt_tcp_logf("[BT] nimble started\r\n");
+        RS3_LOGI(BT, "[BT] nimble started\r\n");
         return ESP_OK;
     }
 };
@@ -848,10 +817,10 @@ static int on_read(uint16_t conn_handle, const struct ble_gatt_error *error,
         memset(&s_last_read, 0, sizeof(s_last_read));
         s_last_read.len = len;
         (void)os_mbuf_copydata(attr->om, 0, len, &s_last_read.msg);
-        bt_tcp_logf("[BT] read(pair) len=%u stage=0x%02X\r\n", (unsigned)OS_MBUF_PKTLEN(attr->om), s_last_read.msg.stage);
+        RS3_LOGD(BT, "[BT] read(pair) len=%u stage=0x%02X\r\n", (unsigned)OS_MBUF_PKTLEN(attr->om), s_last_read.msg.stage);
         s_gatt_rc = 0;
     } else {
-        bt_tcp_logf("[BT] read(pair) failed rc=%d\r\n", error->status);
+        RS3_LOGE(BT, "[BT] read(pair) failed rc=%d\r\n", error->status);
         s_gatt_rc = error->status;
     }
     xSemaphoreGive(s_gatt_sem);
@@ -864,7 +833,7 @@ static bool gatt_read_pair(uint16_t conn_handle, uint32_t timeout_ms)
     s_gatt_rc = 0;
     int rc = ble_gattc_read(conn_handle, s_pair_val_handle, on_read, nullptr);
     if (rc != 0) {
-        bt_tcp_logf("[BT] gattc_read rc=%d\r\n", rc);
+        RS3_LOGI(BT, "[BT] gattc_read rc=%d\r\n", rc);
         return false;
     }
     return gatt_wait(timeout_ms, "read(pair)");
@@ -876,10 +845,10 @@ static int on_mtu(uint16_t conn_handle, const struct ble_gatt_error *error, uint
     (void)arg;
     if (error->status == 0) {
         s_mtu = mtu;
-        bt_tcp_logf("[BT] mtu=%u\r\n", (unsigned)mtu);
+        RS3_LOGD(BT, "[BT] mtu=%u\r\n", (unsigned)mtu);
         s_gatt_rc = 0;
     } else {
-        bt_tcp_logf("[BT] mtu exch failed rc=%d\r\n", error->status);
+        RS3_LOGE(BT, "[BT] mtu exch failed rc=%d\r\n", error->status);
         s_gatt_rc = error->status;
     }
     xSemaphoreGive(s_gatt_sem);
@@ -893,11 +862,11 @@ static bool gatt_exchange_mtu(uint16_t conn_handle)
     int rc = ble_gattc_exchange_mtu(conn_handle, on_mtu, nullptr);
     if (rc == BLE_HS_EALREADY) {
         // MTU already exchanged / procedure already active; not an error.
-        bt_tcp_logf("[BT] mtu exch already active\r\n");
+        RS3_LOGI(BT, "[BT] mtu exch already active\r\n");
         return true;
     }
     if (rc != 0) {
-        bt_tcp_logf("[BT] mtu exch start rc=%d\r\n", rc);
+        RS3_LOGI(BT, "[BT] mtu exch start rc=%d\r\n", rc);
         return false;
     }
     return gatt_wait(3000, "mtu");
@@ -911,13 +880,13 @@ static int bt_security_start(uint16_t conn_handle)
         (void)xSemaphoreTake(s_enc_sem, 0);
     }
     int rc = ble_gap_security_initiate(conn_handle);
-    bt_tcp_logf("[BT] security_initiate rc=%d\r\n", rc);
+    RS3_LOGI(BT, "[BT] security_initiate rc=%d\r\n", rc);
     if (rc == BLE_HS_ENOTSUP) {
-        bt_tcp_logf("[BT] security not supported (ENOTSUP). build cfg: SECURITY_ENABLE=%d SM_LEGACY=%d SM_SC=%d\r\n",
-                    (int)CONFIG_BT_NIMBLE_SECURITY_ENABLE,
-                    (int)CONFIG_BT_NIMBLE_SM_LEGACY,
-                    (int)CONFIG_BT_NIMBLE_SM_SC);
-        bt_tcp_logf("[BT] if these are 1, then ENOTSUP is coming from host state (e.g. not synced) or API usage.\r\n");
+        RS3_LOGE(BT, "[BT] security not supported (ENOTSUP). build cfg: SECURITY_ENABLE=%d SM_LEGACY=%d SM_SC=%d\r\n",
+                     (int)CONFIG_BT_NIMBLE_SECURITY_ENABLE,
+                     (int)CONFIG_BT_NIMBLE_SM_LEGACY,
+                     (int)CONFIG_BT_NIMBLE_SM_SC);
+        RS3_LOGE(BT, "[BT] if these are 1, then ENOTSUP is coming from host state (e.g. not synced) or API usage.\r\n");
     }
     return rc;
 }
@@ -926,10 +895,10 @@ static bool bt_wait_encryption(uint32_t timeout_ms)
 {
     if (!s_enc_sem) return false;
     if (xSemaphoreTake(s_enc_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
-        bt_tcp_logf("[BT] enc_wait timeout\r\n");
+        RS3_LOGW(BT, "[BT] enc_wait timeout\r\n");
         return false;
     }
-    bt_tcp_logf("[BT] enc_wait status=%d\r\n", s_last_enc_status);
+    RS3_LOGI(BT, "[BT] enc_wait status=%d\r\n", s_last_enc_status);
     return (s_last_enc_status == 0);
 }
 
@@ -937,13 +906,11 @@ static bool gatt_wait(uint32_t timeout_ms, const char *what)
 {
     if (s_gatt_sem == nullptr) return false;
     if (xSemaphoreTake(s_gatt_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
-        ESP_LOGW(TAG, "%s: timeout", what);
-        bt_tcp_logf("[BT] %s: timeout\r\n", what);
+        RS3_LOGW(BT, "[BT] %s: timeout\r\n", what);
         return false;
     }
     if (s_gatt_rc != 0) {
-        ESP_LOGW(TAG, "%s: rc=%d", what, s_gatt_rc);
-        bt_tcp_logf("[BT] %s: rc=%d\r\n", what, s_gatt_rc);
+        RS3_LOGW(BT, "[BT] %s: rc=%d\r\n", what, s_gatt_rc);
         return false;
     }
     return true;
@@ -967,14 +934,12 @@ static bool gatt_discover_all(uint16_t conn_handle)
     int rc = ble_gattc_disc_svc_by_uuid(conn_handle, (const ble_uuid_t *)&kNikonServiceUuid,
                                         on_disc_svc, nullptr);
     if (rc != 0) {
-        ESP_LOGW(TAG, "disc_svc rc=%d", rc);
-        bt_tcp_logf("[BT] disc_svc start rc=%d\r\n", rc);
+        RS3_LOGW(BT, "[BT] disc_svc start rc=%d\r\n", rc);
         return false;
     }
     if (!gatt_wait(5000, "disc_svc")) return false;
     if (s_svc_start == 0 || s_svc_end == 0) {
-        ESP_LOGW(TAG, "nikon service not found");
-        bt_tcp_logf("[BT] nikon service not found\r\n");
+        RS3_LOGW(BT, "[BT] nikon service not found\r\n");
         return false;
     }
 
@@ -983,8 +948,7 @@ static bool gatt_discover_all(uint16_t conn_handle)
     s_gatt_rc = 0;
     rc = ble_gattc_disc_all_chrs(conn_handle, s_svc_start, s_svc_end, on_disc_all_chrs, nullptr);
     if (rc != 0) {
-        ESP_LOGW(TAG, "disc_all_chrs rc=%d", rc);
-        bt_tcp_logf("[BT] disc_all_chrs start rc=%d\r\n", rc);
+        RS3_LOGW(BT, "[BT] disc_all_chrs start rc=%d\r\n", rc);
         return false;
     }
     if (!gatt_wait(5000, "disc_all_chrs")) return false;
@@ -1006,13 +970,11 @@ static bool gatt_discover_all(uint16_t conn_handle)
     }
 
     if (s_pair_val_handle == 0 || s_pair_end_handle == 0) {
-        ESP_LOGW(TAG, "pair characteristic not found");
-        bt_tcp_logf("[BT] pair characteristic not found\r\n");
+        RS3_LOGW(BT, "[BT] pair characteristic not found\r\n");
         return false;
     }
     if (s_shutter_val_handle == 0 || s_shutter_end_handle == 0) {
-        ESP_LOGW(TAG, "shutter characteristic not found");
-        bt_tcp_logf("[BT] shutter characteristic not found\r\n");
+        RS3_LOGW(BT, "[BT] shutter characteristic not found\r\n");
         return false;
     }
 
@@ -1021,14 +983,12 @@ static bool gatt_discover_all(uint16_t conn_handle)
     s_gatt_rc = 0;
     rc = ble_gattc_disc_all_dscs(conn_handle, s_pair_val_handle, s_pair_end_handle, on_disc_dsc, (void *)"pair");
     if (rc != 0) {
-        ESP_LOGW(TAG, "disc_dsc rc=%d", rc);
-        bt_tcp_logf("[BT] disc_dsc(pair) start rc=%d\r\n", rc);
+        RS3_LOGW(BT, "[BT] disc_dsc(pair) start rc=%d\r\n", rc);
         return false;
     }
     if (!gatt_wait(5000, "disc_dsc")) return false;
     if (s_pair_cccd_handle == 0) {
-        ESP_LOGW(TAG, "pair CCCD not found");
-        bt_tcp_logf("[BT] pair CCCD not found\r\n");
+        RS3_LOGW(BT, "[BT] pair CCCD not found\r\n");
         return false;
     }
 
@@ -1038,17 +998,14 @@ static bool gatt_discover_all(uint16_t conn_handle)
         s_gatt_rc = 0;
         rc = ble_gattc_disc_all_dscs(conn_handle, s_ind1_val_handle, s_ind1_end_handle, on_disc_dsc, (void *)"ind1");
         if (rc != 0) {
-            ESP_LOGW(TAG, "disc_dsc(ind1) rc=%d", rc);
-            bt_tcp_logf("[BT] disc_dsc(ind1) start rc=%d\r\n", rc);
+            RS3_LOGW(BT, "[BT] disc_dsc(ind1) start rc=%d\r\n", rc);
             return false;
         }
         if (!gatt_wait(5000, "disc_dsc(ind1)")) return false;
     }
 
-    ESP_LOGI(TAG, "gatt ok: svc=[%u..%u] pair=%u cccd=%u shutter=%u ind1=%u",
-             s_svc_start, s_svc_end, s_pair_val_handle, s_pair_cccd_handle, s_shutter_val_handle, s_ind1_val_handle);
-    bt_tcp_logf("[BT] gatt ok svc=[%u..%u] pair=%u cccd=%u shutter=%u ind1=%u\r\n",
-                s_svc_start, s_svc_end, s_pair_val_handle, s_pair_cccd_handle, s_shutter_val_handle, s_ind1_val_handle);
+    RS3_LOGI(BT, "[BT] gatt ok svc=[%u..%u] pair=%u cccd=%u shutter=%u ind1=%u\r\n",
+                 s_svc_start, s_svc_end, s_pair_val_handle, s_pair_cccd_handle, s_shutter_val_handle, s_ind1_val_handle);
     return true;
 }
 
@@ -1059,8 +1016,7 @@ static bool gatt_write_flat(uint16_t conn_handle, uint16_t handle, const void *d
     s_gatt_rc = 0;
     int rc = ble_gattc_write_flat(conn_handle, handle, data, len, on_write, nullptr);
     if (rc != 0) {
-        ESP_LOGW(TAG, "%s: write_flat rc=%d", what, rc);
-        bt_tcp_logf("[BT] %s: write_flat start rc=%d\r\n", what, rc);
+        RS3_LOGW(BT, "[BT] %s: write_flat start rc=%d\r\n", what, rc);
         return false;
     }
     return gatt_wait(timeout_ms, what);
@@ -1069,14 +1025,14 @@ static bool gatt_write_flat(uint16_t conn_handle, uint16_t handle, const void *d
 static bool nikon_remote_handshake(uint16_t conn_handle, const char *what, bool persist_ids, bool force_new_ids)
 {
     if (s_pairing_in_progress) {
-        bt_tcp_logf("[BT] %s already in progress; skip\r\n", what);
+        RS3_LOGW(BT, "[BT] %s already in progress; skip\r\n", what);
         return false;
     }
     s_pairing_in_progress = true;
     s_remote_session_ready = false;
 
     ui_bt_line(persist_ids ? "BT: pairing..." : "BT: session...");
-    bt_tcp_logf("[BT] %s start\r\n", what);
+    RS3_LOGI(BT, "[BT] %s start\r\n", what);
 
     // Security:
     // - Pairing: do security early and wait (user expects pairing to take time).
@@ -1084,20 +1040,20 @@ static bool nikon_remote_handshake(uint16_t conn_handle, const char *what, bool
     //   If a specific GATT op requires encryption, we'll trigger security on-demand and retry.
     if (persist_ids) {
         if (conn_is_encrypted(conn_handle)) {
-            bt_tcp_logf("[BT] %s: link already encrypted\r\n", what);
+            RS3_LOGI(BT, "[BT] %s: link already encrypted\r\n", what);
         } else {
             const int sec_rc = bt_security_start(conn_handle);
             if (sec_rc == 0) {
                 (void)bt_wait_encryption(6000);
             } else {
-                bt_tcp_logf("[BT] %s: skip enc_wait (sec_rc=%d)\r\n", what, sec_rc);
+                RS3_LOGW(BT, "[BT] %s: skip enc_wait (sec_rc=%d)\r\n", what, sec_rc);
             }
         }
     } else {
         if (conn_is_encrypted(conn_handle)) {
-            bt_tcp_logf("[BT] %s: link already encrypted\r\n", what);
+            RS3_LOGI(BT, "[BT] %s: link already encrypted\r\n", what);
         } else {
-            bt_tcp_logf("[BT] %s: security not initiated (fast session)\r\n", what);
+            RS3_LOGI(BT, "[BT] %s: security not initiated (fast session)\r\n", what);
         }
     }
 
@@ -1113,7 +1069,7 @@ static bool nikon_remote_handshake(uint16_t conn_handle, const char *what, bool
         if (attempt == 0) {
             vTaskDelay(pdMS_TO_TICKS(10));
         } else {
-            bt_tcp_logf("[BT] %s: gatt retry #%d in %" PRIu32 " ms\r\n", what, attempt, backoff_ms);
+            RS3_LOGW(BT, "[BT] %s: gatt retry #%d in %" PRIu32 " ms\r\n", what, attempt, backoff_ms);
             vTaskDelay(pdMS_TO_TICKS(backoff_ms));
             if (backoff_ms < 8000) backoff_ms *= 2;
         }
@@ -1125,7 +1081,7 @@ static bool nikon_remote_handshake(uint16_t conn_handle, const char *what, bool
 
     if (!gatt_ok) {
         ui_bt_line("BT: fail (gatt)");
-        bt_tcp_logf("[BT] %s failed: gatt discovery\r\n", what);
+        RS3_LOGE(BT, "[BT] %s failed: gatt discovery\r\n", what);
         s_pairing_in_progress = false;
         return false;
     }
@@ -1136,7 +1092,7 @@ static bool nikon_remote_handshake(uint16_t conn_handle, const char *what, bool
                          5000, "cccd(pair)")) {
         // If camera requires encryption for CCCD writes, enable security on-demand and retry once.
         if (!conn_is_encrypted(conn_handle) && gatt_rc_requires_encryption(s_gatt_rc)) {
-            bt_tcp_logf("[BT] %s: cccd(pair) requires encryption rc=%d -> security+retry\r\n", what, s_gatt_rc);
+            RS3_LOGW(BT, "[BT] %s: cccd(pair) requires encryption rc=%d -> security+retry\r\n", what, s_gatt_rc);
             const int sec_rc = bt_security_start(conn_handle);
             if (sec_rc == 0) {
                 (void)bt_wait_encryption(persist_ids ? 6000 : 2000);
@@ -1147,16 +1103,16 @@ static bool nikon_remote_handshake(uint16_t conn_handle, const char *what, bool
             }
         }
         ui_bt_line("BT: fail (cccd)");
-        bt_tcp_logf("[BT] %s failed: enable indications\r\n", what);
+        RS3_LOGE(BT, "[BT] %s failed: enable indications\r\n", what);
         s_pairing_in_progress = false;
         return false;
     }
 cccd_pair_ok:
-    bt_tcp_logf("[BT] cccd(pair)=ok handle=%u\r\n", (unsigned)s_pair_cccd_handle);
+    RS3_LOGD(BT, "[BT] cccd(pair)=ok handle=%u\r\n", (unsigned)s_pair_cccd_handle);
     if (s_ind1_cccd_handle != 0) {
         if (gatt_write_flat(conn_handle, s_ind1_cccd_handle, cccd_indicate, sizeof(cccd_indicate),
                             5000, "cccd(ind1)")) {
-            bt_tcp_logf("[BT] cccd(ind1)=ok handle=%u\r\n", (unsigned)s_ind1_cccd_handle);
+            RS3_LOGD(BT, "[BT] cccd(ind1)=ok handle=%u\r\n", (unsigned)s_ind1_cccd_handle);
         }
     }
 
@@ -1179,8 +1135,8 @@ cccd_pair_ok:
         }
     }
 
-    bt_tcp_logf("[BT] %s ids device_id_le=0x%08" PRIx32 " nonce_le=0x%08" PRIx32 "%s\r\n",
-                what, device_le, nonce_le, (s_pref_has_nonce ? "" : " (nonce new)"));
+    RS3_LOGI(BT, "[BT] %s ids device_id_le=0x%08" PRIx32 " nonce_le=0x%08" PRIx32 "%s\r\n",
+                 what, device_le, nonce_le, (s_pref_has_nonce ? "" : " (nonce new)"));
 
     if (persist_ids) {
         s_pref_has_device_id = 1;
@@ -1215,48 +1171,48 @@ cccd_pair_ok:
         tx.id.device = device_le;
         tx.id.nonce = nonce_le;
 
-        bt_tcp_logf("[BT] %s stage1 try=%d ts=0x%016" PRIx64 " payload=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X\r\n",
-                    what,
-                    attempt,
-                    (uint64_t)tx.timestamp,
-                    ((const uint8_t *)&tx)[0], ((const uint8_t *)&tx)[1], ((const uint8_t *)&tx)[2],
-                    ((const uint8_t *)&tx)[3], ((const uint8_t *)&tx)[4], ((const uint8_t *)&tx)[5],
-                    ((const uint8_t *)&tx)[6], ((const uint8_t *)&tx)[7], ((const uint8_t *)&tx)[8],
-                    ((const uint8_t *)&tx)[9], ((const uint8_t *)&tx)[10], ((const uint8_t *)&tx)[11],
-                    ((const uint8_t *)&tx)[12], ((const uint8_t *)&tx)[13], ((const uint8_t *)&tx)[14],
-                    ((const uint8_t *)&tx)[15], ((const uint8_t *)&tx)[16]);
+        RS3_LOGI(BT, "[BT] %s stage1 try=%d ts=0x%016" PRIx64 " payload=%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X\r\n",
+                     what,
+                     attempt,
+                     (uint64_t)tx.timestamp,
+                     ((const uint8_t *)&tx)[0], ((const uint8_t *)&tx)[1], ((const uint8_t *)&tx)[2],
+                     ((const uint8_t *)&tx)[3], ((const uint8_t *)&tx)[4], ((const uint8_t *)&tx)[5],
+                     ((const uint8_t *)&tx)[6], ((const uint8_t *)&tx)[7], ((const uint8_t *)&tx)[8],
+                     ((const uint8_t *)&tx)[9], ((const uint8_t *)&tx)[10], ((const uint8_t *)&tx)[11],
+                     ((const uint8_t *)&tx)[12], ((const uint8_t *)&tx)[13], ((const uint8_t *)&tx)[14],
+                     ((const uint8_t *)&tx)[15], ((const uint8_t *)&tx)[16]);
 
         if (!gatt_write_flat(conn_handle, s_pair_val_handle, &tx, sizeof(tx), 5000, "pair(stage1)")) {
             ui_bt_line("BT: fail (s1)");
-            bt_tcp_logf("[BT] %s failed: stage1 write\r\n", what);
+            RS3_LOGE(BT, "[BT] %s failed: stage1 write\r\n", what);
             s_pairing_in_progress = false;
             return false;
         }
-        bt_tcp_logf("[BT] %s stage1 sent\r\n", what);
+        RS3_LOGI(BT, "[BT] %s stage1 sent\r\n", what);
 
         if (xQueueReceive(s_pair_rx_q, &rx, pdMS_TO_TICKS(1500)) == pdTRUE && rx.msg.stage == 0x02) {
             got_stage2 = true;
-            bt_tcp_logf("[BT] %s stage2 ok (notify)\r\n", what);
+            RS3_LOGI(BT, "[BT] %s stage2 ok (notify)\r\n", what);
         } else {
             got_stage2 = false;
             const int polls = 50;
             for (int i = 0; i < polls && !got_stage2; i++) {
                 if (gatt_read_pair(conn_handle, 2000) && s_last_read.msg.stage == 0x02) {
                     got_stage2 = true;
-                    bt_tcp_logf("[BT] %s stage2 ok (read)\r\n", what);
+                    RS3_LOGI(BT, "[BT] %s stage2 ok (read)\r\n", what);
                     break;
                 }
                 vTaskDelay(pdMS_TO_TICKS(200));
             }
             if (!got_stage2) {
-                bt_tcp_logf("[BT] %s stage2 timeout (try=%d)\r\n", what, attempt);
+                RS3_LOGW(BT, "[BT] %s stage2 timeout (try=%d)\r\n", what, attempt);
             }
         }
     }
 
     if (!got_stage2) {
         ui_bt_line("BT: fail (s2)");
-        bt_tcp_logf("[BT] %s failed: stage2 timeout\r\n", what);
+        RS3_LOGE(BT, "[BT] %s failed: stage2 timeout\r\n", what);
         s_pairing_in_progress = false;
         return false;
     }
@@ -1266,7 +1222,7 @@ cccd_pair_ok:
     tx.stage = 0x03;
     if (!gatt_write_flat(conn_handle, s_pair_val_handle, &tx, sizeof(tx), 5000, "pair(stage3)")) {
         ui_bt_line("BT: fail (s3)");
-        bt_tcp_logf("[BT] %s failed: stage3 write\r\n", what);
+        RS3_LOGE(BT, "[BT] %s failed: stage3 write\r\n", what);
         s_pairing_in_progress = false;
         return false;
     }
@@ -1289,14 +1245,14 @@ cccd_pair_ok:
     }
     if (!got_stage4 || rx.len < offsetof(nikon_pair_msg_t, serial) + 8) {
         ui_bt_line("BT: fail (s4)");
-        bt_tcp_logf("[BT] %s failed: stage4 timeout/mismatch\r\n", what);
+        RS3_LOGE(BT, "[BT] %s failed: stage4 timeout/mismatch\r\n", what);
         s_pairing_in_progress = false;
         return false;
     }
 
     char serial[9] = {0};
     memcpy(serial, rx.msg.serial, 8);
-    bt_tcp_logf("[BT] %s ok camera_serial=%s\r\n", what, serial);
+    RS3_LOGI(BT, "[BT] %s ok camera_serial=%s\r\n", what, serial);
 
     // If nonce wasn't persisted (old fw) and this worked, store it now.
     if (!persist_ids && s_pref_has_device_id && !s_pref_has_nonce) {
@@ -1305,12 +1261,12 @@ cccd_pair_ok:
         if (s_have_last_peer) {
             nvs_save_last_peer(s_last_peer);
         }
-        bt_tcp_logf("[BT] %s stored nonce_le=0x%08" PRIx32 "\r\n", what, nonce_le);
+        RS3_LOGI(BT, "[BT] %s stored nonce_le=0x%08" PRIx32 "\r\n", what, nonce_le);
     }
 
     s_remote_session_ready = true;
     ui_bt_line(persist_ids ? "BT: paired" : "BT: ready");
-    bt_tcp_logf("[BT] %s done\r\n", what);
+    RS3_LOGI(BT, "[BT] %s done\r\n", what);
     s_pairing_in_progress = false;
     return true;
 }
@@ -1323,7 +1279,7 @@ static bool nikon_remote_pair(uint16_t conn_handle)
 static bool nikon_remote_session_init(uint16_t conn_handle)
 {
     if (!s_pref_has_device_id) {
-        bt_tcp_logf("[BT] session init skipped: no saved device_id\r\n");
+        RS3_LOGW(BT, "[BT] session init skipped: no saved device_id\r\n");
         return false;
     }
     return nikon_remote_handshake(conn_handle, "session", false, false);
@@ -1332,14 +1288,14 @@ static bool nikon_remote_session_init(uint16_t conn_handle)
 static bool nikon_shutter_click(uint16_t conn_handle)
 {
     if (conn_handle == BLE_HS_CONN_HANDLE_NONE) {
-        bt_tcp_logf("[BT] shutter: not connected -> fast reconnect\r\n");
+        RS3_LOGI(BT, "[BT] shutter: not connected -> fast reconnect\r\n");
         ui_bt_line("BT: connecting...");
 
         // Important: we're in the BT app task. Don't use scan->CMD_CONNECT_CANDIDATE here,
         // or we'd block the processing of that command. For shutter we do fast connect only.
         if (!fast_connect_last_peer(9000)) {
             ui_bt_line("BT: not connected");
-            bt_tcp_logf("[BT] shutter: fast reconnect not possible (no last peer?)\r\n");
+            RS3_LOGW(BT, "[BT] shutter: fast reconnect not possible (no last peer?)\r\n");
             return false;
         }
 
@@ -1355,7 +1311,7 @@ static bool nikon_shutter_click(uint16_t conn_handle)
         conn_handle = s_conn_handle;
         if (conn_handle == BLE_HS_CONN_HANDLE_NONE) {
             ui_bt_line("BT: not connected");
-            bt_tcp_logf("[BT] shutter: reconnect failed/timeout status=%d\r\n", s_last_connect_status);
+            RS3_LOGE(BT, "[BT] shutter: reconnect failed/timeout status=%d\r\n", s_last_connect_status);
             return false;
         }
     }
@@ -1363,17 +1319,17 @@ static bool nikon_shutter_click(uint16_t conn_handle)
         // Lazy discovery if needed.
         if (!gatt_discover_all(conn_handle)) {
             ui_bt_line("BT: shutter fail (gatt)");
-            bt_tcp_logf("[BT] shutter: gatt discovery failed\r\n");
+            RS3_LOGE(BT, "[BT] shutter: gatt discovery failed\r\n");
             return false;
         }
     }
 
     // After reboot/reconnect Nikon expects the remote handshake again before accepting shutter writes.
     if (!s_remote_session_ready && s_pref_has_device_id) {
-        bt_tcp_logf("[BT] shutter: session not ready -> init\r\n");
+        RS3_LOGI(BT, "[BT] shutter: session not ready -> init\r\n");
         if (!nikon_remote_session_init(conn_handle)) {
             ui_bt_line("BT: need pair");
-            bt_tcp_logf("[BT] shutter: session init failed\r\n");
+            RS3_LOGE(BT, "[BT] shutter: session init failed\r\n");
             return false;
         }
     }
@@ -1383,17 +1339,17 @@ static bool nikon_shutter_click(uint16_t conn_handle)
     const uint8_t release[2] = {0x02, 0x00};
     if (!gatt_write_flat(conn_handle, s_shutter_val_handle, press, sizeof(press), 3000, "shutter(press)")) {
         ui_bt_line("BT: shutter fail (press)");
-        bt_tcp_logf("[BT] shutter: press failed\r\n");
+        RS3_LOGE(BT, "[BT] shutter: press failed\r\n");
         return false;
     }
     vTaskDelay(pdMS_TO_TICKS(120));
     if (!gatt_write_flat(conn_handle, s_shutter_val_handle, release, sizeof(release), 3000, "shutter(release)")) {
         ui_bt_line("BT: shutter fail (release)");
-        bt_tcp_logf("[BT] shutter: release failed\r\n");
+        RS3_LOGE(BT, "[BT] shutter: release failed\r\n");
         return false;
     }
     ui_bt_line("BT: shutter");
-    bt_tcp_logf("[BT] shutter: click ok\r\n");
+    RS3_LOGI(BT, "[BT] shutter: click ok\r\n");
     return true;
 }
 
@@ -1410,7 +1366,7 @@ static void nikon_bt_task(void *arg)
             s_mode_pairing = true;
             s_do_pair_after_connect = true;
             ui_bt_line("BT: pair start");
-            bt_tcp_logf("[BT] pair button: cancel scan/reconnect\r\n");
+            RS3_LOGI(BT, "[BT] pair button: cancel scan/reconnect\r\n");
             stop_reconnect();
             (void)ble_gap_disc_cancel();
             // If already connected, just do handshake.
@@ -1437,6 +1393,12 @@ static void nikon_bt_task(void *arg)
         case CMD_SHUTTER_CLICK:
             (void)nikon_shutter_click(s_conn_handle);
             break;
+        case CMD_CONNECT_LAST:
+            // Session init follows from the connect event, as for any reconnect.
+            if (s_conn_handle == BLE_HS_CONN_HANDLE_NONE && !fast_connect_last_peer(9000)) {
+                RS3_LOGW(BT, "[BT] connect: no last peer to connect to\r\n");
+            }
+            break;
         case CMD_CONNECT_CANDIDATE: {
             if (s_conn_handle != BLE_HS_CONN_HANDLE_NONE) break;
             if (!s_scan_have_candidate) break;
@@ -1463,10 +1425,66 @@ static void nikon_bt_task(void *arg)
 
 #endif  // CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ENABLED
 
+// Console commands: queue the request and report whether the BT task took it.
+static void cmd_reply(const char *what, esp_err_t err)
+{
+    char out[64];
+    if (err == ESP_OK) {
+        snprintf(out, sizeof(out), "BT: %s requested\r\n", what);
+    } else {
+        snprintf(out, sizeof(out), "ERR: BT %s: %s\r\n", what, esp_err_to_name(err));
+    }
+    rs3_tcp_server_send_str(out);
+}
+
+static void handle_pair_cmd(char *arg, void *user_ctx)
+{
+    (void)arg;
+    (void)user_ctx;
+    cmd_reply("pairing", rs3_nikon_bt_pair_start());
+}
+
+static void handle_shutter_cmd(char *arg, void *user_ctx)
+{
+    (void)arg;
+    (void)user_ctx;
+    cmd_reply("shutter", rs3_nikon_bt_shutter_click());
+}
+
+static const rs3_cmd_t kBtCmds[] = {
+    {.name = "pair", .aliases = "btpair", .help = "start Nikon Bluetooth pairing", .handler = handle_pair_cmd},
+    {.name = "shutter", .aliases = "btshutter", .help = "Nikon shutter click (press + release)",
+     .handler = handle_shutter_cmd},
+};
+
+// RPC: the status says whether the BT task accepted the request; result is null.
+static esp_err_t rpc_pair(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)params;
+    (void)result;
+    (void)user_ctx;
+    return rs3_nikon_bt_pair_start();
+}
+
+static esp_err_t rpc_shutter(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)params;
+    (void)result;
+    (void)user_ctx;
+    return rs3_nikon_bt_shutter_click();
+}
+
+static const rs3_rpc_method_t kBtRpc[] = {
+    {.name = "pair", .handler = rpc_pair},
+    {.name = "shutter", .handler = rpc_shutter},
+};
+
 }  // namespace
 
 extern "C" esp_err_t rs3_nikon_bt_start(void)
 {
+    for (const rs3_cmd_t &cmd : kBtCmds) (void)rs3_cmd_register(&cmd);
+    for (const rs3_rpc_method_t &m : kBtRpc) (void)rs3_rpc_register(&m);
 #if CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ENABLED
     return s_mgr.start();
 #else
@@ -1482,11 +1500,31 @@ extern "C" esp_err_t rs3_nikon_bt_pair_start(void)
     nikon_cmd_t cmd = {.kind = CMD_PAIR_START};
     return (xQueueSend(s_cmd_q, &cmd, 0) == pdTRUE) ? ESP_OK : ESP_FAIL;
 #else
-    rs3_tcp_logf("[BT] pair_start: BT disabled in sdkconfig\r\n");
+    RS3_LOGW(BT, "[BT] pair_start: BT disabled in sdkconfig\r\n");
     return ESP_ERR_NOT_SUPPORTED;
 #endif
 }
 
+extern "C" esp_err_t rs3_nikon_bt_connect(void)
+{
+#if CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ENABLED
+    if (s_cmd_q == nullptr) return ESP_ERR_INVALID_STATE;
+    nikon_cmd_t cmd = {.kind = CMD_CONNECT_LAST};
+    return (xQueueSend(s_cmd_q, &cmd, 0) == pdTRUE) ? ESP_OK : ESP_FAIL;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+extern "C" bool rs3_nikon_bt_is_ready(void)
+{
+#if CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ENABLED
+    return s_conn_handle != BLE_HS_CONN_HANDLE_NONE && s_remote_session_ready;
+#else
+    return false;
+#endif
+}
+
 extern "C" esp_err_t rs3_nikon_bt_shutter_click(void)
 {
 #if CONFIG_BT_ENABLED && CONFIG_BT_NIMBLE_ENABLED
@@ -1494,7 +1532,7 @@ extern "C" esp_err_t rs3_nikon_bt_shutter_click(void)
     nikon_cmd_t cmd = {.kind = CMD_SHUTTER_CLICK};
     return (xQueueSend(s_cmd_q, &cmd, 0) == pdTRUE) ? ESP_OK : ESP_FAIL;
 #else
-    rs3_tcp_logf("[BT] shutter_click: BT disabled in sdkconfig\r\n");
+    RS3_LOGW(BT, "[BT] shutter_click: BT disabled in sdkconfig\r\n");
     return ESP_ERR_NOT_SUPPORTED;
 #endif
 }
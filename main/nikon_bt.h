@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -24,6 +26,17 @@ esp_err_t rs3_nikon_bt_start(void);
  */
 esp_err_t rs3_nikon_bt_pair_start(void);
 
+/**
+ * Connect to the last paired camera (fast connect, no scan); the remote session is set up once
+ * the link is up. No-op when already connected.
+ */
+esp_err_t rs3_nikon_bt_connect(void);
+
+/**
+ * True while connected to the camera with the Nikon remote session set up (shutter ready).
+ */
+bool rs3_nikon_bt_is_ready(void);
+
 /**
  * Trigger Nikon shutter (press + release).
  *
@@ -5,12 +5,11 @@
 #include "esp_check.h"
 #include "esp_crt_bundle.h"
 #include "esp_https_ota.h"
-#include "esp_log.h"
 #include "esp_system.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
-static const char *TAG = "ota_update";
+#include "log_tcp.h"
 
 static TaskHandle_t s_task = NULL;
 static char s_url[256] = {0};
@@ -48,7 +47,7 @@ static void ota_task(void *arg)
     s_status.progress_pct = -1;
     emit();
 
-    ESP_LOGI(TAG, "Starting OTA from URL: %s", s_url);
+    RS3_LOGI(OTA, "[OTA] start url=%s\r\n", s_url);
 
     esp_http_client_config_t http_cfg = {
         .url = s_url,
@@ -64,7 +63,7 @@ static void ota_task(void *arg)
     esp_https_ota_handle_t ota_handle = NULL;
     esp_err_t ret = esp_https_ota_begin(&ota_cfg, &ota_handle);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "esp_https_ota_begin failed: %s", esp_err_to_name(ret));
+        RS3_LOGE(OTA, "[OTA] begin failed: %s\r\n", esp_err_to_name(ret));
         s_status.state = RS3_OTA_STATE_FAILED;
         s_status.last_err = ret;
         emit();
@@ -110,9 +109,9 @@ static void ota_task(void *arg)
             if (pct != last_pct) {
                 last_pct = pct;
                 if (pct >= 0 && s_status.total_bytes > 0) {
-                    ESP_LOGI(TAG, "OTA %d%% (%ld/%ld)", pct, (long)s_status.bytes_read, (long)s_status.total_bytes);
+                    RS3_LOGD(OTA, "[OTA] %d%% (%ld/%ld)\r\n", pct, (long)s_status.bytes_read, (long)s_status.total_bytes);
                 } else if (s_status.bytes_read > 0) {
-                    ESP_LOGI(TAG, "OTA read %ld bytes", (long)s_status.bytes_read);
+                    RS3_LOGD(OTA, "[OTA] read %ld bytes\r\n", (long)s_status.bytes_read);
                 }
             }
             emit();
@@ -122,7 +121,7 @@ static void ota_task(void *arg)
     if (ret == ESP_OK) {
         ret = esp_https_ota_finish(ota_handle);
         if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "OTA success, restarting...");
+            RS3_LOGI(OTA, "[OTA] success, restarting\r\n");
             s_status.progress_pct = 100;
             s_status.state = RS3_OTA_STATE_SUCCESS;
             s_status.last_err = ESP_OK;
@@ -130,13 +129,13 @@ static void ota_task(void *arg)
             vTaskDelay(pdMS_TO_TICKS(500));
             esp_restart();
         } else {
-            ESP_LOGE(TAG, "esp_https_ota_finish failed: %s", esp_err_to_name(ret));
+            RS3_LOGE(OTA, "[OTA] finish failed: %s\r\n", esp_err_to_name(ret));
             s_status.state = RS3_OTA_STATE_FAILED;
             s_status.last_err = ret;
             emit();
         }
     } else {
-        ESP_LOGE(TAG, "esp_https_ota_perform failed: %s", esp_err_to_name(ret));
+        RS3_LOGE(OTA, "[OTA] download failed: %s\r\n", esp_err_to_name(ret));
         (void)esp_https_ota_abort(ota_handle);
         s_status.state = RS3_OTA_STATE_FAILED;
         s_status.last_err = ret;
@@ -0,0 +1,109 @@
+#include "ptp_layout.h"
+
+#include <string.h>
+
+static inline uint16_t rd_le16(const uint8_t *p)
+{
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static inline uint32_t rd_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool rs3_ptp_parse_cmd(const uint8_t *buf, size_t n, rs3_ptp_cmd_parsed_t *out)
+{
+    if (!out || !buf || n < 8) return false;
+    memset(out, 0, sizeof(*out));
+
+    // Heuristic 0: DJI "no-len" with pad24 (3x 0x00):
+    // 00 00 00 [type16le@3] [code16le@5] [tid32le@7] [params...@11]
+    // Seen as 16-byte packets like:
+    // 00 00 00 01 00 02 10 00 00 00 00 01 00 00 00 00  => type=1 op=0x1002 tid=0 p0=1
+    if (n >= 11 && buf[0] == 0x00 && buf[1] == 0x00 && buf[2] == 0x00) {
+        uint16_t type16 = rd_le16(buf + 3);
+        uint16_t code16 = rd_le16(buf + 5);
+        uint32_t tid32 = rd_le32(buf + 7);
+        if (type16 >= 1 && type16 <= 4) {
+            out->layout = RS3_PTP_LAYOUT_DJI_PAD24_NOLEN;
+            out->type = type16;
+            out->code = code16;
+            out->tid = tid32;
+            out->header_bytes = 11;
+            goto decode_params;
+        }
+    }
+
+    // Heuristic 1: DJI "no-len" with pad16: 00 00 [type16] [code16] [tid32] [params...]
+    if (n >= 10) {
+        uint16_t pad16 = rd_le16(buf + 0);
+        uint16_t type16 = rd_le16(buf + 2);
+        uint16_t code16 = rd_le16(buf + 4);
+        uint32_t tid32 = rd_le32(buf + 6);
+        if (pad16 == 0x0000 && type16 >= 1 && type16 <= 4) {
+            out->layout = RS3_PTP_LAYOUT_DJI_PAD16_NOLEN;
+            out->type = type16;
+            out->code = code16;
+            out->tid = tid32;
+            out->header_bytes = 10;
+            goto decode_params;
+        }
+    }
+
+    // Heuristic 2: DJI "no-len" with pad8: 00 [type16] [code16] [tid32] [params...]
+    if (n >= 9) {
+        uint8_t pad8 = buf[0];
+        uint16_t type16 = rd_le16(buf + 1);
+        uint16_t code16 = rd_le16(buf + 3);
+        uint32_t tid32 = rd_le32(buf + 5);
+        if (pad8 == 0x00 && type16 >= 1 && type16 <= 4) {
+            out->layout = RS3_PTP_LAYOUT_DJI_PAD8_NOLEN;
+            out->type = type16;
+            out->code = code16;
+            out->tid = tid32;
+            out->header_bytes = 9;
+            goto decode_params;
+        }
+    }
+
+    // Standard PTP/MTP: len32,type16,code16,tid32
+    if (n >= 12) {
+        uint16_t type_std = rd_le16(buf + 4);
+        if (type_std >= 1 && type_std <= 4) {
+            out->layout = RS3_PTP_LAYOUT_STD_LEN;
+            out->type = type_std;
+            out->code = rd_le16(buf + 6);
+            out->tid = rd_le32(buf + 8);
+            out->header_bytes = 12;
+            goto decode_params;
+        }
+        // Alt DJI observed: len32,code16,tid32,type16
+        uint16_t type_alt = rd_le16(buf + 10);
+        if (type_alt >= 1 && type_alt <= 4) {
+            out->layout = RS3_PTP_LAYOUT_ALT_LEN;
+            out->type = type_alt;
+            out->code = rd_le16(buf + 4);
+            out->tid = rd_le32(buf + 6);
+            out->header_bytes = 12;
+            goto decode_params;
+        }
+    }
+
+    return false;
+
+decode_params:
+    // Decode params from actual received bytes after header (4-byte each), up to 5
+    out->param_count = 0;
+    if (n > out->header_bytes) {
+        size_t avail = n - out->header_bytes;
+        size_t want = avail / 4;
+        if (want > 5) want = 5;
+        out->param_count = (int)want;
+        for (int i = 0; i < out->param_count; i++) {
+            size_t off = out->header_bytes + (size_t)i * 4;
+            out->params[i] = rd_le32(buf + off);
+        }
+    }
+    return true;
+}
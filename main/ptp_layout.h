@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Container layouts the RS3 uses on bulk OUT. Besides standard PTP it sends DJI variants without
+ * the length field, padded with 1-3 zero bytes, and one with the type moved after the tid. What
+ * the RS3 accepts back on bulk IN is standard PTP (std_len) whatever it sent.
+ */
+typedef enum {
+    RS3_PTP_LAYOUT_STD_LEN = 0,      // len32,type16,code16,tid32
+    RS3_PTP_LAYOUT_ALT_LEN = 1,      // len32,code16,tid32,type16
+    RS3_PTP_LAYOUT_DJI_PAD16_NOLEN = 2, // 0x0000 + type16,code16,tid32,(params...)
+    RS3_PTP_LAYOUT_DJI_PAD8_NOLEN = 3,  // 0x00 + type16,code16,tid32,(params...)
+    // 0x00 0x00 0x00 + type16@3, code16@5, tid32@7, (params...)@11
+    // Note: RS3 often appends an extra 0x01 byte after tid; treat it as part of params/padding.
+    RS3_PTP_LAYOUT_DJI_PAD24_NOLEN = 4,
+} rs3_ptp_layout_t;
+
+typedef struct {
+    rs3_ptp_layout_t layout;
+    uint16_t type;
+    uint16_t code;
+    uint32_t tid;
+    uint32_t params[5];
+    int param_count;
+    size_t header_bytes; // bytes before params/payload
+} rs3_ptp_cmd_parsed_t;
+
+/**
+ * @brief Detect the layout of a host -> device container and decode its header and up to 5 params.
+ *
+ * @return false if no known layout fits (too short, or no container type 1..4 at any offset).
+ */
+bool rs3_ptp_parse_cmd(const uint8_t *buf, size_t n, rs3_ptp_cmd_parsed_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,7 +7,9 @@
 
 #include "esp_check.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 
 #include "lwip/inet.h"
@@ -15,14 +17,35 @@
 #include "lwip/sockets.h"
 
 #include "log_tcp.h"
+#include "ptp_proxy_tap.h"
 
 static const char *TAG = "ptp_proxy";
 
+#ifndef CONFIG_RS3_USB_PTP_PROXY_HEARTBEAT_MS
+#define CONFIG_RS3_USB_PTP_PROXY_HEARTBEAT_MS 0
+#endif
+#ifndef CONFIG_RS3_USB_PTP_PROXY_PEER_TIMEOUT_MS
+#define CONFIG_RS3_USB_PTP_PROXY_PEER_TIMEOUT_MS 1000
+#endif
+
 static TaskHandle_t s_task = NULL;
 static int s_client_fd = -1;
 
 #if CONFIG_RS3_USB_PTP_ENABLE && CONFIG_RS3_USB_PTP_IMPL_PROXY_RAW
 
+// Two tasks use the client socket: the USB task runs exchanges (RAW_OUT, then RAW_IN... RAW_DONE),
+// the server task accepts clients, sends heartbeats and reads the PC's heartbeats while idle.
+// s_rx_lock is held for a whole exchange (and by the server task while it reads one idle frame),
+// s_tx_lock around every frame write. Lock order: rx, then tx.
+static SemaphoreHandle_t s_rx_lock = NULL;
+static SemaphoreHandle_t s_tx_lock = NULL;
+static volatile int64_t s_last_rx_us = 0;
+static volatile int64_t s_last_tx_us = 0;
+// Only clients that send heartbeats themselves are subject to the dead-peer timeout.
+static volatile bool s_peer_heartbeats = false;
+// Rest of a frame the server task has started reading while idle.
+enum { IDLE_FRAME_TIMEOUT_MS = 500 };
+
 static inline void close_client(void)
 {
     if (s_client_fd >= 0) {
@@ -32,6 +55,37 @@ static inline void close_client(void)
     }
 }
 
+// Drop the current client from the server task. shutdown() first so an exchange blocked in
+// select()/recv() on the USB task fails immediately and releases s_rx_lock.
+static void drop_client(const char *why)
+{
+    if (s_client_fd < 0) return;
+    shutdown(s_client_fd, SHUT_RDWR);
+    xSemaphoreTake(s_rx_lock, portMAX_DELAY);
+    xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+    close_client();
+    xSemaphoreGive(s_tx_lock);
+    xSemaphoreGive(s_rx_lock);
+    RS3_LOGI(NET, "[PTP-PROXY] client dropped (%s)\r\n", why);
+}
+
+static void set_client_opts(int fd)
+{
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    // Kernel-level backstop for peers that don't speak heartbeats: ~3 s to a dead link.
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &yes, sizeof(yes));
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+    int idle = 1, intvl = 1, cnt = 2;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+#endif
+    // A half-open peer must not wedge the USB task in send() once the send buffer fills up.
+    struct timeval snd_to = { .tv_sec = 0, .tv_usec = 500 * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &snd_to, sizeof(snd_to));
+}
+
 bool rs3_ptp_proxy_is_connected(void)
 {
     return s_client_fd >= 0;
@@ -48,6 +102,7 @@ static esp_err_t sock_send_all(int fd, const uint8_t *buf, size_t len)
     return ESP_OK;
 }
 
+// ESP_ERR_TIMEOUT only if nothing arrived; a timeout after part of buf is ESP_ERR_INVALID_RESPONSE.
 static esp_err_t sock_recv_all_timeout(int fd, uint8_t *buf, size_t len, uint32_t timeout_ms)
 {
     size_t off = 0;
@@ -60,7 +115,7 @@ static esp_err_t sock_recv_all_timeout(int fd, uint8_t *buf, size_t len, uint32_
             .tv_usec = (int)((timeout_ms % 1000U) * 1000U),
         };
         int r = select(fd + 1, &rfds, NULL, NULL, &tv);
-        if (r == 0) return ESP_ERR_TIMEOUT;
+        if (r == 0) return off ? ESP_ERR_INVALID_RESPONSE : ESP_ERR_TIMEOUT;
         if (r < 0) return ESP_FAIL;
         if (!FD_ISSET(fd, &rfds)) continue;
         int n = recv(fd, buf + off, len - off, 0);
@@ -70,61 +125,135 @@ static esp_err_t sock_recv_all_timeout(int fd, uint8_t *buf, size_t len, uint32_
     return ESP_OK;
 }
 
-esp_err_t rs3_ptp_proxy_send_frame(uint8_t type, const uint8_t *payload, size_t payload_len)
+// Read and discard len bytes.
+static esp_err_t sock_skip_timeout(int fd, size_t len, uint32_t timeout_ms)
+{
+    uint8_t skip[64];
+    while (len) {
+        const size_t n = len < sizeof(skip) ? len : sizeof(skip);
+        esp_err_t r = sock_recv_all_timeout(fd, skip, n, timeout_ms);
+        if (r != ESP_OK) return r;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t send_frame_locked(uint8_t type, const uint8_t *payload, size_t payload_len)
 {
-#if !(CONFIG_RS3_USB_PTP_ENABLE && CONFIG_RS3_USB_PTP_IMPL_PROXY_RAW)
-    (void)type; (void)payload; (void)payload_len;
-    return ESP_ERR_INVALID_STATE;
-#else
     if (s_client_fd < 0) return ESP_ERR_INVALID_STATE;
     const uint32_t total = (uint32_t)(payload_len + 1);
-    uint8_t hdr[5];
-    hdr[0] = (uint8_t)((total >> 24) & 0xFF);
-    hdr[1] = (uint8_t)((total >> 16) & 0xFF);
-    hdr[2] = (uint8_t)((total >> 8) & 0xFF);
-    hdr[3] = (uint8_t)(total & 0xFF);
-    hdr[4] = type;
-
-    ESP_RETURN_ON_ERROR(sock_send_all(s_client_fd, hdr, sizeof(hdr)), TAG, "send hdr failed");
-    if (payload_len) {
+    // Header and (small) payload in one segment: with TCP_NODELAY two send()s are two packets.
+    uint8_t buf[5 + 128];
+    buf[0] = (uint8_t)((total >> 24) & 0xFF);
+    buf[1] = (uint8_t)((total >> 16) & 0xFF);
+    buf[2] = (uint8_t)((total >> 8) & 0xFF);
+    buf[3] = (uint8_t)(total & 0xFF);
+    buf[4] = type;
+
+    if (payload_len <= sizeof(buf) - 5) {
+        if (payload_len) memcpy(buf + 5, payload, payload_len);
+        ESP_RETURN_ON_ERROR(sock_send_all(s_client_fd, buf, 5 + payload_len), TAG, "send failed");
+    } else {
+        ESP_RETURN_ON_ERROR(sock_send_all(s_client_fd, buf, 5), TAG, "send hdr failed");
         ESP_RETURN_ON_ERROR(sock_send_all(s_client_fd, payload, payload_len), TAG, "send payload failed");
     }
+    s_last_tx_us = esp_timer_get_time();
     return ESP_OK;
-#endif
 }
 
-esp_err_t rs3_ptp_proxy_recv_frame(uint8_t *out_type,
-                                  uint8_t *out_buf,
-                                  size_t out_cap,
-                                  size_t *out_len,
-                                  uint32_t timeout_ms)
+esp_err_t rs3_ptp_proxy_send_frame(uint8_t type, const uint8_t *payload, size_t payload_len)
 {
-#if !(CONFIG_RS3_USB_PTP_ENABLE && CONFIG_RS3_USB_PTP_IMPL_PROXY_RAW)
-    (void)out_type; (void)out_buf; (void)out_cap; (void)out_len; (void)timeout_ms;
-    return ESP_ERR_INVALID_STATE;
-#else
-    if (!out_type || !out_buf || !out_len) return ESP_ERR_INVALID_ARG;
-    if (s_client_fd < 0) return ESP_ERR_INVALID_STATE;
+    if (s_client_fd < 0 || !s_tx_lock) return ESP_ERR_INVALID_STATE;
+    rs3_ptp_proxy_tap_publish(type, payload, payload_len);
+    xSemaphoreTake(s_tx_lock, portMAX_DELAY);
+    esp_err_t err = send_frame_locked(type, payload, payload_len);
+    xSemaphoreGive(s_tx_lock);
+    return err;
+}
+
+// Once a frame has started, a timeout leaves the length/type stream out of sync: report it as
+// ESP_ERR_INVALID_RESPONSE and shut the socket down, so the server task drops the client.
+static esp_err_t frame_cut(esp_err_t r)
+{
+    if (r != ESP_ERR_TIMEOUT && r != ESP_ERR_INVALID_RESPONSE) return r;
+    RS3_LOGW(NET, "[PTP-PROXY] frame cut off mid-way, closing the link\r\n");
+    shutdown(s_client_fd, SHUT_RDWR);
+    return ESP_ERR_INVALID_RESPONSE;
+}
 
+// Read one frame (caller holds s_rx_lock). Heartbeats are consumed here and reported via *was_heartbeat.
+// out_buf NULL discards the payload whatever its size. ESP_ERR_TIMEOUT means no byte of a frame arrived.
+static esp_err_t recv_one_frame(uint8_t *out_type, uint8_t *out_buf, size_t out_cap, size_t *out_len,
+                                uint32_t timeout_ms, bool *was_heartbeat)
+{
     uint8_t hdr[5];
     esp_err_t r = sock_recv_all_timeout(s_client_fd, hdr, sizeof(hdr), timeout_ms);
+    if (r == ESP_ERR_INVALID_RESPONSE) return frame_cut(r);
     if (r != ESP_OK) return r;
 
     uint32_t total = ((uint32_t)hdr[0] << 24) | ((uint32_t)hdr[1] << 16) | ((uint32_t)hdr[2] << 8) | (uint32_t)hdr[3];
     uint8_t type = hdr[4];
     if (total == 0) return ESP_FAIL;
     size_t payload_len = (size_t)(total - 1);
-    if (payload_len > out_cap) return ESP_ERR_INVALID_SIZE;
+    s_last_rx_us = esp_timer_get_time();
 
+    *was_heartbeat = (type == RS3_PTP_PROXY_T_HEARTBEAT);
+    if (*was_heartbeat) {
+        s_peer_heartbeats = true;
+        // Heartbeat payloads are opaque (the PC may send a session id); skip them.
+        return frame_cut(sock_skip_timeout(s_client_fd, payload_len, timeout_ms));
+    }
+
+    if (!out_buf) {
+        // Discard mode (stray frames): any size, payload not kept or tapped.
+        r = frame_cut(sock_skip_timeout(s_client_fd, payload_len, timeout_ms));
+        if (r != ESP_OK) return r;
+        *out_type = type;
+        *out_len = payload_len;
+        return ESP_OK;
+    }
+    if (payload_len > out_cap) {
+        // Skip it so the next frame still starts on a header.
+        r = frame_cut(sock_skip_timeout(s_client_fd, payload_len, timeout_ms));
+        return r == ESP_OK ? ESP_ERR_INVALID_SIZE : r;
+    }
     if (payload_len) {
-        r = sock_recv_all_timeout(s_client_fd, out_buf, payload_len, timeout_ms);
+        r = frame_cut(sock_recv_all_timeout(s_client_fd, out_buf, payload_len, timeout_ms));
         if (r != ESP_OK) return r;
     }
-
+    rs3_ptp_proxy_tap_publish(type, out_buf, payload_len);
     *out_type = type;
     *out_len = payload_len;
     return ESP_OK;
-#endif
+}
+
+void rs3_ptp_proxy_exchange_begin(void)
+{
+    if (s_rx_lock) xSemaphoreTake(s_rx_lock, portMAX_DELAY);
+}
+
+void rs3_ptp_proxy_exchange_end(void)
+{
+    if (s_rx_lock) xSemaphoreGive(s_rx_lock);
+}
+
+esp_err_t rs3_ptp_proxy_recv_frame(uint8_t *out_type,
+                                  uint8_t *out_buf,
+                                  size_t out_cap,
+                                  size_t *out_len,
+                                  uint32_t timeout_ms)
+{
+    if (!out_type || !out_buf || !out_len) return ESP_ERR_INVALID_ARG;
+    if (s_client_fd < 0) return ESP_ERR_INVALID_STATE;
+
+    const int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    for (;;) {
+        const int64_t left_us = deadline - esp_timer_get_time();
+        if (left_us <= 0) return ESP_ERR_TIMEOUT;
+        bool hb = false;
+        esp_err_t r = recv_one_frame(out_type, out_buf, out_cap, out_len, (uint32_t)((left_us + 999) / 1000), &hb);
+        if (r != ESP_OK || !hb) return r;
+    }
 }
 
 static void server_task(void *arg)
@@ -180,36 +309,79 @@ static void server_task(void *arg)
             continue;
         }
 
-        if (FD_ISSET(listen_fd, &rfds)) {
+        if (r > 0 && FD_ISSET(listen_fd, &rfds)) {
             struct sockaddr_in6 source_addr;
             socklen_t addr_len = sizeof(source_addr);
             int fd = accept(listen_fd, (struct sockaddr *)&source_addr, &addr_len);
             if (fd >= 0) {
-                close_client();
+                drop_client("replaced");
+                set_client_opts(fd);
+                s_last_rx_us = esp_timer_get_time();
+                s_peer_heartbeats = false;
                 s_client_fd = fd;
-                ESP_LOGI(TAG, "Proxy client connected");
-                rs3_tcp_logf("[PTP-PROXY] client connected\r\n");
+                RS3_LOGI(NET, "[PTP-PROXY] client connected\r\n");
+                continue;
             }
         }
 
-        if (s_client_fd >= 0 && FD_ISSET(s_client_fd, &rfds)) {
-            // If remote closed, drop.
+        // Idle reads: only when no exchange owns the socket (the USB task reads everything then).
+        if (r > 0 && s_client_fd >= 0 && FD_ISSET(s_client_fd, &rfds) && xSemaphoreTake(s_rx_lock, 0) == pdTRUE) {
             char tmp[1];
-            int n = recv(s_client_fd, tmp, sizeof(tmp), MSG_PEEK);
-            if (n <= 0) {
-                ESP_LOGI(TAG, "Proxy client disconnected");
-                close_client();
-                rs3_tcp_logf("[PTP-PROXY] client disconnected\r\n");
+            int n = recv(s_client_fd, tmp, sizeof(tmp), MSG_PEEK | MSG_DONTWAIT);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                xSemaphoreGive(s_rx_lock);
+                drop_client("disconnected");
+                continue;
             }
+            if (n > 0) {
+                uint8_t type = 0;
+                size_t len = 0;
+                bool hb = false;
+                // A byte is waiting, so a frame has started: give the rest time to cross Wi-Fi
+                // (a multi-KB late RAW_OUT reply), any timeout from here on desyncs the stream.
+                esp_err_t rr = recv_one_frame(&type, NULL, 0, &len, IDLE_FRAME_TIMEOUT_MS, &hb);
+                if (rr == ESP_OK && !hb) {
+                    // E.g. a reply (or a whole late data phase) that arrived after the USB task
+                    // gave up on the exchange.
+                    RS3_LOGW(NET, "[PTP-PROXY] stray frame type=0x%02X len=%u dropped\r\n", type, (unsigned)len);
+                }
+                xSemaphoreGive(s_rx_lock);
+                if (rr != ESP_OK) {
+                    drop_client(rr == ESP_ERR_INVALID_RESPONSE ? "frame cut off" : "disconnected");
+                    continue;
+                }
+            } else {
+                xSemaphoreGive(s_rx_lock);
+            }
+        }
+
+        if (s_client_fd < 0) continue;
+        const int64_t now = esp_timer_get_time();
+#if CONFIG_RS3_USB_PTP_PROXY_HEARTBEAT_MS > 0
+        if (now - s_last_tx_us >= (int64_t)CONFIG_RS3_USB_PTP_PROXY_HEARTBEAT_MS * 1000 &&
+            xSemaphoreTake(s_tx_lock, 0) == pdTRUE) {
+            (void)send_frame_locked(RS3_PTP_PROXY_T_HEARTBEAT, NULL, 0);
+            xSemaphoreGive(s_tx_lock);
+        }
+        if (s_peer_heartbeats && now - s_last_rx_us > (int64_t)CONFIG_RS3_USB_PTP_PROXY_PEER_TIMEOUT_MS * 1000) {
+            drop_client("peer timeout");
         }
+#else
+        (void)now;
+#endif
     }
 }
 
 esp_err_t rs3_ptp_proxy_server_start(void)
 {
     if (s_task) return ESP_OK;
+    s_rx_lock = xSemaphoreCreateMutex();
+    s_tx_lock = xSemaphoreCreateMutex();
+    if (!s_rx_lock || !s_tx_lock) return ESP_ERR_NO_MEM;
     // Slightly higher prio so accept() isn't starved by USB traffic at plug-in time.
     xTaskCreate(server_task, "ptp_proxy", 4096, NULL, 6, &s_task);
+    // Taps are optional: the proxy keeps working if the tap ring can't be allocated.
+    (void)rs3_ptp_proxy_tap_start();
     return ESP_OK;
 }
 
@@ -236,6 +408,14 @@ esp_err_t rs3_ptp_proxy_recv_frame(uint8_t *out_type,
     return ESP_ERR_INVALID_STATE;
 }
 
+void rs3_ptp_proxy_exchange_begin(void)
+{
+}
+
+void rs3_ptp_proxy_exchange_end(void)
+{
+}
+
 esp_err_t rs3_ptp_proxy_server_start(void)
 {
     ESP_LOGI(TAG, "PTP proxy disabled");
@@ -6,11 +6,19 @@
 
 #include "esp_err.h"
 
+// Link-level frame type handled inside the server (never returned by rs3_ptp_proxy_recv_frame()).
+// Either side sends an empty HEARTBEAT after CONFIG_RS3_USB_PTP_PROXY_HEARTBEAT_MS without other
+// traffic. Once the PC has sent one, a PC that stays silent for CONFIG_RS3_USB_PTP_PROXY_PEER_TIMEOUT_MS
+// is treated as dead and disconnected.
+#define RS3_PTP_PROXY_T_HEARTBEAT 0x14
+
 /**
  * @brief Start a dedicated TCP server for PTP proxying (binary framed protocol).
  *
  * Listens on CONFIG_RS3_USB_PTP_PROXY_PORT.
  * Single client at a time; new client replaces old one.
+ * Dead clients are dropped after ~1 s (heartbeats) or ~3 s (TCP keepalive, for clients without heartbeats).
+ * Also starts the read-only tap server (ptp_proxy_tap.h) when enabled.
  */
 esp_err_t rs3_ptp_proxy_server_start(void);
 
@@ -38,6 +46,9 @@ esp_err_t rs3_ptp_proxy_send_frame(uint8_t type, const uint8_t *payload, size_t
  * - ESP_ERR_TIMEOUT on timeout
  * - ESP_ERR_INVALID_STATE if no client
  * - ESP_ERR_INVALID_SIZE if frame doesn't fit out_buf
+ * - ESP_FAIL if the client disconnected (or was dropped as dead)
+ *
+ * Heartbeats are consumed without returning. Call between exchange_begin()/exchange_end().
  */
 esp_err_t rs3_ptp_proxy_recv_frame(uint8_t *out_type,
                                   uint8_t *out_buf,
@@ -45,4 +56,13 @@ esp_err_t rs3_ptp_proxy_recv_frame(uint8_t *out_type,
                                   size_t *out_len,
                                   uint32_t timeout_ms);
 
+/**
+ * @brief Claim the read side of the proxy socket for one request/reply exchange.
+ *
+ * While no exchange is running, the server task reads (and discards) heartbeats and stray
+ * frames itself so peer liveness is tracked between exchanges too.
+ */
+void rs3_ptp_proxy_exchange_begin(void);
+void rs3_ptp_proxy_exchange_end(void);
+
 
@@ -0,0 +1,258 @@
+#include "ptp_proxy_tap.h"
+
+#include "sdkconfig.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "lwip/inet.h"
+#include "lwip/sockets.h"
+
+#include "byte_ring.h"
+#include "cmd_tcp.h"
+#include "log_tcp.h"
+#include "tcp_server.h"
+
+static const char *TAG = "ptp_tap";
+
+#ifndef CONFIG_RS3_USB_PTP_PROXY_TAP
+#define CONFIG_RS3_USB_PTP_PROXY_TAP 0
+#endif
+
+#if CONFIG_RS3_USB_PTP_ENABLE && CONFIG_RS3_USB_PTP_IMPL_PROXY_RAW && CONFIG_RS3_USB_PTP_PROXY_TAP
+
+typedef struct {
+    int fd;
+    uint64_t pos;   // next ring byte to send
+} tap_t;
+
+static TaskHandle_t s_task = NULL;
+static rs3_byte_ring_t s_ring;
+static tap_t s_taps[CONFIG_RS3_USB_PTP_PROXY_TAP_CLIENTS];
+static volatile uint32_t s_tap_count = 0;
+static rs3_ptp_proxy_tap_stats_t s_stats;   // under s_stats_lock: publishers run on several tasks
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void rs3_ptp_proxy_tap_publish(uint8_t type, const uint8_t *payload, size_t payload_len)
+{
+    if (s_tap_count == 0 || !s_task) return;
+
+    const uint64_t ts = (uint64_t)esp_timer_get_time();
+    const uint32_t total = (uint32_t)(1 + 8 + payload_len);
+    uint8_t hdr[13];
+    hdr[0] = (uint8_t)(total >> 24);
+    hdr[1] = (uint8_t)(total >> 16);
+    hdr[2] = (uint8_t)(total >> 8);
+    hdr[3] = (uint8_t)total;
+    hdr[4] = type;
+    for (int i = 0; i < 8; i++) hdr[5 + i] = (uint8_t)(ts >> (56 - 8 * i));
+
+    if (!rs3_byte_ring_write2(&s_ring, hdr, sizeof(hdr), payload, payload_len, NULL)) return;
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.frames++;
+    s_stats.bytes += sizeof(hdr) + payload_len;
+    portEXIT_CRITICAL(&s_stats_lock);
+    xTaskNotifyGive(s_task);
+}
+
+static void stats_count(uint32_t *counter)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    (*counter)++;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+void rs3_ptp_proxy_tap_get_stats(rs3_ptp_proxy_tap_stats_t *out)
+{
+    if (!out) return;
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+    out->taps = s_tap_count;
+}
+
+static void tap_close(int i, const char *why)
+{
+    shutdown(s_taps[i].fd, SHUT_RDWR);
+    close(s_taps[i].fd);
+    s_taps[i].fd = -1;
+    s_tap_count--;
+    rs3_ptp_proxy_tap_stats_t st;
+    rs3_ptp_proxy_tap_get_stats(&st);
+    RS3_LOGI(NET, "[PTP-TAP] tap %d closed (%s), frames=%" PRIu32 " dropped_slow=%" PRIu32 "\r\n",
+                  i, why, st.frames, st.dropped_slow);
+}
+
+// Send as much of the backlog as the socket takes without blocking. Returns true if bytes remain.
+static bool tap_pump(int i)
+{
+    tap_t *t = &s_taps[i];
+    for (;;) {
+        if (rs3_byte_ring_lost(&s_ring, t->pos)) {
+            stats_count(&s_stats.dropped_slow);
+            tap_close(i, "too slow");
+            return false;
+        }
+        const uint64_t head = rs3_byte_ring_head(&s_ring);
+        const uint8_t *p = NULL;
+        const size_t n = rs3_byte_ring_peek(&s_ring, t->pos, head, &p);
+        if (n == 0) return false;
+
+        // Straight from ring memory: no per-tap copy.
+        int sent = send(t->fd, p, n, MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            tap_close(i, "send failed");
+            return false;
+        }
+        // The writer may have lapped us while send() was copying: the stream is corrupt then.
+        if (rs3_byte_ring_lost(&s_ring, t->pos)) {
+            stats_count(&s_stats.dropped_slow);
+            tap_close(i, "too slow");
+            return false;
+        }
+        t->pos += (uint64_t)sent;
+        if ((size_t)sent < n) return true;
+    }
+}
+
+static void tap_task(void *arg)
+{
+    (void)arg;
+
+    const int port = CONFIG_RS3_USB_PTP_PROXY_TAP_PORT;
+    int listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (listen_fd < 0) {
+        ESP_LOGE(TAG, "socket() failed: errno=%d", errno);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    int yes = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 2) != 0) {
+        ESP_LOGE(TAG, "bind/listen(%d) failed: errno=%d", port, errno);
+        close(listen_fd);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Listening on tap TCP port %d", port);
+
+    bool backlog = false;
+    for (;;) {
+        // Woken by every publish; the timeout only paces retries for taps with a full socket buffer
+        // and picks up new connections.
+        (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(backlog ? 5 : 100));
+
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(listen_fd, &rfds);
+        int maxfd = listen_fd;
+        for (int i = 0; i < CONFIG_RS3_USB_PTP_PROXY_TAP_CLIENTS; i++) {
+            if (s_taps[i].fd >= 0) {
+                FD_SET(s_taps[i].fd, &rfds);
+                if (s_taps[i].fd > maxfd) maxfd = s_taps[i].fd;
+            }
+        }
+        struct timeval tv = { 0 };
+        if (select(maxfd + 1, &rfds, NULL, NULL, &tv) > 0) {
+            if (FD_ISSET(listen_fd, &rfds)) {
+                int fd = accept(listen_fd, NULL, NULL);
+                if (fd >= 0) {
+                    int slot = -1;
+                    for (int i = 0; i < CONFIG_RS3_USB_PTP_PROXY_TAP_CLIENTS; i++) {
+                        if (s_taps[i].fd < 0) { slot = i; break; }
+                    }
+                    if (slot < 0) {
+                        stats_count(&s_stats.rejected);
+                        close(fd);
+                    } else {
+                        // New taps start at the newest frame; they never see a partial record.
+                        s_taps[slot].fd = fd;
+                        s_taps[slot].pos = rs3_byte_ring_start(&s_ring);
+                        s_tap_count++;
+                        RS3_LOGI(NET, "[PTP-TAP] tap %d connected\r\n", slot);
+                    }
+                }
+            }
+            for (int i = 0; i < CONFIG_RS3_USB_PTP_PROXY_TAP_CLIENTS; i++) {
+                if (s_taps[i].fd < 0 || !FD_ISSET(s_taps[i].fd, &rfds)) continue;
+                // Taps are read-only: discard anything they send, close on EOF.
+                char tmp[32];
+                int n = recv(s_taps[i].fd, tmp, sizeof(tmp), MSG_DONTWAIT);
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) tap_close(i, "disconnected");
+            }
+        }
+
+        backlog = false;
+        for (int i = 0; i < CONFIG_RS3_USB_PTP_PROXY_TAP_CLIENTS; i++) {
+            if (s_taps[i].fd >= 0 && tap_pump(i)) backlog = true;
+        }
+    }
+}
+
+// tapstats -> counters of rs3_ptp_proxy_tap_get_stats()
+static void handle_tapstats(char *arg, void *user_ctx)
+{
+    (void)arg;
+    (void)user_ctx;
+    rs3_ptp_proxy_tap_stats_t st;
+    rs3_ptp_proxy_tap_get_stats(&st);
+    char out[128];
+    snprintf(out, sizeof(out), "TAP: frames=%" PRIu32 " bytes=%" PRIu64 " taps=%" PRIu32 " dropped_slow=%" PRIu32 " rejected=%" PRIu32 "\r\n",
+             st.frames, st.bytes, st.taps, st.dropped_slow, st.rejected);
+    rs3_tcp_server_send_str(out);
+}
+
+static const rs3_cmd_t s_tap_cmd = {
+    .name = "tapstats", .help = "PTP proxy tap counters (frames, bytes, slow drops)", .handler = handle_tapstats,
+};
+
+esp_err_t rs3_ptp_proxy_tap_start(void)
+{
+    if (s_task) return ESP_OK;
+    (void)rs3_cmd_register(&s_tap_cmd);
+    for (int i = 0; i < CONFIG_RS3_USB_PTP_PROXY_TAP_CLIENTS; i++) s_taps[i].fd = -1;
+    esp_err_t err = rs3_byte_ring_init(&s_ring, (size_t)CONFIG_RS3_USB_PTP_PROXY_TAP_RING_KB * 1024U);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "tap ring alloc failed (%s)", esp_err_to_name(err));
+        return err;
+    }
+    // Below the proxy server: taps must never take CPU from the controlling client.
+    xTaskCreate(tap_task, "ptp_tap", 3072, NULL, 4, &s_task);
+    return ESP_OK;
+}
+
+#else
+
+void rs3_ptp_proxy_tap_publish(uint8_t type, const uint8_t *payload, size_t payload_len)
+{
+    (void)type; (void)payload; (void)payload_len;
+}
+
+void rs3_ptp_proxy_tap_get_stats(rs3_ptp_proxy_tap_stats_t *out)
+{
+    if (out) memset(out, 0, sizeof(*out));
+}
+
+esp_err_t rs3_ptp_proxy_tap_start(void)
+{
+    ESP_LOGI(TAG, "PTP proxy tap disabled");
+    return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef struct {
+    uint32_t frames;        // frames published into the tap ring
+    uint64_t bytes;         // bytes published (tap headers included)
+    uint32_t taps;          // currently connected taps
+    uint32_t dropped_slow;  // taps disconnected because they fell a full ring behind
+    uint32_t rejected;      // connections refused (all tap slots busy)
+} rs3_ptp_proxy_tap_stats_t;
+
+/**
+ * @brief Start the read-only tap server (listens on CONFIG_RS3_USB_PTP_PROXY_TAP_PORT).
+ *
+ * Every tap receives a copy of each proxy frame (both directions) as:
+ *   uint32_be length (type + timestamp + payload bytes)
+ *   uint8    type (same as the proxy frame: RAW_OUT/RAW_IN/RAW_DONE/...)
+ *   uint64_be esp_timer_get_time() when the frame was sent/received
+ *   payload...
+ *
+ * Frames are written once into a shared ring; each tap sends from its own cursor.
+ * A tap that falls more than the ring size behind is disconnected (counted in dropped_slow).
+ */
+esp_err_t rs3_ptp_proxy_tap_start(void);
+
+/**
+ * @brief Publish one proxy frame to the taps. Never blocks; no-op when no tap is connected.
+ */
+void rs3_ptp_proxy_tap_publish(uint8_t type, const uint8_t *payload, size_t payload_len);
+
+void rs3_ptp_proxy_tap_get_stats(rs3_ptp_proxy_tap_stats_t *out);
@@ -0,0 +1,415 @@
+#include "rpc_server.h"
+
+#include "sdkconfig.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "lwip/inet.h"
+#include "lwip/sockets.h"
+
+#include "log_tcp.h"
+#include "ptp_proxy_server.h"
+#include "ptp_proxy_tap.h"
+
+static const char *TAG = "rpc";
+
+#ifndef CONFIG_RS3_RPC_ENABLE
+#define CONFIG_RS3_RPC_ENABLE 0
+#endif
+#ifndef CONFIG_RS3_RPC_PORT
+#define CONFIG_RS3_RPC_PORT 1237
+#endif
+
+enum { RS3_RPC_METHOD_MAX = 24 };
+enum { RS3_RPC_FRAME_MAX = 1024 };   // largest request or response body
+
+static const rs3_rpc_method_t *s_methods[RS3_RPC_METHOD_MAX];
+static size_t s_method_count = 0;
+static portMUX_TYPE s_methods_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t rs3_rpc_register(const rs3_rpc_method_t *method)
+{
+    if (!method || !method->name || !method->name[0] || !method->handler) return ESP_ERR_INVALID_ARG;
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_methods_lock);
+    for (size_t i = 0; i < s_method_count && ret == ESP_OK; i++) {
+        if (strcmp(s_methods[i]->name, method->name) == 0) ret = ESP_ERR_INVALID_STATE;
+    }
+    if (ret == ESP_OK && s_method_count == RS3_RPC_METHOD_MAX) ret = ESP_ERR_NO_MEM;
+    if (ret == ESP_OK) s_methods[s_method_count++] = method;
+    portEXIT_CRITICAL(&s_methods_lock);
+    return ret;
+}
+
+static const rs3_rpc_method_t *method_lookup(const char *name, size_t len)
+{
+    const rs3_rpc_method_t *m = NULL;
+    portENTER_CRITICAL(&s_methods_lock);
+    for (size_t i = 0; i < s_method_count && !m; i++) {
+        if (rs3_cbor_text_eq(name, len, s_methods[i]->name)) m = s_methods[i];
+    }
+    portEXIT_CRITICAL(&s_methods_lock);
+    return m;
+}
+
+// ---- built-in methods ----
+
+static esp_err_t rpc_methods(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)params;
+    (void)user_ctx;
+    portENTER_CRITICAL(&s_methods_lock);
+    const size_t n = s_method_count;
+    portEXIT_CRITICAL(&s_methods_lock);
+    rs3_cbor_put_array(result, n);
+    for (size_t i = 0; i < n; i++) rs3_cbor_put_text(result, s_methods[i]->name);  // entries are never removed
+    return ESP_OK;
+}
+
+static esp_err_t rpc_ping(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)params;
+    (void)user_ctx;
+    rs3_cbor_put_map(result, 1);
+    rs3_cbor_put_text(result, "t_us");
+    rs3_cbor_put_uint(result, (uint64_t)esp_timer_get_time());
+    return ESP_OK;
+}
+
+static esp_err_t rpc_stats(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)params;
+    (void)user_ctx;
+    rs3_ptp_proxy_tap_stats_t tap;
+    rs3_ptp_proxy_tap_get_stats(&tap);
+
+    rs3_cbor_put_map(result, 5);
+    rs3_cbor_put_text(result, "uptime_us");
+    rs3_cbor_put_uint(result, (uint64_t)esp_timer_get_time());
+    rs3_cbor_put_text(result, "heap_free");
+    rs3_cbor_put_uint(result, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    rs3_cbor_put_text(result, "heap_min_free");
+    rs3_cbor_put_uint(result, heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+    rs3_cbor_put_text(result, "ptp_proxy_connected");
+    rs3_cbor_put_bool(result, rs3_ptp_proxy_is_connected());
+    rs3_cbor_put_text(result, "tap");
+    rs3_cbor_put_map(result, 5);
+    rs3_cbor_put_text(result, "frames");
+    rs3_cbor_put_uint(result, tap.frames);
+    rs3_cbor_put_text(result, "bytes");
+    rs3_cbor_put_uint(result, tap.bytes);
+    rs3_cbor_put_text(result, "taps");
+    rs3_cbor_put_uint(result, tap.taps);
+    rs3_cbor_put_text(result, "dropped_slow");
+    rs3_cbor_put_uint(result, tap.dropped_slow);
+    rs3_cbor_put_text(result, "rejected");
+    rs3_cbor_put_uint(result, tap.rejected);
+    return ESP_OK;
+}
+
+// Config keys: "log.<tag>" (per-tag level 0..5, writable) and "log.max" (build maximum, read-only).
+static int config_log_tag(const char *key)
+{
+    if (strncmp(key, "log.", 4) != 0) return -1;
+    return rs3_log_tag_from_name(key + 4);
+}
+
+static void put_config_entry(rs3_cbor_writer_t *w, const char *key)
+{
+    rs3_cbor_put_text(w, key);
+    const int t = config_log_tag(key);
+    rs3_cbor_put_uint(w, (t >= 0) ? rs3_log_levels[t] : CONFIG_RS3_LOG_MAX_LEVEL);
+}
+
+// config.get                -> {key: value, ...} for every key
+// config.get {"key": k}     -> {k: value}
+static esp_err_t rpc_config_get(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)user_ctx;
+    char key[24];
+    rs3_cbor_reader_t v;
+    if (rs3_cbor_map_find(params, "key", &v)) {
+        if (!rs3_cbor_get_text_z(&v, key, sizeof(key))) return ESP_ERR_INVALID_ARG;
+        if (config_log_tag(key) < 0 && strcmp(key, "log.max") != 0) return ESP_ERR_NOT_FOUND;
+        rs3_cbor_put_map(result, 1);
+        put_config_entry(result, key);
+        return ESP_OK;
+    }
+    rs3_cbor_put_map(result, RS3_LOG_TAG_COUNT + 1);
+    for (int i = 0; i < RS3_LOG_TAG_COUNT; i++) {
+        snprintf(key, sizeof(key), "log.%s", rs3_log_tag_name((rs3_log_tag_t)i));
+        put_config_entry(result, key);
+    }
+    put_config_entry(result, "log.max");
+    return ESP_OK;
+}
+
+// config.set {"key": "log.<tag>", "value": 0..5 | "none".."verbose"} -> {key: stored value}
+static esp_err_t rpc_config_set(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)user_ctx;
+    char key[24];
+    rs3_cbor_reader_t k, v;
+    if (!rs3_cbor_map_find(params, "key", &k) || !rs3_cbor_map_find(params, "value", &v)) return ESP_ERR_INVALID_ARG;
+    if (!rs3_cbor_get_text_z(&k, key, sizeof(key))) return ESP_ERR_INVALID_ARG;
+    const int t = config_log_tag(key);
+    if (t < 0) return (strcmp(key, "log.max") == 0) ? ESP_ERR_NOT_SUPPORTED : ESP_ERR_NOT_FOUND;
+
+    int64_t level = -1;
+    char name[12];
+    if (rs3_cbor_peek(&v) == RS3_CBOR_TEXT) {
+        if (!rs3_cbor_get_text_z(&v, name, sizeof(name))) return ESP_ERR_INVALID_ARG;
+        level = rs3_log_level_from_name(name);
+    } else if (!rs3_cbor_get_int(&v, &level)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (level < 0 || level > RS3_LOG_VERBOSE) return ESP_ERR_INVALID_ARG;
+    // Same clamp as `loglevel`: levels above the build's maximum are compiled out.
+    rs3_log_levels[t] = (uint8_t)((level > CONFIG_RS3_LOG_MAX_LEVEL) ? CONFIG_RS3_LOG_MAX_LEVEL : level);
+    rs3_cbor_put_map(result, 1);
+    put_config_entry(result, key);
+    return ESP_OK;
+}
+
+static const rs3_rpc_method_t s_builtin[] = {
+    {.name = "methods", .handler = rpc_methods},
+    {.name = "ping", .handler = rpc_ping},
+    {.name = "stats", .handler = rpc_stats},
+    {.name = "config.get", .handler = rpc_config_get},
+    {.name = "config.set", .handler = rpc_config_set},
+};
+
+#if CONFIG_RS3_RPC_ENABLE
+
+static TaskHandle_t s_task = NULL;
+static int s_client_fd = -1;
+
+// Server task only. Responses to one burst of pipelined requests go out in as few sends as possible.
+static uint8_t s_rx[4 + RS3_RPC_FRAME_MAX];
+static size_t s_rx_len = 0;
+static uint8_t s_tx[2 * (4 + RS3_RPC_FRAME_MAX)];
+static size_t s_tx_len = 0;
+static uint8_t s_result[RS3_RPC_FRAME_MAX - 16];   // room for the [id, status, ...] wrapper
+static int64_t s_rx_us = 0;                        // when the bytes being processed arrived
+
+int64_t rs3_rpc_request_rx_us(void)
+{
+    return s_rx_us;
+}
+
+static void drop_client(const char *why)
+{
+    if (s_client_fd < 0) return;
+    shutdown(s_client_fd, SHUT_RDWR);
+    close(s_client_fd);
+    s_client_fd = -1;
+    s_rx_len = 0;
+    s_tx_len = 0;
+    RS3_LOGI(NET, "[RPC] client dropped (%s)\r\n", why);
+}
+
+// Same options as the PTP proxy's client: the single RPC task must never hang on one peer.
+static void set_client_opts(int fd)
+{
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    // Half-open Wi-Fi peers: ~3 s to a dead link, then select() reports the error.
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &yes, sizeof(yes));
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+    int idle = 1, intvl = 1, cnt = 2;
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+#endif
+    // A pipelining client that stops reading fills the send buffer: flush_tx() gives up and drops it.
+    struct timeval snd_to = { .tv_sec = 0, .tv_usec = 500 * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &snd_to, sizeof(snd_to));
+}
+
+static bool flush_tx(void)
+{
+    size_t off = 0;
+    while (off < s_tx_len) {
+        int n = send(s_client_fd, s_tx + off, s_tx_len - off, 0);
+        if (n <= 0) {
+            drop_client("send failed");
+            return false;
+        }
+        off += (size_t)n;
+    }
+    s_tx_len = 0;
+    return true;
+}
+
+// Decode one request body and append its response frame to s_tx.
+static void handle_request(const uint8_t *body, size_t len)
+{
+    rs3_cbor_reader_t r;
+    rs3_cbor_reader_init(&r, body, len);
+    size_t items = 0;
+    uint64_t id = 0;
+    const char *name = NULL;
+    size_t name_len = 0;
+    esp_err_t status;
+    rs3_cbor_writer_t res;
+    rs3_cbor_writer_init(&res, s_result, sizeof(s_result));
+
+    if (!rs3_cbor_get_array(&r, &items) || items < 2 || items > 3 || !rs3_cbor_get_uint(&r, &id) ||
+        !rs3_cbor_get_text(&r, &name, &name_len)) {
+        status = ESP_ERR_INVALID_ARG;
+    } else {
+        const rs3_rpc_method_t *m = method_lookup(name, name_len);
+        status = m ? m->handler(&r, &res, m->user_ctx) : ESP_ERR_NOT_FOUND;
+        if (status == ESP_OK && res.overflow) status = ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t *frame = s_tx + s_tx_len;
+    rs3_cbor_writer_t w;
+    rs3_cbor_writer_init(&w, frame + 4, RS3_RPC_FRAME_MAX);
+    rs3_cbor_put_array(&w, 3);
+    rs3_cbor_put_uint(&w, id);
+    rs3_cbor_put_int(&w, status);
+    if (status != ESP_OK) {
+        rs3_cbor_put_text(&w, esp_err_to_name(status));
+    } else if (res.len == 0) {
+        rs3_cbor_put_null(&w);
+    } else {
+        rs3_cbor_put_raw(&w, res.buf, res.len);
+    }
+    frame[0] = (uint8_t)(w.len >> 24);
+    frame[1] = (uint8_t)(w.len >> 16);
+    frame[2] = (uint8_t)(w.len >> 8);
+    frame[3] = (uint8_t)w.len;
+    s_tx_len += 4 + w.len;
+}
+
+// Handle every complete frame in s_rx; keeps a trailing partial one for the next recv.
+static void process_rx(void)
+{
+    size_t off = 0;
+    while (s_client_fd >= 0 && s_rx_len - off >= 4) {
+        const uint8_t *p = s_rx + off;
+        const uint32_t len = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        if (len > RS3_RPC_FRAME_MAX) {
+            drop_client("frame too large");
+            return;
+        }
+        if (s_rx_len - off < 4 + len) break;
+        if (s_tx_len + 4 + RS3_RPC_FRAME_MAX > sizeof(s_tx) && !flush_tx()) return;
+        handle_request(p + 4, len);
+        off += 4 + len;
+    }
+    memmove(s_rx, s_rx + off, s_rx_len - off);
+    s_rx_len -= off;
+    if (s_tx_len) (void)flush_tx();
+}
+
+static void server_task(void *arg)
+{
+    (void)arg;
+    const int port = CONFIG_RS3_RPC_PORT;
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (listen_fd < 0) {
+        ESP_LOGE(TAG, "socket() failed: errno=%d", errno);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    int yes = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "bind(%d) failed: errno=%d", port, errno);
+        close(listen_fd);
+        vTaskDelete(NULL);
+        return;
+    }
+    if (listen(listen_fd, 1) != 0) {
+        ESP_LOGE(TAG, "listen() failed: errno=%d", errno);
+        close(listen_fd);
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_LOGI(TAG, "Listening on RPC port %d", port);
+
+    for (;;) {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(listen_fd, &rfds);
+        int maxfd = listen_fd;
+        if (s_client_fd >= 0) {
+            FD_SET(s_client_fd, &rfds);
+            if (s_client_fd > maxfd) maxfd = s_client_fd;
+        }
+        if (select(maxfd + 1, &rfds, NULL, NULL, NULL) < 0) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        if (FD_ISSET(listen_fd, &rfds)) {
+            struct sockaddr_in6 source_addr;
+            socklen_t addr_len = sizeof(source_addr);
+            int fd = accept(listen_fd, (struct sockaddr *)&source_addr, &addr_len);
+            if (fd >= 0) {
+                drop_client("replaced");
+                set_client_opts(fd);
+                s_client_fd = fd;
+                RS3_LOGI(NET, "[RPC] client connected\r\n");
+                continue;
+            }
+        }
+
+        if (s_client_fd >= 0 && FD_ISSET(s_client_fd, &rfds)) {
+            int n = recv(s_client_fd, s_rx + s_rx_len, sizeof(s_rx) - s_rx_len, 0);
+            if (n <= 0) {
+                drop_client("disconnected");
+                continue;
+            }
+            s_rx_us = esp_timer_get_time();
+            s_rx_len += (size_t)n;
+            process_rx();
+        }
+    }
+}
+
+esp_err_t rs3_rpc_server_start(void)
+{
+    if (s_task) return ESP_OK;
+    for (size_t i = 0; i < sizeof(s_builtin) / sizeof(s_builtin[0]); i++) {
+        esp_err_t err = rs3_rpc_register(&s_builtin[i]);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err;
+    }
+    // Same priority as the console: requests are short, and long work is queued to its owner.
+    xTaskCreate(server_task, "rpc", 4096, NULL, 4, &s_task);
+    return ESP_OK;
+}
+
+#else  // CONFIG_RS3_RPC_ENABLE
+
+int64_t rs3_rpc_request_rx_us(void)
+{
+    return 0;
+}
+
+esp_err_t rs3_rpc_server_start(void)
+{
+    (void)s_builtin;
+    ESP_LOGI(TAG, "RPC server disabled");
+    return ESP_OK;
+}
+
+#endif
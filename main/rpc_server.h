@@ -0,0 +1,58 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include "cbor_lite.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Binary RPC control channel for automation (listens on CONFIG_RS3_RPC_PORT, default 1237).
+ *
+ * Frame (both directions): uint32_be length, then one CBOR item (cbor_lite.h) of that length.
+ *   request:  [id: uint, method: text, params: any (optional)]
+ *   response: [id, status: int (0 = ESP_OK, else the esp_err_t), result: any]
+ * On failure the result is the error name (esp_err_to_name). Requests are answered in order and
+ * may be pipelined: a client can send many before reading any response.
+ *
+ * Single client at a time; a new connection replaces the old one. scripts/rs3_rpc.py is the client.
+ */
+
+/**
+ * @brief Method handler. params is positioned on the params item (RS3_CBOR_END when absent).
+ *
+ * Write exactly one CBOR item to result on success (nothing = null). A returned error discards
+ * whatever was written.
+ */
+typedef esp_err_t (*rs3_rpc_handler_t)(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx);
+
+typedef struct {
+    const char *name;   // "shutter", "config.get", ...
+    rs3_rpc_handler_t handler;
+    void *user_ctx;
+} rs3_rpc_method_t;
+
+/**
+ * @brief Add a method (descriptor kept by pointer). Modules register their own, before or after start.
+ *
+ * @return ESP_ERR_INVALID_STATE if the name is taken, ESP_ERR_NO_MEM if the table is full.
+ */
+esp_err_t rs3_rpc_register(const rs3_rpc_method_t *method);
+
+/**
+ * @brief esp_timer time at which the current request's last bytes were received (call from a
+ *        handler). Requests pipelined in one TCP segment share it.
+ */
+int64_t rs3_rpc_request_rx_us(void);
+
+/**
+ * @brief Start the RPC server task; registers the built-in methods
+ *        (methods, ping, stats, config.get, config.set).
+ */
+esp_err_t rs3_rpc_server_start(void);
+
+#ifdef __cplusplus
+}
+#endif
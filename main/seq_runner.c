@@ -0,0 +1,802 @@
+#include "seq_runner.h"
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
+#include "cmd_tcp.h"
+#include "log_tcp.h"
+#include "nikon_bt.h"
+#include "rec_events.h"
+#include "rpc_server.h"
+#include "tcp_server.h"
+
+static const char *TAG = "seq";
+
+enum { RS3_SEQ_STEPS_MAX = 64 };
+enum { RS3_SEQ_DEPTH_MAX = 4 };        // nested repeats
+enum { RS3_SEQ_REPORT_MAX = 128 };
+enum { RS3_SEQ_LEAD_US = 10000 };      // first step's deadline: time for the task to settle
+enum { RS3_SEQ_READY_POLL_MS = 10 };
+enum { RS3_SEQ_RPC_PAGE = 24 };        // report entries per seq.report response
+enum { RS3_SEQ_RPC_LIST_MAX = 24 };    // names per seq.list response
+
+static const char *const kNvsNs = "rs3_seq";
+
+typedef enum {
+    OP_CONNECT = 0,
+    OP_WAIT_READY,
+    OP_SHUTTER,
+    OP_PAIR,
+    OP_REC_START,
+    OP_REC_STOP,
+    OP_LOG,
+    OP_WAIT,     // schedule-only ops from here on: never recorded
+    OP_REPEAT,
+    OP_END,
+    OP_COUNT,
+} seq_op_t;
+
+static const char *const s_op_names[OP_COUNT] = {
+    [OP_CONNECT] = "connect",
+    [OP_WAIT_READY] = "wait_ready",
+    [OP_SHUTTER] = "shutter",
+    [OP_PAIR] = "pair",
+    [OP_REC_START] = "rec_start",
+    [OP_REC_STOP] = "rec_stop",
+    [OP_LOG] = "log",
+    [OP_WAIT] = "wait",
+    [OP_REPEAT] = "repeat",
+    [OP_END] = "end",
+};
+
+typedef struct {
+    uint8_t op;
+    uint16_t jump;   // end: first step of the loop body
+    uint32_t arg;    // wait/wait_ready: ms; repeat: count; log: offset of the text in prog.text
+} seq_step_t;
+
+typedef struct {
+    char text[RS3_SEQ_SCRIPT_MAX];   // tokenized copy of the script; log steps point into it
+    seq_step_t steps[RS3_SEQ_STEPS_MAX];
+    size_t count;
+} seq_prog_t;
+
+static TaskHandle_t s_task = NULL;
+static esp_timer_handle_t s_timer = NULL;
+static SemaphoreHandle_t s_lock = NULL;   // compile + start, s_check, s_text
+
+// s_prog is only written while no run is in progress (under s_lock); the runner reads it unlocked.
+static seq_prog_t s_prog;
+static seq_prog_t s_check;                // rs3_seq_save() validation
+static char s_text[RS3_SEQ_SCRIPT_MAX];   // stored script being loaded for a run
+static volatile bool s_running = false;
+static volatile bool s_stop = false;
+
+static rs3_seq_record_t s_report[RS3_SEQ_REPORT_MAX];
+static size_t s_report_total = 0;
+static portMUX_TYPE s_report_lock = portMUX_INITIALIZER_UNLOCKED;
+
+const char *rs3_seq_op_name(uint8_t op)
+{
+    return (op < OP_COUNT) ? s_op_names[op] : NULL;
+}
+
+static void set_err(char *err, size_t cap, const char *fmt, ...)
+{
+    if (!err || !cap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(err, cap, fmt, ap);
+    va_end(ap);
+}
+
+static bool parse_u32(const char *s, uint32_t lo, uint32_t hi, uint32_t *out)
+{
+    if (!isdigit((unsigned char)*s)) return false;
+    char *end;
+    const unsigned long v = strtoul(s, &end, 10);
+    if (*end || v < lo || v > hi) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+// One step: `word [arg]`, arg trimmed. Returns false with err set.
+static bool compile_step(seq_prog_t *p, char *word, char *arg, uint16_t *open, size_t *depth, char *err, size_t err_cap)
+{
+    const size_t i = p->count;
+    if (i == RS3_SEQ_STEPS_MAX) {
+        set_err(err, err_cap, "more than %d steps", RS3_SEQ_STEPS_MAX);
+        return false;
+    }
+    seq_step_t *st = &p->steps[i];
+    memset(st, 0, sizeof(*st));
+    bool ok;
+    if (strcasecmp(word, "connect") == 0) {
+        st->op = OP_CONNECT;
+        ok = !*arg;
+    } else if (strcasecmp(word, "wait_ready") == 0) {
+        st->op = OP_WAIT_READY;
+        ok = parse_u32(arg, 1, 600000, &st->arg);
+    } else if (strcasecmp(word, "shutter") == 0) {
+        st->op = OP_SHUTTER;
+        ok = !*arg;
+    } else if (strcasecmp(word, "pair") == 0) {
+        st->op = OP_PAIR;
+        ok = !*arg;
+    } else if (strcasecmp(word, "rec") == 0) {
+        ok = true;
+        if (strcasecmp(arg, "start") == 0) {
+            st->op = OP_REC_START;
+        } else if (strcasecmp(arg, "stop") == 0) {
+            st->op = OP_REC_STOP;
+        } else {
+            ok = false;
+        }
+    } else if (strcasecmp(word, "log") == 0) {
+        st->op = OP_LOG;
+        st->arg = (uint32_t)(arg - p->text);
+        ok = (*arg != 0);
+    } else if (strcasecmp(word, "wait") == 0) {
+        st->op = OP_WAIT;
+        ok = parse_u32(arg, 0, 3600000, &st->arg);
+    } else if (strcasecmp(word, "repeat") == 0) {
+        st->op = OP_REPEAT;
+        ok = parse_u32(arg, 1, 10000, &st->arg);
+        if (ok && *depth == RS3_SEQ_DEPTH_MAX) {
+            set_err(err, err_cap, "#%u: repeat nested more than %d deep", (unsigned)i, RS3_SEQ_DEPTH_MAX);
+            return false;
+        }
+        if (ok) open[(*depth)++] = (uint16_t)i;
+    } else if (strcasecmp(word, "end") == 0) {
+        st->op = OP_END;
+        ok = !*arg;
+        if (ok && *depth == 0) {
+            set_err(err, err_cap, "#%u: end without repeat", (unsigned)i);
+            return false;
+        }
+        if (ok) st->jump = (uint16_t)(open[--(*depth)] + 1);
+        // The runner only yields on actions: a body of waits/repeats would spin without a break.
+        bool action = false;
+        for (size_t j = st->jump; ok && j < i && !action; j++) action = (p->steps[j].op < OP_WAIT);
+        if (ok && !action) {
+            set_err(err, err_cap, "#%u: repeat body has no action step", (unsigned)(st->jump - 1));
+            return false;
+        }
+    } else {
+        set_err(err, err_cap, "#%u: unknown step '%s'", (unsigned)i, word);
+        return false;
+    }
+    if (!ok) {
+        set_err(err, err_cap, "#%u: bad argument for %s: '%s'", (unsigned)i, word, arg);
+        return false;
+    }
+    p->count++;
+    return true;
+}
+
+static esp_err_t compile(const char *script, seq_prog_t *p, char *err, size_t err_cap)
+{
+    const size_t len = strlen(script);
+    if (len >= sizeof(p->text)) {
+        set_err(err, err_cap, "script longer than %d bytes", RS3_SEQ_SCRIPT_MAX - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(p->text, script, len + 1);
+    p->count = 0;
+
+    uint16_t open[RS3_SEQ_DEPTH_MAX];
+    size_t depth = 0;
+    char *s = p->text;
+    for (;;) {
+        char *e = s + strcspn(s, ";\r\n");
+        const bool last = (*e == 0);
+        *e = 0;
+        while (isspace((unsigned char)*s)) s++;
+        for (char *t = e; t > s && isspace((unsigned char)t[-1]);) *--t = 0;
+        if (*s) {
+            char *arg = s;
+            while (*arg && !isspace((unsigned char)*arg)) arg++;
+            if (*arg) {
+                *arg++ = 0;
+                while (isspace((unsigned char)*arg)) arg++;
+            }
+            if (!compile_step(p, s, arg, open, &depth, err, err_cap)) return ESP_ERR_INVALID_ARG;
+        }
+        if (last) break;
+        s = e + 1;
+    }
+    if (depth) {
+        set_err(err, err_cap, "#%u: repeat without end", (unsigned)open[depth - 1]);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (p->count == 0) {
+        set_err(err, err_cap, "empty script");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+// ---- storage ----
+
+static bool name_ok(const char *name)
+{
+    const size_t n = name ? strlen(name) : 0;
+    if (n == 0 || n > RS3_SEQ_NAME_MAX) return false;
+    for (size_t i = 0; i < n; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-') return false;
+    }
+    return true;
+}
+
+esp_err_t rs3_seq_load(const char *name, char *buf, size_t cap)
+{
+    if (!name_ok(name)) return ESP_ERR_INVALID_ARG;
+    nvs_handle_t h = 0;
+    esp_err_t err = nvs_open(kNvsNs, NVS_READONLY, &h);
+    if (err != ESP_OK) return err;
+    size_t len = cap;
+    err = nvs_get_str(h, name, buf, &len);
+    nvs_close(h);
+    return err;
+}
+
+esp_err_t rs3_seq_save(const char *name, const char *script, size_t *steps, char *err, size_t err_cap)
+{
+    if (!name_ok(name)) {
+        set_err(err, err_cap, "name: 1..%d of [A-Za-z0-9_-]", RS3_SEQ_NAME_MAX);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t ret = compile(script, &s_check, err, err_cap);
+    if (ret == ESP_OK && steps) *steps = s_check.count;
+    xSemaphoreGive(s_lock);
+    if (ret != ESP_OK) return ret;
+
+    nvs_handle_t h = 0;
+    ret = nvs_open(kNvsNs, NVS_READWRITE, &h);
+    if (ret == ESP_OK) {
+        ret = nvs_set_str(h, name, script);
+        if (ret == ESP_OK) ret = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (ret != ESP_OK) set_err(err, err_cap, "nvs: %s", esp_err_to_name(ret));
+    return ret;
+}
+
+esp_err_t rs3_seq_delete(const char *name)
+{
+    if (!name_ok(name)) return ESP_ERR_INVALID_ARG;
+    nvs_handle_t h = 0;
+    esp_err_t err = nvs_open(kNvsNs, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_erase_key(h, name);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+// Calls fn for every stored script name; returns how many there are.
+static size_t seq_list(void (*fn)(const char *name, void *ctx), void *ctx)
+{
+    size_t n = 0;
+    nvs_iterator_t it = NULL;
+    esp_err_t res = nvs_entry_find(NVS_DEFAULT_PART_NAME, kNvsNs, NVS_TYPE_STR, &it);
+    while (res == ESP_OK) {
+        nvs_entry_info_t info;
+        if (nvs_entry_info(it, &info) == ESP_OK) {
+            if (fn) fn(info.key, ctx);
+            n++;
+        }
+        res = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
+    return n;
+}
+
+// ---- runner ----
+
+static void deadline_cb(void *arg)
+{
+    (void)arg;
+    xTaskNotifyGive(s_task);
+}
+
+// Sleep until the absolute deadline (esp_timer clock); false if stopped meanwhile.
+static bool wait_until(int64_t deadline)
+{
+    for (;;) {
+        if (s_stop) return false;
+        const int64_t left = deadline - esp_timer_get_time();
+        if (left <= 0) return true;
+        (void)esp_timer_stop(s_timer);  // a stop request may have woken us with the timer still armed
+        (void)esp_timer_start_once(s_timer, (uint64_t)left);
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+// Poll the BT session; a stop request ends the poll early. ready_at: when it was seen ready.
+static bool wait_ready(uint32_t ms, int64_t *ready_at)
+{
+    const int64_t until = esp_timer_get_time() + (int64_t)ms * 1000;
+    const TickType_t poll = pdMS_TO_TICKS(RS3_SEQ_READY_POLL_MS) ? pdMS_TO_TICKS(RS3_SEQ_READY_POLL_MS) : 1;
+    while (!rs3_nikon_bt_is_ready()) {
+        if (s_stop || esp_timer_get_time() >= until) return false;
+        (void)ulTaskNotifyTake(pdTRUE, poll);
+    }
+    *ready_at = esp_timer_get_time();
+    return true;
+}
+
+static void record(size_t step, uint8_t op, bool ok, int64_t sched_us, int64_t actual_us)
+{
+    portENTER_CRITICAL(&s_report_lock);
+    if (s_report_total < RS3_SEQ_REPORT_MAX) {
+        s_report[s_report_total] = (rs3_seq_record_t){
+            .step = (uint16_t)step, .op = op, .ok = ok, .sched_us = sched_us, .actual_us = actual_us,
+        };
+    }
+    s_report_total++;
+    portEXIT_CRITICAL(&s_report_lock);
+}
+
+static void run_prog(const seq_prog_t *p)
+{
+    uint32_t left[RS3_SEQ_DEPTH_MAX];
+    size_t depth = 0;
+    size_t actions = 0;
+    int64_t late_sum = 0;
+    int64_t late_max = 0;
+    const char *abort_why = NULL;
+
+    const int64_t t0 = esp_timer_get_time() + RS3_SEQ_LEAD_US;
+    int64_t sched = t0;
+    size_t pc = 0;
+    RS3_LOGI(SEQ, "[SEQ] run: %u steps\r\n", (unsigned)p->count);
+
+    while (pc < p->count && !abort_why) {
+        const seq_step_t *st = &p->steps[pc];
+        if (st->op == OP_WAIT) {
+            sched += (int64_t)st->arg * 1000;
+            pc++;
+            continue;
+        }
+        if (st->op == OP_REPEAT) {
+            left[depth++] = st->arg;
+            pc++;
+            continue;
+        }
+        if (st->op == OP_END) {
+            if (--left[depth - 1]) {
+                pc = st->jump;
+            } else {
+                depth--;
+                pc++;
+            }
+            continue;
+        }
+
+        if (!wait_until(sched)) {
+            abort_why = "stopped";
+            break;
+        }
+        const int64_t actual = esp_timer_get_time();
+        bool ok = true;
+        switch (st->op) {
+        case OP_CONNECT:
+            ok = (rs3_nikon_bt_connect() == ESP_OK);
+            break;
+        case OP_SHUTTER:
+            ok = (rs3_nikon_bt_shutter_click() == ESP_OK);
+            break;
+        case OP_PAIR:
+            ok = (rs3_nikon_bt_pair_start() == ESP_OK);
+            break;
+        case OP_REC_START:
+            rs3_rec_events_publish(RS3_REC_EVT_START, 0, NULL, 0);
+            break;
+        case OP_REC_STOP:
+            rs3_rec_events_publish(RS3_REC_EVT_STOP, 0, NULL, 0);
+            break;
+        case OP_LOG:
+            RS3_LOGI(SEQ, "[SEQ] #%u log: %s\r\n", (unsigned)pc, p->text + st->arg);
+            break;
+        case OP_WAIT_READY: {
+            int64_t ready_at = 0;
+            ok = wait_ready(st->arg, &ready_at);
+            if (!ok) {
+                abort_why = s_stop ? "stopped" : "camera not ready";
+                record(pc, st->op, false, sched - t0, esp_timer_get_time() - t0);
+                continue;
+            }
+            // Later steps count from the moment the camera became usable, not from the request.
+            record(pc, st->op, true, sched - t0, ready_at - t0);
+            RS3_LOGI(SEQ, "[SEQ] #%u wait_ready: ready after %" PRIu32 " ms\r\n", (unsigned)pc,
+                     (uint32_t)((ready_at - sched) / 1000));
+            sched = ready_at;
+            pc++;
+            continue;
+        }
+        default:
+            break;
+        }
+
+        const int64_t late = actual - sched;
+        record(pc, st->op, ok, sched - t0, actual - t0);
+        actions++;
+        late_sum += late;
+        if (late > late_max) late_max = late;
+        // 64-bit: 32-bit microseconds would wrap after ~71 minutes of script.
+        RS3_LOGI(SEQ, "[SEQ] #%u %s sched=+%" PRId64 " us actual=+%" PRId64 " us late=%" PRId64 " us%s\r\n",
+                 (unsigned)pc, s_op_names[st->op], sched - t0, actual - t0, late, ok ? "" : " FAILED");
+        pc++;
+    }
+    (void)esp_timer_stop(s_timer);
+
+    if (abort_why) {
+        RS3_LOGW(SEQ, "[SEQ] aborted at #%u: %s\r\n", (unsigned)pc, abort_why);
+    }
+    RS3_LOGI(SEQ, "[SEQ] done: %u actions, late avg=%" PRId64 " us max=%" PRId64 " us\r\n", (unsigned)actions,
+             actions ? late_sum / (int64_t)actions : 0, late_max);
+}
+
+static void seq_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!s_running) continue;  // leftover wake-up from a stop or a late timer
+        run_prog(&s_prog);
+        s_running = false;
+    }
+}
+
+esp_err_t rs3_seq_run(const char *name, const char *script, size_t *steps, char *err, size_t err_cap)
+{
+    if (!s_task) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t ret = ESP_OK;
+    if (s_running) {
+        set_err(err, err_cap, "already running (seq stop)");
+        ret = ESP_ERR_INVALID_STATE;
+    } else if (name) {
+        ret = rs3_seq_load(name, s_text, sizeof(s_text));
+        if (ret != ESP_OK) set_err(err, err_cap, "load %s: %s", name, esp_err_to_name(ret));
+        script = s_text;
+    }
+    if (ret == ESP_OK) ret = compile(script ? script : "", &s_prog, err, err_cap);
+    if (ret == ESP_OK) {
+        if (steps) *steps = s_prog.count;
+        portENTER_CRITICAL(&s_report_lock);
+        s_report_total = 0;
+        portEXIT_CRITICAL(&s_report_lock);
+        s_stop = false;
+        s_running = true;
+        xTaskNotifyGive(s_task);
+    }
+    xSemaphoreGive(s_lock);
+    return ret;
+}
+
+void rs3_seq_stop(void)
+{
+    if (!s_running) return;
+    s_stop = true;
+    xTaskNotifyGive(s_task);
+}
+
+bool rs3_seq_is_running(void)
+{
+    return s_running;
+}
+
+size_t rs3_seq_report(size_t from, rs3_seq_record_t *out, size_t max, size_t *total)
+{
+    size_t n = 0;
+    portENTER_CRITICAL(&s_report_lock);
+    const size_t kept = (s_report_total < RS3_SEQ_REPORT_MAX) ? s_report_total : RS3_SEQ_REPORT_MAX;
+    for (size_t i = from; i < kept && n < max; i++) out[n++] = s_report[i];
+    if (total) *total = s_report_total;
+    portEXIT_CRITICAL(&s_report_lock);
+    return n;
+}
+
+// ---- console: seq ... ----
+
+static void reply_err(const char *what, esp_err_t ret, const char *why)
+{
+    char out[160];
+    snprintf(out, sizeof(out), "ERR: seq %s: %s\r\n", what, (why && why[0]) ? why : esp_err_to_name(ret));
+    rs3_tcp_server_send_str(out);
+}
+
+// Split off the first word of s (in place); returns the rest, trimmed.
+static char *next_word(char *s)
+{
+    while (*s && *s != ' ' && *s != '\t') s++;
+    if (!*s) return s;
+    *s++ = 0;
+    while (*s == ' ' || *s == '\t') s++;
+    return s;
+}
+
+static void list_cb(const char *name, void *ctx)
+{
+    (void)ctx;
+    char out[40];
+    snprintf(out, sizeof(out), "SEQ:   %s\r\n", name);
+    rs3_tcp_server_send_str(out);
+}
+
+static void send_report(void)
+{
+    rs3_seq_record_t r[8];
+    size_t total = 0;
+    size_t from = 0;
+    size_t n;
+    char out[128];
+    while ((n = rs3_seq_report(from, r, sizeof(r) / sizeof(r[0]), &total)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            snprintf(out, sizeof(out), "SEQ: #%u %-10s sched=+%" PRId64 " us actual=+%" PRId64 " us late=%" PRId64 " us%s\r\n",
+                     r[i].step, rs3_seq_op_name(r[i].op), r[i].sched_us, r[i].actual_us,
+                     r[i].actual_us - r[i].sched_us, r[i].ok ? "" : " FAILED");
+            rs3_tcp_server_send_str(out);
+        }
+        from += n;
+    }
+    snprintf(out, sizeof(out), "SEQ: %u records (%u kept)%s\r\n", (unsigned)total, (unsigned)from,
+             s_running ? ", running" : "");
+    rs3_tcp_server_send_str(out);
+}
+
+// seq save <name> <script> | run <name> | exec <script> | stop | show <name> | del <name> | list | report
+static void handle_seq(char *arg, void *user_ctx)
+{
+    (void)user_ctx;
+    char err[96] = "";
+    char out[96];
+    char *sub = arg;
+    char *rest = next_word(arg);
+    size_t steps = 0;
+    esp_err_t ret;
+
+    if (strcasecmp(sub, "save") == 0) {
+        char *name = rest;
+        char *script = next_word(rest);
+        ret = rs3_seq_save(name, script, &steps, err, sizeof(err));
+        if (ret != ESP_OK) {
+            reply_err("save", ret, err);
+            return;
+        }
+        snprintf(out, sizeof(out), "SEQ: saved %s (%u steps)\r\n", name, (unsigned)steps);
+        rs3_tcp_server_send_str(out);
+    } else if (strcasecmp(sub, "run") == 0 || strcasecmp(sub, "exec") == 0) {
+        const bool stored = (strcasecmp(sub, "run") == 0);
+        ret = rs3_seq_run(stored ? rest : NULL, stored ? NULL : rest, &steps, err, sizeof(err));
+        if (ret != ESP_OK) {
+            reply_err(sub, ret, err);
+            return;
+        }
+        snprintf(out, sizeof(out), "SEQ: running (%u steps; seq report)\r\n", (unsigned)steps);
+        rs3_tcp_server_send_str(out);
+    } else if (strcasecmp(sub, "stop") == 0) {
+        rs3_tcp_server_send_str(s_running ? "SEQ: stopping\r\n" : "SEQ: not running\r\n");
+        rs3_seq_stop();
+    } else if (strcasecmp(sub, "show") == 0) {
+        char text[RS3_SEQ_SCRIPT_MAX];
+        ret = rs3_seq_load(rest, text, sizeof(text));
+        if (ret != ESP_OK) {
+            reply_err("show", ret, NULL);
+            return;
+        }
+        rs3_tcp_server_send_str("SEQ: ");
+        rs3_tcp_server_send_str(text);
+        rs3_tcp_server_send_str("\r\n");
+    } else if (strcasecmp(sub, "del") == 0) {
+        ret = rs3_seq_delete(rest);
+        if (ret != ESP_OK) {
+            reply_err("del", ret, NULL);
+            return;
+        }
+        rs3_tcp_server_send_str("SEQ: deleted\r\n");
+    } else if (strcasecmp(sub, "list") == 0) {
+        const size_t n = seq_list(list_cb, NULL);
+        snprintf(out, sizeof(out), "SEQ: %u stored\r\n", (unsigned)n);
+        rs3_tcp_server_send_str(out);
+    } else if (strcasecmp(sub, "report") == 0) {
+        send_report();
+    } else {
+        rs3_tcp_server_send_str("ERR: usage: seq <save <name> <script>|run <name>|exec <script>|stop|show <name>|del <name>|list|report>\r\n");
+    }
+}
+
+static const rs3_cmd_t s_seq_cmd = {
+    .name = "seq",
+    .usage = "<save|run|exec|stop|show|del|list|report> ...",
+    .help = "timed action scripts (steps: connect, wait_ready, shutter, rec, wait, repeat, ...)",
+    .min_args = 1,
+    .max_args = RS3_CMD_ARGS_ANY,
+    .handler = handle_seq,
+};
+
+// ---- RPC: seq.* ----
+
+static bool param_text(rs3_cbor_reader_t *params, const char *key, char *buf, size_t cap)
+{
+    rs3_cbor_reader_t v;
+    return rs3_cbor_map_find(params, key, &v) && rs3_cbor_get_text_z(&v, buf, cap);
+}
+
+// seq.save {"name", "script"} -> {"steps": n}
+static esp_err_t rpc_seq_save(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)user_ctx;
+    char name[RS3_SEQ_NAME_MAX + 1];
+    char script[RS3_SEQ_SCRIPT_MAX];
+    char err[96] = "";
+    if (!param_text(params, "name", name, sizeof(name)) || !param_text(params, "script", script, sizeof(script))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t steps = 0;
+    esp_err_t ret = rs3_seq_save(name, script, &steps, err, sizeof(err));
+    if (ret != ESP_OK) {
+        RS3_LOGW(SEQ, "[SEQ] save %s: %s\r\n", name, err);
+        return ret;
+    }
+    rs3_cbor_put_map(result, 1);
+    rs3_cbor_put_text(result, "steps");
+    rs3_cbor_put_uint(result, steps);
+    return ESP_OK;
+}
+
+// seq.run {"name"} | {"script"} -> {"steps": n}
+static esp_err_t rpc_seq_run(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)user_ctx;
+    char name[RS3_SEQ_NAME_MAX + 1];
+    char script[RS3_SEQ_SCRIPT_MAX];
+    char err[96] = "";
+    size_t steps = 0;
+    esp_err_t ret;
+    if (param_text(params, "name", name, sizeof(name))) {
+        ret = rs3_seq_run(name, NULL, &steps, err, sizeof(err));
+    } else if (param_text(params, "script", script, sizeof(script))) {
+        ret = rs3_seq_run(NULL, script, &steps, err, sizeof(err));
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ret != ESP_OK) {
+        RS3_LOGW(SEQ, "[SEQ] run: %s\r\n", err);
+        return ret;
+    }
+    rs3_cbor_put_map(result, 1);
+    rs3_cbor_put_text(result, "steps");
+    rs3_cbor_put_uint(result, steps);
+    return ESP_OK;
+}
+
+static esp_err_t rpc_seq_stop(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)params;
+    (void)result;
+    (void)user_ctx;
+    rs3_seq_stop();
+    return ESP_OK;
+}
+
+typedef struct {
+    char names[RS3_SEQ_RPC_LIST_MAX][RS3_SEQ_NAME_MAX + 1];
+    size_t n;
+} rpc_list_t;
+
+static void rpc_list_cb(const char *name, void *ctx)
+{
+    rpc_list_t *l = (rpc_list_t *)ctx;
+    if (l->n < RS3_SEQ_RPC_LIST_MAX) strlcpy(l->names[l->n++], name, sizeof(l->names[0]));
+}
+
+// seq.list -> [name, ...] (the first RS3_SEQ_RPC_LIST_MAX)
+static esp_err_t rpc_seq_list(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)params;
+    (void)user_ctx;
+    rpc_list_t l = {.n = 0};
+    (void)seq_list(rpc_list_cb, &l);
+    rs3_cbor_put_array(result, l.n);
+    for (size_t i = 0; i < l.n; i++) rs3_cbor_put_text(result, l.names[i]);
+    return ESP_OK;
+}
+
+// seq.show {"name"} -> script text
+static esp_err_t rpc_seq_show(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)user_ctx;
+    char name[RS3_SEQ_NAME_MAX + 1];
+    char script[RS3_SEQ_SCRIPT_MAX];
+    if (!param_text(params, "name", name, sizeof(name))) return ESP_ERR_INVALID_ARG;
+    ESP_RETURN_ON_ERROR(rs3_seq_load(name, script, sizeof(script)), TAG, "load %s", name);
+    rs3_cbor_put_text(result, script);
+    return ESP_OK;
+}
+
+static esp_err_t rpc_seq_delete(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)result;
+    (void)user_ctx;
+    char name[RS3_SEQ_NAME_MAX + 1];
+    if (!param_text(params, "name", name, sizeof(name))) return ESP_ERR_INVALID_ARG;
+    return rs3_seq_delete(name);
+}
+
+// seq.report {"from": i} -> {"running", "total", "steps": [[step, op, sched_us, actual_us, ok], ...]}
+// At most RS3_SEQ_RPC_PAGE steps per call; ask again from i + len(steps) for the rest.
+static esp_err_t rpc_seq_report(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)user_ctx;
+    uint64_t from = 0;
+    rs3_cbor_reader_t v;
+    if (rs3_cbor_map_find(params, "from", &v) && !rs3_cbor_get_uint(&v, &from)) return ESP_ERR_INVALID_ARG;
+    rs3_seq_record_t r[RS3_SEQ_RPC_PAGE];
+    size_t total = 0;
+    const size_t n = rs3_seq_report((size_t)from, r, RS3_SEQ_RPC_PAGE, &total);
+
+    rs3_cbor_put_map(result, 3);
+    rs3_cbor_put_text(result, "running");
+    rs3_cbor_put_bool(result, s_running);
+    rs3_cbor_put_text(result, "total");
+    rs3_cbor_put_uint(result, total);
+    rs3_cbor_put_text(result, "steps");
+    rs3_cbor_put_array(result, n);
+    for (size_t i = 0; i < n; i++) {
+        rs3_cbor_put_array(result, 5);
+        rs3_cbor_put_uint(result, r[i].step);
+        rs3_cbor_put_text(result, rs3_seq_op_name(r[i].op));
+        rs3_cbor_put_int(result, r[i].sched_us);
+        rs3_cbor_put_int(result, r[i].actual_us);
+        rs3_cbor_put_bool(result, r[i].ok);
+    }
+    return ESP_OK;
+}
+
+static const rs3_rpc_method_t s_seq_rpc[] = {
+    {.name = "seq.save", .handler = rpc_seq_save},
+    {.name = "seq.run", .handler = rpc_seq_run},
+    {.name = "seq.stop", .handler = rpc_seq_stop},
+    {.name = "seq.list", .handler = rpc_seq_list},
+    {.name = "seq.show", .handler = rpc_seq_show},
+    {.name = "seq.delete", .handler = rpc_seq_delete},
+    {.name = "seq.report", .handler = rpc_seq_report},
+};
+
+esp_err_t rs3_seq_start(void)
+{
+    if (s_task) return ESP_OK;
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+    const esp_timer_create_args_t args = {
+        .callback = deadline_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "seq_deadline",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_timer), TAG, "timer");
+    // Above the TCP/RPC servers and the command worker: network bursts must not delay a step.
+    if (xTaskCreate(seq_task, "seq", 3072, NULL, 6, &s_task) != pdPASS) return ESP_ERR_NO_MEM;
+    (void)rs3_cmd_register(&s_seq_cmd);
+    for (size_t i = 0; i < sizeof(s_seq_rpc) / sizeof(s_seq_rpc[0]); i++) (void)rs3_rpc_register(&s_seq_rpc[i]);
+    ESP_LOGI(TAG, "sequence runner ready (send: seq list)");
+    return ESP_OK;
+}
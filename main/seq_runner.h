@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * On-device sequence runner: timed action scripts run without the Wi-Fi round trip per step.
+ *
+ * A script is a list of steps separated by ';' or newlines:
+ *
+ *   connect                 BT: connect to the last paired camera
+ *   wait_ready <ms>         wait (up to ms) for the BT remote session; re-anchors the schedule
+ *   shutter | pair          BT shutter click / start pairing
+ *   rec start|stop          publish an RS3 REC event (same path as the RS3 REC button)
+ *   wait <ms>               advance the schedule
+ *   repeat <n> ... end      loop (nested up to 4 deep)
+ *   log <text>              console line
+ *
+ *   connect; wait_ready 8000; repeat 5; shutter; wait 250; end; rec start
+ *
+ * Steps are scheduled on an absolute timeline (waits add to it, so late steps do not push the
+ * ones after them) and woken by esp_timer deadlines. Every action records its scheduled and
+ * actual dispatch time; actions that only queue work (BT) are timed at dispatch.
+ *
+ * Scripts are stored in NVS (namespace "rs3_seq", key = name). Console: `seq`; RPC: seq.*.
+ */
+
+#define RS3_SEQ_SCRIPT_MAX 512   // bytes of script text, NUL included
+#define RS3_SEQ_NAME_MAX 15      // NVS key length
+
+typedef struct {
+    uint16_t step;       // index of the step in the compiled script
+    uint8_t op;          // rs3_seq_op_name()
+    bool ok;             // action accepted (wait_ready: ready before the timeout)
+    int64_t sched_us;    // relative to the run's start
+    int64_t actual_us;
+} rs3_seq_record_t;
+
+/** @brief Start the runner task and register the `seq` console command and seq.* RPC methods. */
+esp_err_t rs3_seq_start(void);
+
+/**
+ * @brief Check a script and store it under name; steps (optional) gets its compiled length.
+ *
+ * @return ESP_ERR_INVALID_ARG for a bad name or script (err, if given, says why).
+ */
+esp_err_t rs3_seq_save(const char *name, const char *script, size_t *steps, char *err, size_t err_cap);
+
+/** @brief Read a stored script into buf (NUL-terminated). ESP_ERR_NVS_NOT_FOUND if absent. */
+esp_err_t rs3_seq_load(const char *name, char *buf, size_t cap);
+
+esp_err_t rs3_seq_delete(const char *name);
+
+/**
+ * @brief Compile and start a script (text, or the stored one when name is set).
+ *
+ * @return ESP_ERR_INVALID_STATE while another run is in progress.
+ */
+esp_err_t rs3_seq_run(const char *name, const char *script, size_t *steps, char *err, size_t err_cap);
+
+/** @brief Abort the current run at its next wake-up. */
+void rs3_seq_stop(void);
+
+bool rs3_seq_is_running(void);
+
+/**
+ * @brief Copy report entries [from, from + max) of the current/last run.
+ *
+ * @param total Records written so far (entries past the report buffer are counted, not kept).
+ * @return Entries copied.
+ */
+size_t rs3_seq_report(size_t from, rs3_seq_record_t *out, size_t max, size_t *total);
+
+const char *rs3_seq_op_name(uint8_t op);
+
+#ifdef __cplusplus
+}
+#endif
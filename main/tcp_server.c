@@ -1,28 +1,90 @@
 #include "tcp_server.h"
 
 #include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <unistd.h>
 
 #include "esp_check.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_eventfd.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 #include "freertos/task.h"
 
 #include "lwip/sockets.h"
 #include "lwip/inet.h"
 #include "lwip/netdb.h"
 
+#include "byte_ring.h"
+#include "crash_log.h"
+#include "lz4_stream.h"
+
+#ifndef CONFIG_RS3_TCP_SERVER_LOG_RING_KB
+#define CONFIG_RS3_TCP_SERVER_LOG_RING_KB 16
+#endif
+#ifndef CONFIG_RS3_TCP_SERVER_CLIENTS
+#define CONFIG_RS3_TCP_SERVER_CLIENTS 3
+#endif
+#ifndef CONFIG_RS3_TCP_SERVER_ZLOG
+#define CONFIG_RS3_TCP_SERVER_ZLOG 0
+#endif
+
 static const char *TAG = "tcp_server";
 
+enum { REC_ENDS = 256 };  // power of two: end positions of the newest records
+
+// Compressed console (`zlog on`, per client). After the plain "ZLOG: on\r\n" note the client gets
+// frames: u16 LE compressed length, u16 LE raw length, one LZ4 block (see lz4_stream.h). A frame
+// with both lengths 0 ends compressed mode; plain text follows. scripts/rs3_zlog.py decodes it.
+typedef struct {
+    rs3_lz4s_t lz;
+    uint8_t out[4 + RS3_LZ4S_BOUND];   // frame being sent
+    uint16_t out_len;
+    uint16_t out_off;
+    bool on;          // ring bytes and notes go through the compressor
+    uint8_t plain_end;  // note bytes before this offset (up to "ZLOG: on\r\n") still go out plain
+    bool stopping;    // `zlog off`: end frame, then plain text
+    bool end_queued;
+    uint64_t raw;     // statistics since `zlog on`
+    uint64_t packed;
+    uint64_t cpu_us;
+} zlog_t;
+
 typedef struct {
-    size_t len;
-    char buf[512];
-} out_msg_t;
+    int fd;
+    uint64_t pos;       // next s_out_ring byte to send
+    uint32_t dropped;   // lines lost because this client fell a whole ring behind
+    char note[96];      // pending "[LOG] dropped" marker or reply, sent before the next ring byte
+    uint8_t note_len;
+    uint8_t note_off;
+    char rx[128];       // partial command line
+    size_t rx_len;
+    zlog_t *zl;         // non-NULL while compressed mode is on or being switched
+} client_t;
 
-static QueueHandle_t s_out_q = NULL;
+// Outgoing text: lines are appended back to back into one overwriting byte ring (PSRAM when
+// available) and every client reads it at its own cursor, like the PTP tap. Producers never wait;
+// a client that falls a whole ring behind skips to the newest line and gets a drop marker.
+static rs3_byte_ring_t s_out_ring;
+static bool s_out_ready = false;
+// Record ends (for counting what a lapped client lost), updated together with the ring.
+static portMUX_TYPE s_out_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint64_t s_rec_end[REC_ENDS];
+static uint64_t s_records = 0;
+// Producers wake the server task through an eventfd that select() waits on together with the
+// sockets; only the first write after a drain pays for the syscall.
+static int s_wake_fd = -1;
+static bool s_wake_pending = false;
 static TaskHandle_t s_task = NULL;
-static int s_client_fd = -1;
+
+static client_t s_clients[CONFIG_RS3_TCP_SERVER_CLIENTS];
+static volatile uint32_t s_client_id = 0;   // 0 = no client
+static uint32_t s_client_seq = 0;
 
 static rs3_tcp_server_status_cb_t s_status_cb = NULL;
 static void *s_status_ctx = NULL;
@@ -48,35 +110,435 @@ static inline void emit_status(void)
     if (s_status_cb) s_status_cb(&s_status, s_status_ctx);
 }
 
+// Ring copy only (spinlocks, no syscalls): safe inside another critical section.
+static esp_err_t out_enqueue(const char *data, size_t len)
+{
+    if (!s_out_ready || !data || len == 0 || !s_client_id) return ESP_ERR_INVALID_STATE;
+
+    uint64_t end = 0;
+    if (!rs3_byte_ring_write2(&s_out_ring, data, len, NULL, 0, &end)) return ESP_ERR_INVALID_SIZE;
+    // Concurrent writers may log their ends slightly out of order: drop counts are a lower bound.
+    taskENTER_CRITICAL(&s_out_lock);
+    s_rec_end[s_records & (REC_ENDS - 1)] = end;
+    s_records++;
+    taskEXIT_CRITICAL(&s_out_lock);
+    return ESP_OK;
+}
+
+// eventfd write (VFS + lwIP locks): never from a critical section.
+static void out_wake(void)
+{
+    taskENTER_CRITICAL(&s_out_lock);
+    const bool wake = !s_wake_pending;
+    s_wake_pending = true;
+    taskEXIT_CRITICAL(&s_out_lock);
+    if (wake && s_wake_fd >= 0) {
+        const uint64_t one = 1;
+        (void)write(s_wake_fd, &one, sizeof(one));
+    }
+}
+
+static esp_err_t out_write(const char *data, size_t len)
+{
+    const esp_err_t err = out_enqueue(data, len);
+    if (err == ESP_OK) out_wake();
+    return err;
+}
+
 esp_err_t rs3_tcp_server_send(const char *data, size_t len)
 {
+#if CONFIG_RS3_CRASHLOG_ENABLE
+    // Mirrored even with nobody connected: that is exactly when the crash log is needed later.
+    rs3_crash_log_write(data, len);
+#endif
 #if !CONFIG_RS3_TCP_SERVER_ENABLE
     (void)data; (void)len;
     return ESP_OK;
 #else
-    if (!s_out_q || !data || len == 0) return ESP_ERR_INVALID_STATE;
-    if (len > sizeof(((out_msg_t *)0)->buf)) len = sizeof(((out_msg_t *)0)->buf);
-    out_msg_t msg = { .len = len };
-    memcpy(msg.buf, data, len);
-    // non-blocking: drop if full
-    if (xQueueSend(s_out_q, &msg, 0) != pdTRUE) {
-        return ESP_ERR_NO_MEM;
-    }
+    return out_write(data, len);
+#endif
+}
+
+esp_err_t rs3_tcp_server_enqueue(const char *data, size_t len)
+{
+#if CONFIG_RS3_CRASHLOG_ENABLE
+    rs3_crash_log_write(data, len);
+#endif
+#if !CONFIG_RS3_TCP_SERVER_ENABLE
+    (void)data; (void)len;
+    return ESP_OK;
+#else
+    return out_enqueue(data, len);
+#endif
+}
+
+void rs3_tcp_server_wake(void)
+{
+#if CONFIG_RS3_TCP_SERVER_ENABLE
+    out_wake();
+#endif
+}
+
+esp_err_t rs3_tcp_server_send_raw(const char *data, size_t len)
+{
+#if !CONFIG_RS3_TCP_SERVER_ENABLE
+    (void)data; (void)len;
     return ESP_OK;
+#else
+    return out_write(data, len);
 #endif
 }
 
-static void close_client(void)
+uint32_t rs3_tcp_server_client_id(void)
+{
+    return s_client_id;
+}
+
+// A reader joined the stream mid-way (connect, or resync after drops): binary log records
+// restart with an absolute timestamp when the id changes.
+static void bump_client_id(void)
+{
+    if (++s_client_seq == 0) s_client_seq = 1;
+    s_client_id = s_client_seq;
+}
+
+static void zlog_free(client_t *c)
+{
+    if (!c->zl) return;
+    rs3_lz4s_free(&c->zl->lz);
+    heap_caps_free(c->zl);
+    c->zl = NULL;
+}
+
+static void close_client(int i, const char *why)
+{
+    client_t *c = &s_clients[i];
+    shutdown(c->fd, SHUT_RDWR);
+    close(c->fd);
+    c->fd = -1;
+    zlog_free(c);
+    ESP_LOGI(TAG, "Client %d disconnected (%s), dropped %" PRIu32 " lines", i, why, c->dropped);
+    s_status.clients--;
+    s_status.client_connected = (s_status.clients > 0);
+    if (!s_status.client_connected) s_client_id = 0;
+    emit_status();
+}
+
+// "[LOG] dropped N lines" where this client's stream has a gap, stamped like rs3_tcp_vlogf()
+// lines. Skips to the newest record; N counts records that were not sent completely (at least
+// that many if more than REC_ENDS went missing).
+static void client_resync(client_t *c)
 {
-    if (s_client_fd >= 0) {
-        shutdown(s_client_fd, SHUT_RDWR);
-        close(s_client_fd);
-        s_client_fd = -1;
+    taskENTER_CRITICAL(&s_out_lock);
+    const uint64_t start = rs3_byte_ring_start(&s_out_ring);
+    uint32_t lost = 0;
+    for (uint64_t k = s_records; k > 0 && lost < REC_ENDS && s_rec_end[(k - 1) & (REC_ENDS - 1)] > c->pos; k--) {
+        lost++;
     }
-    if (s_status.client_connected) {
-        s_status.client_connected = false;
-        emit_status();
+    taskEXIT_CRITICAL(&s_out_lock);
+
+    c->pos = start;
+    c->dropped += lost;
+    const uint64_t us = (uint64_t)esp_timer_get_time();
+    // Leading CRLF: the line this client was in the middle of is cut short.
+    int n = snprintf(c->note, sizeof(c->note), "\r\n[%06" PRIu32 ".%03" PRIu32 "] [LOG] dropped %" PRIu32 " lines\r\n",
+                     (uint32_t)(us / 1000ULL), (uint32_t)(us % 1000ULL), lost);
+    c->note_len = (n > 0 && (size_t)n < sizeof(c->note)) ? (uint8_t)n : 0;
+    c->note_off = 0;
+    bump_client_id();
+}
+
+// Reply to this client only, ahead of its next ring byte (appended to a note still pending).
+static void client_note(client_t *c, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void client_note(client_t *c, const char *fmt, ...)
+{
+    if (c->note_off) {
+        // Drop what already went out, so replies queued in one burst share the whole buffer.
+        memmove(c->note, c->note + c->note_off, c->note_len - c->note_off);
+        c->note_len -= c->note_off;
+#if CONFIG_RS3_TCP_SERVER_ZLOG
+        if (c->zl) c->zl->plain_end = (c->zl->plain_end > c->note_off) ? (uint8_t)(c->zl->plain_end - c->note_off) : 0;
+#endif
+        c->note_off = 0;
     }
+    const size_t room = sizeof(c->note) - c->note_len;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(c->note + c->note_len, room, fmt, ap);
+    va_end(ap);
+    if (n > 0 && (size_t)n < room) c->note_len += (uint8_t)n;
+}
+
+#if CONFIG_RS3_TCP_SERVER_ZLOG
+static bool client_pump(int i);
+
+// "raw 123456 B -> 23456 B, x5.26, 85 us/KB"
+static void zlog_note_stats(client_t *c, const char *state)
+{
+    const zlog_t *z = c->zl;
+    const uint64_t ratio100 = z->packed ? z->raw * 100 / z->packed : 0;
+    const uint32_t us_per_kb = z->raw ? (uint32_t)(z->cpu_us * 1024 / z->raw) : 0;
+    client_note(c, "ZLOG: %s (raw %" PRIu64 " B -> %" PRIu64 " B, x%" PRIu32 ".%02" PRIu32 ", %" PRIu32 " us/KB)\r\n",
+                state, z->raw, z->packed, (uint32_t)(ratio100 / 100), (uint32_t)(ratio100 % 100), us_per_kb);
+}
+
+// Compressed counterpart of client_pump(): gathers notes and ring bytes into the compressor's
+// window (one copy), compresses up to a block at a time and sends the frame.
+static bool client_pump_z(int i)
+{
+    client_t *c = &s_clients[i];
+    zlog_t *z = c->zl;
+    for (;;) {
+        if (c->note_off < z->plain_end) {
+            int sent = send(c->fd, c->note + c->note_off, z->plain_end - c->note_off, MSG_DONTWAIT);
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+                close_client(i, "send failed");
+                return false;
+            }
+            c->note_off += (uint8_t)sent;
+            if (c->note_off >= z->plain_end) z->plain_end = 0;
+            continue;
+        }
+        if (z->out_off < z->out_len) {
+            int sent = send(c->fd, z->out + z->out_off, z->out_len - z->out_off, MSG_DONTWAIT);
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+                close_client(i, "send failed");
+                return false;
+            }
+            z->out_off += (uint16_t)sent;
+            continue;
+        }
+        if (z->stopping) {
+            if (!z->end_queued) {
+                memset(z->out, 0, 4);
+                z->out_len = 4;
+                z->out_off = 0;
+                z->end_queued = true;
+                continue;
+            }
+            zlog_note_stats(c, "off");
+            zlog_free(c);
+            return client_pump(i);
+        }
+
+        uint8_t *blk = rs3_lz4s_begin(&z->lz);
+        size_t n = 0;
+        while (n < RS3_LZ4S_BLOCK) {
+            if (c->note_off < c->note_len) {
+                size_t k = c->note_len - c->note_off;
+                if (k > RS3_LZ4S_BLOCK - n) k = RS3_LZ4S_BLOCK - n;
+                memcpy(blk + n, c->note + c->note_off, k);
+                c->note_off += (uint8_t)k;
+                n += k;
+                continue;
+            }
+            if (rs3_byte_ring_lost(&s_out_ring, c->pos)) {
+                client_resync(c);
+                continue;
+            }
+            const uint8_t *p = NULL;
+            size_t k = rs3_byte_ring_peek(&s_out_ring, c->pos, rs3_byte_ring_head(&s_out_ring), &p);
+            if (k == 0) break;
+            if (k > RS3_LZ4S_BLOCK - n) k = RS3_LZ4S_BLOCK - n;
+            memcpy(blk + n, p, k);
+            // Same rule as the plain path: bytes copied while a producer lapped us are garbage.
+            if (rs3_byte_ring_lost(&s_out_ring, c->pos)) {
+                client_resync(c);
+                continue;
+            }
+            c->pos += k;
+            n += k;
+        }
+        if (n == 0) return false;
+
+        const int64_t t0 = esp_timer_get_time();
+        const size_t packed = rs3_lz4s_end(&z->lz, n, z->out + 4);
+        z->cpu_us += (uint64_t)(esp_timer_get_time() - t0);
+        z->out[0] = (uint8_t)packed;
+        z->out[1] = (uint8_t)(packed >> 8);
+        z->out[2] = (uint8_t)n;
+        z->out[3] = (uint8_t)(n >> 8);
+        z->out_len = (uint16_t)(4 + packed);
+        z->out_off = 0;
+        z->raw += n;
+        z->packed += 4 + packed;
+    }
+}
+
+// `zlog [on|off]`: handled here, per connection, instead of going to the rx callback.
+static bool client_zlog_cmd(client_t *c, const char *line, size_t len)
+{
+    while (len && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' ')) len--;
+    while (len && *line == ' ') { line++; len--; }
+    if (len < 4 || strncasecmp(line, "zlog", 4) != 0 || (len > 4 && line[4] != ' ')) return false;
+    const char *arg = line + 4;
+    size_t arg_len = len - 4;
+    while (arg_len && *arg == ' ') { arg++; arg_len--; }
+
+    if (arg_len == 2 && strncasecmp(arg, "on", 2) == 0) {
+        if (c->zl) {
+            zlog_note_stats(c, c->zl->stopping ? "stopping" : "on");
+            return true;
+        }
+        zlog_t *z = heap_caps_calloc(1, sizeof(*z), MALLOC_CAP_8BIT);
+        if (!z || rs3_lz4s_init(&z->lz) != ESP_OK) {
+            heap_caps_free(z);
+            client_note(c, "ZLOG: no memory\r\n");
+            return true;
+        }
+        c->zl = z;
+        client_note(c, "ZLOG: on\r\n");
+        // The client switches right after this note: every later byte, even a note queued by the
+        // next command of the same burst, goes through the compressor.
+        z->plain_end = c->note_len;
+        z->on = true;
+    } else if (arg_len == 3 && strncasecmp(arg, "off", 3) == 0) {
+        if (!c->zl) {
+            client_note(c, "ZLOG: off\r\n");
+        } else {
+            c->zl->stopping = true;
+        }
+    } else if (arg_len == 0) {
+        if (c->zl) {
+            zlog_note_stats(c, "on");
+        } else {
+            client_note(c, "ZLOG: off\r\n");
+        }
+    } else {
+        client_note(c, "ERR: usage: zlog [on|off]\r\n");
+    }
+    return true;
+}
+#endif
+
+// Send as much as the socket takes without blocking. Returns true if bytes remain (wait for POLLOUT).
+static bool client_pump(int i)
+{
+    client_t *c = &s_clients[i];
+#if CONFIG_RS3_TCP_SERVER_ZLOG
+    if (c->zl && c->zl->on) return client_pump_z(i);
+#endif
+    for (;;) {
+        if (c->note_off < c->note_len) {
+            int sent = send(c->fd, c->note + c->note_off, c->note_len - c->note_off, MSG_DONTWAIT);
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+                close_client(i, "send failed");
+                return false;
+            }
+            c->note_off += (uint8_t)sent;
+            continue;
+        }
+        if (rs3_byte_ring_lost(&s_out_ring, c->pos)) {
+            client_resync(c);
+            continue;
+        }
+        const uint64_t head = rs3_byte_ring_head(&s_out_ring);
+        const uint8_t *p = NULL;
+        const size_t n = rs3_byte_ring_peek(&s_out_ring, c->pos, head, &p);
+        if (n == 0) return false;
+
+        // Straight from ring memory: no per-client copy.
+        int sent = send(c->fd, p, n, MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            close_client(i, "send failed");
+            return false;
+        }
+        // A producer may have lapped us while send() was copying: what went out is garbage then.
+        if (rs3_byte_ring_lost(&s_out_ring, c->pos)) {
+            client_resync(c);
+            continue;
+        }
+        c->pos += (uint64_t)sent;
+        if ((size_t)sent < n) return true;
+    }
+}
+
+// Commands go to the rx callback one whole line at a time, so clients typing at once never mix.
+static void client_recv(int i)
+{
+    client_t *c = &s_clients[i];
+    int n = recv(c->fd, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        close_client(i, "disconnected");
+        return;
+    }
+    if (n < 0) return;
+    c->rx_len += (size_t)n;
+
+    size_t start = 0;
+    for (size_t j = 0; j < c->rx_len; j++) {
+        if (c->rx[j] != '\n') continue;
+#if CONFIG_RS3_TCP_SERVER_ZLOG
+        if (client_zlog_cmd(c, c->rx + start, j + 1 - start)) {
+            start = j + 1;
+            continue;
+        }
+#endif
+        if (s_rx_cb) s_rx_cb((const uint8_t *)c->rx + start, j + 1 - start, s_rx_ctx);
+        start = j + 1;
+    }
+    if (start == 0 && c->rx_len == sizeof(c->rx)) {
+        // Overlong line: hand it over in pieces.
+        if (s_rx_cb) s_rx_cb((const uint8_t *)c->rx, c->rx_len, s_rx_ctx);
+        start = c->rx_len;
+    }
+    memmove(c->rx, c->rx + start, c->rx_len - start);
+    c->rx_len -= start;
+}
+
+#if CONFIG_RS3_CRASHLOG_ENABLE
+static void replay_emit(const char *data, size_t len, void *user_ctx)
+{
+    (void)user_ctx;
+    (void)out_write(data, len);
+}
+#endif
+
+static void client_accept(int listen_fd)
+{
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    int slot = -1;
+    for (int i = 0; i < CONFIG_RS3_TCP_SERVER_CLIENTS; i++) {
+        if (s_clients[i].fd < 0) { slot = i; break; }
+    }
+    if (slot < 0) {
+        const char *full = "rs3proxy: console full\r\n";
+        (void)send(fd, full, strlen(full), MSG_DONTWAIT);
+        close(fd);
+        ESP_LOGW(TAG, "Client rejected: %d consoles open", CONFIG_RS3_TCP_SERVER_CLIENTS);
+        return;
+    }
+
+    client_t *c = &s_clients[slot];
+    memset(c, 0, sizeof(*c));
+    c->fd = fd;
+    // New clients start at the newest line; they never see a partial record.
+    taskENTER_CRITICAL(&s_out_lock);
+    c->pos = rs3_byte_ring_start(&s_out_ring);
+    taskEXIT_CRITICAL(&s_out_lock);
+    bump_client_id();
+    s_status.clients++;
+    s_status.client_connected = true;
+    emit_status();
+
+    const char *banner = "rs3proxy: connected\r\n";
+    (void)send(fd, banner, strlen(banner), MSG_DONTWAIT);
+    ESP_LOGI(TAG, "Client %d connected", slot);
+
+#if CONFIG_RS3_CRASHLOG_ENABLE
+    // The first console after a reset gets the log that led up to it, once.
+    static bool s_replayed = false;
+    if (!s_replayed && rs3_crash_log_has_prev()) {
+        s_replayed = true;
+        rs3_crash_log_dump_prev(replay_emit, NULL);
+    }
+#endif
 }
 
 static void server_task(void *arg)
@@ -106,76 +568,62 @@ static void server_task(void *arg)
         vTaskDelete(NULL);
         return;
     }
-    if (listen(listen_fd, 1) != 0) {
+    if (listen(listen_fd, CONFIG_RS3_TCP_SERVER_CLIENTS) != 0) {
         ESP_LOGE(TAG, "listen() failed: errno=%d", errno);
         close(listen_fd);
         vTaskDelete(NULL);
         return;
     }
 
-    ESP_LOGI(TAG, "Listening on TCP port %d", port);
+    ESP_LOGI(TAG, "Listening on TCP port %d (%d clients)", port, CONFIG_RS3_TCP_SERVER_CLIENTS);
 
+    bool backlog[CONFIG_RS3_TCP_SERVER_CLIENTS] = {0};
     for (;;) {
-        fd_set rfds;
+        fd_set rfds, wfds;
         FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
         FD_SET(listen_fd, &rfds);
         int maxfd = listen_fd;
-        if (s_client_fd >= 0) {
-            FD_SET(s_client_fd, &rfds);
-            if (s_client_fd > maxfd) maxfd = s_client_fd;
+        for (int i = 0; i < CONFIG_RS3_TCP_SERVER_CLIENTS; i++) {
+            const int fd = s_clients[i].fd;
+            if (fd < 0) continue;
+            FD_SET(fd, &rfds);
+            // Only clients with a full socket buffer wait for POLLOUT; the rest wait for the eventfd.
+            if (backlog[i]) FD_SET(fd, &wfds);
+            if (fd > maxfd) maxfd = fd;
+        }
+        if (s_wake_fd >= 0) {
+            FD_SET(s_wake_fd, &rfds);
+            if (s_wake_fd > maxfd) maxfd = s_wake_fd;
         }
 
+        // Sleep until a socket or a producer needs us; poll only if the eventfd is unavailable.
         struct timeval tv = { .tv_sec = 0, .tv_usec = 100 * 1000 };
-        int r = select(maxfd + 1, &rfds, NULL, NULL, &tv);
+        int r = select(maxfd + 1, &rfds, &wfds, NULL, (s_wake_fd >= 0) ? NULL : &tv);
         if (r < 0) {
             ESP_LOGW(TAG, "select() errno=%d", errno);
+            FD_ZERO(&rfds);
             vTaskDelay(pdMS_TO_TICKS(100));
         }
 
-        if (FD_ISSET(listen_fd, &rfds)) {
-            struct sockaddr_in6 source_addr;
-            socklen_t addr_len = sizeof(source_addr);
-            int fd = accept(listen_fd, (struct sockaddr *)&source_addr, &addr_len);
-            if (fd >= 0) {
-                close_client();
-                s_client_fd = fd;
-                s_status.client_connected = true;
-                emit_status();
-
-                const char *banner = "rs3proxy: connected\r\n";
-                (void)send(s_client_fd, banner, strlen(banner), 0);
-                ESP_LOGI(TAG, "Client connected");
-            }
+        if (s_wake_fd >= 0 && FD_ISSET(s_wake_fd, &rfds)) {
+            uint64_t cnt;
+            (void)read(s_wake_fd, &cnt, sizeof(cnt));
+            // Cleared before draining: anything written after this point signals again.
+            taskENTER_CRITICAL(&s_out_lock);
+            s_wake_pending = false;
+            taskEXIT_CRITICAL(&s_out_lock);
         }
 
-        if (s_client_fd >= 0 && FD_ISSET(s_client_fd, &rfds)) {
-            char rx[128];
-            int n = recv(s_client_fd, rx, sizeof(rx) - 1, 0);
-            if (n <= 0) {
-                ESP_LOGI(TAG, "Client disconnected");
-                close_client();
-            } else {
-                if (s_rx_cb) {
-                    s_rx_cb((const uint8_t *)rx, (size_t)n, s_rx_ctx);
-                }
-            }
+        if (FD_ISSET(listen_fd, &rfds)) client_accept(listen_fd);
+
+        for (int i = 0; i < CONFIG_RS3_TCP_SERVER_CLIENTS; i++) {
+            if (s_clients[i].fd >= 0 && FD_ISSET(s_clients[i].fd, &rfds)) client_recv(i);
         }
 
-        // Drain outgoing queue (best-effort)
-        if (s_client_fd >= 0) {
-            out_msg_t msg;
-            while (xQueueReceive(s_out_q, &msg, 0) == pdTRUE) {
-                int sent = send(s_client_fd, msg.buf, msg.len, 0);
-                if (sent < 0) {
-                    ESP_LOGW(TAG, "send() failed: errno=%d", errno);
-                    close_client();
-                    break;
-                }
-            }
-        } else {
-            // no client: drop queued messages
-            out_msg_t msg;
-            while (xQueueReceive(s_out_q, &msg, 0) == pdTRUE) {}
+        // Each client drains at its own pace; a slow one only ever loses its own lines.
+        for (int i = 0; i < CONFIG_RS3_TCP_SERVER_CLIENTS; i++) {
+            backlog[i] = (s_clients[i].fd >= 0) && client_pump(i);
         }
     }
 }
@@ -188,12 +636,21 @@ esp_err_t rs3_tcp_server_start(void)
 #else
     if (s_task) return ESP_OK;
 
-    s_out_q = xQueueCreate(8, sizeof(out_msg_t));
-    if (!s_out_q) return ESP_ERR_NO_MEM;
+    for (int i = 0; i < CONFIG_RS3_TCP_SERVER_CLIENTS; i++) s_clients[i].fd = -1;
+    esp_err_t err = rs3_byte_ring_init(&s_out_ring, (size_t)CONFIG_RS3_TCP_SERVER_LOG_RING_KB * 1024U);
+    if (err != ESP_OK) return err;
+
+    const esp_vfs_eventfd_config_t efd_cfg = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    err = esp_vfs_eventfd_register(&efd_cfg);
+    if (err == ESP_OK || err == ESP_ERR_INVALID_STATE) {  // INVALID_STATE: already registered
+        s_wake_fd = eventfd(0, 0);
+    }
+    if (s_wake_fd < 0) {
+        ESP_LOGW(TAG, "eventfd unavailable (vfs=%s errno=%d); polling every 100 ms", esp_err_to_name(err), errno);
+    }
+    s_out_ready = true;
 
     xTaskCreate(server_task, "tcp_server", 4096, NULL, 4, &s_task);
     return ESP_OK;
 #endif
 }
-
-
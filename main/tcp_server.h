@@ -1,19 +1,30 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "esp_err.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct {
-    bool client_connected;
+    bool client_connected;  // at least one console client
+    uint8_t clients;
 } rs3_tcp_server_status_t;
 
 typedef void (*rs3_tcp_server_status_cb_t)(const rs3_tcp_server_status_t *status, void *user_ctx);
+// Called from the server task with one command line (up to and including '\n') at a time, from any client.
 typedef void (*rs3_tcp_server_rx_cb_t)(const uint8_t *data, size_t len, void *user_ctx);
 
 /**
  * @brief Start TCP server task (listens on CONFIG_RS3_TCP_SERVER_PORT).
  *
+ * Up to CONFIG_RS3_TCP_SERVER_CLIENTS consoles at once; all of them get the same log stream and
+ * can send commands.
+ *
  * Requires:
  * - esp_netif_init() already called
  * - esp_event_loop_create_default() already called
@@ -21,11 +32,26 @@ typedef void (*rs3_tcp_server_rx_cb_t)(const uint8_t *data, size_t len, void *us
 esp_err_t rs3_tcp_server_start(void);
 
 /**
- * @brief Enqueue a text line to send to the currently connected client (if any).
- * Non-blocking: drops if queue is full or no client.
+ * @brief Enqueue a text line for all connected clients.
+ * Non-blocking: copied into the shared log ring (CONFIG_RS3_TCP_SERVER_LOG_RING_KB), which never
+ * refuses a line; a client that falls a whole ring behind skips ahead and sees "[LOG] dropped N lines".
+ * Also mirrored into the crash log (CONFIG_RS3_CRASHLOG_ENABLE), with or without a client.
+ * Returns ESP_ERR_INVALID_STATE when there is no client.
  */
 esp_err_t rs3_tcp_server_send(const char *data, size_t len);
 
+/**
+ * @brief rs3_tcp_server_send() without waking the server task: ring copies under spinlocks only,
+ * so it may run inside a critical section. Call rs3_tcp_server_wake() once that section is left.
+ */
+esp_err_t rs3_tcp_server_enqueue(const char *data, size_t len);
+void rs3_tcp_server_wake(void);
+
+/**
+ * @brief Like rs3_tcp_server_send() but not mirrored into the crash log (crash log replays, `dmesg`).
+ */
+esp_err_t rs3_tcp_server_send_raw(const char *data, size_t len);
+
 /**
  * @brief Convenience helper for C strings (no newline added).
  */
@@ -36,7 +62,15 @@ static inline esp_err_t rs3_tcp_server_send_str(const char *s)
     return rs3_tcp_server_send(s, n);
 }
 
+/**
+ * @brief Nonzero while a client is connected; changes whenever a client joins the stream mid-way
+ * (connect, or skip-ahead after drops).
+ */
+uint32_t rs3_tcp_server_client_id(void);
+
 void rs3_tcp_server_set_status_cb(rs3_tcp_server_status_cb_t cb, void *user_ctx);
 void rs3_tcp_server_set_rx_cb(rs3_tcp_server_rx_cb_t cb, void *user_ctx);
 
-
+#ifdef __cplusplus
+}
+#endif
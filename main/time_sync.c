@@ -0,0 +1,110 @@
+#include "time_sync.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "cmd_tcp.h"
+#include "log_tcp.h"
+#include "rpc_server.h"
+#include "tcp_server.h"
+
+static rs3_time_sync_t s_sync;
+static bool s_synced = false;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool rs3_time_sync_get(rs3_time_sync_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    const bool ok = s_synced;
+    if (ok) *out = s_sync;
+    portEXIT_CRITICAL(&s_lock);
+    return ok;
+}
+
+bool rs3_time_wall_us(int64_t mono_us, int64_t *wall_us)
+{
+    rs3_time_sync_t s;
+    if (!rs3_time_sync_get(&s)) return false;
+    const int64_t dt = mono_us - s.mono_us;
+    *wall_us = s.wall_us + dt + dt * s.drift_ppb / 1000000000LL;
+    return true;
+}
+
+// time -> {"rx_us": t2, "tx_us": t3}: request arrival and response time on the esp_timer clock.
+// The response leaves a few tens of us after t3 (encode + send); the PC's t4 absorbs that.
+static esp_err_t rpc_time(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)params;
+    (void)user_ctx;
+    rs3_cbor_put_map(result, 2);
+    rs3_cbor_put_text(result, "rx_us");
+    rs3_cbor_put_int(result, rs3_rpc_request_rx_us());
+    rs3_cbor_put_text(result, "tx_us");
+    rs3_cbor_put_int(result, esp_timer_get_time());
+    return ESP_OK;
+}
+
+// time.set {"mono_us", "wall_us", "err_us", "drift_ppb"} -> null; logs the [TIME] anchor line.
+static esp_err_t rpc_time_set(rs3_cbor_reader_t *params, rs3_cbor_writer_t *result, void *user_ctx)
+{
+    (void)result;
+    (void)user_ctx;
+    rs3_cbor_reader_t v;
+    int64_t mono = 0, wall = 0, err = 0, drift = 0;
+    if (!rs3_cbor_map_find(params, "mono_us", &v) || !rs3_cbor_get_int(&v, &mono)) return ESP_ERR_INVALID_ARG;
+    if (!rs3_cbor_map_find(params, "wall_us", &v) || !rs3_cbor_get_int(&v, &wall)) return ESP_ERR_INVALID_ARG;
+    if (rs3_cbor_map_find(params, "err_us", &v) && !rs3_cbor_get_int(&v, &err)) return ESP_ERR_INVALID_ARG;
+    if (rs3_cbor_map_find(params, "drift_ppb", &v) && !rs3_cbor_get_int(&v, &drift)) return ESP_ERR_INVALID_ARG;
+    // 1000 ppm is far beyond any crystal: a fit that bad is a bug on the PC side.
+    if (mono < 0 || wall <= 0 || err < 0 || err > UINT32_MAX || drift < -1000000 || drift > 1000000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const rs3_time_sync_t s = {
+        .mono_us = mono, .wall_us = wall, .drift_ppb = (int32_t)drift, .err_us = (uint32_t)err,
+    };
+    portENTER_CRITICAL(&s_lock);
+    s_sync = s;
+    s_synced = true;
+    portEXIT_CRITICAL(&s_lock);
+    RS3_LOGI(NET, "[TIME] sync mono_us=%" PRId64 " wall_us=%" PRId64 " err_us=%" PRIu32 " drift_ppb=%" PRId32 "\r\n",
+             s.mono_us, s.wall_us, s.err_us, s.drift_ppb);
+    return ESP_OK;
+}
+
+static const rs3_rpc_method_t s_time_rpc[] = {
+    {.name = "time", .handler = rpc_time},
+    {.name = "time.set", .handler = rpc_time_set},
+};
+
+// time -> esp_timer now and, once synced, the PC wall clock it maps to
+static void handle_time(char *arg, void *user_ctx)
+{
+    (void)arg;
+    (void)user_ctx;
+    char out[160];
+    const int64_t now = esp_timer_get_time();
+    rs3_time_sync_t s;
+    int64_t wall = 0;
+    if (rs3_time_sync_get(&s) && rs3_time_wall_us(now, &wall)) {
+        snprintf(out, sizeof(out), "TIME: mono_us=%" PRId64 " wall_us=%" PRId64 " (synced %" PRId64 " s ago, +/-%" PRIu32
+                 " us, drift %" PRId32 " ppb)\r\n", now, wall, (now - s.mono_us) / 1000000, s.err_us, s.drift_ppb);
+    } else {
+        snprintf(out, sizeof(out), "TIME: mono_us=%" PRId64 " (not synced: scripts/rs3_clock_sync.py)\r\n", now);
+    }
+    rs3_tcp_server_send_str(out);
+}
+
+static const rs3_cmd_t s_time_cmd = {
+    .name = "time", .help = "esp_timer now, and PC wall clock once synced", .handler = handle_time,
+};
+
+esp_err_t rs3_time_sync_start(void)
+{
+    (void)rs3_cmd_register(&s_time_cmd);
+    for (size_t i = 0; i < sizeof(s_time_rpc) / sizeof(s_time_rpc[0]); i++) (void)rs3_rpc_register(&s_time_rpc[i]);
+    return ESP_OK;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * PC clock sync (NTP-style, run by scripts/rs3_clock_sync.py over the RPC port).
+ *
+ * The PC timestamps its request (t1) and the response (t4); the `time` method answers with the
+ * esp_timer times the request arrived (t2) and the response was built (t3). From many exchanges
+ * the PC fits offset and drift of its wall clock against esp_timer and installs the result with
+ * `time.set`, which logs an anchor line
+ *
+ *   [TIME] sync mono_us=<esp_timer> wall_us=<PC epoch us> err_us=<bound> drift_ppb=<d>
+ *
+ * that maps every "[ms.us]" console stamp of this boot onto the PC's wall clock.
+ */
+
+typedef struct {
+    int64_t mono_us;     // esp_timer time of the anchor
+    int64_t wall_us;     // PC wall clock (Unix epoch, us) at mono_us
+    int32_t drift_ppb;   // PC clock rate minus ESP clock rate, parts per billion
+    uint32_t err_us;     // accuracy bound reported by the PC
+} rs3_time_sync_t;
+
+/** @brief Register the `time` console command and the `time` / `time.set` RPC methods. */
+esp_err_t rs3_time_sync_start(void);
+
+/** @brief Last installed sync; false if the PC never synced this boot. */
+bool rs3_time_sync_get(rs3_time_sync_t *out);
+
+/** @brief PC wall clock (epoch us) for an esp_timer time; false if not synced. */
+bool rs3_time_wall_us(int64_t mono_us, int64_t *wall_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,6 +11,7 @@
 #include "freertos/queue.h"
 #include "freertos/task.h"
 
+#include "fmt_fast.h"
 #include "font5x7.h"
 #include "lcd_st7789.h"
 #include "log_tcp.h"
@@ -143,36 +144,44 @@ static void render_all(void)
 
     fb_fill(s_fb, s_lcd.w, s_lcd.h, BLACK);
 
-    char line1[64] = {0};
-    char line2[64] = {0};
-    char line3[64] = {0};
-    char line4[64] = {0};
-    char line_bt[64] = {0};
+    const char *line1 = "WiFi: ?";
+    char line2[32] = {0};
+    char line3[32] = {0};
+    char line4[32] = {0};
+    const char *line_bt = s_bt_status;
+    rs3_fmt_t f;
 
     switch (s_last_wifi.state) {
         case RS3_WIFI_STA_STATE_DISABLED:
-            snprintf(line1, sizeof(line1), "WiFi: off");
+            line1 = "WiFi: off";
             break;
         case RS3_WIFI_STA_STATE_CONNECTING:
-            snprintf(line1, sizeof(line1), "WiFi: conn");
+            line1 = "WiFi: conn";
             break;
         case RS3_WIFI_STA_STATE_CONNECTED:
-            snprintf(line1, sizeof(line1), "WiFi: ok");
+            line1 = "WiFi: ok";
             if (s_last_wifi.has_ip) {
-                snprintf(line2, sizeof(line2), "IP: " IPSTR, IP2STR(&s_last_wifi.ip));
+                const uint8_t *ip = (const uint8_t *)&s_last_wifi.ip.addr;  // network order
+                rs3_fmt_init(&f, line2, sizeof(line2));
+                rs3_fmt_str(&f, "IP: ");
+                for (int i = 0; i < 4; i++) {
+                    if (i) rs3_fmt_char(&f, '.');
+                    rs3_fmt_u32(&f, ip[i], 0, ' ');
+                }
             }
             break;
         case RS3_WIFI_STA_STATE_FAILED:
-            snprintf(line1, sizeof(line1), "WiFi: fail");
+            line1 = "WiFi: fail";
             break;
         default:
-            snprintf(line1, sizeof(line1), "WiFi: ?");
             break;
     }
 
     if (CONFIG_RS3_TCP_SERVER_ENABLE) {
-        snprintf(line3, sizeof(line3), "TCP:%d %s", CONFIG_RS3_TCP_SERVER_PORT,
-                 (s_has_tcp && s_last_tcp.client_connected) ? "cli" : "wait");
+        rs3_fmt_init(&f, line3, sizeof(line3));
+        rs3_fmt_str(&f, "TCP:");
+        rs3_fmt_u32(&f, CONFIG_RS3_TCP_SERVER_PORT, 0, ' ');
+        rs3_fmt_str(&f, (s_has_tcp && s_last_tcp.client_connected) ? " cli" : " wait");
     }
 
     if (CONFIG_RS3_OTA_ENABLE && s_has_ota) {
@@ -184,23 +193,21 @@ static void render_all(void)
             case RS3_OTA_STATE_FAILED: ota_s = "fail"; break;
             default: break;
         }
+        rs3_fmt_init(&f, line4, sizeof(line4));
+        rs3_fmt_str(&f, "OTA: ");
+        rs3_fmt_str(&f, ota_s);
         if (s_last_ota.state == RS3_OTA_STATE_RUNNING) {
             if (s_last_ota.progress_pct >= 0) {
-                snprintf(line4, sizeof(line4), "OTA: %s %d%%", ota_s, (int)s_last_ota.progress_pct);
+                rs3_fmt_char(&f, ' ');
+                rs3_fmt_i32(&f, (int32_t)s_last_ota.progress_pct);
+                rs3_fmt_char(&f, '%');
             } else if (s_last_ota.bytes_read > 0) {
-                snprintf(line4, sizeof(line4), "OTA: %s %ld", ota_s, (long)s_last_ota.bytes_read);
-            } else {
-                snprintf(line4, sizeof(line4), "OTA: %s", ota_s);
+                rs3_fmt_char(&f, ' ');
+                rs3_fmt_i32(&f, (int32_t)s_last_ota.bytes_read);
             }
-        } else {
-            snprintf(line4, sizeof(line4), "OTA: %s", ota_s);
         }
     }
 
-    if (s_bt_status[0]) {
-        snprintf(line_bt, sizeof(line_bt), "%s", s_bt_status);
-    }
-
     const int x = 10;
     const int y1 = 10;
     const int y2 = y1 + (7 + 2) * scale;
@@ -211,34 +218,35 @@ static void render_all(void)
     const int y7 = y6 + (7 + 2) * scale;
     const int y8 = y7 + (7 + 2) * scale;
     rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, y1, line1, WHITE, BLACK, scale);
-    if (strlen(line2)) {
+    if (line2[0]) {
         rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, y2, line2, WHITE, BLACK, scale);
     }
-    if (strlen(line3)) {
+    if (line3[0]) {
         rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, y3, line3, WHITE, BLACK, scale);
     }
-    if (strlen(line4)) {
+    if (line4[0]) {
         rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, y4, line4, WHITE, BLACK, scale);
     }
-    if (strlen(line_bt)) {
+    if (line_bt[0]) {
         rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, y5, line_bt, WHITE, BLACK, scale);
     }
 
     // USB/PTP impl + current status (no history)
+    char line[48];
     if (s_ptp_impl[0]) {
-        char ptp_impl_line[48];
-        snprintf(ptp_impl_line, sizeof(ptp_impl_line), "PTP impl: %s", s_ptp_impl);
-        rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, y6, ptp_impl_line, WHITE, BLACK, scale);
+        rs3_fmt_init(&f, line, sizeof(line));
+        rs3_fmt_str(&f, "PTP impl: ");
+        rs3_fmt_str(&f, s_ptp_impl);
+        rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, y6, line, WHITE, BLACK, scale);
     }
     if (s_has_rec) {
-        char rec_line[48];
-        snprintf(rec_line, sizeof(rec_line), "REC: %s", s_rec_on ? "ON" : "OFF");
-        rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, y7, rec_line, WHITE, BLACK, scale);
+        rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, y7, s_rec_on ? "REC: ON" : "REC: OFF", WHITE, BLACK, scale);
     }
     if (s_ptp_status[0]) {
-        char ptp_line[48];
-        snprintf(ptp_line, sizeof(ptp_line), "PTP: %s", s_ptp_status);
-        rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, s_has_rec ? y8 : y7, ptp_line, WHITE, BLACK, scale);
+        rs3_fmt_init(&f, line, sizeof(line));
+        rs3_fmt_str(&f, "PTP: ");
+        rs3_fmt_str(&f, s_ptp_status);
+        rs3_draw_text_5x7(s_fb, s_lcd.w, s_lcd.h, x, s_has_rec ? y8 : y7, line, WHITE, BLACK, scale);
     }
 
     // Touch buttons
@@ -299,11 +307,11 @@ static void ui_task(void *arg)
         if (t && !s_touch_prev) {
             // Rising edge = click
             if (btn_hit(&s_btn_pair, tx, ty)) {
-                rs3_tcp_logf("[UI] Pair Nikon pressed x=%d y=%d\r\n", tx, ty);
+                RS3_LOGI(UI, "[UI] Pair Nikon pressed x=%d y=%d\r\n", tx, ty);
                 (void)rs3_ui_status_bt_line("BT: pair pressed");
                 (void)rs3_nikon_bt_pair_start();
             } else if (btn_hit(&s_btn_shut, tx, ty)) {
-                rs3_tcp_logf("[UI] Shutter pressed x=%d y=%d\r\n", tx, ty);
+                RS3_LOGI(UI, "[UI] Shutter pressed x=%d y=%d\r\n", tx, ty);
                 (void)rs3_ui_status_bt_line("BT: shutter pressed");
                 (void)rs3_nikon_bt_shutter_click();
             } else if (btn_hit(&s_btn_ota, tx, ty)) {
@@ -25,7 +25,9 @@
 
 #include "device/usbd_pvt.h"
 
+#include "fmt_fast.h"
 #include "log_tcp.h"
+#include "ptp_layout.h"
 #include "tcp_server.h"
 #include "ui_status.h"
 #include "rec_events.h"
@@ -124,15 +126,6 @@ static bool s_recording = false;
 
 static uint8_t s_itf_num = 0;
 static bool s_mounted = false;
-typedef enum {
-    RS3_PTP_LAYOUT_STD_LEN = 0,      // len32,type16,code16,tid32
-    RS3_PTP_LAYOUT_ALT_LEN = 1,      // len32,code16,tid32,type16
-    RS3_PTP_LAYOUT_DJI_PAD16_NOLEN = 2, // 0x0000 + type16,code16,tid32,(params...)
-    RS3_PTP_LAYOUT_DJI_PAD8_NOLEN = 3,  // 0x00 + type16,code16,tid32,(params...)
-    // 0x00 0x00 0x00 + type16@3, code16@5, tid32@7, (params...)@11
-    // Note: RS3 often appends an extra 0x01 byte after tid; treat it as part of params/padding.
-    RS3_PTP_LAYOUT_DJI_PAD24_NOLEN = 4,
-} rs3_ptp_layout_t;
 
 static rs3_ptp_layout_t s_ptp_layout = RS3_PTP_LAYOUT_STD_LEN;
 static rs3_ptp_layout_t s_last_rx_layout = RS3_PTP_LAYOUT_STD_LEN;
@@ -598,16 +591,6 @@ static inline void wr_le32(uint8_t *p, uint32_t v)
     p[3] = (uint8_t)((v >> 24) & 0xFF);
 }
 
-static inline uint16_t rd_le16(const uint8_t *p)
-{
-    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
-}
-
-static inline uint32_t rd_le32(const uint8_t *p)
-{
-    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
-}
-
 // (proxy helpers removed from this module)
 
 static const char *layout_name(rs3_ptp_layout_t l)
@@ -622,112 +605,6 @@ static const char *layout_name(rs3_ptp_layout_t l)
     }
 }
 
-typedef struct {
-    rs3_ptp_layout_t layout;
-    uint16_t type;
-    uint16_t code;
-    uint32_t tid;
-    uint32_t params[5];
-    int param_count;
-    size_t header_bytes; // bytes before params/payload
-} rs3_ptp_cmd_parsed_t;
-
-static bool parse_rs3_ptp_cmd(const uint8_t *buf, size_t n, rs3_ptp_cmd_parsed_t *out)
-{
-    if (!out || !buf || n < 8) return false;
-    memset(out, 0, sizeof(*out));
-
-    // Heuristic 0: DJI "no-len" with pad24 (3x 0x00):
-    // 00 00 00 [type16le@3] [code16le@5] [tid32le@7] [params...@11]
-    // Seen as 16-byte packets like:
-    // 00 00 00 01 00 02 10 00 00 00 00 01 00 00 00 00  => type=1 op=0x1002 tid=0 p0=1
-    if (n >= 11 && buf[0] == 0x00 && buf[1] == 0x00 && buf[2] == 0x00) {
-        uint16_t type16 = rd_le16(buf + 3);
-        uint16_t code16 = rd_le16(buf + 5);
-        uint32_t tid32 = rd_le32(buf + 7);
-        if (type16 >= 1 && type16 <= 4) {
-            out->layout = RS3_PTP_LAYOUT_DJI_PAD24_NOLEN;
-            out->type = type16;
-            out->code = code16;
-            out->tid = tid32;
-            out->header_bytes = 11;
-            goto decode_params;
-        }
-    }
-
-    // Heuristic 1: DJI "no-len" with pad16: 00 00 [type16] [code16] [tid32] [params...]
-    if (n >= 10) {
-        uint16_t pad16 = rd_le16(buf + 0);
-        uint16_t type16 = rd_le16(buf + 2);
-        uint16_t code16 = rd_le16(buf + 4);
-        uint32_t tid32 = rd_le32(buf + 6);
-        if (pad16 == 0x0000 && type16 >= 1 && type16 <= 4) {
-            out->layout = RS3_PTP_LAYOUT_DJI_PAD16_NOLEN;
-            out->type = type16;
-            out->code = code16;
-            out->tid = tid32;
-            out->header_bytes = 10;
-            goto decode_params;
-        }
-    }
-
-    // Heuristic 2: DJI "no-len" with pad8: 00 [type16] [code16] [tid32] [params...]
-    if (n >= 9) {
-        uint8_t pad8 = buf[0];
-        uint16_t type16 = rd_le16(buf + 1);
-        uint16_t code16 = rd_le16(buf + 3);
-        uint32_t tid32 = rd_le32(buf + 5);
-        if (pad8 == 0x00 && type16 >= 1 && type16 <= 4) {
-            out->layout = RS3_PTP_LAYOUT_DJI_PAD8_NOLEN;
-            out->type = type16;
-            out->code = code16;
-            out->tid = tid32;
-            out->header_bytes = 9;
-            goto decode_params;
-        }
-    }
-
-    // Standard PTP/MTP: len32,type16,code16,tid32
-    if (n >= 12) {
-        uint16_t type_std = rd_le16(buf + 4);
-        if (type_std >= 1 && type_std <= 4) {
-            out->layout = RS3_PTP_LAYOUT_STD_LEN;
-            out->type = type_std;
-            out->code = rd_le16(buf + 6);
-            out->tid = rd_le32(buf + 8);
-            out->header_bytes = 12;
-            goto decode_params;
-        }
-        // Alt DJI observed: len32,code16,tid32,type16
-        uint16_t type_alt = rd_le16(buf + 10);
-        if (type_alt >= 1 && type_alt <= 4) {
-            out->layout = RS3_PTP_LAYOUT_ALT_LEN;
-            out->type = type_alt;
-            out->code = rd_le16(buf + 4);
-            out->tid = rd_le32(buf + 6);
-            out->header_bytes = 12;
-            goto decode_params;
-        }
-    }
-
-    return false;
-
-decode_params:
-    // Decode params from actual received bytes after header (4-byte each), up to 5
-    out->param_count = 0;
-    if (n > out->header_bytes) {
-        size_t avail = n - out->header_bytes;
-        size_t want = avail / 4;
-        if (want > 5) want = 5;
-        out->param_count = (int)want;
-        for (int i = 0; i < out->param_count; i++) {
-            size_t off = out->header_bytes + (size_t)i * 4;
-            out->params[i] = rd_le32(buf + off);
-        }
-    }
-    return true;
-}
-
 // Write header matching the detected RS3 layout (TX follows the RX layout for now).
 // STD_LEN:  len32, type16, code16, tid32
 // ALT_LEN:  len32, code16, tid32, type16
@@ -867,18 +744,8 @@ static void tx_stream_start(uint8_t rhport, uint16_t op_code, uint32_t trans_id,
     ui_ptp_progress_tx_data(op_code);
 }
 
-static const char *ptp_op_hex_name(uint16_t op)
-{
-    // Safe: return pointer to a static ring buffer (avoids returning stack memory).
-    // Not thread-safe, but good enough for logging in this module.
-    static char s_buf[8][7]; // "0xFFFF" + NUL
-    static unsigned s_idx = 0;
-    unsigned idx = (s_idx++) & 7u;
-    (void)snprintf(s_buf[idx], sizeof(s_buf[idx]), "0x%04X", (unsigned)op);
-    return s_buf[idx];
-}
-
-static const char *ptp_op_name(uint16_t op)
+// Unknown ops are named by their code, formatted into the caller's hex[7] ("0xFFFF").
+static const char *ptp_op_name(uint16_t op, char hex[7])
 {
     switch (op) {
         case PTP_OC_OPEN_SESSION:    return "OpenSession";
@@ -889,13 +756,20 @@ static const char *ptp_op_name(uint16_t op)
         case PTP_OC_SONY_9202:       return "Sony 0x9202";
         case PTP_OC_SONY_9207:       return "Sony REC";
         case PTP_OC_SONY_9209:       return "Sony 0x9209";
-        default:                     return ptp_op_hex_name(op);
+        default: {
+            rs3_fmt_t f;
+            rs3_fmt_init(&f, hex, 7);
+            rs3_fmt_mem(&f, "0x", 2);
+            rs3_fmt_hex(&f, op, 4);
+            return hex;
+        }
     }
 }
 
 static void log_cmd_banner(uint16_t op, uint32_t tid)
 {
-    const char *name = ptp_op_name(op);
+    char hex[7];
+    const char *name = ptp_op_name(op, hex);
     if (!name) return;
     (void)tid;
 
@@ -903,8 +777,16 @@ static void log_cmd_banner(uint16_t op, uint32_t tid)
         return;
     }
 
-    rs3_tcp_logf("[PTP CMD] %s op=0x%04X tid=%" PRIu32 "\r\n",
-                 name, op, tid);
+    // A change of op always shows; repeats of the same op (RS3 polling) are rate-limited.
+    static uint16_t s_last_op = 0;
+    if (op != s_last_op) {
+        s_last_op = op;
+        RS3_LOGD(PTP, "[PTP CMD] %s op=0x%04X tid=%" PRIu32 "\r\n",
+                      name, op, tid);
+        return;
+    }
+    RS3_LOGD_RL(PTP, "[PTP CMD] %s op=0x%04X tid=%" PRIu32 "\r\n",
+                     name, op, tid);
 }
 
 static void ui_ptp_linef(const char *fmt, ...)
@@ -932,7 +814,7 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
         const size_t n = (size_t)xferred_bytes;
         if (n >= 8) {
             rs3_ptp_cmd_parsed_t cmd;
-            if (!parse_rs3_ptp_cmd(s_rx_buf, n, &cmd)) {
+            if (!rs3_ptp_parse_cmd(s_rx_buf, n, &cmd)) {
                 usbd_edpt_xfer(rhport, EP_BULK_OUT, s_rx_buf, sizeof(s_rx_buf));
                 return true;
             }
@@ -956,9 +838,9 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
                     //   - 0x01 for stop
                     // Publish event for UI/Bluetooth.
 
-                    rs3_tcp_logf("[PTP] 0x9207 DATA: p0=%08" PRIx32 " payload_len=%u payload=%02X\r\n",
-                                 s_waiting_data_p0, (unsigned)payload_len,
-                                 (unsigned)((payload_len >= 1 && payload) ? payload[0] : 0));
+                    RS3_LOGI(PTP, "[PTP] 0x9207 DATA: p0=%08" PRIx32 " payload_len=%u payload=%02X\r\n",
+                                  s_waiting_data_p0, (unsigned)payload_len,
+                                  (unsigned)((payload_len >= 1 && payload) ? payload[0] : 0));
 
                     // Button press level is encoded in COMMAND param0 (p0):
                     //  - 0x0000D2C1: half-press (ignore for recording)
@@ -975,14 +857,14 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
                                 rs3_rec_events_publish(RS3_REC_EVT_STOP, tid, payload, payload_len);
                                 (void)rs3_ui_status_ptp_line("rec stop");
                             } else {
-                                rs3_tcp_logf("[PTP] 0x9207 DATA(full): unknown payload0=0x%02X\r\n", payload[0]);
+                                RS3_LOGW(PTP, "[PTP] 0x9207 DATA(full): unknown payload0=0x%02X\r\n", payload[0]);
                             }
                         } else {
-                            rs3_tcp_logf("[PTP] 0x9207 DATA(full): empty payload\r\n");
+                            RS3_LOGW(PTP, "[PTP] 0x9207 DATA(full): empty payload\r\n");
                         }
                     } else {
                         // Ignore half-press (or unknown p0) for recording logic.
-                        rs3_tcp_logf("[PTP] 0x9207 DATA: ignoring (not full press)\r\n");
+                        RS3_LOGD(PTP, "[PTP] 0x9207 DATA: ignoring (not full press)\r\n");
                     }
                     s_waiting_data = false;
                     s_waiting_data_code = 0;
@@ -996,7 +878,7 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
 
             // Only treat COMMAND containers as ops
             if (type != PTP_CT_COMMAND) {
-                rs3_tcp_logf("[PTP] ignoring container type=0x%04X\r\n", type);
+                RS3_LOGW_RL(PTP, "[PTP] ignoring container type=0x%04X\r\n", type);
                 usbd_edpt_xfer(rhport, EP_BULK_OUT, s_rx_buf, sizeof(s_rx_buf));
                 return true;
             }
@@ -1035,7 +917,7 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
                 ep_probe_schedule(rhport, 200000);
 
             } else if (code == PTP_OC_CLOSE_SESSION) {
-                rs3_tcp_logf("[PTP] CloseSession sid=%" PRIu32 "\r\n", s_session_id);
+                RS3_LOGI(PTP, "[PTP] CloseSession sid=%" PRIu32 "\r\n", s_session_id);
                 s_session_id = 0;
                 send_response(rhport, PTP_RC_OK, tid);
             } else {
@@ -1052,8 +934,8 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
                     s_waiting_data_code = code;
                     s_waiting_data_tid = tid;
                     s_waiting_data_p0 = (param_count >= 1 ? params[0] : 0);
-                    rs3_tcp_logf("[PTP] vendor 0x9207 waiting DATA tid=%" PRIu32 " p0=%08" PRIx32 "\r\n",
-                                 tid, (param_count >= 1 ? params[0] : 0));
+                    RS3_LOGD(PTP, "[PTP] vendor 0x9207 waiting DATA tid=%" PRIu32 " p0=%08" PRIx32 "\r\n",
+                                  tid, (param_count >= 1 ? params[0] : 0));
                 } else {
                     send_response(rhport, PTP_RC_OPERATION_NOT_SUPPORTED, tid);
                 }
@@ -1153,8 +1035,8 @@ esp_err_t rs3_usb_ptp_cam_start(void)
         .event_arg = NULL,
     };
 
-    rs3_tcp_logf("[USB] Starting USB PTP device VID=0x%04X PID=0x%04X\r\n",
-                 (unsigned)CONFIG_RS3_USB_PTP_VID, (unsigned)CONFIG_RS3_USB_PTP_PID);
+    RS3_LOGI(PTP, "[USB] Starting USB PTP device VID=0x%04X PID=0x%04X\r\n",
+                  (unsigned)CONFIG_RS3_USB_PTP_VID, (unsigned)CONFIG_RS3_USB_PTP_PID);
     return tinyusb_driver_install(&tusb_cfg);
 }
 
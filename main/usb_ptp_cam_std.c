@@ -159,6 +159,8 @@ static inline void wr_le32(uint8_t *p, uint32_t v) { p[0] = (uint8_t)(v & 0xFF);
 
 static void tcp_hex_dump_lines(const char *prefix, const uint8_t *data, size_t len)
 {
+  if (!rs3_log_enabled(PTP, RS3_LOG_VERBOSE)) return;
+
   char line[512];
   for (size_t off0 = 0; off0 < len; off0 += 16) {
     size_t off = 0;
@@ -233,7 +235,7 @@ static size_t write_ptp_hdr_std(uint8_t *dst, uint32_t len, uint16_t type, uint1
 static void send_response(uint8_t rhport, uint16_t resp_code, uint32_t trans_id)
 {
   size_t hdr = write_ptp_hdr_std(s_tx_buf, 12, PTP_CT_RESPONSE, resp_code, trans_id);
-  rs3_tcp_logf("[PTP-STD] -> RESP code=0x%04X tid=%" PRIu32 "\r\n", resp_code, trans_id);
+  RS3_LOGD(PTP, "[PTP-STD] -> RESP code=0x%04X tid=%" PRIu32 "\r\n", resp_code, trans_id);
   tcp_hex_dump_lines("[PTP-STD] tx ", s_tx_buf, hdr);
   (void)usbd_edpt_xfer(rhport, EP_BULK_IN, s_tx_buf, (uint16_t)hdr);
 }
@@ -244,8 +246,8 @@ static void send_data_and_ok(uint8_t rhport, uint16_t op_code, uint32_t trans_id
   size_t hdr = write_ptp_hdr_std(s_tx_buf, (uint32_t)(12 + payload_len), PTP_CT_DATA, op_code, trans_id);
   memcpy(s_tx_buf + hdr, payload, payload_len);
 
-  rs3_tcp_logf("[PTP-STD] -> DATA op=0x%04X tid=%" PRIu32 " bytes=%u\r\n",
-               op_code, trans_id, (unsigned)payload_len);
+  RS3_LOGD(PTP, "[PTP-STD] -> DATA op=0x%04X tid=%" PRIu32 " bytes=%u\r\n",
+                op_code, trans_id, (unsigned)payload_len);
   tcp_hex_dump_lines("[PTP-STD] tx ", s_tx_buf, (hdr + payload_len > 64) ? 64 : (hdr + payload_len));
 
   s_pending_ok = true;
@@ -295,7 +297,7 @@ static uint16_t ptp_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc,
   // Start first OUT transfer
   usbd_edpt_xfer(rhport, EP_BULK_OUT, s_rx_buf, sizeof(s_rx_buf));
   s_mounted = true;
-  rs3_tcp_logf("[USB] PTP-STD interface opened (itf=%u)\r\n", s_itf_num);
+  RS3_LOGI(PTP, "[USB] PTP-STD interface opened (itf=%u)\r\n", s_itf_num);
   return len;
 }
 
@@ -353,15 +355,15 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
   // OUT: receive command container
   if (!is_in && ep_num == (EP_BULK_OUT & 0x7F)) {
     size_t n = (size_t)xferred_bytes;
-    rs3_tcp_logf("[PTP-STD] <- OUT bytes=%" PRIu32 " res=%d\r\n", xferred_bytes, (int)result);
+    RS3_LOGD(PTP, "[PTP-STD] <- OUT bytes=%" PRIu32 " res=%d\r\n", xferred_bytes, (int)result);
     if (n >= 12) {
       uint32_t clen = rd_le32(s_rx_buf + 0);
       uint16_t ctype = rd_le16(s_rx_buf + 4);
       uint16_t code  = rd_le16(s_rx_buf + 6);
       uint32_t tid   = rd_le32(s_rx_buf + 8);
 
-      rs3_tcp_logf("[PTP-STD] cmd len=%" PRIu32 " type=0x%04X op=0x%04X tid=%" PRIu32 " (rx=%u)\r\n",
-                   clen, ctype, code, tid, (unsigned)n);
+      RS3_LOGD(PTP, "[PTP-STD] cmd len=%" PRIu32 " type=0x%04X op=0x%04X tid=%" PRIu32 " (rx=%u)\r\n",
+                    clen, ctype, code, tid, (unsigned)n);
       tcp_hex_dump_lines("[PTP-STD]  ", s_rx_buf, (n > 64 ? 64 : n));
 
       if (clen < 12 || clen > n) {
@@ -386,7 +388,7 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
         } else {
           s_session_id = rd_le32(s_rx_buf + 12);
           s_session_open = true;
-          rs3_tcp_logf("[PTP-STD] OpenSession sid=%" PRIu32 "\r\n", s_session_id);
+          RS3_LOGI(PTP, "[PTP-STD] OpenSession sid=%" PRIu32 "\r\n", s_session_id);
           send_response(rhport, PTP_RC_OK, tid);
         }
       } else {
@@ -460,8 +462,8 @@ esp_err_t rs3_usb_ptp_cam_start(void)
     .event_arg = NULL,
   };
 
-  rs3_tcp_logf("[USB] Starting USB PTP-STD device VID=0x%04X PID=0x%04X\r\n",
-               (unsigned)CONFIG_RS3_USB_PTP_VID, (unsigned)CONFIG_RS3_USB_PTP_PID);
+  RS3_LOGI(PTP, "[USB] Starting USB PTP-STD device VID=0x%04X PID=0x%04X\r\n",
+                (unsigned)CONFIG_RS3_USB_PTP_VID, (unsigned)CONFIG_RS3_USB_PTP_PID);
   return tinyusb_driver_install(&tusb_cfg);
 }
 
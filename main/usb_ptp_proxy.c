@@ -13,11 +13,14 @@
 #include <string.h>
 
 #include "esp_check.h"
+#include "esp_timer.h"
 
 #include "tinyusb.h"
 #include "tusb.h"
 
+#include "fmt_fast.h"
 #include "log_tcp.h"
+#include "ptp_layout.h"
 #include "ptp_proxy_server.h"
 #include "tcp_server.h"
 
@@ -29,6 +32,17 @@
 #define RS3_PTP_RAW_PROXY_T_RAW_IN   0x11
 // - PC  -> ESP: RAW_DONE (end-of-reply marker for one RS3 OUT command; no payload)
 #define RS3_PTP_RAW_PROXY_T_RAW_DONE 0x12
+// - ESP -> PC: RAW_TS (timestamps of the previous exchange, sent right before the next RAW_OUT).
+//   Payload (big-endian, like the frame length): u32 seq, u64 out_us, u64 send_us, u64 reply_us, u64 in_done_us.
+//   All stamps are esp_timer_get_time(); only sent with CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS.
+#define RS3_PTP_RAW_PROXY_T_RAW_TS   0x13
+
+#ifndef CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS
+#define CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS 0
+#endif
+#ifndef CONFIG_RS3_USB_PTP_PROXY_BUSY_FALLBACK
+#define CONFIG_RS3_USB_PTP_PROXY_BUSY_FALLBACK 0
+#endif
 
 // Endpoints (Full-speed). Match the real Sony camera as closely as possible:
 // the ILCE-5100 interface reports only 2 endpoints (bulk IN/OUT), no interrupt/event endpoint.
@@ -43,6 +57,7 @@ static const uint8_t EP_BULK_OUT= 0x02;
 
 // PTP Response code OK
 #define PTP_RC_OK 0x2001
+#define PTP_RC_DEVICE_BUSY 0x2019
 
 static uint8_t s_rx_buf[64];
 static uint8_t s_tx_buf[512];
@@ -64,17 +79,66 @@ static in_frame_t s_in_q[8];
 static int s_in_q_count = 0;
 static int s_in_q_idx = 0;
 
+// Per-packet lines of one exchange (OUT, its IN frames, DONE) share one rate-limit token, taken on
+// the OUT: either all of them reach the log or none, so rs3_log_analyze.py never pairs an OUT with
+// another exchange's DONE.
+static bool s_ex_log = false;
+#define EX_LOGD(fmt, ...) do { if (s_ex_log) RS3_LOGD(RAW, fmt, ##__VA_ARGS__); } while (0)
+
+#if CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS
+// Stamps of the current/last exchange. Reported to the PC before the next RAW_OUT so the
+// report itself never delays the IN path of the exchange it describes.
+typedef struct {
+    uint32_t seq;
+    uint64_t out_us;     // bulk OUT transfer completed (xfer_cb entry)
+    uint64_t send_us;    // RAW_OUT handed to the socket
+    uint64_t reply_us;   // first reply frame (RAW_IN/RAW_DONE) received
+    uint64_t in_done_us; // last queued IN transfer completed (== reply_us if nothing queued)
+} raw_ts_t;
+
+static raw_ts_t s_ts;
+static uint32_t s_ts_seq = 0;
+static bool s_ts_pending = false;
+
+static inline void wr_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline void wr_be64(uint8_t *p, uint64_t v)
+{
+    wr_be32(p, (uint32_t)(v >> 32));
+    wr_be32(p + 4, (uint32_t)v);
+}
+
+static void ts_flush_report(void)
+{
+    if (!s_ts_pending) return;
+    s_ts_pending = false;
+    uint8_t pl[4 + 4 * 8];
+    wr_be32(pl, s_ts.seq);
+    wr_be64(pl + 4, s_ts.out_us);
+    wr_be64(pl + 12, s_ts.send_us);
+    wr_be64(pl + 20, s_ts.reply_us);
+    wr_be64(pl + 28, s_ts.in_done_us);
+    (void)rs3_ptp_proxy_send_frame(RS3_PTP_RAW_PROXY_T_RAW_TS, pl, sizeof(pl));
+}
+#endif
+
 static void log_hex8(const char *prefix, const uint8_t *buf, size_t n)
 {
+    if (!rs3_log_enabled(RAW, RS3_LOG_VERBOSE)) return;
+
     char line[96];
-    size_t off = 0;
-    off += (size_t)snprintf(line + off, sizeof(line) - off, "%s", prefix);
-    size_t k = (n > 8) ? 8 : n;
-    for (size_t i = 0; i < k && off + 4 < sizeof(line); i++) {
-        off += (size_t)snprintf(line + off, sizeof(line) - off, "%02X%s", buf[i], (i + 1 < k) ? " " : "");
-    }
-    off += (size_t)snprintf(line + off, sizeof(line) - off, "\r\n");
-    (void)rs3_tcp_server_send(line, off);
+    rs3_fmt_t f;
+    rs3_fmt_init(&f, line, sizeof(line));
+    rs3_fmt_str(&f, prefix);
+    rs3_fmt_hex_bytes(&f, buf, (n > 8) ? 8 : n, ' ');
+    rs3_fmt_mem(&f, "\r\n", 2);
+    (void)rs3_tcp_server_send(line, f.len);
 }
 
 // -----------------------------
@@ -178,7 +242,7 @@ static uint16_t ptp_open(uint8_t rhport, tusb_desc_interface_t const *itf_desc,
     // Start first OUT transfer
     usbd_edpt_xfer(rhport, EP_BULK_OUT, s_rx_buf, sizeof(s_rx_buf));
     s_mounted = true;
-    rs3_tcp_logf("[USB] PTP RAW PROXY opened (itf=%u) proxy_port=%d\r\n", s_itf_num, CONFIG_RS3_USB_PTP_PROXY_PORT);
+    RS3_LOGI(RAW, "[USB] PTP RAW PROXY opened (itf=%u) proxy_port=%d\r\n", s_itf_num, CONFIG_RS3_USB_PTP_PROXY_PORT);
     return len;
 }
 
@@ -190,8 +254,8 @@ static bool ptp_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_requ
     if ((uint8_t)tu_le16toh(request->wIndex) != s_itf_num) return false;
 
     if (stage == CONTROL_STAGE_SETUP) {
-        rs3_tcp_logf("[RAW][EP0] class req=0x%02X wLen=%u\r\n",
-                     request->bRequest, (unsigned)tu_le16toh(request->wLength));
+        RS3_LOGD(RAW, "[RAW][EP0] class req=0x%02X wLen=%u\r\n",
+                      request->bRequest, (unsigned)tu_le16toh(request->wLength));
     }
 
     switch (request->bRequest) {
@@ -255,7 +319,7 @@ static void start_next_in(uint8_t rhport)
     if (s_pending_zlp) {
         s_pending_zlp = false;
         s_in_busy = true;
-        rs3_tcp_logf("[RAW] -> IN ZLP\r\n");
+        EX_LOGD("[RAW] -> IN ZLP\r\n");
         (void)usbd_edpt_xfer(rhport, EP_BULK_IN, s_tx_buf, 0);
         return;
     }
@@ -266,23 +330,73 @@ static void start_next_in(uint8_t rhport)
     }
     in_frame_t *f = &s_in_q[s_in_q_idx];
     s_in_busy = true;
-    rs3_tcp_logf("[RAW] -> IN bytes=%u idx=%d/%d\r\n", (unsigned)f->len, s_in_q_idx + 1, s_in_q_count);
-    log_hex8("[RAW] -> IN head: ", f->buf, f->len);
+    if (s_ex_log) {
+        RS3_LOGD(RAW, "[RAW] -> IN bytes=%u idx=%d/%d\r\n", (unsigned)f->len, s_in_q_idx + 1, s_in_q_count);
+        log_hex8("[RAW] -> IN head: ", f->buf, f->len);
+    }
     (void)usbd_edpt_xfer(rhport, EP_BULK_IN, f->buf, (uint16_t)f->len);
 }
 
+#if CONFIG_RS3_USB_PTP_PROXY_BUSY_FALLBACK
+// No PC to forward to (never connected, or the link just died mid-exchange): answer a PTP
+// COMMAND container with DeviceBusy so the RS3 retries instead of waiting out its own timeout.
+// The RS3 sends DJI-padded layouts (ptp_layout.h); the response is std_len, which it accepts.
+// Returns true if a response was queued.
+static bool queue_busy_response(const uint8_t *out, size_t n)
+{
+    rs3_ptp_cmd_parsed_t cmd;
+    if (!rs3_ptp_parse_cmd(out, n, &cmd) || cmd.type != 1) return false;
+
+    uint8_t *r = s_in_q[0].buf;
+    r[0] = 12; r[1] = 0; r[2] = 0; r[3] = 0;
+    r[4] = 3; r[5] = 0;
+    r[6] = (uint8_t)(PTP_RC_DEVICE_BUSY & 0xFF);
+    r[7] = (uint8_t)(PTP_RC_DEVICE_BUSY >> 8);
+    r[8] = (uint8_t)(cmd.tid & 0xFF);
+    r[9] = (uint8_t)((cmd.tid >> 8) & 0xFF);
+    r[10] = (uint8_t)((cmd.tid >> 16) & 0xFF);
+    r[11] = (uint8_t)((cmd.tid >> 24) & 0xFF);
+    s_in_q[0].len = 12;
+    s_in_q_count = 1;
+    s_in_q_idx = 0;
+    // Ends the exchange in the log: goes out with its OUT line, or on its own budget otherwise.
+    if (s_ex_log || RS3_LOG_RL_PASS(RAW, RS3_LOG_WARN)) {
+        RS3_LOGW(RAW, "[RAW] no proxy peer: op=0x%04X layout=%d -> DeviceBusy\r\n", cmd.code, (int)cmd.layout);
+    }
+    return true;
+}
+#endif
+
 static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
 {
     const bool is_in = (ep_addr & 0x80) != 0;
     const uint8_t ep_num = (uint8_t)(ep_addr & 0x7F);
 
     if (!is_in && ep_num == (EP_BULK_OUT & 0x7F)) {
+#if CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS
+        const uint64_t out_us = (uint64_t)esp_timer_get_time();
+#endif
         const size_t n = (size_t)xferred_bytes;
-        rs3_tcp_logf("[RAW] <- OUT bytes=%" PRIu32 " res=%d\r\n", xferred_bytes, (int)result);
-        log_hex8("[RAW] <- OUT head: ", s_rx_buf, n);
+        // Per-packet lines are rate-limited: RS3 polling must not push the rare ones out of the log.
+        s_ex_log = RS3_LOG_RL_PASS(RAW, RS3_LOG_DEBUG);
+        if (s_ex_log) {
+            RS3_LOGD(RAW, "[RAW] <- OUT bytes=%" PRIu32 " res=%d\r\n", xferred_bytes, (int)result);
+            log_hex8("[RAW] <- OUT head: ", s_rx_buf, n);
+        }
 
-        if (rs3_ptp_proxy_is_connected()) {
-            (void)rs3_ptp_proxy_send_frame(RS3_PTP_RAW_PROXY_T_RAW_OUT, s_rx_buf, n);
+        bool link_failed = !rs3_ptp_proxy_is_connected();
+        if (!link_failed) {
+            // Owns the proxy socket's read side until the reply is complete (see ptp_proxy_server.h).
+            rs3_ptp_proxy_exchange_begin();
+#if CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS
+            ts_flush_report();
+            s_ts.seq = s_ts_seq++;
+            s_ts.out_us = out_us;
+            s_ts.send_us = (uint64_t)esp_timer_get_time();
+            s_ts.reply_us = 0;
+            s_ts.in_done_us = 0;
+#endif
+            if (rs3_ptp_proxy_send_frame(RS3_PTP_RAW_PROXY_T_RAW_OUT, s_rx_buf, n) != ESP_OK) link_failed = true;
 
             // Receive up to N raw IN frames from PC.
             // IMPORTANT: Don't rely on timeouts to decide "end of reply" (OpenSession is usually a single short response).
@@ -291,7 +405,7 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
             s_in_q_idx = 0;
             s_pending_zlp = false;
 
-            for (int i = 0; i < (int)(sizeof(s_in_q) / sizeof(s_in_q[0])); i++) {
+            for (int i = 0; !link_failed && i < (int)(sizeof(s_in_q) / sizeof(s_in_q[0])); i++) {
                 uint8_t ftype = 0;
                 size_t flen = 0;
                 esp_err_t rr = rs3_ptp_proxy_recv_frame(&ftype,
@@ -303,27 +417,45 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
                     break; // no more frames right now
                 }
                 if (rr != ESP_OK) {
-                    rs3_tcp_logf("[RAW] proxy recv failed (%s)\r\n", esp_err_to_name(rr));
+                    RS3_LOGE(RAW, "[RAW] proxy recv failed (%s)\r\n", esp_err_to_name(rr));
+                    if (s_in_q_count == 0) link_failed = true;
                     break;
                 }
+#if CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS
+                if (s_ts.reply_us == 0) s_ts.reply_us = (uint64_t)esp_timer_get_time();
+#endif
                 if (ftype == RS3_PTP_RAW_PROXY_T_RAW_DONE) {
-                    rs3_tcp_logf("[RAW] proxy: DONE\r\n");
+                    EX_LOGD("[RAW] proxy: DONE\r\n");
                     break;
                 } else if (ftype == RS3_PTP_RAW_PROXY_T_RAW_IN) {
                     s_in_q[i].len = flen;
                     s_in_q_count = i + 1;
                 } else {
-                    rs3_tcp_logf("[RAW] unexpected proxy frame type=0x%02X\r\n", ftype);
+                    RS3_LOGW(RAW, "[RAW] unexpected proxy frame type=0x%02X\r\n", ftype);
                     break;
                 }
             }
+            rs3_ptp_proxy_exchange_end();
+        }
 
+#if CONFIG_RS3_USB_PTP_PROXY_BUSY_FALLBACK
+        if (link_failed && s_in_q_count == 0 && queue_busy_response(s_rx_buf, n)) {
+            s_in_busy = false;
+            start_next_in(rhport);
+        } else
+#endif
+        if (!link_failed) {
             // Start sending queued frames immediately.
             if (s_in_q_count > 0) {
                 s_in_busy = false;
                 start_next_in(rhport);
             } else {
-                rs3_tcp_logf("[RAW] proxy: no IN frames queued\r\n");
+                RS3_LOGW_RL(RAW, "[RAW] proxy: no IN frames queued\r\n");
+#if CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS
+                // Nothing to send back: the exchange ends when the reply (or timeout) arrived.
+                s_ts.in_done_us = s_ts.reply_us ? s_ts.reply_us : (uint64_t)esp_timer_get_time();
+                s_ts_pending = true;
+#endif
             }
         }
 
@@ -334,9 +466,15 @@ static bool ptp_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, u
 
     if ((ep_addr & 0x7F) == (EP_BULK_IN & 0x7F)) {
         (void)result;
-        rs3_tcp_logf("[RAW] <- IN complete bytes=%" PRIu32 "\r\n", xferred_bytes);
+        EX_LOGD("[RAW] <- IN complete bytes=%" PRIu32 "\r\n", xferred_bytes);
         s_in_busy = false;
         if (s_in_q_idx < s_in_q_count) s_in_q_idx++;
+#if CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS
+        if (s_in_q_idx >= s_in_q_count && !s_pending_zlp && s_ts.in_done_us == 0 && s_ts.send_us != 0) {
+            s_ts.in_done_us = (uint64_t)esp_timer_get_time();
+            s_ts_pending = true;
+        }
+#endif
         start_next_in(rhport);
         return true;
     }
@@ -393,8 +531,8 @@ esp_err_t rs3_usb_ptp_cam_start(void)
         .event_arg = NULL,
     };
 
-    rs3_tcp_logf("[USB] Starting USB PTP RAW PROXY VID=0x%04X PID=0x%04X\r\n",
-                 (unsigned)CONFIG_RS3_USB_PTP_VID, (unsigned)CONFIG_RS3_USB_PTP_PID);
+    RS3_LOGI(RAW, "[USB] Starting USB PTP RAW PROXY VID=0x%04X PID=0x%04X\r\n",
+                  (unsigned)CONFIG_RS3_USB_PTP_VID, (unsigned)CONFIG_RS3_USB_PTP_PID);
     return tinyusb_driver_install(&tusb_cfg);
 }
 
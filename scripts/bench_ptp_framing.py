@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+"""
+Microbenchmark for rs3_ptp_common.py against the per-script code it replaced.
+
+Receive: frames go through a local socketpair (a writer thread sends one prebuilt blob) and
+the reader's CPU time is measured with time.thread_time(), so "frames/s/core" is what one
+core can parse, independent of the writer. Parse/build/hexdump run in a tight loop.
+
+  python3 scripts/bench_ptp_framing.py            # default sizes 12, 64, 512 bytes
+  python3 scripts/bench_ptp_framing.py --frames 200000 --sizes 64
+"""
+
+from __future__ import annotations
+
+import argparse
+import socket
+import struct
+import threading
+import time
+from typing import Callable, List, Tuple
+
+import rs3_ptp_common as common
+
+
+# --- previous per-script implementations (baseline) ----------------------------------------------
+
+def legacy_recv_exact(sock: socket.socket, n: int) -> bytes:
+    buf = bytearray()
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            raise EOFError("socket closed")
+        buf += chunk
+    return bytes(buf)
+
+
+def legacy_recv_frame(sock: socket.socket) -> Tuple[int, bytes]:
+    hdr = legacy_recv_exact(sock, 5)
+    length = struct.unpack(">I", hdr[:4])[0]
+    ftype = hdr[4]
+    payload_len = length - 1
+    payload = legacy_recv_exact(sock, payload_len) if payload_len else b""
+    return ftype, payload
+
+
+def _le32(b: bytes, off: int = 0) -> int:
+    return struct.unpack_from("<I", b, off)[0]
+
+
+def _le16(b: bytes, off: int = 0) -> int:
+    return struct.unpack_from("<H", b, off)[0]
+
+
+def legacy_parse_rs3_container(payload: bytes, *, align_tail_u32: bool):
+    b = payload
+    n = len(b)
+
+    def tail(off: int) -> bytes:
+        if n <= off:
+            return b""
+        t = b[off:]
+        if not align_tail_u32:
+            return t
+        return t[: (len(t) // 4) * 4]
+
+    if n >= 11 and b[0] == 0x00 and b[1] == 0x00 and b[2] == 0x00:
+        return "dji_pad24", _le16(b, 3), _le16(b, 5), _le32(b, 7), tail(11)
+    if n >= 10 and b[0] == 0x00 and b[1] == 0x00:
+        return "dji_pad16", _le16(b, 2), _le16(b, 4), _le32(b, 6), tail(10)
+    if n >= 9 and b[0] == 0x00:
+        return "dji_pad8", _le16(b, 1), _le16(b, 3), _le32(b, 5), tail(9)
+    if n >= 12:
+        t_std = _le16(b, 4)
+        if 1 <= t_std <= 4:
+            return "std_len", t_std, _le16(b, 6), _le32(b, 8), tail(12)
+        t_alt = _le16(b, 10)
+        if 1 <= t_alt <= 4:
+            return "alt_len", t_alt, _le16(b, 4), _le32(b, 6), tail(12)
+    raise ValueError("unknown RS3 container layout")
+
+
+def legacy_hexdump(buf: bytes, prefix: str = "") -> str:
+    lines = []
+    for off in range(0, len(buf), 16):
+        chunk = buf[off : off + 16]
+        lines.append(f"{prefix}{off:04x}: " + " ".join(f"{b:02x}" for b in chunk))
+    return "\n".join(lines)
+
+
+def legacy_coalesce(parts: List[bytes]) -> bytearray:
+    out = bytearray()
+    for p in parts:
+        out += struct.pack(">IB", 1 + len(p), common.T_RAW_IN) + p
+    return out
+
+
+def new_coalesce(parts: List[bytes]) -> bytearray:
+    out = bytearray()
+    for p in parts:
+        common.frame_into(out, common.T_RAW_IN, p)
+    return out
+
+
+# --- harness -------------------------------------------------------------------------------------
+
+def bench_recv(name: str, n_frames: int, size: int, make_reader: Callable[[socket.socket], Callable[[], object]]) -> None:
+    blob = common.frame_bytes(common.T_RAW_OUT, bytes(size)) * n_frames
+    a, b = socket.socketpair()
+    a.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, 1 << 20)
+    b.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    writer = threading.Thread(target=a.sendall, args=(blob,), daemon=True)
+    read = make_reader(b)
+    writer.start()
+    t_wall = time.perf_counter()
+    t_cpu = time.thread_time()
+    for _ in range(n_frames):
+        read()
+    cpu = max(1e-9, time.thread_time() - t_cpu)
+    wall = max(1e-9, time.perf_counter() - t_wall)
+    writer.join()
+    a.close()
+    b.close()
+    print(f"  {name:<28} {size:>6}B  {n_frames / cpu:>12,.0f} frames/s/core  {n_frames / wall:>12,.0f} frames/s wall")
+
+
+def bench_loop(name: str, n: int, fn: Callable[[], object], unit: str = "ops") -> float:
+    t = time.thread_time()
+    for _ in range(n):
+        fn()
+    rate = n / max(1e-9, time.thread_time() - t)
+    print(f"  {name:<36} {rate:>12,.0f} {unit}/s/core")
+    return rate
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Frames/s per core of rs3_ptp_common vs the previous per-script code.")
+    ap.add_argument("--frames", type=int, default=100000)
+    ap.add_argument("--sizes", type=lambda s: [int(x) for x in s.split(",")], default=[12, 64, 512])
+    ap.add_argument("--loops", type=int, default=200000, help="Iterations for parse/build/hexdump loops")
+    args = ap.parse_args()
+
+    print("Receive (ESP -> PC frames over a socketpair):")
+    for size in args.sizes:
+        bench_recv("legacy recv_frame", args.frames, size, lambda s: (lambda: legacy_recv_frame(s)))
+        bench_recv("common.recv_frame", args.frames, size, lambda s: (lambda: common.recv_frame(s)))
+        bench_recv("common.FrameReader", args.frames, size, lambda s: common.FrameReader(s).read)
+
+    samples = [
+        common.build_rs3_container(layout, common.PTP_CT_COMMAND, 0x9207, 7, struct.pack("<II", 1, 2))
+        for layout in common.RS3_LAYOUTS
+    ]
+    k = [0]
+
+    def pick() -> bytes:
+        k[0] = (k[0] + 1) % len(samples)
+        return samples[k[0]]
+
+    print("Parse RS3 containers (five layouts, round robin):")
+    bench_loop("legacy parse_rs3_container", args.loops, lambda: legacy_parse_rs3_container(pick(), align_tail_u32=True))
+    bench_loop("common.parse_rs3_container", args.loops, lambda: common.parse_rs3_container(pick(), align_tail_u32=True))
+
+    container = bytes(range(256)) * 16
+    parts = [container[i : i + 512] for i in range(0, len(container), 512)]
+    print(f"Coalesce one {len(container)}-byte container into RAW_IN frames:")
+    bench_loop("legacy bytes concat", args.loops // 10, lambda: legacy_coalesce(parts), "containers")
+    bench_loop("common.frame_into", args.loops // 10, lambda: new_coalesce(parts), "containers")
+
+    print("Hexdump 512 bytes:")
+    blk = container[:512]
+    bench_loop("legacy hexdump", args.loops // 20, lambda: legacy_hexdump(blk, "  "), "dumps")
+    bench_loop("common.hexdump", args.loops // 20, lambda: common.hexdump(blk, "  "), "dumps")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
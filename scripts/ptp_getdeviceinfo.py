@@ -2,6 +2,15 @@
 """
 Send PTP GetDeviceInfo (0x1001) to a USB Still Image (PTP) device and print the
 raw DeviceInfo dataset as hex.
+
+--profile FILE walks the camera instead: it parses DeviceInfo, opens a session, runs every
+supported read-only op (and GetDevicePropDesc/GetDevicePropValue for every property when the
+camera has them) --iterations times, prints min/median/p99 latency per op and writes the
+responses as `static const uint8_t k_<name>_<op>[N]` arrays in the main/usb_ptp_cam.c format
+(load it with `virtual_ptp_camera.py --virtual-profile FILE`). Ops that may change camera
+state (capture, delete, format, SetDevicePropValue, 0x9207, ...) are listed but not run,
+unless forced with --probe-op.
+
 Works best on macOS with:
   brew install libusb
   python3 -m pip install --user pyusb
@@ -15,55 +24,50 @@ Notes:
 from __future__ import annotations
 
 import argparse
-import struct
-import sys
-from dataclasses import dataclass
-from typing import Optional, Tuple
+import time
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Tuple
 
 import usb.core
 import usb.util
 
-
-PTP_CLASS = 0x06
-PTP_SUBCLASS = 0x01
-PTP_PROTOCOL = 0x01
-
-PTP_CT_COMMAND = 0x0001
-PTP_CT_DATA = 0x0002
-PTP_CT_RESPONSE = 0x0003
-
-PTP_OC_GET_DEVICE_INFO = 0x1001
-
-
-def hexdump(buf: bytes, prefix: str = "") -> None:
-    for off in range(0, len(buf), 16):
-        chunk = buf[off : off + 16]
-        print(f"{prefix}{off:04x}: " + " ".join(f"{b:02x}" for b in chunk))
-
-
-def le16(b: bytes, off: int) -> int:
-    return struct.unpack_from("<H", b, off)[0]
-
-
-def le32(b: bytes, off: int) -> int:
-    return struct.unpack_from("<I", b, off)[0]
-
-
-def read_ptp_container(ep_in, timeout_ms: int = 5000) -> bytes:
-    """
-    Read one PTP container from bulk IN.
-    Container format: <len32><type16><code16><tid32> + payload...
-    """
-    first = ep_in.read(ep_in.wMaxPacketSize, timeout=timeout_ms).tobytes()
-    if len(first) < 12:
-        raise RuntimeError(f"Short read ({len(first)} bytes), expected >= 12")
-    total_len = le32(first, 0)
-    if total_len < 12:
-        raise RuntimeError(f"Invalid container length={total_len}")
-    buf = bytearray(first)
-    while len(buf) < total_len:
-        buf += ep_in.read(ep_in.wMaxPacketSize, timeout=timeout_ms).tobytes()
-    return bytes(buf[:total_len])
+from rs3_ptp_common import (
+    PTP_CLASS,
+    PTP_CT_COMMAND,
+    PTP_CT_DATA,
+    PTP_OC_CLOSE_SESSION,
+    PTP_OC_GET_DEVICE_INFO,
+    PTP_OC_OPEN_SESSION,
+    PTP_PROTOCOL,
+    PTP_RC_OK,
+    PTP_RC_SESSION_ALREADY_OPEN,
+    PTP_SUBCLASS,
+    U32_LE,
+    build_ptp_container,
+    hexdump,
+    parse_ptp_container_header,
+    read_ptp_container,
+)
+
+PTP_OC_GET_STORAGE_IDS = 0x1004
+PTP_OC_GET_STORAGE_INFO = 0x1005
+PTP_OC_GET_NUM_OBJECTS = 0x1006
+PTP_OC_GET_OBJECT_HANDLES = 0x1007
+PTP_OC_GET_DEVICE_PROP_DESC = 0x1014
+PTP_OC_GET_DEVICE_PROP_VALUE = 0x1015
+
+# Read-only ops the profiler runs by default: op -> (array name, params). None = params filled in
+# at run time (first storage id). Sony vendor ops are sent the way RS3 sends them (no params).
+SAFE_PROBES: Dict[int, Tuple[str, Optional[Tuple[int, ...]]]] = {
+    PTP_OC_GET_DEVICE_INFO: ("devinfo", ()),
+    PTP_OC_GET_STORAGE_IDS: ("storageids", ()),
+    PTP_OC_GET_STORAGE_INFO: ("storageinfo", None),
+    PTP_OC_GET_NUM_OBJECTS: ("numobjects", (0xFFFFFFFF,)),
+    PTP_OC_GET_OBJECT_HANDLES: ("objecthandles", (0xFFFFFFFF,)),
+    0x9201: ("vendor", ()),
+    0x9202: ("vendor", ()),
+    0x9209: ("vendor", ()),
+}
 
 
 @dataclass
@@ -141,19 +145,221 @@ def claim_interface(dev: usb.core.Device, cfg_value: int, intf_num: int) -> Tupl
 
 
 def ptp_get_device_info(ep_in, ep_out, tid: int = 1) -> Tuple[bytes, bytes]:
-    cmd = struct.pack("<IHHI", 12, PTP_CT_COMMAND, PTP_OC_GET_DEVICE_INFO, tid)
+    cmd = build_ptp_container(PTP_CT_COMMAND, PTP_OC_GET_DEVICE_INFO, tid)
     ep_out.write(cmd, timeout=5000)
     data = read_ptp_container(ep_in, timeout_ms=5000)
     resp = read_ptp_container(ep_in, timeout_ms=5000)
     return data, resp
 
 
+# --- profiler ------------------------------------------------------------------------------------
+
+@dataclass
+class DeviceInfo:
+    standard_version: int
+    vendor_ext_id: int
+    vendor_ext_version: int
+    vendor_ext_desc: str
+    functional_mode: int
+    operations: List[int]
+    events: List[int]
+    properties: List[int]
+    capture_formats: List[int]
+    image_formats: List[int]
+    manufacturer: str
+    model: str
+    device_version: str
+    serial_number: str
+
+
+def parse_device_info(ds: bytes) -> DeviceInfo:
+    off = 0
+
+    def u16() -> int:
+        nonlocal off
+        off += 2
+        return int.from_bytes(ds[off - 2 : off], "little")
+
+    def u32() -> int:
+        nonlocal off
+        off += 4
+        return U32_LE.unpack_from(ds, off - 4)[0]
+
+    def u16_array() -> List[int]:
+        return [u16() for _ in range(u32())]
+
+    def string() -> str:
+        nonlocal off
+        n = ds[off]
+        off += 1 + 2 * n
+        return ds[off - 2 * n : off].decode("utf-16-le", errors="replace").rstrip("\x00")
+
+    return DeviceInfo(u16(), u32(), u16(), string(), u16(), u16_array(), u16_array(), u16_array(),
+                      u16_array(), u16_array(), string(), string(), string(), string())
+
+
+@dataclass
+class OpProfile:
+    op: int
+    name: str
+    params: Tuple[int, ...]
+    rc: Optional[int] = None
+    data: Optional[bytes] = None
+    variants: int = 0
+    latencies_us: List[float] = field(default_factory=list)
+
+    def pct(self, p: float) -> float:
+        v = sorted(self.latencies_us)
+        return v[min(len(v) - 1, int(round(p / 100.0 * (len(v) - 1))))]
+
+
+def ptp_transaction(ep_in, ep_out, op: int, tid: int, params: Tuple[int, ...] = ()) -> Tuple[Optional[bytes], int]:
+    """One COMMAND -> [DATA] -> RESPONSE exchange: (data payload or None, response code)."""
+    ep_out.write(build_ptp_container(PTP_CT_COMMAND, op, tid, b"".join(U32_LE.pack(p) for p in params)),
+                 timeout=5000)
+    data = None
+    cont = read_ptp_container(ep_in, timeout_ms=5000)
+    if parse_ptp_container_header(cont)[1] == PTP_CT_DATA:
+        data = cont[12:]
+        cont = read_ptp_container(ep_in, timeout_ms=5000)
+    return data, parse_ptp_container_header(cont)[2]
+
+
+def profile_camera(ep_in, ep_out, info: DeviceInfo, iterations: int, extra: Dict[int, Tuple[int, ...]]) -> Tuple[List[OpProfile], List[int]]:
+    """Run every probe `iterations` times. Returns (profiles, supported ops that were skipped)."""
+    tid = 1
+    _, rc = ptp_transaction(ep_in, ep_out, PTP_OC_OPEN_SESSION, tid, (1,))
+    if rc not in (PTP_RC_OK, PTP_RC_SESSION_ALREADY_OPEN):
+        raise RuntimeError(f"OpenSession failed: rc=0x{rc:04x}")
+
+    probes: List[OpProfile] = []
+    skipped: List[int] = []
+    storage_id = 0xFFFFFFFF
+    for op in info.operations:
+        if op in extra:
+            probes.append(OpProfile(op, "op", extra[op]))
+        elif op in SAFE_PROBES:
+            name, params = SAFE_PROBES[op]
+            if params is None:
+                params = (storage_id,)
+            probes.append(OpProfile(op, name, params))
+            if op == PTP_OC_GET_STORAGE_IDS:
+                tid += 1
+                data, rc = ptp_transaction(ep_in, ep_out, op, tid)
+                if rc == PTP_RC_OK and data and len(data) >= 8 and U32_LE.unpack_from(data, 0)[0]:
+                    storage_id = U32_LE.unpack_from(data, 4)[0]
+        elif op not in (PTP_OC_OPEN_SESSION, PTP_OC_CLOSE_SESSION, PTP_OC_GET_DEVICE_PROP_DESC,
+                        PTP_OC_GET_DEVICE_PROP_VALUE):
+            skipped.append(op)
+    for op, params in extra.items():
+        if op not in info.operations:
+            probes.append(OpProfile(op, "op", params))
+    for prop_op, name in ((PTP_OC_GET_DEVICE_PROP_DESC, "propdesc"), (PTP_OC_GET_DEVICE_PROP_VALUE, "propvalue")):
+        if prop_op in info.operations and prop_op not in extra:
+            probes.extend(OpProfile(prop_op, name, (prop,)) for prop in info.properties)
+
+    for it in range(iterations):
+        for p in probes:
+            tid += 1
+            t0 = time.perf_counter()
+            data, rc = ptp_transaction(ep_in, ep_out, p.op, tid, p.params)
+            p.latencies_us.append((time.perf_counter() - t0) * 1e6)
+            if it == 0:
+                p.rc, p.data, p.variants = rc, data, 1
+            elif data != p.data:
+                p.variants += 1
+
+    tid += 1
+    ptp_transaction(ep_in, ep_out, PTP_OC_CLOSE_SESSION, tid)
+    return probes, skipped
+
+
+def _c_array(name: str, payload: bytes) -> str:
+    rows = ["  " + " ".join(f"0x{b:02X}," for b in payload[i : i + 16]) for i in range(0, len(payload), 16)]
+    return f"static const uint8_t {name}[{len(payload)}] = {{\n" + "\n".join(rows) + "\n};\n"
+
+
+def write_profile(path: str, vid: int, pid: int, info: DeviceInfo, probes: List[OpProfile], skipped: List[int],
+                  iterations: int) -> None:
+    lines = [
+        "// -----------------------------",
+        f"// Captured response payloads ({info.manufacturer} {info.model}, firmware {info.device_version})",
+        "// -----------------------------",
+        f"// Written by ptp_getdeviceinfo.py --profile on {time.strftime('%Y-%m-%d %H:%M')},"
+        f" VID=0x{vid:04X} PID=0x{pid:04X}, {iterations} iterations per op.",
+        "// Raw container payload bytes (after the standard 12-byte PTP header), same format as",
+        "// main/usb_ptp_cam.c; k_<name>_<op>_<param> arrays are the answer for that first parameter.",
+        "//",
+        "// Camera latency, COMMAND written -> RESPONSE read on the host (us):",
+        f"//   {'op':<6}  {'param':<10} {'min':>8} {'median':>10} {'p99':>10}  rc",
+    ]
+    for p in probes:
+        param = f"0x{p.params[0]:08X}" if p.params else "-"
+        lines.append(f"//   0x{p.op:04X}  {param:<10} {p.pct(0):>8.0f} {p.pct(50):>10.0f} {p.pct(99):>10.0f}  0x{p.rc or 0:04X}"
+                     + ("  (payload varies)" if p.variants > 1 else ""))
+    if skipped:
+        lines.append("// Supported but not run (may change camera state): "
+                     + ", ".join(f"0x{op:04X}" for op in skipped))
+    delays = {}
+    for p in probes:
+        if p.op not in (PTP_OC_GET_DEVICE_PROP_DESC, PTP_OC_GET_DEVICE_PROP_VALUE):
+            delays.setdefault(p.op, p.pct(50) / 1000.0)
+    lines.append("// virtual_ptp_camera.py medians: --virtual-op-delay "
+                 + ",".join(f"0x{op:04X}={ms:.2f}" for op, ms in delays.items()))
+    lines.append("")
+    for p in probes:
+        if p.rc != PTP_RC_OK or p.data is None:
+            continue
+        name = f"k_{p.name}_{p.op:04x}"
+        if p.op in (PTP_OC_GET_DEVICE_PROP_DESC, PTP_OC_GET_DEVICE_PROP_VALUE):
+            name += f"_{p.params[0]:04x}"
+        elif p.name == "vendor":
+            name = f"k_vendor_{p.op:04x}_payload"
+        else:
+            name = f"k_{p.name}_payload_{p.op:04x}"
+        lines.append(_c_array(name, p.data))
+    with open(path, "w", encoding="utf-8") as f:
+        f.write("\n".join(lines))
+
+
+def parse_probe_op(spec: str) -> Tuple[int, Tuple[int, ...]]:
+    """'0x9203' or '0x1014:0x5004' or '0x9201:1,0,0' -> (op, params)"""
+    op, _, params = spec.partition(":")
+    return int(op, 0), tuple(int(p, 0) for p in params.split(",") if p.strip())
+
+
+def run_profile(ep_in, ep_out, vid: int, pid: int, path: str, iterations: int,
+                extra: Dict[int, Tuple[int, ...]]) -> None:
+    data, rc = ptp_transaction(ep_in, ep_out, PTP_OC_GET_DEVICE_INFO, 0)
+    if rc != PTP_RC_OK or data is None:
+        raise RuntimeError(f"GetDeviceInfo failed: rc=0x{rc:04x}")
+    info = parse_device_info(data)
+    print(f"{info.manufacturer} {info.model} {info.device_version}: {len(info.operations)} ops, "
+          f"{len(info.properties)} properties")
+    probes, skipped = profile_camera(ep_in, ep_out, info, iterations, extra)
+    print(f"{'op':<7} {'param':<10} {'bytes':>6} {'min us':>8} {'median us':>10} {'p99 us':>10}  rc")
+    for p in probes:
+        param = f"0x{p.params[0]:08x}" if p.params else "-"
+        n = "-" if p.data is None else str(len(p.data))
+        print(f"0x{p.op:04x} {param:<10} {n:>6} {p.pct(0):>8.0f} {p.pct(50):>10.0f} {p.pct(99):>10.0f}  0x{p.rc or 0:04x}"
+              + ("  payload varies" if p.variants > 1 else ""))
+    if skipped:
+        print("Not run (may change camera state; force with --probe-op): " + ", ".join(f"0x{op:04x}" for op in skipped))
+    write_profile(path, vid, pid, info, probes, skipped, iterations)
+    print(f"Profile written to {path}")
+
+
 def main() -> int:
     ap = argparse.ArgumentParser(description="Send PTP GetDeviceInfo over USB and print raw dataset hex.")
     ap.add_argument("--vid", type=lambda s: int(s, 0), default=None, help="USB VID (e.g. 0x054c)")
     ap.add_argument("--pid", type=lambda s: int(s, 0), default=None, help="USB PID (e.g. 0x0d9f)")
     ap.add_argument("--pick", type=int, default=0, help="Pick Nth matching PTP interface (default: 0)")
     ap.add_argument("--dump-container", action="store_true", help="Also dump full DATA/RESP containers (incl headers)")
+    ap.add_argument("--profile", default=None, metavar="FILE",
+                    help="Profile every supported op and write a usb_ptp_cam.c-style payload header")
+    ap.add_argument("--iterations", type=int, default=50, help="Runs per op for --profile latency stats")
+    ap.add_argument("--probe-op", type=parse_probe_op, action="append", default=[], metavar="OP[:P1,P2,...]",
+                    help="Also run this op with --profile (repeatable), even if it is not in the safe list")
     args = ap.parse_args()
 
     ptp = find_ptp_interface(vid=args.vid, pid=args.pid, pick=args.pick)
@@ -163,22 +369,26 @@ def main() -> int:
     ep_in = ep_out = None
     try:
         ep_in, ep_out = claim_interface(d, ptp.cfg_value, ptp.intf_num)
+        if args.profile:
+            run_profile(ep_in, ep_out, int(d.idVendor), int(d.idProduct), args.profile, args.iterations,
+                        dict(args.probe_op))
+            return 0
         data, resp = ptp_get_device_info(ep_in, ep_out, tid=1)
 
-        dlen, dtype, dop, dtid = struct.unpack_from("<IHHI", data, 0)
-        rlen, rtype, rcode, rtid = struct.unpack_from("<IHHI", resp, 0)
+        dlen, dtype, dop, dtid = parse_ptp_container_header(data)
+        rlen, rtype, rcode, rtid = parse_ptp_container_header(resp)
         print(f"DATA: len={dlen} type=0x{dtype:04x} code=0x{dop:04x} tid={dtid}")
         print(f"RESP: len={rlen} type=0x{rtype:04x} code=0x{rcode:04x} tid={rtid}")
 
         if args.dump_container:
             print("\nDATA container (hex):")
-            hexdump(data)
+            print(hexdump(data))
             print("\nRESP container (hex):")
-            hexdump(resp)
+            print(hexdump(resp))
 
         dataset = data[12:]
         print("\nDeviceInfo dataset (hex):")
-        hexdump(dataset)
+        print(hexdump(dataset))
 
     finally:
         try:
@@ -0,0 +1,402 @@
+#!/usr/bin/env python3
+"""
+Diff PTP traffic of the emulator against real-camera captures, transaction by transaction.
+
+Inputs (files or directories; directories are paired by file name):
+  - pcapng/pcap with USB link types 220 (LINKTYPE_USB_LINUX_MMAPPED, written by --pcap of
+    rs3_ptp_raw_proxy.py / rs3_ptp_tap.py) or 189 (LINKTYPE_USB_LINUX, usbmon/tcpdump on Linux),
+  - rs3_ptp_tap.py --log files (RAW_OUT/RAW_IN lines with esp_us= stamps and hexdumps).
+
+Captures are parsed as a stream (one block / line at a time). Bulk transfers are joined into
+containers (short packet, ZLP or the container length ends one), containers into transactions:
+COMMAND [DATA out] [DATA in] RESPONSE, in any of the RS3 layouts. Transactions are aligned by
+(op, tid, n-th occurrence of that pair); when the two captures' tids don't line up, by (op, n-th
+occurrence). Transactions left without a partner are reported as missing.
+
+Reported per op: missing transactions, response code / response parameter / data mismatches
+(length, first differing offset, differing bytes) and device latency (last host->device
+container to RESPONSE) p50/p99 on both sides. Exit status 1 when a gate fails:
+  --max-mismatches N        semantic mismatches allowed (default 0)
+  --max-latency-regress P   emulator p50 may exceed the camera's by at most P percent (per op)
+
+  python3 scripts/ptp_trace_diff.py captures/emu captures/real -j 8 --ignore-op 0x1001
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+from concurrent.futures import ProcessPoolExecutor
+from typing import BinaryIO, Dict, Iterator, List, Optional, Tuple
+
+from rs3_ptp_common import PTP_CT_COMMAND, PTP_CT_DATA, PTP_CT_RESPONSE, U32_LE, parse_rs3_container
+
+# (timestamp_us, is_in, payload) for one bulk transfer
+Transfer = Tuple[int, bool, bytes]
+
+USB_FS_MPS = 64
+
+_USBMON_HDR = {220: 64, 189: 48}
+_TAP_LINE_RE = re.compile(r"(RS3->ESP RAW_OUT|ESP<-PY RAW_IN) bytes=(\d+) esp_us=(\d+)")
+_HEX_ROW_RE = re.compile(r"^\s+[0-9a-fA-F]{4}: ((?:[0-9a-fA-F]{2} ?)+)$")
+
+
+# --- capture readers -----------------------------------------------------------------------------
+
+def _usbmon_transfer(linktype: int, pkt: bytes, ts_us: int, e: str) -> Optional[Transfer]:
+    hdr_len = _USBMON_HDR[linktype]
+    if len(pkt) < hdr_len:
+        return None
+    ev, xfer_type, epnum = pkt[8], pkt[9], pkt[10]
+    if xfer_type != 3:  # bulk only
+        return None
+    len_cap = struct.unpack_from(e + "I", pkt, 36)[0]
+    is_in = bool(epnum & 0x80)
+    # OUT data travels with the submit, IN data with the completion.
+    if is_in and ev != ord("C"):
+        return None
+    if not is_in and ev != ord("S"):
+        return None
+    return ts_us, is_in, pkt[hdr_len : hdr_len + len_cap]
+
+
+def _read_pcapng(f: BinaryIO) -> Iterator[Transfer]:
+    e = "<"
+    linktypes: List[int] = []
+    tsres: List[int] = []  # timestamp units per second, per interface
+    while True:
+        head = f.read(8)
+        if len(head) < 8:
+            return
+        btype = struct.unpack("<I", head[:4])[0]
+        if btype == 0x0A0D0D0A:
+            magic = f.read(4)
+            e = "<" if magic == b"\x4d\x3c\x2b\x1a" else ">"
+            blen = struct.unpack(e + "I", head[4:])[0]
+            f.read(blen - 12)
+            linktypes, tsres = [], []
+            continue
+        blen = struct.unpack(e + "I", head[4:])[0]
+        body = f.read(blen - 8)
+        btype = struct.unpack(e + "I", head[:4])[0]
+        if btype == 1:
+            linktypes.append(struct.unpack_from(e + "H", body, 0)[0])
+            res = 1_000_000
+            off = 8
+            while off + 4 <= len(body) - 4:
+                code, olen = struct.unpack_from(e + "HH", body, off)
+                if code == 0:
+                    break
+                if code == 9 and olen >= 1:
+                    v = body[off + 4]
+                    res = 2 ** (v & 0x7F) if v & 0x80 else 10 ** v
+                off += 4 + olen + ((-olen) % 4)
+            tsres.append(res)
+        elif btype == 6:
+            ifid, th, tl, cap = struct.unpack_from(e + "IIII", body, 0)
+            if ifid >= len(linktypes) or linktypes[ifid] not in _USBMON_HDR:
+                continue
+            ts_us = ((th << 32) | tl) * 1_000_000 // tsres[ifid]
+            t = _usbmon_transfer(linktypes[ifid], body[20 : 20 + cap], ts_us, e)
+            if t is not None:
+                yield t
+
+
+def _read_pcap(f: BinaryIO, magic: bytes) -> Iterator[Transfer]:
+    e = "<" if magic in (b"\xd4\xc3\xb2\xa1", b"\x4d\x3c\xb2\xa1") else ">"
+    nanos = magic in (b"\x4d\x3c\xb2\xa1", b"\xa1\xb2\x3c\x4d")
+    hdr = f.read(20)
+    linktype = struct.unpack_from(e + "I", hdr, 16)[0] & 0xFFFF
+    if linktype not in _USBMON_HDR:
+        raise ValueError(f"unsupported pcap link type {linktype}")
+    while True:
+        rec = f.read(16)
+        if len(rec) < 16:
+            return
+        sec, frac, cap, _ = struct.unpack(e + "IIII", rec)
+        pkt = f.read(cap)
+        ts_us = sec * 1_000_000 + (frac // 1000 if nanos else frac)
+        t = _usbmon_transfer(linktype, pkt, ts_us, e)
+        if t is not None:
+            yield t
+
+
+def _read_tap_log(path: str) -> Iterator[Transfer]:
+    pending: Optional[Tuple[int, bool, int]] = None
+    data = bytearray()
+    with open(path, "r", encoding="utf-8", errors="replace") as f:
+        for line in f:
+            m = _TAP_LINE_RE.search(line)
+            if m:
+                if pending is not None:
+                    yield pending[0], pending[1], bytes(data[: pending[2]])
+                pending = (int(m.group(3)), m.group(1).endswith("RAW_IN"), int(m.group(2)))
+                data.clear()
+                continue
+            if pending is not None:
+                h = _HEX_ROW_RE.match(line)
+                if h:
+                    data += bytes.fromhex(h.group(1))
+                elif line.strip():
+                    yield pending[0], pending[1], bytes(data[: pending[2]])
+                    pending = None
+        if pending is not None:
+            yield pending[0], pending[1], bytes(data[: pending[2]])
+
+
+def read_transfers(path: str) -> Iterator[Transfer]:
+    with open(path, "rb") as f:
+        magic = f.read(4)
+        if magic == b"\x0a\x0d\x0d\x0a":
+            f.seek(0)
+            yield from _read_pcapng(f)
+            return
+        if magic in (b"\xd4\xc3\xb2\xa1", b"\xa1\xb2\xc3\xd4", b"\x4d\x3c\xb2\xa1", b"\xa1\xb2\x3c\x4d"):
+            yield from _read_pcap(f, magic)
+            return
+    yield from _read_tap_log(path)
+
+
+# --- containers and transactions -----------------------------------------------------------------
+
+class Txn:
+    __slots__ = ("op", "tid", "params", "data_out", "data_in", "rc", "resp_params", "t_last_out", "t_resp")
+
+    def __init__(self, op: int, tid: int, params: bytes, t: int) -> None:
+        self.op = op
+        self.tid = tid
+        self.params = params
+        self.data_out: Optional[bytes] = None
+        self.data_in: Optional[bytes] = None
+        self.rc: Optional[int] = None
+        self.resp_params = b""
+        self.t_last_out = t
+        self.t_resp: Optional[int] = None
+
+    @property
+    def latency_us(self) -> Optional[int]:
+        return None if self.t_resp is None else self.t_resp - self.t_last_out
+
+
+def _container_complete(buf: bytearray, last_len: int) -> bool:
+    if last_len == 0 or last_len % USB_FS_MPS:
+        return True  # ZLP or short packet ends the transfer
+    if len(buf) >= 12 and buf[0] != 0:
+        length = U32_LE.unpack_from(buf, 0)[0]
+        return 12 <= length <= len(buf)
+    return False
+
+
+def read_transactions(path: str) -> List[Txn]:
+    out: List[Txn] = []
+    cur: Optional[Txn] = None
+    bufs = {False: bytearray(), True: bytearray()}
+    for ts, is_in, data in read_transfers(path):
+        buf = bufs[is_in]
+        if not data and not buf:
+            continue  # ZLP after a container that was already complete
+        buf += data
+        if not _container_complete(buf, len(data)):
+            continue
+        cont = bytes(buf)
+        buf.clear()
+        try:
+            _, ctype, code, tid, tail = parse_rs3_container(cont, align_tail_u32=False)
+        except ValueError:
+            continue
+        if not is_in and ctype == PTP_CT_COMMAND:
+            cur = Txn(code, tid, bytes(tail[: len(tail) & ~3]), ts)
+            out.append(cur)
+        elif cur is None:
+            continue
+        elif not is_in and ctype == PTP_CT_DATA:
+            cur.data_out = bytes(tail)
+            cur.t_last_out = ts
+        elif is_in and ctype == PTP_CT_DATA:
+            cur.data_in = bytes(tail) if cur.data_in is None else cur.data_in + bytes(tail)
+        elif is_in and ctype == PTP_CT_RESPONSE:
+            cur.rc = code
+            cur.resp_params = bytes(tail[: len(tail) & ~3]).rstrip(b"\x00")
+            cur.t_resp = ts
+            cur = None
+    return out
+
+
+# --- diff ----------------------------------------------------------------------------------------
+
+def _align(a: List[Txn], b: List[Txn]) -> Tuple[str, List[Tuple[Optional[Txn], Optional[Txn]]]]:
+    # Keys carry the occurrence index: session restarts, tid wraparound and captures that reuse
+    # tids repeat (op, tid), and a plain dict would silently keep only the last of them.
+    def by_tid(txns: List[Txn]) -> Dict[Tuple[int, ...], Txn]:
+        seen: Dict[Tuple[int, int], int] = {}
+        out = {}
+        for t in txns:
+            n = seen.get((t.op, t.tid), 0)
+            seen[(t.op, t.tid)] = n + 1
+            out[(t.op, t.tid, n)] = t
+        return out
+
+    def by_seq(txns: List[Txn]) -> Dict[Tuple[int, ...], Txn]:
+        seen: Dict[int, int] = {}
+        out = {}
+        for t in txns:
+            n = seen.get(t.op, 0)
+            seen[t.op] = n + 1
+            out[(t.op, n)] = t
+        return out
+
+    ka, kb = by_tid(a), by_tid(b)
+    mode = "tid"
+    if len(set(ka) & set(kb)) < 0.5 * max(1, min(len(ka), len(kb))):
+        ka, kb, mode = by_seq(a), by_seq(b), "seq"
+    # Capture order: the emulator's transactions, then what only the real capture has.
+    keys = list(ka) + [k for k in kb if k not in ka]
+    return mode, [(ka.get(k), kb.get(k)) for k in keys]
+
+
+def _byte_diff(x: Optional[bytes], y: Optional[bytes]) -> Optional[str]:
+    if x == y:
+        return None
+    if x is None or y is None:
+        return f"data present emu={x is not None} real={y is not None}"
+    n = min(len(x), len(y))
+    diffs = [i for i in range(n) if x[i] != y[i]]
+    parts = []
+    if len(x) != len(y):
+        parts.append(f"len emu={len(x)} real={len(y)}")
+    if diffs:
+        parts.append(f"{len(diffs)} bytes differ, first at 0x{diffs[0]:x} "
+                     f"(emu {x[diffs[0]:diffs[0] + 8].hex(' ')} / real {y[diffs[0]:diffs[0] + 8].hex(' ')})")
+    return "; ".join(parts)
+
+
+def diff_pair(emu_path: str, real_path: str, ignore_ops: List[int]) -> dict:
+    a = [t for t in read_transactions(emu_path) if t.op not in ignore_ops]
+    b = [t for t in read_transactions(real_path) if t.op not in ignore_ops]
+    mode, pairs = _align(a, b)
+    ops: Dict[str, dict] = {}
+    details: List[str] = []
+    for ta, tb in pairs:
+        t = ta or tb
+        op = ops.setdefault(f"0x{t.op:04x}", {"n": 0, "missing_emu": 0, "missing_real": 0, "rc": 0, "params": 0,
+                                               "data": 0, "lat_emu": [], "lat_real": []})
+        op["n"] += 1
+        where = f"op=0x{t.op:04x} tid={t.tid}"
+        if ta is None:
+            op["missing_emu"] += 1
+            details.append(f"{where}: only in real capture")
+            continue
+        if tb is None:
+            op["missing_real"] += 1
+            details.append(f"{where}: only in emulator capture")
+            continue
+        if ta.rc != tb.rc:
+            op["rc"] += 1
+            details.append(f"{where}: response emu={ta.rc and hex(ta.rc)} real={tb.rc and hex(tb.rc)}")
+        if ta.resp_params != tb.resp_params:
+            op["params"] += 1
+            details.append(f"{where}: response params emu={ta.resp_params.hex()} real={tb.resp_params.hex()}")
+        d = _byte_diff(ta.data_in, tb.data_in)
+        if d:
+            op["data"] += 1
+            details.append(f"{where}: data {d}")
+        if ta.latency_us is not None:
+            op["lat_emu"].append(ta.latency_us)
+        if tb.latency_us is not None:
+            op["lat_real"].append(tb.latency_us)
+    return {"emu": emu_path, "real": real_path, "align": mode, "txns_emu": len(a), "txns_real": len(b),
+            "ops": ops, "details": details}
+
+
+def _pct(v: List[int], p: float) -> Optional[int]:
+    if not v:
+        return None
+    v = sorted(v)
+    return v[min(len(v) - 1, int(round(p / 100.0 * (len(v) - 1))))]
+
+
+def _pairs(emu: str, real: str) -> List[Tuple[str, str]]:
+    if os.path.isdir(emu) != os.path.isdir(real):
+        raise SystemExit("both inputs must be files or both directories")
+    if not os.path.isdir(emu):
+        return [(emu, real)]
+    a = {n for n in os.listdir(emu) if os.path.isfile(os.path.join(emu, n))}
+    b = {n for n in os.listdir(real) if os.path.isfile(os.path.join(real, n))}
+    for n in sorted(a ^ b):
+        print(f"warning: {n} has no counterpart, skipped", file=sys.stderr)
+    return [(os.path.join(emu, n), os.path.join(real, n)) for n in sorted(a & b)]
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Diff emulator PTP captures against real-camera captures.")
+    ap.add_argument("emu", help="Emulator capture file or directory")
+    ap.add_argument("real", help="Real-camera capture file or directory (same file names)")
+    ap.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 1, help="Parallel capture pairs")
+    ap.add_argument("--ignore-op", type=lambda s: int(s, 0), action="append", default=[],
+                    help="Op code to skip (repeatable), e.g. 0x1001 when serial numbers differ")
+    ap.add_argument("--max-mismatches", type=int, default=0)
+    ap.add_argument("--max-latency-regress", type=float, default=None, metavar="PCT")
+    ap.add_argument("--details", type=int, default=20, help="Mismatch lines to print per capture pair")
+    ap.add_argument("--json", default=None, help="Also write the summary as JSON")
+    args = ap.parse_args()
+
+    pairs = _pairs(args.emu, args.real)
+    if not pairs:
+        raise SystemExit("no capture pairs")
+    if args.jobs > 1 and len(pairs) > 1:
+        with ProcessPoolExecutor(max_workers=args.jobs) as ex:
+            results = list(ex.map(diff_pair, *zip(*pairs), [args.ignore_op] * len(pairs)))
+    else:
+        results = [diff_pair(e, r, args.ignore_op) for e, r in pairs]
+
+    total: Dict[str, dict] = {}
+    for res in results:
+        if res["details"]:
+            print(f"== {os.path.basename(res['emu'])} ({res['txns_emu']} vs {res['txns_real']} txns, by {res['align']})")
+            for line in res["details"][: args.details]:
+                print(f"  {line}")
+            if len(res["details"]) > args.details:
+                print(f"  ... {len(res['details']) - args.details} more")
+        for op, o in res["ops"].items():
+            t = total.setdefault(op, {k: (0 if not isinstance(v, list) else []) for k, v in o.items()})
+            for k, v in o.items():
+                t[k] += v
+
+    print(f"\nSummary over {len(results)} capture pair(s):")
+    print(f"  {'op':<8} {'n':>6} {'miss_e':>6} {'miss_r':>6} {'rc':>4} {'par':>4} {'data':>5}"
+          f" {'emu p50':>9} {'emu p99':>9} {'real p50':>9} {'real p99':>9} {'d p50':>8}")
+    mismatches = 0
+    regressions = []
+    summary = {}
+    for op in sorted(total):
+        t = total[op]
+        mm = t["missing_emu"] + t["missing_real"] + t["rc"] + t["params"] + t["data"]
+        mismatches += mm
+        e50, e99, r50, r99 = _pct(t["lat_emu"], 50), _pct(t["lat_emu"], 99), _pct(t["lat_real"], 50), _pct(t["lat_real"], 99)
+        d50 = None if e50 is None or r50 is None else e50 - r50
+        fmt = lambda v: "-" if v is None else str(v)
+        print(f"  {op:<8} {t['n']:>6} {t['missing_emu']:>6} {t['missing_real']:>6} {t['rc']:>4} {t['params']:>4}"
+              f" {t['data']:>5} {fmt(e50):>9} {fmt(e99):>9} {fmt(r50):>9} {fmt(r99):>9} {fmt(d50):>8}")
+        if args.max_latency_regress is not None and e50 is not None and r50:
+            if e50 > r50 * (1 + args.max_latency_regress / 100.0):
+                regressions.append(op)
+        summary[op] = {"n": t["n"], "mismatches": mm, "emu_p50_us": e50, "emu_p99_us": e99,
+                       "real_p50_us": r50, "real_p99_us": r99}
+
+    ok = mismatches <= args.max_mismatches and not regressions
+    print(f"\nMismatches: {mismatches} (allowed {args.max_mismatches})"
+          + (f"; latency regressions: {', '.join(regressions)}" if regressions else "")
+          + f" -> {'PASS' if ok else 'FAIL'}")
+    if args.json:
+        with open(args.json, "w", encoding="utf-8") as f:
+            json.dump({"pass": ok, "mismatches": mismatches, "latency_regressions": regressions, "ops": summary}, f,
+                      indent=2)
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
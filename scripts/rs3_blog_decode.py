@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+"""
+Decode the binary TCP log (CONFIG_RS3_LOG_BINARY) back into the usual text lines.
+
+Reads the console stream from the ESP (--esp-host, port 1234) or from a raw capture file
+(`nc <esp> 1234 > rs3.blog`), passes ordinary text (command replies, "[LOG] dropped N lines")
+through and turns every binary record into `[ms.us] text`, exactly what the text mode prints,
+so rs3_log_analyze.py works on the output. Needs the dictionary of the firmware build that is
+running (build/rs3_blog_dict.json, written by rs3_blog_dict.py during `idf.py build`).
+
+  python3 scripts/rs3_blog_decode.py --dict build/rs3_blog_dict.json --esp-host 192.168.1.91 | tee rs3.log
+  python3 scripts/rs3_blog_decode.py --dict build/rs3_blog_dict.json rs3.blog > rs3.log
+
+Record layout: see main/log_tcp.h.
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import re
+import socket
+import struct
+import sys
+from typing import BinaryIO, Callable, Dict, Iterator, List, Optional, Tuple
+
+SYNC = 0x1E
+_CONV_RE = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|j|z|t|L)?([diouxXcsfFeEgGp%])")
+_MASKS = {"hh": 0xFF, "h": 0xFFFF, "ll": (1 << 64) - 1, "j": (1 << 64) - 1}
+
+
+def _varint(b: bytes, i: int) -> Tuple[int, int]:
+    v = shift = 0
+    while True:
+        c = b[i]
+        i += 1
+        v |= (c & 0x7F) << shift
+        shift += 7
+        if c < 0x80:
+            return v, i
+
+
+def _zigzag(v: int) -> int:
+    return (v >> 1) ^ -(v & 1)
+
+
+class Format:
+    """One dictionary entry, split once into literal text and conversions."""
+
+    def __init__(self, fmt: str) -> None:
+        self.pieces: List[Tuple[str, Optional[Tuple[str, str, str, str, str]]]] = []
+        pos = 0
+        for m in _CONV_RE.finditer(fmt):
+            self.pieces.append((fmt[pos : m.start()], m.groups()))
+            pos = m.end()
+        self.pieces.append((fmt[pos:], None))
+
+    def render(self, args: bytes) -> str:
+        out: List[str] = []
+        i = 0
+
+        def next_int() -> int:
+            nonlocal i
+            v, i = _varint(args, i)
+            return _zigzag(v)
+
+        for text, conv in self.pieces:
+            out.append(text)
+            if conv is None:
+                continue
+            flags, width, prec, length, ch = conv
+            if ch == "%":
+                out.append("%")
+                continue
+            if width == "*":
+                width = str(next_int())
+            if prec == "*":
+                prec = str(next_int())
+            spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+            if ch == "s":
+                n, i = _varint(args, i)
+                out.append((spec + "s") % args[i : i + n].decode("utf-8", errors="replace"))
+                i += n
+            elif ch in "fFeEgG":
+                out.append((spec + ch) % struct.unpack_from("<d", args, i)[0])
+                i += 8
+            elif ch == "p":
+                out.append("0x%x" % (next_int() & 0xFFFFFFFF))
+            elif ch == "c":
+                out.append((spec + "c") % chr(next_int() & 0xFF))
+            else:
+                v = next_int()
+                if ch in "uoxX" and v < 0:  # an int argument printed with an unsigned conversion
+                    v &= _MASKS.get(length or "", 0xFFFFFFFF)
+                out.append((spec + ("d" if ch in "iu" else ch)) % v)
+        return "".join(out)
+
+
+class Decoder:
+    def __init__(self, formats: Dict[int, str]) -> None:
+        self.formats = {k: Format(v) for k, v in formats.items()}
+        self.raw = formats
+        self.last_us: Optional[int] = None
+        self.unknown = 0
+
+    def _stamp(self, us: int) -> str:
+        return f"[{us // 1000:06d}.{us % 1000:03d}] "
+
+    def record(self, body: bytes) -> str:
+        rid = struct.unpack_from("<I", body, 0)[0]
+        t, i = _varint(body, 4)
+        if t & 1:
+            self.last_us = t >> 1
+        elif self.last_us is not None:
+            self.last_us += t >> 1
+        stamp = self._stamp(self.last_us) if self.last_us is not None else "[??????.???] "
+        fmt = self.formats.get(rid)
+        if fmt is None:
+            self.unknown += 1
+            return f"{stamp}[BLOG] unknown id 0x{rid:08x} ({len(body) - i} arg bytes; dictionary of another build?)\r\n"
+        try:
+            return stamp + fmt.render(body[i:])
+        except (IndexError, struct.error, ValueError, TypeError) as e:
+            return f"{stamp}[BLOG] bad args for {self.raw[rid]!r}: {e}\r\n"
+
+    def feed(self, chunks: Iterator[bytes], write: Callable[[str], None]) -> None:
+        buf = bytearray()
+        for chunk in chunks:
+            buf += chunk
+            i = 0
+            n = len(buf)
+            while i < n:
+                j = buf.find(SYNC, i)
+                if j < 0:
+                    write(buf[i:].decode("utf-8", errors="replace"))
+                    i = n
+                    break
+                if j > i:
+                    write(buf[i:j].decode("utf-8", errors="replace"))
+                if j + 2 > n or j + 2 + buf[j + 1] > n:
+                    i = j
+                    break  # incomplete record: wait for more bytes
+                write(self.record(bytes(buf[j + 2 : j + 2 + buf[j + 1]])))
+                i = j + 2 + buf[j + 1]
+            del buf[:i]
+
+
+def load_dict(path: str) -> Dict[int, str]:
+    with open(path, "r", encoding="utf-8") as f:
+        d = json.load(f)
+    return {int(k, 16): v["fmt"] for k, v in d["formats"].items()}
+
+
+def _read_file(f: BinaryIO) -> Iterator[bytes]:
+    while True:
+        chunk = f.read(65536)
+        if not chunk:
+            return
+        yield chunk
+
+
+def _read_sock(sock: socket.socket) -> Iterator[bytes]:
+    while True:
+        chunk = sock.recv(65536)
+        if not chunk:
+            return
+        yield chunk
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Decode the ESP binary TCP log into text.")
+    ap.add_argument("--dict", required=True, help="rs3_blog_dict.json of the running firmware build")
+    ap.add_argument("--esp-host", default=None, help="Connect to the ESP console instead of reading a file")
+    ap.add_argument("--port", type=int, default=1234)
+    ap.add_argument("capture", nargs="?", default="-", help="Raw capture file ('-' = stdin)")
+    args = ap.parse_args()
+
+    dec = Decoder(load_dict(args.dict))
+    out = sys.stdout
+
+    def write(s: str) -> None:
+        out.write(s.replace("\r\n", "\n"))
+
+    try:
+        if args.esp_host:
+            sock = socket.create_connection((args.esp_host, args.port), timeout=5)
+            sock.settimeout(None)
+            dec.feed(_read_sock(sock), lambda s: (write(s), out.flush()))
+        elif args.capture == "-":
+            dec.feed(_read_file(sys.stdin.buffer), write)
+        else:
+            with open(args.capture, "rb") as f:
+                dec.feed(_read_file(f), write)
+    except KeyboardInterrupt:
+        pass
+    if dec.unknown:
+        print(f"rs3_blog_decode: {dec.unknown} record(s) with unknown ids", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
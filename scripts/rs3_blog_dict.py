@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+Build the binary-log dictionary (CONFIG_RS3_LOG_BINARY) from the firmware sources.
+
+A binary log record carries id = file_id << 16 | line of the RS3_LOGx()/rs3_tcp_logf()/RS3_BLOG()
+call. file_id is the first 4 hex digits of the MD5 of the source name exactly as listed in
+main/CMakeLists.txt (which passes it to the compiler as RS3_BLOG_FILE_ID), so this script must be
+given the same names, from the same directory. main/CMakeLists.txt runs it on every build:
+
+  python3 scripts/rs3_blog_dict.py --out build/rs3_blog_dict.json main.c usb_ptp_proxy.c ...   (cwd: main/)
+
+Output: {"version": 1, "formats": {"<id hex>": {"fmt": "...", "src": "file:line"}}}.
+Format strings are the concatenated literals, with <inttypes.h> PRI* macros expanded.
+"""
+
+from __future__ import annotations
+
+import argparse
+import hashlib
+import json
+import re
+import sys
+from typing import Dict, List, Optional, Tuple
+
+# rs3_tcp_logf(fmt, ...), RS3_BLOG(fmt, ...) and the tagged RS3_LOGE..V[_RL](TAG, fmt, ...).
+_CALL_RE = re.compile(r"\b(?:rs3_tcp_logf|RS3_BLOG)\s*\(|\bRS3_LOG[EWIDV](?:_RL)?\s*\(\s*\w+\s*,")
+_PRI_RE = re.compile(r"PRI([diouxX])(?:LEAST|FAST)?(8|16|32|64|MAX|PTR)")
+_ESCAPES = {"n": "\n", "r": "\r", "t": "\t", "\\": "\\", '"': '"', "'": "'", "0": "\0", "a": "\a",
+            "b": "\b", "f": "\f", "v": "\v", "?": "?"}
+
+
+def file_id(name: str) -> int:
+    return int(hashlib.md5(name.encode()).hexdigest()[:4], 16)
+
+
+def strip_comments(text: str) -> str:
+    """Blank out comments (newlines kept, so line numbers stay valid); strings are left alone."""
+    out: List[str] = []
+    i, n = 0, len(text)
+    while i < n:
+        c = text[i]
+        if c in "\"'":
+            j = i + 1
+            while j < n and text[j] != c:
+                j += 2 if text[j] == "\\" else 1
+            out.append(text[i : j + 1])
+            i = j + 1
+        elif text.startswith("//", i):
+            j = text.find("\n", i)
+            j = n if j < 0 else j
+            out.append(" " * (j - i))
+            i = j
+        elif text.startswith("/*", i):
+            j = text.find("*/", i + 2)
+            j = n if j < 0 else j + 2
+            out.append(re.sub(r"[^\n]", " ", text[i:j]))
+            i = j
+        else:
+            out.append(c)
+            i += 1
+    return "".join(out)
+
+
+def _c_string(text: str, i: int) -> Tuple[str, int]:
+    """Decode the C string literal starting at text[i] == '"'; return (value, index after it)."""
+    out: List[str] = []
+    i += 1
+    while text[i] != '"':
+        c = text[i]
+        if c == "\\":
+            e = text[i + 1]
+            if e == "x":
+                m = re.match(r"[0-9A-Fa-f]+", text[i + 2 :])
+                out.append(chr(int(m.group(0), 16)))
+                i += 2 + len(m.group(0))
+                continue
+            out.append(_ESCAPES.get(e, e))
+            i += 2
+            continue
+        out.append(c)
+        i += 1
+    return "".join(out), i + 1
+
+
+def format_at(text: str, i: int) -> Optional[str]:
+    """Concatenated format literal (plus PRI* macros) starting at text[i], or None if not a literal."""
+    parts: List[str] = []
+    n = len(text)
+    while i < n:
+        while i < n and text[i].isspace():
+            i += 1
+        if i < n and text[i] == '"':
+            s, i = _c_string(text, i)
+            parts.append(s)
+            continue
+        m = _PRI_RE.match(text, i)
+        if m:
+            parts.append(("ll" if m.group(2) == "64" else "") + m.group(1))
+            i = m.end()
+            continue
+        break
+    return "".join(parts) if parts else None
+
+
+def scan(name: str) -> List[Tuple[int, str]]:
+    with open(name, "r", encoding="utf-8", errors="replace") as f:
+        text = strip_comments(f.read())
+    sites = []
+    for m in _CALL_RE.finditer(text):
+        fmt = format_at(text, m.end())
+        if fmt is None:
+            continue  # the prototype/definition, or a non-literal format (text path only)
+        sites.append((text.count("\n", 0, m.start()) + 1, fmt))
+    return sites
+
+
+def build(sources: List[str]) -> Dict[str, Dict[str, str]]:
+    formats: Dict[str, Dict[str, str]] = {}
+    owners: Dict[int, str] = {}
+    for name in sources:
+        fid = file_id(name)
+        if fid in owners and owners[fid] != name:
+            raise SystemExit(f"file id 0x{fid:04x} collision: {owners[fid]} and {name} (rename one)")
+        owners[fid] = name
+        for line, fmt in scan(name):
+            key = f"{(fid << 16) | line:08x}"
+            if key in formats and formats[key]["fmt"] != fmt:
+                raise SystemExit(f"{name}:{line}: two log calls on one line")
+            formats[key] = {"fmt": fmt, "src": f"{name}:{line}"}
+    return formats
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Extract the binary-log format dictionary from sources.")
+    ap.add_argument("--out", required=True)
+    ap.add_argument("sources", nargs="+", help="Source names as listed in main/CMakeLists.txt")
+    args = ap.parse_args()
+    formats = build(args.sources)
+    with open(args.out, "w", encoding="utf-8") as f:
+        json.dump({"version": 1, "formats": formats}, f, indent=1, sort_keys=True)
+    print(f"rs3_blog_dict: {len(formats)} formats from {len(args.sources)} files -> {args.out}", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,299 @@
+#!/usr/bin/env python3
+"""
+Synchronize the ESP's esp_timer clock with this PC's wall clock (NTP-style, over the RPC port).
+
+Each exchange is four timestamps: t1 PC send, t2 ESP receive, t3 ESP reply (the `time` RPC
+method), t4 PC receive. Per exchange
+
+  offset = ((t1 - t2) + (t4 - t3)) / 2      PC wall clock minus esp_timer
+  delay  = (t4 - t1) - (t3 - t2)            network round trip without ESP processing
+
+and the true offset lies within offset +/- delay / 2. Wi-Fi delay varies by milliseconds, so only
+the fastest exchanges are used (queueing only ever adds delay): offset and drift come from a line
+fitted through the fastest exchange of each time window. The reported accuracy is the worst-case bound of the
+fastest exchange (half its delay) next to the spread of the fitted samples and a check against
+fresh exchanges after the fit.
+
+  python3 scripts/rs3_clock_sync.py --esp-host 192.168.1.91 --duration 30 --install --json clock.json
+  python3 scripts/rs3_clock_sync.py annotate rs3.log > rs3_wall.log
+  python3 scripts/rs3_clock_sync.py annotate rs3.log --model clock.json > rs3_wall.log
+
+--install sends the result with `time.set`; the ESP logs it as a "[TIME] sync ..." line, which
+`annotate` uses to put a PC wall-clock time (microseconds) in front of every "[ms.us]" console
+line of that boot. rs3_ptp_tap.py --clock-sync uses the same fit for its frame timestamps.
+"""
+
+from __future__ import annotations
+
+import argparse
+import datetime
+import json
+import re
+import statistics
+import sys
+import time
+from dataclasses import asdict, dataclass
+from typing import Dict, Iterable, List, Optional, Sequence, Tuple
+
+from rs3_rpc import DEFAULT_PORT, RpcClient, RpcError
+
+# (t1, t2, t3, t4) in microseconds: PC epoch, esp_timer, esp_timer, PC epoch
+Exchange = Tuple[int, int, int, int]
+
+
+@dataclass
+class ClockModel:
+    mono_us: int          # esp_timer time of the anchor
+    wall_us: int          # PC wall clock (epoch us) at mono_us
+    drift_ppb: int = 0    # PC clock rate minus ESP clock rate
+    err_us: int = 0       # worst-case bound (half the fastest round trip)
+
+    def to_wall(self, mono_us: int) -> int:
+        dt = mono_us - self.mono_us
+        return self.wall_us + dt + dt * self.drift_ppb // 1_000_000_000
+
+    def to_json(self) -> str:
+        return json.dumps(asdict(self))
+
+    @classmethod
+    def from_json(cls, text: str) -> "ClockModel":
+        d = json.loads(text)
+        return cls(int(d["mono_us"]), int(d["wall_us"]), int(d.get("drift_ppb", 0)), int(d.get("err_us", 0)))
+
+
+@dataclass
+class SyncReport:
+    samples: int          # exchanges made
+    used: int             # lowest-delay exchanges the fit used
+    span_s: float         # time covered by the exchanges
+    delay_min_us: int
+    delay_p50_us: int
+    fit_rms_us: float     # spread of the used samples around the fit
+    drift_measured: bool = False
+    check_us: Optional[int] = None   # after the fit: |error| against fresh exchanges
+
+
+def now_us() -> int:
+    return time.time_ns() // 1000
+
+
+def exchange(rpc: RpcClient) -> Exchange:
+    t1 = now_us()
+    r = rpc.call("time")
+    t4 = now_us()
+    return t1, int(r["rx_us"]), int(r["tx_us"]), t4
+
+
+def offset_delay(x: Exchange) -> Tuple[float, int]:
+    t1, t2, t3, t4 = x
+    return ((t1 - t2) + (t4 - t3)) / 2.0, (t4 - t1) - (t3 - t2)
+
+
+def collect(rpc: RpcClient, samples: int, duration_s: float) -> List[Exchange]:
+    gap = duration_s / max(1, samples - 1) if duration_s > 0 else 0.0
+    out = []
+    t0 = time.monotonic()
+    for i in range(samples):
+        if gap:
+            delay = t0 + i * gap - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+        out.append(exchange(rpc))
+    return out
+
+
+def _near_min(rows: Sequence[Tuple[float, int, int]]) -> List[Tuple[float, int, int]]:
+    """Rows whose delay is within 10 % (+50 us) of the fastest: the ones that did not queue."""
+    dmin = min(r[1] for r in rows)
+    return [r for r in rows if r[1] <= dmin * 1.1 + 50]
+
+
+def fit(xs: Sequence[Exchange], windows: int = 8, min_span_s: float = 5.0) -> Tuple[ClockModel, SyncReport]:
+    """Offset (and drift, given min_span_s of data) from the exchanges that did not queue.
+
+    Over a short run the offset is the median of the near-fastest exchanges. Over a longer one the
+    run is cut into windows, the fastest exchange of each is kept (NTP's clock filter) and a line
+    through those gives offset and drift; windows whose best is still slow are dropped.
+    """
+    rows = [offset_delay(x) + (x[2],) for x in xs]   # (offset, delay, t3), in time order
+    delays = sorted(r[1] for r in rows)
+    span_s = (rows[-1][2] - rows[0][2]) / 1e6
+    anchor = rows[-1][2]
+    slope = 0.0
+
+    picks: List[Tuple[float, int, int]] = []
+    if span_s >= min_span_s and len(rows) >= 2 * windows:
+        size = -(-len(rows) // windows)
+        best = [min(rows[i : i + size], key=lambda r: r[1]) for i in range(0, len(rows), size)]
+        picks = [r for r in best if r[1] <= 2 * delays[0] + 200]
+    if len(picks) >= 3:
+        t3s = [r[2] for r in picks]
+        offs = [r[0] for r in picks]
+        mx = statistics.fmean(t3s)
+        my = statistics.fmean(offs)
+        sxx = sum((t - mx) ** 2 for t in t3s)
+        if sxx > 0:
+            slope = sum((t - mx) * (o - my) for t, o in zip(t3s, offs)) / sxx
+        off_at_anchor = my + slope * (anchor - mx)
+    else:
+        picks = _near_min(rows)
+        off_at_anchor = statistics.median(r[0] for r in picks)
+
+    resid = [r[0] - (off_at_anchor + slope * (r[2] - anchor)) for r in picks]
+    model = ClockModel(
+        mono_us=anchor,
+        wall_us=int(round(anchor + off_at_anchor)),
+        drift_ppb=int(round(slope * 1e9)),
+        err_us=(delays[0] + 1) // 2,
+    )
+    report = SyncReport(
+        samples=len(xs),
+        used=len(picks),
+        span_s=span_s,
+        delay_min_us=delays[0],
+        delay_p50_us=delays[len(delays) // 2],
+        fit_rms_us=(statistics.fmean(r * r for r in resid)) ** 0.5,
+        drift_measured=slope != 0.0,
+    )
+    return model, report
+
+
+def check(rpc: RpcClient, model: ClockModel, samples: int = 16) -> int:
+    """|model - measured offset| on fresh exchanges (median over the near-fastest ones)."""
+    rows = [offset_delay(x) + (x[2],) for x in collect(rpc, samples, 0.0)]
+    return int(round(statistics.median(abs(o - (model.to_wall(t3) - t3)) for o, _, t3 in _near_min(rows))))
+
+
+def sync(host: str, port: int = DEFAULT_PORT, samples: int = 64, duration_s: float = 0.0,
+         install: bool = False) -> Tuple[ClockModel, SyncReport]:
+    with RpcClient(host, port) as rpc:
+        for _ in range(3):
+            exchange(rpc)   # warm up: ARP, Wi-Fi power save, TCP window
+        model, report = fit(collect(rpc, samples, duration_s))
+        report.check_us = check(rpc, model)
+        if install:
+            rpc.call("time.set", asdict(model))
+    return model, report
+
+
+def describe(model: ClockModel, report: SyncReport) -> str:
+    wall = datetime.datetime.fromtimestamp(model.wall_us / 1e6).strftime("%Y-%m-%d %H:%M:%S.%f")
+    lines = [
+        f"esp_timer {model.mono_us} us = {wall} (PC wall clock)",
+        f"drift {model.drift_ppb / 1000:+.3f} ppm" if report.drift_measured
+        else "drift not measured (use --duration >= 5)",
+        f"round trip min {report.delay_min_us} us, p50 {report.delay_p50_us} us over {report.samples} exchanges "
+        f"({report.span_s:.1f} s); fit uses {report.used} that did not queue",
+        f"accuracy: bound +/-{model.err_us} us, fit spread {report.fit_rms_us:.0f} us rms"
+        + (f", check {report.check_us} us" if report.check_us is not None else ""),
+    ]
+    return "\n".join(lines)
+
+
+# ---- annotate a console log ----
+
+_STAMP_RE = re.compile(r"\[(\d+)\.(\d{3})\] ")
+_ANCHOR_RE = re.compile(r"\[TIME\] sync mono_us=(-?\d+) wall_us=(-?\d+) err_us=(\d+) drift_ppb=(-?\d+)")
+
+
+def _anchor(m: "re.Match[str]") -> ClockModel:
+    return ClockModel(int(m.group(1)), int(m.group(2)), drift_ppb=int(m.group(4)), err_us=int(m.group(3)))
+
+
+def _wall_text(wall_us: int) -> str:
+    return datetime.datetime.fromtimestamp(wall_us / 1e6).strftime("%Y-%m-%d %H:%M:%S.%f")
+
+
+def _boots(lines: Iterable[str]) -> Iterable[List[Tuple[str, Optional[int]]]]:
+    """Split into boots (stamps going backwards) as [(line, esp_timer us or None)]."""
+    boot: List[Tuple[str, Optional[int]]] = []
+    last = -1
+    for line in lines:
+        m = _STAMP_RE.search(line)
+        t = int(m.group(1)) * 1000 + int(m.group(2)) if m else None
+        if t is not None and t < last and boot:
+            yield boot
+            boot = []
+        if t is not None:
+            last = t
+        boot.append((line, t))
+    if boot:
+        yield boot
+
+
+def annotate(lines: Iterable[str], out, model: Optional[ClockModel] = None) -> Dict[str, int]:
+    """Prefix stamped lines with the PC wall time. Without a model each boot uses its own [TIME]
+    anchors (the latest one before the line; the first one for lines before it)."""
+    stats = {"lines": 0, "annotated": 0, "boots": 0, "boots_unsynced": 0}
+    for boot in _boots(lines):
+        stats["boots"] += 1
+        anchors = []
+        if model is None:
+            for line, _ in boot:
+                m = _ANCHOR_RE.search(line)
+                if m:
+                    anchors.append(_anchor(m))
+            if not anchors:
+                stats["boots_unsynced"] += 1
+        cur = model or (anchors[0] if anchors else None)
+        for line, t in boot:
+            stats["lines"] += 1
+            if model is None:
+                m = _ANCHOR_RE.search(line)
+                if m:
+                    cur = _anchor(m)
+            if t is None or cur is None:
+                out.write(line)
+                continue
+            out.write(f"{_wall_text(cur.to_wall(t))} {line}")
+            stats["annotated"] += 1
+    return stats
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Sync the ESP clock with the PC over RPC, or annotate a console log.")
+    sub = ap.add_subparsers(dest="cmd")
+    an = sub.add_parser("annotate", help="Prefix console log lines with synchronized PC wall-clock time")
+    an.add_argument("log", help="Console log (`nc <esp> 1234 > rs3.log`); - for stdin")
+    an.add_argument("--model", default=None, help="Model JSON from --json instead of the log's [TIME] lines")
+
+    ap.add_argument("--esp-host")
+    ap.add_argument("--port", type=int, default=DEFAULT_PORT)
+    ap.add_argument("--samples", type=int, default=64, help="Exchanges (default 64)")
+    ap.add_argument("--duration", type=float, default=0.0,
+                    help="Spread the exchanges over this many seconds; >= 5 also measures drift")
+    ap.add_argument("--install", action="store_true", help="Send the result to the ESP (logged as [TIME] sync)")
+    ap.add_argument("--json", default=None, help="Write the model (mono_us, wall_us, drift_ppb, err_us)")
+    args = ap.parse_args()
+
+    if args.cmd == "annotate":
+        model = ClockModel.from_json(open(args.model, encoding="utf-8").read()) if args.model else None
+        f = sys.stdin if args.log == "-" else open(args.log, "r", encoding="utf-8", errors="replace")
+        try:
+            st = annotate(f, sys.stdout, model)
+        finally:
+            if f is not sys.stdin:
+                f.close()
+        print(f"annotated {st['annotated']}/{st['lines']} lines, {st['boots']} boot(s)"
+              + (f", {st['boots_unsynced']} without a [TIME] sync line" if st["boots_unsynced"] else ""),
+              file=sys.stderr)
+        return 0
+
+    if not args.esp_host:
+        ap.error("--esp-host required")
+    if args.samples < 4:
+        ap.error("--samples must be at least 4")
+    try:
+        model, report = sync(args.esp_host, args.port, args.samples, args.duration, args.install)
+    except RpcError as e:
+        print(f"rs3_clock_sync: {e}", file=sys.stderr)
+        return 1
+    print(describe(model, report))
+    if args.json:
+        with open(args.json, "w", encoding="utf-8") as f:
+            f.write(model.to_json() + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,356 @@
+#!/usr/bin/env python3
+"""
+RS3 traffic load generator for the raw proxy protocol.
+
+Plays the ESP side of the proxy link: listens like ptp_proxy_server (default port 1235), waits for
+proxy clients (rs3_ptp_raw_proxy.py) to connect, then sends RAW_OUT frames and waits for the
+RAW_IN... RAW_DONE reply of each one, exactly like the firmware does for one RS3 bulk OUT.
+
+Every connected client is one session; sessions run in parallel, each replaying the command
+stream in a loop at --rate exchanges/s (open loop: exchange k is due at t0 + k/rate and its
+latency is measured from that due time, so a stalled proxy shows up in the tail instead of
+silently lowering the offered load) or back-to-back with --rate 0.
+
+Command streams:
+  - built-in (default): std_len OpenSession, GetDeviceInfo, 0x9201, 0x9202, then a loop of
+    0x9209 polls and 0x9207 full-press start/stop (COMMAND + DATA stage), like RS3 does.
+  - --replay FILE: RAW_OUT packets from a rs3_ptp_raw_proxy.py log ("RS3->ESP RAW_OUT bytes=N"
+    followed by its hexdump), or a file with one hex packet per line.
+
+With --spawn, the tool starts the proxies itself ({host}, {port} and {i} are substituted), e.g.
+  python3 scripts/rs3_load_gen.py --sessions 4 --duration 10 \
+      --spawn "python3 scripts/rs3_ptp_raw_proxy.py --esp-host {host} --esp-port {port} \
+               --virtual-camera --translate --bench --log /tmp/proxy{i}.log"
+
+Reports exchanges/s, latency p50/p95/p99/p99.9/max (overall and per op) and error counts every
+second and at exit.
+"""
+
+from __future__ import annotations
+
+import argparse
+import collections
+import re
+import shlex
+import socket
+import subprocess
+import sys
+import threading
+import time
+from typing import Dict, List, Optional, Tuple
+
+from rs3_ptp_common import (
+    PTP_CT_COMMAND,
+    PTP_CT_DATA,
+    T_HEARTBEAT,
+    T_RAW_DONE,
+    T_RAW_IN,
+    T_RAW_OUT,
+    U32_LE,
+    FrameReader,
+    build_ptp_container,
+    exchange_op_label,
+    send_frame,
+)
+from rs3_ptp_raw_proxy import percentile
+
+PTP_OC_GET_DEVICE_INFO = 0x1001
+PTP_OC_OPEN_SESSION = 0x1002
+PTP_OC_SONY_9201 = 0x9201
+PTP_OC_SONY_9202 = 0x9202
+PTP_OC_SONY_9207 = 0x9207
+PTP_OC_SONY_9209 = 0x9209
+
+
+def std_cmd(code: int, tid: int, *params: int) -> bytes:
+    return build_ptp_container(PTP_CT_COMMAND, code, tid, b"".join(U32_LE.pack(p) for p in params))
+
+
+def std_data(code: int, tid: int, data: bytes) -> bytes:
+    return build_ptp_container(PTP_CT_DATA, code, tid, data)
+
+
+def builtin_stream(loops: int = 8) -> Tuple[List[bytes], List[bytes]]:
+    """(setup, loop): setup is sent once per session, loop is replayed for the rest of the run."""
+    tid = 0
+    setup = []
+    for code, params in ((PTP_OC_OPEN_SESSION, (1,)), (PTP_OC_GET_DEVICE_INFO, ()),
+                         (PTP_OC_SONY_9201, ()), (PTP_OC_SONY_9202, ())):
+        setup.append(std_cmd(code, tid, *params))
+        tid += 1
+    loop = []
+    for i in range(loops):
+        loop.append(std_cmd(PTP_OC_SONY_9209, tid))
+        tid += 1
+        if i % 4 == 3:
+            # Full press (p0=0xD2C8): DATA 0x02 starts recording, 0x01 stops it.
+            loop.append(std_cmd(PTP_OC_SONY_9207, tid, 0xD2C8))
+            loop.append(std_data(PTP_OC_SONY_9207, tid, b"\x02" if i % 8 == 3 else b"\x01"))
+            tid += 1
+    return setup, loop
+
+
+_RAW_OUT_RE = re.compile(r"RS3->ESP RAW_OUT bytes=(\d+)")
+_HEX_ROW_RE = re.compile(r"^\s+[0-9a-fA-F]{4}: ((?:[0-9a-fA-F]{2} ?)+)$")
+_HEX_LINE_RE = re.compile(r"^(?:[0-9a-fA-F]{2}\s*)+$")
+
+
+def load_replay(path: str) -> List[bytes]:
+    """RAW_OUT packets from a raw proxy log, or one hex packet per line."""
+    packets: List[bytes] = []
+    cur: Optional[bytearray] = None
+    want = 0
+    with open(path, "r", encoding="utf-8", errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            m = _RAW_OUT_RE.search(line)
+            if m:
+                cur, want = bytearray(), int(m.group(1))
+                if want == 0:
+                    packets.append(b"")
+                    cur = None
+                continue
+            if cur is not None:
+                row = _HEX_ROW_RE.match(line)
+                if row:
+                    cur += bytes.fromhex(row.group(1))
+                    if len(cur) >= want:
+                        packets.append(bytes(cur[:want]))
+                        cur = None
+                    continue
+                cur = None  # truncated dump
+            if _HEX_LINE_RE.match(line.strip() or "x"):
+                packets.append(bytes.fromhex(line))
+    return packets
+
+
+class Stats:
+    def __init__(self) -> None:
+        self.lock = threading.Lock()
+        self.latency_us: List[int] = []
+        self.service_us: List[int] = []
+        self.per_op: Dict[str, List[int]] = collections.defaultdict(list)
+        self.errors: Dict[str, int] = collections.Counter()
+        self.in_bytes = 0
+        self.window = 0
+        self.window_lat: List[int] = []
+
+    def add(self, op: str, latency_us: int, service_us: int, in_bytes: int) -> None:
+        with self.lock:
+            self.latency_us.append(latency_us)
+            self.service_us.append(service_us)
+            self.per_op[op].append(latency_us)
+            self.in_bytes += in_bytes
+            self.window += 1
+            self.window_lat.append(latency_us)
+
+    def error(self, kind: str) -> None:
+        with self.lock:
+            self.errors[kind] += 1
+
+    def take_window(self) -> Tuple[int, List[int]]:
+        with self.lock:
+            n, lat = self.window, self.window_lat
+            self.window, self.window_lat = 0, []
+        return n, lat
+
+    def errors_str(self) -> str:
+        return " ".join(f"{k}={v}" for k, v in sorted(self.errors.items())) or "none"
+
+    def report(self, elapsed_s: float) -> str:
+        with self.lock:
+            lat = sorted(self.latency_us)
+            svc = sorted(self.service_us)
+            per_op = {k: sorted(v) for k, v in self.per_op.items()}
+        n = len(lat)
+        lines = [
+            f"{n} exchanges in {elapsed_s:.1f}s = {n / max(elapsed_s, 1e-9):.1f} ex/s, "
+            f"RAW_IN {self.in_bytes / max(elapsed_s, 1e-9) / 1024:.1f} KiB/s, errors: {self.errors_str()}",
+            f"  {'op':<14} {'n':>7} {'p50':>8} {'p95':>8} {'p99':>8} {'p99.9':>8} {'max':>8}   (us)",
+        ]
+
+        def row(name: str, v: List[int]) -> str:
+            return (f"  {name:<14} {len(v):>7} {percentile(v, 50):>8} {percentile(v, 95):>8} "
+                    f"{percentile(v, 99):>8} {percentile(v, 99.9):>8} {(v[-1] if v else 0):>8}")
+
+        lines.append(row("latency", lat))
+        lines.append(row("service", svc))
+        for op in sorted(per_op):
+            lines.append(row(op, per_op[op]))
+        return "\n".join(lines)
+
+
+def drain_late_reply(sock: socket.socket, reader: FrameReader, wait_s: float) -> bool:
+    """
+    Discard the rest of a timed-out exchange's reply, up to its RAW_DONE. Otherwise the late
+    RAW_IN/RAW_DONE would be taken as the reply to the next RAW_OUT and every later sample would
+    be shifted by one exchange. False if RAW_DONE did not arrive within wait_s.
+    """
+    deadline = time.perf_counter() + wait_s
+    try:
+        while True:
+            left = deadline - time.perf_counter()
+            if left <= 0:
+                return False
+            sock.settimeout(left)
+            ftype, _ = reader.read()
+            if ftype == T_RAW_DONE:
+                return True
+    except socket.timeout:
+        return False
+
+
+def run_session(idx: int, sock: socket.socket, setup: List[bytes], loop: List[bytes], args,
+                stats: Stats, stop: threading.Event) -> None:
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    sock.settimeout(args.timeout_ms / 1000.0)
+    period = (1.0 / args.rate) if args.rate > 0 else 0.0
+    reader = FrameReader(sock, bufsize=64 * 1024)
+    t0 = time.perf_counter()
+    k = 0
+    i_loop = 0
+    try:
+        while not stop.is_set() and (args.count <= 0 or k < args.count):
+            if k < len(setup):
+                pkt = setup[k]
+            else:
+                pkt = loop[i_loop % len(loop)]
+                i_loop += 1
+            due = t0 + k * period
+            now = time.perf_counter()
+            if due > now:
+                time.sleep(due - now)
+            elif period == 0:
+                due = now
+            k += 1
+
+            t_send = time.perf_counter()
+            send_frame(sock, T_RAW_OUT, pkt)
+            in_bytes = 0
+            while True:
+                try:
+                    ftype, payload = reader.read()
+                except socket.timeout:
+                    # The ESP gives up on a frame after its recv timeout; so do we.
+                    stats.error("timeout")
+                    if not drain_late_reply(sock, reader, args.late_ms / 1000.0):
+                        # Replies can no longer be matched to requests: end this session.
+                        stats.error("desync")
+                        print(f"session {idx}: no RAW_DONE for a timed-out exchange, stopping", file=sys.stderr,
+                              flush=True)
+                        return
+                    sock.settimeout(args.timeout_ms / 1000.0)
+                    break
+                if ftype == T_RAW_IN:
+                    in_bytes += len(payload)
+                elif ftype == T_RAW_DONE:
+                    t_done = time.perf_counter()
+                    stats.add(exchange_op_label(pkt), int((t_done - due) * 1e6),
+                              int((t_done - t_send) * 1e6), in_bytes)
+                    break
+                elif ftype != T_HEARTBEAT:
+                    stats.error(f"frame_0x{ftype:02x}")
+    except (EOFError, OSError) as e:
+        if not stop.is_set():
+            stats.error("disconnect")
+            print(f"session {idx}: {e}", file=sys.stderr, flush=True)
+    finally:
+        try:
+            sock.close()
+        except OSError:
+            pass
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Load generator for the RS3 raw proxy protocol (plays the ESP side).")
+    ap.add_argument("--listen", default="127.0.0.1", help="Address to listen on (default 127.0.0.1)")
+    ap.add_argument("--port", type=int, default=1235)
+    ap.add_argument("--sessions", type=int, default=1, help="Number of proxy connections to drive in parallel")
+    ap.add_argument("--rate", type=float, default=0.0,
+                    help="Exchanges/s per session, open loop (default 0 = back-to-back)")
+    ap.add_argument("--duration", type=float, default=10.0, help="Seconds to run (default 10)")
+    ap.add_argument("--count", type=int, default=0, help="Stop each session after N exchanges (default: duration)")
+    ap.add_argument("--timeout-ms", type=int, default=1500,
+                    help="Reply timeout per frame, like the ESP's recv timeout (default 1500)")
+    ap.add_argument("--late-ms", type=int, default=5000,
+                    help="After a timeout, wait this long for the exchange's late RAW_DONE (its reply is "
+                         "discarded) before giving up on the session (default 5000)")
+    ap.add_argument("--replay", default=None, help="Raw proxy log or hex file to replay (default: built-in stream)")
+    ap.add_argument("--spawn", default=None, help="Command to start one proxy per session ({host} {port} {i})")
+    ap.add_argument("--accept-timeout", type=float, default=15.0, help="Seconds to wait for all sessions to connect")
+    args = ap.parse_args()
+
+    if args.replay:
+        loop = load_replay(args.replay)
+        setup: List[bytes] = []
+        if not loop:
+            print(f"No RAW_OUT packets found in {args.replay}", file=sys.stderr)
+            return 2
+        print(f"Replaying {len(loop)} RAW_OUT packets from {args.replay}")
+    else:
+        setup, loop = builtin_stream()
+
+    ls = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    ls.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    ls.bind((args.listen, args.port))
+    ls.listen(args.sessions)
+    ls.settimeout(args.accept_timeout)
+    print(f"Listening on {args.listen}:{args.port}, waiting for {args.sessions} session(s)...", flush=True)
+
+    procs: List[subprocess.Popen] = []
+    if args.spawn:
+        host = "127.0.0.1" if args.listen in ("0.0.0.0", "") else args.listen
+        for i in range(args.sessions):
+            cmd = args.spawn.format(host=host, port=args.port, i=i)
+            procs.append(subprocess.Popen(shlex.split(cmd), stdout=subprocess.DEVNULL))
+
+    stats = Stats()
+    stop = threading.Event()
+    threads: List[threading.Thread] = []
+    try:
+        for i in range(args.sessions):
+            try:
+                conn, peer = ls.accept()
+            except socket.timeout:
+                print(f"Only {i}/{args.sessions} sessions connected", file=sys.stderr)
+                return 1
+            print(f"session {i}: {peer[0]}:{peer[1]}", flush=True)
+            th = threading.Thread(target=run_session, args=(i, conn, setup, loop, args, stats, stop), daemon=True)
+            threads.append(th)
+        t0 = time.perf_counter()
+        for th in threads:
+            th.start()
+
+        deadline = t0 + args.duration
+        while any(th.is_alive() for th in threads):
+            now = time.perf_counter()
+            if args.count <= 0 and now >= deadline:
+                break
+            time.sleep(min(1.0, max(0.0, deadline - now)) if args.count <= 0 else 1.0)
+            n, lat = stats.take_window()
+            lat.sort()
+            print(f"[{time.perf_counter() - t0:6.1f}s] {n} ex p50={percentile(lat, 50)}us "
+                  f"p99={percentile(lat, 99)}us max={(lat[-1] if lat else 0)}us errors: {stats.errors_str()}",
+                  flush=True)
+        stop.set()
+        elapsed = time.perf_counter() - t0
+        for th in threads:
+            th.join(timeout=args.timeout_ms / 1000.0 + 1.0)
+        print(stats.report(elapsed))
+    except KeyboardInterrupt:
+        stop.set()
+    finally:
+        ls.close()
+        for p in procs:
+            p.terminate()
+        for p in procs:
+            try:
+                p.wait(timeout=5)
+            except subprocess.TimeoutExpired:
+                p.kill()
+
+    return 1 if stats.errors else 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,304 @@
+#!/usr/bin/env python3
+"""
+Offline latency analyzer for ESP TCP console logs (`nc <esp> 1234 > rs3.log`).
+
+Every firmware line starts with `[%06u.%03u]` = milliseconds.microseconds since boot
+(rs3_tcp_vlogf). The log is read as a stream, one line at a time, so multi-hour captures are fine
+(`-` reads stdin: `nc 192.168.1.91 1234 | tee rs3.log | python3 scripts/rs3_log_analyze.py -`).
+
+Timelines rebuilt from the tags:
+  transactions  [PTP-STD] cmd ... op= tid=  -> [PTP-STD] -> RESP ... tid=     (std emulator)
+                [RAW] <- OUT bytes=         -> [RAW] proxy: DONE              (raw proxy, ESP side)
+                [PTP CMD] ... op= tid=      (emulator: counted, no end marker in the log)
+  REC events    [PTP CMD] ... op=0x9207     -> [PTP] 0x9207 DATA: ... payload=02|01
+                -> [REC] start|stop -> BT shutter -> [BT] shutter: click ok (or a shutter failure)
+
+Reported: latency distribution per op and per REC stage (min/p50/p90/p99/max), the slowest
+outliers with their log line numbers, `[LOG] dropped N lines` markers (the firmware log queue
+overflowed) and `[LOG] <tag>: suppressed N similar` markers (rate-limited lines): timelines
+spanning either are flagged and left out of the stats. Also silent gaps longer than --gap-ms,
+and restarts (timestamps going backwards).
+
+  python3 scripts/rs3_log_analyze.py rs3.log --outliers 10 --json /tmp/rs3_latency.json
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import re
+import sys
+from typing import Dict, Iterable, List, Optional, Tuple
+
+_STAMP_RE = re.compile(r"\[(\d+)\.(\d{3})\] (.*)")
+_PTP_CMD_RE = re.compile(r"\[PTP CMD\] .*op=0x([0-9A-Fa-f]{4}) tid=(\d+)")
+_STD_CMD_RE = re.compile(r"\[PTP-STD\] cmd .*op=0x([0-9A-Fa-f]{4}) tid=(\d+)")
+_STD_RESP_RE = re.compile(r"\[PTP-STD\] -> RESP code=0x([0-9A-Fa-f]{4}) tid=(\d+)")
+_RAW_OUT_RE = re.compile(r"\[RAW\] <- OUT bytes=(\d+)")
+_RAW_DONE_RE = re.compile(r"\[RAW\] proxy: DONE|\[RAW\] proxy recv failed|\[RAW\] no proxy peer")
+_DATA_9207_RE = re.compile(r"\[PTP\] 0x9207 DATA: .*payload=([0-9A-Fa-f]{2})")
+_REC_RE = re.compile(r"\[REC\] (start|stop) -> BT shutter")
+_BT_OK_RE = re.compile(r"\[BT\] shutter: click ok")
+_BT_FAIL_RE = re.compile(r"\[BT\] shutter: (.*(?:fail|timeout|not possible).*)")
+_DROP_RE = re.compile(r"\[LOG\] dropped (\d+) lines")
+_SUPPRESSED_RE = re.compile(r"\[LOG\] (\w+): suppressed (\d+) similar")
+
+REC_STAGES = ("cmd->data", "data->rec", "rec->bt_ok", "total")
+
+
+def read_lines(paths: List[str]) -> Iterable[Tuple[str, int, int, str]]:
+    """(file, line number, t_us, text) for every stamped line."""
+    for path in paths:
+        f = sys.stdin if path == "-" else open(path, "r", encoding="utf-8", errors="replace")
+        try:
+            for n, line in enumerate(f, 1):
+                m = _STAMP_RE.search(line)
+                if m:
+                    yield path, n, int(m.group(1)) * 1000 + int(m.group(2)), m.group(3).rstrip()
+        finally:
+            if f is not sys.stdin:
+                f.close()
+
+
+def pct(v: List[float], p: float) -> float:
+    s = sorted(v)
+    return s[min(len(s) - 1, int(round(p / 100.0 * (len(s) - 1))))]
+
+
+class Series:
+    """Latency samples (ms) with where they came from, for outliers."""
+
+    def __init__(self) -> None:
+        self.values: List[float] = []
+        self.where: List[str] = []
+
+    def add(self, ms: float, where: str) -> None:
+        self.values.append(ms)
+        self.where.append(where)
+
+    def summary(self) -> Dict[str, float]:
+        v = self.values
+        return {"n": len(v), "min": min(v), "p50": pct(v, 50), "p90": pct(v, 90), "p99": pct(v, 99), "max": max(v)}
+
+    def outliers(self, k: int, factor: float) -> List[Tuple[float, str]]:
+        if not self.values:
+            return []
+        limit = max(pct(self.values, 99), factor * pct(self.values, 50))
+        out = [(v, w) for v, w in zip(self.values, self.where) if v > limit]
+        return sorted(out, reverse=True)[:k]
+
+
+class Analyzer:
+    def __init__(self, gap_ms: float) -> None:
+        self.gap_ms = gap_ms
+        self.ops: Dict[str, Series] = {}
+        self.op_counts: Dict[str, int] = {}
+        self.rec: Dict[str, Series] = {s: Series() for s in REC_STAGES}
+        self.rec_events = {"ok": 0, "failed": 0, "incomplete": 0, "tainted": 0}
+        self.rec_failures: List[str] = []
+        self.drops: List[Tuple[str, int]] = []
+        self.suppressed: List[Tuple[str, str, int]] = []  # (where, tag, lines)
+        self.gaps: List[Tuple[str, float]] = []
+        self.restarts: List[str] = []
+        self.tainted_txns = 0
+        self._reset()
+
+    def _reset(self) -> None:
+        self._txn: Optional[Tuple[str, int, str, int]] = None  # (op, t_us, where, drop epoch)
+        self._rec: Optional[Dict] = None
+        self._pending_9207: Optional[Tuple[int, str]] = None
+        self._last_t: Optional[int] = None
+        self._drop_epoch = 0
+
+    def _close_rec(self, outcome: str) -> None:
+        r = self._rec
+        self._rec = None
+        if r is None:
+            return
+        if r["epoch"] != self._drop_epoch:
+            self.rec_events["tainted"] += 1
+            return
+        self.rec_events[outcome] += 1
+        if outcome != "ok":
+            return
+        t = r["t"]
+        w = r["where"]
+        if "cmd" in t and "data" in t:
+            self.rec["cmd->data"].add((t["data"] - t["cmd"]) / 1000.0, w)
+        if "data" in t:
+            self.rec["data->rec"].add((t["rec"] - t["data"]) / 1000.0, w)
+        self.rec["rec->bt_ok"].add((t["bt"] - t["rec"]) / 1000.0, w)
+        self.rec["total"].add((t["bt"] - t.get("cmd", t.get("data", t["rec"]))) / 1000.0, w)
+
+    def _start_txn(self, op: str, t: int, where: str, has_end: bool) -> None:
+        self.op_counts[op] = self.op_counts.get(op, 0) + 1
+        self._txn = (op, t, where, self._drop_epoch) if has_end else None
+
+    def _end_txn(self, t: int) -> None:
+        if self._txn is None:
+            return
+        op, t0, where, epoch = self._txn
+        self._txn = None
+        if epoch != self._drop_epoch:
+            self.tainted_txns += 1
+            return
+        self.ops.setdefault(op, Series()).add((t - t0) / 1000.0, where)
+
+    def feed(self, path: str, n: int, t: int, text: str) -> None:
+        where = f"{path}:{n}"
+        if self._last_t is not None:
+            if t + 1_000_000 < self._last_t:
+                self.restarts.append(where)
+                self._close_rec("incomplete")
+                self._reset()
+            elif t - self._last_t > self.gap_ms * 1000:
+                self.gaps.append((where, (t - self._last_t) / 1000.0))
+        self._last_t = t
+
+        m = _DROP_RE.search(text)
+        if m:
+            self.drops.append((where, int(m.group(1))))
+            self._drop_epoch += 1
+            return
+        m = _SUPPRESSED_RE.search(text)
+        if m:
+            # The missing lines may include the open transaction's end marker: a later one would
+            # otherwise close it with another exchange's time.
+            self.suppressed.append((where, m.group(1), int(m.group(2))))
+            self._drop_epoch += 1
+            if self._txn is not None:
+                self._txn = None
+                self.tainted_txns += 1
+            return
+        m = _PTP_CMD_RE.search(text)
+        if m:
+            op = f"0x{m.group(1).lower()}"
+            self._start_txn(op, t, where, has_end=False)
+            if op == "0x9207":
+                self._pending_9207 = (t, where)
+            return
+        m = _STD_CMD_RE.search(text)
+        if m:
+            self._start_txn(f"0x{m.group(1).lower()}", t, where, has_end=True)
+            return
+        if _STD_RESP_RE.search(text) or _RAW_DONE_RE.search(text):
+            self._end_txn(t)
+            return
+        if _RAW_OUT_RE.search(text):
+            if self._txn is None:  # a DATA stage OUT belongs to the running exchange
+                self._start_txn("raw", t, where, has_end=True)
+            return
+        m = _DATA_9207_RE.search(text)
+        if m:
+            self._close_rec("incomplete")
+            rec = {"t": {"data": t}, "where": where, "epoch": self._drop_epoch}
+            if self._pending_9207 is not None:
+                rec["t"]["cmd"], rec["where"] = self._pending_9207
+            self._pending_9207 = None
+            self._rec = rec
+            return
+        m = _REC_RE.search(text)
+        if m:
+            if self._rec is None or "rec" in self._rec["t"]:
+                self._close_rec("incomplete")
+                self._rec = {"t": {}, "where": where, "epoch": self._drop_epoch}
+            self._rec["t"]["rec"] = t
+            self._rec["kind"] = m.group(1)
+            return
+        if _BT_OK_RE.search(text):
+            if self._rec is not None and "rec" in self._rec["t"]:
+                self._rec["t"]["bt"] = t
+                self._close_rec("ok")
+            return
+        m = _BT_FAIL_RE.search(text)
+        if m and self._rec is not None and "rec" in self._rec["t"]:
+            self.rec_failures.append(f"{where}: {m.group(1)}")
+            self._close_rec("failed")
+
+    def finish(self) -> None:
+        self._close_rec("incomplete")
+
+
+def _fmt_row(name: str, s: Dict[str, float]) -> str:
+    return (f"  {name:<12} {s['n']:>7} {s['min']:>9.1f} {s['p50']:>9.1f} {s['p90']:>9.1f} {s['p99']:>9.1f}"
+            f" {s['max']:>9.1f}")
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Latency timelines from ESP TCP console logs.")
+    ap.add_argument("logs", nargs="+", help="Log files in time order ('-' = stdin)")
+    ap.add_argument("--gap-ms", type=float, default=5000.0, help="Report silences longer than this")
+    ap.add_argument("--outliers", type=int, default=5, help="Slowest samples to list per op/stage")
+    ap.add_argument("--outlier-factor", type=float, default=3.0,
+                    help="Outlier = above p99 and above this many times the median")
+    ap.add_argument("--json", default=None, help="Also write the summary as JSON")
+    args = ap.parse_args()
+
+    a = Analyzer(args.gap_ms)
+    lines = 0
+    for path, n, t, text in read_lines(args.logs):
+        lines += 1
+        a.feed(path, n, t, text)
+    a.finish()
+
+    hdr = f"  {'':<12} {'n':>7} {'min ms':>9} {'p50':>9} {'p90':>9} {'p99':>9} {'max':>9}"
+    print(f"{lines} stamped lines")
+    print("\nTransactions (command -> response/DONE on the ESP):")
+    print(hdr)
+    out = {"lines": lines, "ops": {}, "rec": {}, "op_counts": a.op_counts}
+    for op in sorted(a.ops):
+        s = a.ops[op].summary()
+        out["ops"][op] = s
+        print(_fmt_row(op, s))
+    counted = {op: c for op, c in a.op_counts.items() if op not in a.ops}
+    if counted:
+        print("  commands without an end marker: " + ", ".join(f"{op}={c}" for op, c in sorted(counted.items())))
+    if a.tainted_txns:
+        print(f"  {a.tainted_txns} transaction(s) span a log drop or suppression, not counted")
+
+    ev = a.rec_events
+    print(f"\nREC events: ok={ev['ok']} failed={ev['failed']} incomplete={ev['incomplete']} tainted={ev['tainted']}")
+    if any(a.rec[s].values for s in REC_STAGES):
+        print(hdr)
+        for stage in REC_STAGES:
+            if a.rec[stage].values:
+                s = a.rec[stage].summary()
+                out["rec"][stage] = s
+                print(_fmt_row(stage, s))
+    for f in a.rec_failures[: args.outliers]:
+        print(f"  failed: {f}")
+
+    print("\nOutliers:")
+    any_outlier = False
+    for name, series in [*sorted(a.ops.items()), *[(f"rec {s}", a.rec[s]) for s in REC_STAGES]]:
+        for v, where in series.outliers(args.outliers, args.outlier_factor):
+            any_outlier = True
+            print(f"  {name:<16} {v:9.1f} ms  {where}")
+    if not any_outlier:
+        print("  none")
+
+    print(f"\nLog drops: {len(a.drops)} marker(s), {sum(n for _, n in a.drops)} line(s) lost")
+    for where, n in a.drops[: args.outliers]:
+        print(f"  {where}: {n} line(s)")
+    if a.suppressed:
+        print(f"Rate-limited: {len(a.suppressed)} marker(s), {sum(n for _, _, n in a.suppressed)} line(s) suppressed")
+        for where, tag, n in a.suppressed[: args.outliers]:
+            print(f"  {where}: {tag} {n} line(s)")
+    if a.gaps:
+        print(f"Silent gaps > {args.gap_ms:.0f} ms: {len(a.gaps)}")
+        for where, ms in sorted(a.gaps, key=lambda g: -g[1])[: args.outliers]:
+            print(f"  {where}: {ms:.0f} ms")
+    if a.restarts:
+        print(f"Restarts (time went backwards): {', '.join(a.restarts[: args.outliers])}")
+
+    out.update({"rec_events": ev, "drops": [{"at": w, "lines": n} for w, n in a.drops],
+                "suppressed": [{"at": w, "tag": tag, "lines": n} for w, tag, n in a.suppressed],
+                "gaps": [{"at": w, "ms": ms} for w, ms in a.gaps], "restarts": a.restarts})
+    if args.json:
+        with open(args.json, "w", encoding="utf-8") as f:
+            json.dump(out, f, indent=2)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
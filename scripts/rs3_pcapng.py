@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+pcapng writer for proxied RS3 <-> ESP USB/PTP traffic.
+
+Each RS3 bulk transfer becomes a usbmon URB pair (LINKTYPE_USB_LINUX_MMAPPED, 220):
+  RAW_OUT -> submit with data + complete on bulk OUT 0x02
+  RAW_IN  -> submit + complete with data on bulk IN 0x81 (empty RAW_IN = ZLP)
+RAW_DONE/RAW_TS/HEARTBEAT are proxy bookkeeping, not USB traffic, and are not written.
+
+Timestamps have microsecond resolution (if_tsresol=6). Wireshark shows the URBs with its USB
+dissector; the PTP container is the URB payload (filter e.g. usb.endpoint_address == 0x02).
+
+  w = PcapngWriter("/tmp/rs3.pcapng")
+  w.usb_out(payload, ts_us)   # ts_us: microseconds since the Unix epoch
+  w.usb_in(payload, ts_us)
+  w.close()
+"""
+
+from __future__ import annotations
+
+import struct
+import time
+from typing import BinaryIO, Optional
+
+LINKTYPE_USB_LINUX_MMAPPED = 220
+
+EP_BULK_OUT = 0x02
+EP_BULK_IN = 0x81
+
+_SHB_MAGIC = 0x1A2B3C4D
+_BT_SHB = 0x0A0D0D0A
+_BT_IDB = 0x00000001
+_BT_EPB = 0x00000006
+
+# struct usbmon_packet (mmapped variant, 64 bytes):
+# id, type, xfer_type, epnum, devnum, busnum, flag_setup, flag_data, ts_sec, ts_usec,
+# status, length, len_cap, setup[8], interval, start_frame, xfer_flags, ndesc
+_USBMON = struct.Struct("<QBBBBHbbqiiII8siiII")
+_EPB_HDR = struct.Struct("<IIIII")  # interface id, ts high, ts low, captured len, original len
+_XFER_BULK = 3
+_EINPROGRESS = -115
+_NO_SETUP = ord("-")
+_NO_DATA_IN = ord("<")
+_NO_DATA_OUT = ord(">")
+
+
+def _option(code: int, value: bytes) -> bytes:
+    pad = (-len(value)) % 4
+    return struct.pack("<HH", code, len(value)) + value + b"\x00" * pad
+
+
+def _block(btype: int, body: bytes) -> bytes:
+    total = 12 + len(body)
+    return struct.pack("<II", btype, total) + body + struct.pack("<I", total)
+
+
+def now_epoch_us() -> int:
+    return time.time_ns() // 1000
+
+
+class PcapngWriter:
+    """Writes one section with one USB interface. Not thread-safe: call from one thread."""
+
+    def __init__(self, path: str, app: str = "rs3 ptp proxy", busnum: int = 1, devnum: int = 1) -> None:
+        self._f: BinaryIO = open(path, "wb")
+        self._busnum = busnum
+        self._devnum = devnum
+        self._urb_id = 0
+        self.packets = 0
+        shb_opts = _option(4, app.encode()) + _option(0, b"")  # shb_userappl, opt_endofopt
+        self._f.write(_block(_BT_SHB, struct.pack("<IHHq", _SHB_MAGIC, 1, 0, -1) + shb_opts))
+        idb_opts = (_option(2, b"rs3-usb")            # if_name
+                    + _option(9, bytes([6]))          # if_tsresol: 10^-6 s
+                    + _option(0, b""))
+        self._f.write(_block(_BT_IDB, struct.pack("<HHI", LINKTYPE_USB_LINUX_MMAPPED, 0, 0) + idb_opts))
+
+    def _urb(self, ts_us: int, urb_id: int, ev: str, ep: int, status: int, length: int, data: bytes) -> None:
+        if data:
+            flag_data = 0
+        else:
+            flag_data = _NO_DATA_IN if ep & 0x80 else _NO_DATA_OUT
+        hdr = _USBMON.pack(urb_id, ord(ev), _XFER_BULK, ep, self._devnum, self._busnum, _NO_SETUP, flag_data,
+                           ts_us // 1_000_000, ts_us % 1_000_000, status, length, len(data), b"\x00" * 8,
+                           0, 0, 0, 0)
+        pkt = hdr + data
+        pad = (-len(pkt)) % 4
+        epb = _EPB_HDR.pack(0, (ts_us >> 32) & 0xFFFFFFFF, ts_us & 0xFFFFFFFF, len(pkt), len(pkt))
+        self._f.write(_block(_BT_EPB, epb + pkt + b"\x00" * pad))
+        self.packets += 1
+
+    def usb_out(self, data: bytes, ts_us: Optional[int] = None) -> None:
+        """Host -> device transfer on bulk OUT (what the RS3 sent)."""
+        ts = now_epoch_us() if ts_us is None else ts_us
+        self._urb_id += 1
+        data = bytes(data)
+        self._urb(ts, self._urb_id, "S", EP_BULK_OUT, _EINPROGRESS, len(data), data)
+        self._urb(ts, self._urb_id, "C", EP_BULK_OUT, 0, len(data), b"")
+
+    def usb_in(self, data: bytes, ts_us: Optional[int] = None) -> None:
+        """Device -> host transfer on bulk IN (what the RS3 received); empty = ZLP."""
+        ts = now_epoch_us() if ts_us is None else ts_us
+        self._urb_id += 1
+        data = bytes(data)
+        self._urb(ts, self._urb_id, "S", EP_BULK_IN, _EINPROGRESS, 512, b"")
+        self._urb(ts, self._urb_id, "C", EP_BULK_IN, 0, len(data), data)
+
+    def flush(self) -> None:
+        self._f.flush()
+
+    def close(self) -> None:
+        self._f.close()
@@ -0,0 +1,269 @@
+#!/usr/bin/env python3
+"""
+Shared framing and PTP container helpers for the RS3 proxy scripts.
+
+ESP <-> PC framing (ptp_proxy_server):
+  uint32_be length (type + payload)
+  uint8     type
+  payload...
+
+Receive side: FrameReader reads whatever the socket has into one preallocated buffer
+(recv_into) and hands out payloads as memoryviews into it, so a burst of small frames costs
+one syscall and no per-frame allocation. recv_exact()/recv_frame() are the simple one-shot
+variants (a short read is completed with recv_into a preallocated bytearray, not concatenation).
+
+PTP containers use precompiled struct.Struct objects. RS3 containers come in five layouts
+(RS3_LAYOUTS); parse_rs3_container()/build_rs3_container() are the only implementation.
+
+Run bench_ptp_framing.py for frames/s per core of these helpers against the old per-script code.
+"""
+
+from __future__ import annotations
+
+import socket
+import struct
+from typing import Tuple, Union
+
+Buffer = Union[bytes, bytearray, memoryview]
+
+# Legacy proxy (rs3_ptp_proxy.py): standard PTP containers.
+T_CMD_STD = 0x01
+T_CONT_STD = 0x02
+# Raw proxy (rs3_ptp_raw_proxy.py), see main/usb_ptp_proxy.c / main/ptp_proxy_server.h.
+T_RAW_OUT = 0x10
+T_RAW_IN = 0x11
+T_RAW_DONE = 0x12
+T_RAW_TS = 0x13
+T_HEARTBEAT = 0x14
+
+PTP_CLASS, PTP_SUBCLASS, PTP_PROTOCOL = 0x06, 0x01, 0x01
+PTP_CT_COMMAND, PTP_CT_DATA, PTP_CT_RESPONSE, PTP_CT_EVENT = 1, 2, 3, 4
+
+PTP_RC_OK = 0x2001
+PTP_RC_SESSION_ALREADY_OPEN = 0x201E
+
+PTP_OC_GET_DEVICE_INFO = 0x1001
+PTP_OC_OPEN_SESSION = 0x1002
+PTP_OC_CLOSE_SESSION = 0x1003
+
+FRAME_HDR = struct.Struct(">IB")     # length, type
+PTP_HDR = struct.Struct("<IHHI")     # len, type, code, tid
+ALT_HDR = struct.Struct("<IHIH")     # len, code, tid, type (alt_len layout)
+DJI_HDR = struct.Struct("<HHI")      # type, code, tid after 1..3 zero pad bytes
+U32_LE = struct.Struct("<I")
+
+# Layout name -> header size. dji_padN: N/8 zero bytes, then type16 code16 tid32, no length.
+RS3_LAYOUTS = {"dji_pad8": 9, "dji_pad16": 10, "dji_pad24": 11, "std_len": 12, "alt_len": 12}
+
+
+def hexdump(buf: Buffer, prefix: str = "") -> str:
+    mv = memoryview(buf)
+    return "\n".join(f"{prefix}{off:04x}: {mv[off : off + 16].hex(' ')}" for off in range(0, len(mv), 16))
+
+
+def head8(b: Buffer) -> str:
+    return memoryview(b)[:8].hex(" ")
+
+
+# --- ESP <-> PC framing ---------------------------------------------------------------------------
+
+def recv_exact_into(sock: socket.socket, view: memoryview) -> None:
+    off = 0
+    n = len(view)
+    while off < n:
+        got = sock.recv_into(view[off:], n - off)
+        if not got:
+            raise EOFError("socket closed")
+        off += got
+
+
+def recv_exact(sock: socket.socket, n: int) -> bytes:
+    data = sock.recv(n)
+    if len(data) == n:
+        return data  # common case: no reassembly at all
+    if not data:
+        raise EOFError("socket closed")
+    buf = bytearray(n)
+    buf[: len(data)] = data
+    recv_exact_into(sock, memoryview(buf)[len(data) :])
+    return bytes(buf)
+
+
+def recv_frame(sock: socket.socket) -> Tuple[int, bytes]:
+    length, ftype = FRAME_HDR.unpack(recv_exact(sock, FRAME_HDR.size))
+    if length == 0:
+        raise ValueError("invalid frame length=0")
+    return ftype, recv_exact(sock, length - 1) if length > 1 else b""
+
+
+class FrameReader:
+    """
+    Buffered frame reader for one socket.
+
+    read() returns (type, payload) where payload is a memoryview into the reader's buffer:
+    it stays valid only until the next read(). Copy it (bytes(payload)) to keep it longer.
+    Socket timeouts propagate; buffered bytes are kept, so read() may simply be retried.
+    """
+
+    def __init__(self, sock: socket.socket, bufsize: int = 256 * 1024) -> None:
+        self.sock = sock
+        self._buf = bytearray(bufsize)
+        self._view = memoryview(self._buf)
+        self._start = 0
+        self._end = 0
+
+    def _fill(self, need: int) -> None:
+        while self._end - self._start < need:
+            if self._start + need > len(self._buf):
+                # Move the partial frame to the front (grow if a single frame exceeds the buffer).
+                pending = self._end - self._start
+                if need > len(self._buf):
+                    buf = bytearray(max(need, 2 * len(self._buf)))
+                    buf[:pending] = self._view[self._start : self._end]
+                    self._buf, self._view = buf, memoryview(buf)
+                else:
+                    self._view[:pending] = bytes(self._view[self._start : self._end])  # may overlap
+                self._start, self._end = 0, pending
+            got = self.sock.recv_into(self._view[self._end :])
+            if not got:
+                raise EOFError("socket closed")
+            self._end += got
+
+    def read(self) -> Tuple[int, memoryview]:
+        if self._start == self._end:
+            self._start = self._end = 0
+        self._fill(FRAME_HDR.size)
+        length, ftype = FRAME_HDR.unpack_from(self._view, self._start)
+        if length == 0:
+            raise ValueError("invalid frame length=0")
+        self._fill(4 + length)
+        p0 = self._start + FRAME_HDR.size
+        self._start += 4 + length
+        return ftype, self._view[p0 : self._start]
+
+
+def frame_bytes(ftype: int, payload: Buffer) -> bytes:
+    return FRAME_HDR.pack(1 + len(payload), ftype) + payload
+
+
+def frame_into(out: bytearray, ftype: int, payload: Buffer) -> None:
+    """Append one frame to out (for coalescing several frames into a single write)."""
+    out += FRAME_HDR.pack(1 + len(payload), ftype)
+    out += payload
+
+
+def send_frame(sock, ftype: int, payload: Buffer) -> None:
+    """sock: a socket or anything with sendall() (e.g. rs3_ptp_raw_proxy.EspLink)."""
+    hdr = FRAME_HDR.pack(1 + len(payload), ftype)
+    if len(payload) >= 4096 and isinstance(sock, socket.socket):
+        # Scatter-gather: no header+payload concatenation copy for big payloads.
+        sent = sock.sendmsg([hdr, payload])
+        total = len(hdr) + len(payload)
+        if sent < total:
+            rest = memoryview(payload)[max(0, sent - len(hdr)) :]
+            if sent < len(hdr):
+                sock.sendall(hdr[sent:])
+            sock.sendall(rest)
+        return
+    sock.sendall(hdr + payload)
+
+
+# --- PTP containers -------------------------------------------------------------------------------
+
+def parse_ptp_container_header(b: Buffer) -> Tuple[int, int, int, int]:
+    """(len, type, code, tid) of a standard PTP container."""
+    if len(b) < PTP_HDR.size:
+        raise ValueError("short PTP container")
+    return PTP_HDR.unpack_from(b, 0)
+
+
+def build_ptp_container(ctype: int, code: int, tid: int, payload: Buffer = b"") -> bytes:
+    return PTP_HDR.pack(PTP_HDR.size + len(payload), ctype, code & 0xFFFF, tid & 0xFFFFFFFF) + payload
+
+
+def build_std_command_container(code: int, tid: int, params_bytes: Buffer) -> bytes:
+    return build_ptp_container(PTP_CT_COMMAND, code, tid, params_bytes)
+
+
+def build_std_data_container(code: int, tid: int, data_bytes: Buffer) -> bytes:
+    return build_ptp_container(PTP_CT_DATA, code, tid, data_bytes)
+
+
+def read_ptp_container(ep_in, timeout_ms: int = 5000) -> bytes:
+    """Read one PTP container from a bulk IN endpoint, one max-packet read at a time."""
+    first = ep_in.read(ep_in.wMaxPacketSize, timeout=timeout_ms).tobytes()
+    if len(first) < PTP_HDR.size:
+        raise RuntimeError(f"short read ({len(first)} bytes)")
+    total_len = U32_LE.unpack_from(first, 0)[0]
+    if total_len < PTP_HDR.size:
+        raise RuntimeError(f"invalid PTP length={total_len}")
+    buf = bytearray(first)
+    while len(buf) < total_len:
+        buf += ep_in.read(ep_in.wMaxPacketSize, timeout=timeout_ms).tobytes()
+    return bytes(buf[:total_len])
+
+
+def parse_rs3_container(payload: Buffer, *, align_tail_u32: bool) -> Tuple[str, int, int, int, Buffer]:
+    """
+    Parse an RS3/DJI container in any of the RS3_LAYOUTS and return (layout, type, code, tid, tail).
+
+      dji_pad24: 00 00 00 [type16][code16][tid32][tail...]
+      dji_pad16: 00 00    [type16][code16][tid32][tail...]
+      dji_pad8 : 00       [type16][code16][tid32][tail...]
+      std_len  : [len32][type16][code16][tid32][tail...]
+      alt_len  : [len32][code16][tid32][type16][tail...]
+
+    align_tail_u32=True truncates the tail to whole uint32 params (COMMAND; RS3 sometimes appends
+    a stray 0x01 after the tid), False returns it raw (DATA payload). The tail has the input's type:
+    a memoryview in gives a memoryview slice out (no copy).
+    """
+    b = payload
+    n = len(b)
+    if n >= 9 and b[0] == 0:
+        pad = 3 if (n >= 11 and b[1] == 0 and b[2] == 0) else 2 if (n >= 10 and b[1] == 0) else 1
+        ctype, code, tid = DJI_HDR.unpack_from(b, pad)
+        layout, off = ("dji_pad8", "dji_pad16", "dji_pad24")[pad - 1], pad + 8
+    elif n >= 12:
+        _, t_std, code, tid = PTP_HDR.unpack_from(b, 0)
+        if 1 <= t_std <= 4:
+            layout, ctype, off = "std_len", t_std, 12
+        else:
+            _, code, tid, ctype = ALT_HDR.unpack_from(b, 0)
+            if not 1 <= ctype <= 4:
+                raise ValueError("unknown RS3 container layout")
+            layout, off = "alt_len", 12
+    else:
+        raise ValueError("unknown RS3 container layout")
+    end = off + ((n - off) & ~3) if align_tail_u32 else n
+    return layout, ctype, code, tid, b[off:end]
+
+
+def build_rs3_container(layout: str, ctype: int, code: int, tid: int, payload: Buffer) -> bytes:
+    """
+    Build an RS3-side container in the given layout (the one the RS3 used for the command).
+    DJI layouts carry no length; a RESPONSE without params is zero-padded to 12 bytes.
+    """
+    ctype &= 0xFFFF
+    code &= 0xFFFF
+    tid &= 0xFFFFFFFF
+    if layout in ("dji_pad8", "dji_pad16", "dji_pad24"):
+        out = bytes(RS3_LAYOUTS[layout] - 8) + DJI_HDR.pack(ctype, code, tid) + payload
+        if ctype == PTP_CT_RESPONSE and len(payload) == 0 and len(out) < 12:
+            out += bytes(12 - len(out))
+        return out
+    if layout == "alt_len":
+        return ALT_HDR.pack(12 + len(payload), code, tid, ctype) + payload
+    return PTP_HDR.pack(12 + len(payload), ctype, code, tid) + payload
+
+
+def exchange_op_label(payload: Buffer) -> str:
+    """Short per-op key for stats: '0x1002' for COMMAND, 'data:0x9207' for DATA stage."""
+    try:
+        _, ctype, code, _, _ = parse_rs3_container(payload, align_tail_u32=False)
+    except ValueError:
+        return "raw"
+    if ctype == PTP_CT_COMMAND:
+        return f"0x{code:04x}"
+    if ctype == PTP_CT_DATA:
+        return f"data:0x{code:04x}"
+    return f"type{ctype}:0x{code:04x}"
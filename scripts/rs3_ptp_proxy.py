@@ -7,7 +7,7 @@ RS3 (USB host) -> ESP32-S3 (USB device) -> TCP (binary frames) -> this script ->
 This script connects to the ESP32 "PTP proxy" TCP port (separate from logs/OTA),
 receives standard PTP command containers, forwards them to a real camera over USB
 (bulk OUT), reads back PTP containers from the camera (bulk IN), and returns them
-to the ESP which relays to RS3.
+to the ESP which relays to RS3. --virtual-camera answers from virtual_ptp_camera.py instead.
 
 Dependencies (macOS):
   brew install libusb
@@ -23,78 +23,31 @@ from __future__ import annotations
 
 import argparse
 import socket
-import struct
 import sys
 import time
 from dataclasses import dataclass
-from typing import Optional, Tuple
-
-import usb.core
-import usb.util
-
-
-# Proxy framing: uint32_be length (type+payload), uint8 type, payload...
-T_CMD_STD = 0x01
-T_CONT_STD = 0x02
-
-
-# PTP constants
-PTP_CLASS, PTP_SUBCLASS, PTP_PROTOCOL = 0x06, 0x01, 0x01
-PTP_CT_COMMAND, PTP_CT_DATA, PTP_CT_RESPONSE = 1, 2, 3
-
-
-def hexdump(buf: bytes, prefix: str = "") -> str:
-    lines = []
-    for off in range(0, len(buf), 16):
-        chunk = buf[off : off + 16]
-        lines.append(f"{prefix}{off:04x}: " + " ".join(f"{b:02x}" for b in chunk))
-    return "\n".join(lines)
-
-
-def recv_exact(sock: socket.socket, n: int) -> bytes:
-    buf = bytearray()
-    while len(buf) < n:
-        chunk = sock.recv(n - len(buf))
-        if not chunk:
-            raise EOFError("socket closed")
-        buf += chunk
-    return bytes(buf)
-
-
-def recv_frame(sock: socket.socket) -> Tuple[int, bytes]:
-    hdr = recv_exact(sock, 5)
-    length = struct.unpack(">I", hdr[:4])[0]
-    ftype = hdr[4]
-    if length == 0:
-        raise ValueError("invalid frame length=0")
-    payload_len = length - 1
-    payload = recv_exact(sock, payload_len) if payload_len else b""
-    return ftype, payload
-
-
-def send_frame(sock: socket.socket, ftype: int, payload: bytes) -> None:
-    length = 1 + len(payload)
-    sock.sendall(struct.pack(">IB", length, ftype) + payload)
-
-
-def parse_ptp_hdr(container: bytes) -> Tuple[int, int, int, int]:
-    if len(container) < 12:
-        raise ValueError("short container")
-    length, ctype, code, tid = struct.unpack_from("<IHHI", container, 0)
-    return length, ctype, code, tid
-
-
-def read_container(ep_in, timeout_ms: int = 5000) -> bytes:
-    first = ep_in.read(ep_in.wMaxPacketSize, timeout=timeout_ms).tobytes()
-    if len(first) < 12:
-        raise RuntimeError(f"short read ({len(first)} bytes)")
-    total_len = struct.unpack_from("<I", first, 0)[0]
-    if total_len < 12:
-        raise RuntimeError(f"invalid container length={total_len}")
-    buf = bytearray(first)
-    while len(buf) < total_len:
-        buf += ep_in.read(ep_in.wMaxPacketSize, timeout=timeout_ms).tobytes()
-    return bytes(buf[:total_len])
+from typing import Optional
+
+try:
+    import usb.core
+    import usb.util
+except ImportError:  # --virtual-camera works without pyusb
+    usb = None
+
+from rs3_ptp_common import (
+    PTP_CLASS,
+    PTP_CT_RESPONSE,
+    PTP_PROTOCOL,
+    PTP_SUBCLASS,
+    T_CMD_STD,
+    T_CONT_STD,
+    hexdump,
+    parse_ptp_container_header,
+    read_ptp_container,
+    recv_frame,
+    send_frame,
+)
+from virtual_ptp_camera import add_virtual_camera_args, virtual_camera_from_args
 
 
 @dataclass
@@ -165,6 +118,7 @@ def main() -> int:
     ap.add_argument("--pid", type=lambda s: int(s, 0), default=None, help="Camera USB PID")
     ap.add_argument("--pick", type=int, default=0, help="Pick Nth PTP interface (default: 0)")
     ap.add_argument("--log", default=None, help="Write log to this file")
+    add_virtual_camera_args(ap)
     args = ap.parse_args()
 
     log_f = open(args.log, "a", encoding="utf-8") if args.log else None
@@ -177,8 +131,14 @@ def main() -> int:
             log_f.write(line + "\n")
             log_f.flush()
 
-    log("Opening camera USB interface...")
-    cam = find_ptp_camera(args.vid, args.pid, args.pick)
+    if args.virtual_camera:
+        dev, intf_num, _, _, ep_in, ep_out = virtual_camera_from_args(args)
+        cam = CameraUsb(dev=dev, cfg_value=1, intf_num=intf_num, ep_in=ep_in, ep_out=ep_out)
+    else:
+        if usb is None:
+            raise SystemExit("pyusb is required (python3 -m pip install --user pyusb), or use --virtual-camera")
+        log("Opening camera USB interface...")
+        cam = find_ptp_camera(args.vid, args.pid, args.pick)
     log(f"Camera: VID=0x{int(cam.dev.idVendor):04x} PID=0x{int(cam.dev.idProduct):04x} if={cam.intf_num}")
 
     log(f"Connecting to ESP proxy {args.esp_host}:{args.esp_port} ...")
@@ -195,7 +155,7 @@ def main() -> int:
 
             cmd = payload
             try:
-                clen, ctype, code, tid = parse_ptp_hdr(cmd)
+                clen, ctype, code, tid = parse_ptp_container_header(cmd)
             except Exception as e:
                 log(f"Bad CMD_STD: {e}")
                 continue
@@ -209,9 +169,9 @@ def main() -> int:
 
             # Read containers until RESPONSE
             while True:
-                cont = read_container(cam.ep_in, timeout_ms=5000)
+                cont = read_ptp_container(cam.ep_in, timeout_ms=5000)
                 try:
-                    alen, atype, acode, atid = parse_ptp_hdr(cont)
+                    alen, atype, acode, atid = parse_ptp_container_header(cont)
                 except Exception as e:
                     log(f"Bad camera container: {e}")
                     break
@@ -233,14 +193,15 @@ def main() -> int:
             sock.close()
         except Exception:
             pass
-        try:
-            usb.util.release_interface(cam.dev, cam.intf_num)
-        except Exception:
-            pass
-        try:
-            usb.util.dispose_resources(cam.dev)
-        except Exception:
-            pass
+        if not args.virtual_camera:
+            try:
+                usb.util.release_interface(cam.dev, cam.intf_num)
+            except Exception:
+                pass
+            try:
+                usb.util.dispose_resources(cam.dev)
+            except Exception:
+                pass
         if log_f:
             log_f.close()
 
@@ -6,6 +6,7 @@ ESP (USB device to RS3) forwards raw BULK OUT packets to this script over TCP.
 This script can:
   - Log the raw OUT packets (always),
   - Optionally forward them to a real camera over USB (best-effort),
+    or answer them from a virtual camera (--virtual-camera, see virtual_ptp_camera.py),
   - Read camera BULK IN containers and send them back to ESP as raw BULK IN payloads.
 
 Protocol (over TCP, same framing as ptp_proxy_server):
@@ -17,6 +18,34 @@ Types:
   0x10 RAW_OUT: ESP -> PC, payload is raw bytes from RS3 bulk OUT
   0x11 RAW_IN : PC  -> ESP, payload is raw bytes to send to RS3 bulk IN (len may be 0 => ZLP)
   0x12 RAW_DONE: PC -> ESP, end-of-reply marker for one RAW_OUT command (no payload)
+  0x13 RAW_TS : ESP -> PC, timestamps of the previous exchange (CONFIG_RS3_USB_PTP_PROXY_TIMESTAMPS),
+                sent right before the next RAW_OUT:
+                u32_be seq, u64_be out_us, u64_be send_us, u64_be reply_us, u64_be in_done_us (esp_timer)
+  0x14 HEARTBEAT: both ways, sent after CONFIG_RS3_USB_PTP_PROXY_HEARTBEAT_MS without other traffic.
+                The PC only sends them (payload: u32_be session id) once the ESP has, and only then
+                treats --peer-timeout-ms of silence as a dead link. The ESP does the same in reverse.
+
+Link loss: the script reconnects with backoff (unless --no-reconnect) and resumes the same session:
+camera session, pending two-stage op and statistics are kept, so the RS3 only sees DeviceBusy
+replies from the ESP (CONFIG_RS3_USB_PTP_PROXY_BUSY_FALLBACK) while the link is down.
+
+Latency legs (printed per op as p50/p95/p99 at exit and every --stats-every exchanges):
+  esp_out   ESP: bulk OUT complete -> RAW_OUT sent        (needs RAW_TS)
+  wifi      ESP RAW_OUT sent -> first reply frame in, minus PC RAW_OUT received -> first reply
+            frame sent (both directions)                  (needs RAW_TS)
+  pc_in     PC: RAW_OUT received -> camera write done
+  camera    PC: camera write done -> last camera container read
+  pc_out    PC: last camera read -> RAW_DONE sent
+  esp_in    ESP: first reply frame -> last IN complete     (needs RAW_TS)
+  pc        PC: RAW_OUT received -> RAW_DONE sent
+  total     ESP: bulk OUT complete -> last IN complete     (needs RAW_TS)
+
+Structure (keeps the RAW_OUT -> RAW_DONE turnaround short):
+  - log lines and hexdumps are queued and written by a background thread (LogWriter),
+  - camera IN is read with one large transfer per container (CameraReader), not per packet,
+  - all frames for one camera container (and RAW_DONE) leave in a single TCP write, TCP_NODELAY on,
+  - ops with a host->device DATA stage (--data-ops, default 0x9207) skip the post-COMMAND read probe.
+  --bench turns off console echo and hexdumps and prints exchanges/s plus the latency the PC adds.
 
 Notes:
  - If you want a ZLP, explicitly send RAW_IN with empty payload.
@@ -27,232 +56,274 @@ Notes:
 from __future__ import annotations
 
 import argparse
+import collections
+import datetime
+import os
 import socket
 import struct
 import sys
+import threading
 import time
-from typing import Optional, Tuple
-
-import usb.core
-import usb.util
-
-
-T_RAW_OUT = 0x10
-T_RAW_IN = 0x11
-T_RAW_DONE = 0x12
-
-PTP_CLASS, PTP_SUBCLASS, PTP_PROTOCOL = 0x06, 0x01, 0x01
-PTP_CT_RESPONSE = 3
-PTP_CT_COMMAND = 1
-PTP_CT_DATA = 2
-
-# Response codes we care about (subset)
-PTP_RC_OK = 0x2001
-PTP_RC_SESSION_ALREADY_OPEN = 0x201E
-
-# Operation codes (subset)
-PTP_OC_OPEN_SESSION = 0x1002
-PTP_OC_CLOSE_SESSION = 0x1003
-
+from typing import Callable, Deque, Dict, List, Optional, Tuple
+
+try:
+    import usb.core
+    import usb.util
+except ImportError:  # --virtual-camera / log-only mode work without pyusb
+    usb = None
+
+from rs3_ptp_common import (
+    PTP_CLASS,
+    PTP_CT_COMMAND,
+    PTP_CT_DATA,
+    PTP_CT_RESPONSE,
+    PTP_OC_CLOSE_SESSION,
+    PTP_OC_OPEN_SESSION,
+    PTP_PROTOCOL,
+    PTP_RC_OK,
+    PTP_RC_SESSION_ALREADY_OPEN,
+    PTP_SUBCLASS,
+    T_HEARTBEAT,
+    T_RAW_DONE,
+    T_RAW_IN,
+    T_RAW_OUT,
+    T_RAW_TS,
+    U32_LE,
+    FrameReader,
+    build_rs3_container,
+    build_std_command_container,
+    build_std_data_container,
+    exchange_op_label,
+    frame_bytes,
+    frame_into,
+    head8,
+    hexdump,
+    parse_ptp_container_header,
+    parse_rs3_container,
+    read_ptp_container,
+    send_frame,
+)
+from rs3_pcapng import PcapngWriter
+from virtual_ptp_camera import USBError, add_virtual_camera_args, virtual_camera_from_args
+
+
+def now_us() -> int:
+    return time.perf_counter_ns() // 1000
+
+
+class EspLinkDown(Exception):
+    """The ESP connection failed (EOF, socket error or peer timeout)."""
+
+
+class EspLink:
+    """
+    The TCP connection to the ESP, shared by the exchange path and the heartbeat thread.
 
-def hexdump(buf: bytes, prefix: str = "") -> str:
-    lines = []
-    for off in range(0, len(buf), 16):
-        chunk = buf[off : off + 16]
-        lines.append(f"{prefix}{off:04x}: " + " ".join(f"{b:02x}" for b in chunk))
-    return "\n".join(lines)
+    sendall() is serialized so a heartbeat never lands inside a multi-frame reply. The socket
+    object is replaced on reconnect; holders of the link keep working with the new one.
+    """
 
+    def __init__(self, host: str, port: int, heartbeat_ms: int, peer_timeout_ms: int) -> None:
+        self.host = host
+        self.port = port
+        self.heartbeat_s = heartbeat_ms / 1000.0
+        self.peer_timeout_s = peer_timeout_ms / 1000.0
+        self.session_id = struct.unpack(">I", os.urandom(4))[0]
+        self.sock: Optional[socket.socket] = None
+        self.reader: Optional[FrameReader] = None
+        self.peer_heartbeats = False
+        self.last_tx = 0.0
+        self._lock = threading.Lock()
+        self._stop = threading.Event()
+        self._hb_thread: Optional[threading.Thread] = None
+
+    def connect(self, timeout_s: float = 5.0) -> None:
+        sock = socket.create_connection((self.host, self.port), timeout=timeout_s)
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_KEEPALIVE, 1)
+        sock.settimeout(None)
+        with self._lock:
+            self.sock = sock
+            self.reader = FrameReader(sock)
+            self.peer_heartbeats = False
+            self.last_tx = time.monotonic()
+        if self.heartbeat_s > 0 and self._hb_thread is None:
+            self._hb_thread = threading.Thread(target=self._heartbeat_loop, name="esp-heartbeat", daemon=True)
+            self._hb_thread.start()
+
+    def close(self) -> None:
+        with self._lock:
+            sock, self.sock = self.sock, None
+        if sock is not None:
+            try:
+                sock.close()
+            except OSError:
+                pass
 
-def recv_exact(sock: socket.socket, n: int) -> bytes:
-    buf = bytearray()
-    while len(buf) < n:
-        chunk = sock.recv(n - len(buf))
-        if not chunk:
-            raise EOFError("socket closed")
-        buf += chunk
-    return bytes(buf)
+    def stop(self) -> None:
+        self._stop.set()
+        self.close()
 
+    def sendall(self, data: bytes) -> None:
+        with self._lock:
+            if self.sock is None:
+                raise EspLinkDown("not connected")
+            try:
+                self.sock.sendall(data)
+            except OSError as e:
+                raise EspLinkDown(f"send failed: {e}") from None
+            self.last_tx = time.monotonic()
+
+    def recv_frame(self) -> Tuple[int, memoryview]:
+        """
+        Next non-heartbeat frame; the payload view is valid until the next call.
+        Raises EspLinkDown on EOF, errors, or when a heartbeating ESP goes silent.
+        """
+        while True:
+            sock, reader = self.sock, self.reader
+            if sock is None or reader is None:
+                raise EspLinkDown("not connected")
+            try:
+                ftype, payload = reader.read()
+            except socket.timeout:
+                raise EspLinkDown(f"no frame for {self.peer_timeout_s * 1000:.0f} ms") from None
+            except EOFError:
+                raise EspLinkDown("ESP disconnected") from None
+            except OSError as e:
+                raise EspLinkDown(str(e)) from None
+            if ftype != T_HEARTBEAT:
+                return ftype, payload
+            if not self.peer_heartbeats and self.heartbeat_s > 0:
+                # The ESP heartbeats: from now on silence means a dead link.
+                self.peer_heartbeats = True
+                sock.settimeout(self.peer_timeout_s)
+
+    def _heartbeat_loop(self) -> None:
+        payload = struct.pack(">I", self.session_id)
+        while not self._stop.wait(self.heartbeat_s / 2):
+            if not self.peer_heartbeats or time.monotonic() - self.last_tx < self.heartbeat_s:
+                continue
+            try:
+                self.sendall(frame_bytes(T_HEARTBEAT, payload))
+            except EspLinkDown:
+                pass  # the reader notices the dead link and reconnects
 
-def recv_frame(sock: socket.socket) -> Tuple[int, bytes]:
-    hdr = recv_exact(sock, 5)
-    length = struct.unpack(">I", hdr[:4])[0]
-    ftype = hdr[4]
-    if length == 0:
-        raise ValueError("invalid frame length=0")
-    payload_len = length - 1
-    payload = recv_exact(sock, payload_len) if payload_len else b""
-    return ftype, payload
 
+def percentile(sorted_vals: List[int], pct: float) -> int:
+    if not sorted_vals:
+        return 0
+    k = min(len(sorted_vals) - 1, max(0, int(round(pct / 100.0 * (len(sorted_vals) - 1)))))
+    return sorted_vals[k]
 
-def send_frame(sock: socket.socket, ftype: int, payload: bytes) -> None:
-    length = 1 + len(payload)
-    sock.sendall(struct.pack(">IB", length, ftype) + payload)
 
+class Exchange:
+    """
+    PC-side stamps for one RAW_OUT -> RAW_DONE exchange (perf_counter microseconds).
+    ESP stamps are merged later from the RAW_TS frame that precedes the next RAW_OUT.
+    """
 
-def head8(b: bytes) -> str:
-    return " ".join(f"{x:02x}" for x in b[:8])
+    __slots__ = ("op", "recv", "cam_write", "cam_read", "first_reply", "reply")
+
+    def __init__(self, op: str, recv: int) -> None:
+        self.op = op
+        self.recv = recv
+        self.cam_write: Optional[int] = None
+        self.cam_read: Optional[int] = None
+        self.first_reply: Optional[int] = None  # first reply frame (RAW_IN, or RAW_DONE) handed to the socket
+        self.reply: Optional[int] = None        # RAW_DONE sent
+
+
+class LatencyStats:
+    LEGS = ("esp_out", "wifi", "pc_in", "camera", "pc_out", "pc", "esp_in", "total")
+
+    def __init__(self) -> None:
+        self.samples: Dict[str, Dict[str, List[int]]] = {}
+        self.last: Optional[Exchange] = None
+        self.count = 0
+
+    def _add(self, op: str, leg: str, us: int) -> None:
+        self.samples.setdefault(op, {}).setdefault(leg, []).append(us)
+
+    def finish(self, ex: Exchange) -> None:
+        """Record PC-only legs of a finished exchange; ESP legs arrive with the next RAW_TS."""
+        self.count += 1
+        self.last = ex
+        if ex.reply is not None:
+            self._add(ex.op, "pc", ex.reply - ex.recv)
+        if ex.cam_write is not None:
+            self._add(ex.op, "pc_in", ex.cam_write - ex.recv)
+            if ex.cam_read is not None:
+                self._add(ex.op, "camera", ex.cam_read - ex.cam_write)
+                if ex.reply is not None:
+                    self._add(ex.op, "pc_out", ex.reply - ex.cam_read)
+
+    def on_esp_ts(self, payload: bytes) -> Optional[int]:
+        """Merge a RAW_TS report into the last exchange. Returns the ESP seq (or None if unusable)."""
+        if len(payload) < 36:
+            return None
+        seq, out_us, send_us, reply_us, in_done_us = struct.unpack_from(">IQQQQ", payload, 0)
+        ex, self.last = self.last, None
+        if ex is None:
+            return seq  # report for an exchange of a previous connection
+        self._add(ex.op, "esp_out", send_us - out_us)
+        if in_done_us >= out_us:
+            self._add(ex.op, "total", in_done_us - out_us)
+        if reply_us:
+            self._add(ex.op, "esp_in", in_done_us - reply_us)
+            # ESP: RAW_OUT sent -> first reply frame in. PC: RAW_OUT in -> first reply frame out.
+            # The difference is both Wi-Fi directions (a data phase's later frames are not in it).
+            if ex.first_reply is not None:
+                self._add(ex.op, "wifi", max(0, (reply_us - send_us) - (ex.first_reply - ex.recv)))
+        return seq
+
+    def report(self) -> str:
+        lines = [f"Latency per op over {self.count} exchanges (us):",
+                 f"  {'op':<14} {'leg':<8} {'n':>6} {'p50':>8} {'p95':>8} {'p99':>8}"]
+        for op in sorted(self.samples):
+            legs = self.samples[op]
+            for leg in self.LEGS:
+                vals = legs.get(leg)
+                if not vals:
+                    continue
+                v = sorted(vals)
+                lines.append(f"  {op:<14} {leg:<8} {len(v):>6} {percentile(v, 50):>8} "
+                             f"{percentile(v, 95):>8} {percentile(v, 99):>8}")
+        return "\n".join(lines)
 
 
-def send_raw_in_chunks(sock: socket.socket, payload: bytes, chunk_max: int, log) -> None:
+def send_raw_in_chunks(sock: socket.socket, payload: bytes, chunk_max: int, log,
+                       out: Optional[bytearray] = None, trace: Optional[Callable[[bytes], None]] = None) -> None:
     """
     Send RAW_IN payload to ESP split into <=chunk_max frames.
     This is required because ESP buffers one RAW_IN frame in a fixed-size slot (512 bytes by default).
+    If `out` is given, the frames are appended to it instead of being sent (caller sends them in one write).
+    `trace` is called with each frame payload (one RS3 bulk IN transfer each), e.g. for --pcap.
     """
     if chunk_max <= 0:
         raise ValueError("chunk_max must be > 0")
     if len(payload) == 0:
-        send_frame(sock, T_RAW_IN, b"")
+        if out is not None:
+            frame_into(out, T_RAW_IN, b"")
+        else:
+            send_frame(sock, T_RAW_IN, b"")
+        if trace is not None:
+            trace(b"")
         log("ESP<-PY RAW_IN send ZLP")
         return
     off = 0
     idx = 0
     while off < len(payload):
         part = payload[off : off + chunk_max]
-        send_frame(sock, T_RAW_IN, part)
+        if out is not None:
+            frame_into(out, T_RAW_IN, part)
+        else:
+            send_frame(sock, T_RAW_IN, part)
+        if trace is not None:
+            trace(part)
         log(f"ESP<-PY RAW_IN send chunk[{idx}] bytes={len(part)} head={head8(part)}")
         off += len(part)
         idx += 1
 
-def _le32(b: bytes, off: int = 0) -> int:
-    return struct.unpack_from("<I", b, off)[0]
-
-def _le16(b: bytes, off: int = 0) -> int:
-    return struct.unpack_from("<H", b, off)[0]
-
-def parse_ptp_container_header(b: bytes) -> Tuple[int, int, int, int]:
-    if len(b) < 12:
-        raise ValueError("short PTP container")
-    total_len = _le32(b, 0)
-    ctype = _le16(b, 4)
-    code = _le16(b, 6)
-    tid = _le32(b, 8)
-    return total_len, ctype, code, tid
-
-def read_ptp_container(ep_in, timeout_ms: int = 5000) -> bytes:
-    """
-    Read one full PTP container from bulk IN using the <len32,...> header.
-    """
-    first = ep_in.read(ep_in.wMaxPacketSize, timeout=timeout_ms).tobytes()
-    if len(first) < 12:
-        raise RuntimeError(f"short read ({len(first)} bytes)")
-    total_len = _le32(first, 0)
-    if total_len < 12:
-        raise RuntimeError(f"invalid PTP length={total_len}")
-    buf = bytearray(first)
-    while len(buf) < total_len:
-        buf += ep_in.read(ep_in.wMaxPacketSize, timeout=timeout_ms).tobytes()
-    return bytes(buf[:total_len])
-
-def parse_rs3_command(payload: bytes) -> Tuple[str, int, int, int, bytes]:
-    """
-    Parse RS3/DJI command variants we observed and return:
-      (layout, type, code, tid, params_bytes)
-    layouts:
-      - "dji_pad24": 00 00 00 [type16le@3][code16le@5][tid32le@7][params...]
-      - "dji_pad16": 00 00 [type16le@2][code16le@4][tid32le@6][params...]
-      - "dji_pad8" : 00 [type16le@1][code16le@3][tid32le@5][params...]
-      - "std_len"  : [len32][type16le][code16le][tid32le][params...]
-      - "alt_len"  : [len32][code16le][tid32le][type16le][params...]
-    """
-    b = payload
-    n = len(b)
-    def params_aligned(off: int) -> bytes:
-        # RS3/DJI sometimes appends extra padding bytes (e.g. an extra 0x01) after tid.
-        # For PTP standard command params must be 32-bit aligned. Keep only full uint32 params.
-        if n <= off:
-            return b""
-        tail = b[off:]
-        return tail[: (len(tail) // 4) * 4]
-
-    if n >= 11 and b[0] == 0x00 and b[1] == 0x00 and b[2] == 0x00:
-        ctype = _le16(b, 3)
-        code = _le16(b, 5)
-        tid = _le32(b, 7)
-        return "dji_pad24", ctype, code, tid, params_aligned(11)
-    if n >= 10 and b[0] == 0x00 and b[1] == 0x00:
-        ctype = _le16(b, 2)
-        code = _le16(b, 4)
-        tid = _le32(b, 6)
-        return "dji_pad16", ctype, code, tid, params_aligned(10)
-    if n >= 9 and b[0] == 0x00:
-        ctype = _le16(b, 1)
-        code = _le16(b, 3)
-        tid = _le32(b, 5)
-        return "dji_pad8", ctype, code, tid, params_aligned(9)
-    if n >= 12:
-        length = _le32(b, 0)
-        t_std = _le16(b, 4)
-        if 1 <= t_std <= 4:
-            code = _le16(b, 6)
-            tid = _le32(b, 8)
-            # params are in remaining bytes (ignore length mismatch; we just pass through)
-            return "std_len", t_std, code, tid, params_aligned(12)
-        t_alt = _le16(b, 10)
-        if 1 <= t_alt <= 4:
-            code = _le16(b, 4)
-            tid = _le32(b, 6)
-            return "alt_len", t_alt, code, tid, params_aligned(12)
-    raise ValueError("unknown RS3 command layout")
-
-
-def parse_rs3_container(payload: bytes, *, align_tail_u32: bool) -> Tuple[str, int, int, int, bytes]:
-    """
-    Parse RS3/DJI container variants and return:
-      (layout, type, code, tid, tail_bytes)
-    If align_tail_u32=True, tail is truncated to full uint32 params (PTP COMMAND params).
-    If align_tail_u32=False, tail is returned raw (PTP DATA payload).
-    """
-    b = payload
-    n = len(b)
-
-    def tail(off: int) -> bytes:
-        if n <= off:
-            return b""
-        t = b[off:]
-        if not align_tail_u32:
-            return t
-        return t[: (len(t) // 4) * 4]
-
-    if n >= 11 and b[0] == 0x00 and b[1] == 0x00 and b[2] == 0x00:
-        ctype = _le16(b, 3)
-        code = _le16(b, 5)
-        tid = _le32(b, 7)
-        return "dji_pad24", ctype, code, tid, tail(11)
-    if n >= 10 and b[0] == 0x00 and b[1] == 0x00:
-        ctype = _le16(b, 2)
-        code = _le16(b, 4)
-        tid = _le32(b, 6)
-        return "dji_pad16", ctype, code, tid, tail(10)
-    if n >= 9 and b[0] == 0x00:
-        ctype = _le16(b, 1)
-        code = _le16(b, 3)
-        tid = _le32(b, 5)
-        return "dji_pad8", ctype, code, tid, tail(9)
-    if n >= 12:
-        length = _le32(b, 0)
-        t_std = _le16(b, 4)
-        if 1 <= t_std <= 4:
-            code = _le16(b, 6)
-            tid = _le32(b, 8)
-            return "std_len", t_std, code, tid, tail(12)
-        t_alt = _le16(b, 10)
-        if 1 <= t_alt <= 4:
-            code = _le16(b, 4)
-            tid = _le32(b, 6)
-            return "alt_len", t_alt, code, tid, tail(12)
-    raise ValueError("unknown RS3 container layout")
-
-def build_std_command_container(code: int, tid: int, params_bytes: bytes) -> bytes:
-    # Standard PTP command: len32,type16,code16,tid32 + params (4-byte LE)
-    total_len = 12 + len(params_bytes)
-    return struct.pack("<IHHI", total_len, PTP_CT_COMMAND, code & 0xFFFF, tid & 0xFFFFFFFF) + params_bytes
-
-
-def build_std_data_container(code: int, tid: int, data_bytes: bytes) -> bytes:
-    total_len = 12 + len(data_bytes)
-    return struct.pack("<IHHI", total_len, PTP_CT_DATA, code & 0xFFFF, tid & 0xFFFFFFFF) + data_bytes
-
-
 def _read_until_response(ep_in, timeout_ms: int = 1200) -> Optional[bytes]:
     """
     Best-effort read: try to read one or more PTP containers until we see RESPONSE (type=3).
@@ -310,38 +381,6 @@ def best_effort_close_camera_session(ep_out, ep_in, log) -> None:
     except Exception as e:
         log(f"Camera preflight: CloseSession(2) failed: {e}")
 
-def build_rs3_container(layout: str, ctype: int, code: int, tid: int, payload: bytes) -> bytes:
-    """
-    Build RS3-side container using the same layout we received commands with.
-    For DATA/RESP from camera, we use (ctype, code, tid) from camera header and payload bytes.
-    """
-    if layout == "dji_pad24":
-        hdr = b"\x00\x00\x00" + struct.pack("<HHI", ctype & 0xFFFF, code & 0xFFFF, tid & 0xFFFFFFFF)
-        out = hdr + payload
-        # For RESPONSE (no payload), RS3 may expect >= 12 bytes (std header size). Pad with zeros to 12.
-        if ctype == PTP_CT_RESPONSE and len(payload) == 0 and len(out) < 12:
-            out += b"\x00" * (12 - len(out))
-        return out
-    if layout == "dji_pad16":
-        hdr = b"\x00\x00" + struct.pack("<HHI", ctype & 0xFFFF, code & 0xFFFF, tid & 0xFFFFFFFF)
-        out = hdr + payload
-        if ctype == PTP_CT_RESPONSE and len(payload) == 0 and len(out) < 12:
-            out += b"\x00" * (12 - len(out))
-        return out
-    if layout == "dji_pad8":
-        hdr = b"\x00" + struct.pack("<HHI", ctype & 0xFFFF, code & 0xFFFF, tid & 0xFFFFFFFF)
-        out = hdr + payload
-        if ctype == PTP_CT_RESPONSE and len(payload) == 0 and len(out) < 12:
-            out += b"\x00" * (12 - len(out))
-        return out
-    if layout == "alt_len":
-        total_len = 12 + len(payload)
-        return struct.pack("<IHIH", total_len, code & 0xFFFF, tid & 0xFFFFFFFF, ctype & 0xFFFF) + payload
-    # std_len default
-    total_len = 12 + len(payload)
-    return struct.pack("<IHHI", total_len, ctype & 0xFFFF, code & 0xFFFF, tid & 0xFFFFFFFF) + payload
-
-
 def find_camera(vid: Optional[int], pid: Optional[int], pick: int):
     matches = []
     for dev in usb.core.find(find_all=True):
@@ -387,6 +426,365 @@ def find_camera(vid: Optional[int], pid: Optional[int], pick: int):
     return dev, intf_num, int(ep_in.bEndpointAddress), int(ep_out.bEndpointAddress), ep_in, ep_out
 
 
+class LogWriter(threading.Thread):
+    """
+    Background log writer. The proxy path only appends to a deque (thread-safe, no I/O);
+    this thread formats hexdumps, echoes to stdout and writes the log file in batches
+    with a single flush per batch.
+    """
+
+    def __init__(self, path: str, echo: bool = True, hexdumps: bool = True, interval_s: float = 0.05) -> None:
+        super().__init__(name="log-writer", daemon=True)
+        self._f = open(path, "a", encoding="utf-8")
+        self._echo = echo
+        self._hexdumps = hexdumps
+        self._interval_s = interval_s
+        self._q: Deque[Tuple[float, Optional[str], Optional[bytes]]] = collections.deque()
+        self._wake = threading.Event()
+        self._stopping = False
+
+    def log(self, msg: str) -> None:
+        self._q.append((time.time(), msg, None))
+
+    def hexdump(self, data: bytes) -> None:
+        if self._hexdumps:
+            self._q.append((0.0, None, bytes(data)))
+
+    def _drain(self) -> None:
+        if not self._q:
+            return
+        file_lines: List[str] = []
+        echo_lines: List[str] = []
+        while self._q:
+            ts, msg, data = self._q.popleft()
+            if data is not None:
+                file_lines.append(hexdump(data, prefix="  "))
+                continue
+            line = f"[{datetime.datetime.fromtimestamp(ts).strftime('%H:%M:%S.%f')}] {msg}"
+            file_lines.append(line)
+            if self._echo:
+                echo_lines.append(line)
+        self._f.write("\n".join(file_lines) + "\n")
+        self._f.flush()
+        if echo_lines:
+            sys.stdout.write("\n".join(echo_lines) + "\n")
+            sys.stdout.flush()
+
+    def run(self) -> None:
+        while not self._stopping:
+            self._wake.wait(self._interval_s)
+            self._wake.clear()
+            self._drain()
+
+    def close(self) -> None:
+        self._stopping = True
+        self._wake.set()
+        if self.is_alive():
+            self.join()
+        self._drain()
+        self._f.close()
+
+
+class CameraReader:
+    """
+    Splits camera bulk IN traffic into PTP containers.
+
+    Reads are issued with a large buffer so a single libusb transfer returns a whole container
+    (the transfer completes on the camera's short packet / ZLP) instead of one call per 64-byte
+    packet. Bytes past the end of the current container are kept for the next call.
+    """
+
+    def __init__(self, ep_in, read_size: int = 65536) -> None:
+        self.ep_in = ep_in
+        self.read_size = read_size
+        self._buf = bytearray()
+
+    def reset(self) -> None:
+        self._buf.clear()
+
+    def read_container(self, timeout_ms: int) -> bytes:
+        buf = self._buf
+        while True:
+            if len(buf) >= 4:
+                total_len = U32_LE.unpack_from(buf, 0)[0]
+                if total_len < 12:
+                    buf.clear()
+                    raise RuntimeError(f"invalid PTP length={total_len}")
+                if len(buf) >= total_len:
+                    out = bytes(buf[:total_len])
+                    del buf[:total_len]
+                    return out
+            buf += self.ep_in.read(self.read_size, timeout=timeout_ms).tobytes()
+
+
+class BenchStats:
+    """--bench: exchanges per second and latency the PC adds per exchange (PC time minus camera time)."""
+
+    def __init__(self, log) -> None:
+        self.log = log
+        self.t0 = time.perf_counter()
+        self.t_last = self.t0
+        self.n_total = 0
+        self.n_window = 0
+        self.added_us: List[int] = []
+        self.window_added_us: List[int] = []
+
+    def add(self, ex: Exchange) -> None:
+        self.n_total += 1
+        self.n_window += 1
+        if ex.reply is not None:
+            added = ex.reply - ex.recv
+            if ex.cam_write is not None and ex.cam_read is not None:
+                added -= ex.cam_read - ex.cam_write
+            self.added_us.append(added)
+            self.window_added_us.append(added)
+        now = time.perf_counter()
+        if now - self.t_last >= 1.0:
+            self._emit("bench", self.n_window / (now - self.t_last), self.window_added_us)
+            self.t_last = now
+            self.n_window = 0
+            self.window_added_us = []
+
+    def _emit(self, what: str, rate: float, added: List[int]) -> None:
+        v = sorted(added)
+        self.log(f"{what}: {rate:.1f} exchanges/s added_us p50={percentile(v, 50)} "
+                 f"p99={percentile(v, 99)} max={v[-1] if v else 0} (n={len(v)})")
+
+    def summary(self) -> None:
+        elapsed = max(1e-9, time.perf_counter() - self.t0)
+        self._emit(f"bench total {self.n_total} exchanges in {elapsed:.1f}s", self.n_total / elapsed, self.added_us)
+
+
+class CameraForwarder:
+    """
+    Camera side of one exchange: exchange() writes a RAW_OUT to the camera's bulk OUT endpoint,
+    reads back up to 8 containers and relays each as RAW_IN frames (plus a ZLP when it ends on a
+    64-byte boundary); RAW_DONE closes the exchange after the RESPONSE, a read timeout or an error.
+
+    With --translate, RS3/DJI containers are rewritten to std_len for the camera and the camera's
+    replies back to the RS3 layout; the last COMMAND is remembered so its DATA stage can be wrapped.
+    After a COMMAND the camera is only probed for --cmd-probe-ms (RAW_DONE right away for
+    --data-ops opcodes), so the ESP re-arms OUT and the RS3 can send the DATA stage.
+
+    exchange() is called synchronously from the main loop, which reads the next RAW_OUT only once
+    it returns. Log lines and hexdumps are only queued (LogWriter thread does the I/O); heartbeats
+    share the link from their own thread.
+    """
+
+    def __init__(self, args, sock: EspLink, cam, log, hexlog, on_done,
+                 pcap: Optional[PcapngWriter] = None) -> None:
+        self.args = args
+        self.pcap = pcap
+        self.sock = sock
+        self.cam = cam
+        self.log = log
+        self.hexlog = hexlog
+        self.on_done = on_done
+        self.reader = CameraReader(cam[4], read_size=args.cam_read_size) if cam is not None else None
+        # Some PTP operations are 2-stage: COMMAND (host->device) then DATA (host->device),
+        # then the camera replies with DATA/RESPONSE. Remember the last command so we can
+        # wrap the RS3 DATA stage into a standard PTP DATA container for the camera.
+        self.pending_cam_op: Optional[int] = None
+        self.pending_cam_tid: Optional[int] = None
+        self.pending_rs3_layout: Optional[str] = None
+
+    def send_done(self, ex: Exchange, out: Optional[bytearray] = None) -> None:
+        if ex.first_reply is None:
+            ex.first_reply = now_us()
+        if out is not None:
+            frame_into(out, T_RAW_DONE, b"")
+            self.sock.sendall(out)
+        else:
+            send_frame(self.sock, T_RAW_DONE, b"")
+        ex.reply = now_us()
+        self.on_done(ex)
+        self.log("ESP<-PY RAW_DONE")
+
+    def exchange(self, payload: bytes, ex: Exchange) -> None:
+        args = self.args
+        log = self.log
+        if self.cam is None:
+            return
+
+        dev, ifnum, ep_in_addr, ep_out_addr, ep_in, ep_out = self.cam
+
+        if len(payload) >= 4:
+            log(f"RAW_OUT head: {payload[:8].hex(' ')}")
+
+        cam_out = payload
+        rs3_layout = None
+        last_op = None
+        rs3_stage = None  # "cmd" | "data" | None
+        if args.translate:
+            try:
+                rs3_layout, ctype, code, tid, tail = parse_rs3_container(payload, align_tail_u32=True)
+            except Exception as e:
+                log(f"Translate: cannot parse RS3 container: {e}")
+                self.send_done(ex)
+                return
+
+            if ctype == PTP_CT_COMMAND:
+                cam_out = build_std_command_container(code, tid, tail)
+                last_op = code
+                self.pending_cam_op = code
+                self.pending_cam_tid = tid
+                self.pending_rs3_layout = rs3_layout
+                rs3_stage = "cmd"
+                log(f"Translate: {rs3_layout} -> std_len CMD op=0x{code:04x} tid={tid} bytes={len(cam_out)}")
+            elif ctype == PTP_CT_DATA:
+                # Re-parse without alignment to preserve DATA payload bytes.
+                rs3_layout, _, code2, tid2, data_tail = parse_rs3_container(payload, align_tail_u32=False)
+                op = self.pending_cam_op if self.pending_cam_op is not None else code2
+                tid_use = self.pending_cam_tid if self.pending_cam_tid is not None else tid2
+                rs3_layout = self.pending_rs3_layout if self.pending_rs3_layout is not None else rs3_layout
+                cam_out = build_std_data_container(op, tid_use, data_tail)
+                last_op = op
+                rs3_stage = "data"
+                log(f"Translate: {rs3_layout} -> std_len DATA op=0x{op:04x} tid={tid_use} bytes={len(cam_out)} payload={len(data_tail)}")
+            else:
+                log(f"Translate: ignoring container type={ctype}")
+                self.send_done(ex)
+                return
+
+        # Forward bytes to camera bulk OUT.
+        try:
+            ep_out.write(cam_out, timeout=2000)
+            ex.cam_write = now_us()
+        except Exception as e:
+            log(f"Camera write failed: {e}")
+            try:
+                dev.clear_halt(ep_out_addr)
+                log("Cleared camera OUT halt.")
+            except Exception:
+                pass
+            self.send_done(ex)
+            return
+
+        # Operations with a host->device DATA stage (e.g. Sony 0x9207) never answer the COMMAND:
+        # release the ESP right away so RS3 can send the DATA stage, instead of waiting out the probe.
+        if rs3_stage == "cmd" and last_op in args.data_ops:
+            log(f"Camera awaits DATA stage for op=0x{last_op:04x}; RAW_DONE without probe")
+            self.send_done(ex)
+            return
+
+        # IMPORTANT:
+        # For operations that require host->device DATA, the camera will not reply until it receives DATA.
+        # We must NOT block for seconds after COMMAND, because that prevents ESP from re-arming the OUT endpoint
+        # and RS3 cannot send the DATA stage. So after COMMAND we only probe briefly; on timeout we send RAW_DONE
+        # immediately and wait for the next RS3 OUT (DATA stage).
+        cam_read_timeout_ms = 4000
+        if rs3_stage == "cmd":
+            cam_read_timeout_ms = args.cmd_probe_ms
+
+        # Read full PTP containers and relay them back as RAW_IN.
+        # Stop when we get RESPONSE (type=3). Also send ZLP to RS3 if container size is multiple of 64.
+        for _ in range(8):
+            try:
+                cont = self.reader.read_container(timeout_ms=cam_read_timeout_ms)
+                ex.cam_read = now_us()
+            except USBError as e:
+                # After some commands the camera expects a host->device DATA stage.
+                # Treat timeouts as "waiting for DATA", not as an error.
+                msg = str(e).lower()
+                if "timed out" in msg or "timeout" in msg:
+                    if rs3_stage == "cmd":
+                        log(f"Camera awaiting RS3 DATA stage (no reply after CMD): {e}")
+                        # Let ESP re-arm OUT so RS3 can send DATA.
+                        self.send_done(ex)
+                        break
+                    log(f"Camera read timeout: {e}")
+                    self.send_done(ex)
+                    break
+                log(f"Camera read failed: {e}")
+                self.reader.reset()
+                try:
+                    dev.clear_halt(ep_in_addr)
+                    log("Cleared camera IN halt.")
+                except Exception:
+                    pass
+                self.send_done(ex)
+                break
+            except Exception as e:
+                log(f"Camera read failed: {e}")
+                self.reader.reset()
+                self.send_done(ex)
+                break
+
+            try:
+                total_len, ctype, code, tid = parse_ptp_container_header(cont)
+            except Exception:
+                total_len, ctype, code, tid = (len(cont), -1, -1, -1)
+
+            log(f"CAM->RS3 RAW_IN PTP bytes={len(cont)} type={ctype} code=0x{code:04x} tid={tid}")
+            self.hexlog(cont)
+            out_bytes = cont
+            if args.translate and rs3_layout is not None:
+                # Convert standard camera container to RS3-side format.
+                payload_bytes = cont[12:]
+                send_code = code
+                # Some cameras reply SessionAlreadyOpen to OpenSession if a previous session exists.
+                # RS3 expects OpenSession OK; treat this as OK on the RS3-facing side to proceed.
+                if ctype == PTP_CT_RESPONSE and last_op == 0x1002 and code == PTP_RC_SESSION_ALREADY_OPEN:
+                    send_code = PTP_RC_OK
+                    # IMPORTANT: camera may include response parameters (len=16). RS3 expects OpenSession OK
+                    # without response parameters, so drop them when overriding.
+                    payload_bytes = b""
+                    log("Translate: overriding OpenSession SessionAlreadyOpen -> OK for RS3")
+                # Decide which RS3-facing format to send.
+                rs3_reply_layout = rs3_layout
+                if args.rs3_in_layout != "auto":
+                    rs3_reply_layout = args.rs3_in_layout
+
+                if rs3_reply_layout == "camera":
+                    # Send camera bytes as-is (but still allow overriding response code, e.g. OpenSession).
+                    if send_code == code:
+                        out_bytes = cont
+                    else:
+                        # Rebuild standard container with modified response code.
+                        out_bytes = build_rs3_container("std_len", ctype, send_code, tid, payload_bytes)
+                else:
+                    out_bytes = build_rs3_container(rs3_reply_layout, ctype, send_code, tid, payload_bytes)
+                # Optional quirk: add 0x01 after tid for RESPONSE only (before zero padding)
+                if args.rs3_resp_pad01 and ctype == PTP_CT_RESPONSE and len(payload_bytes) == 0:
+                    # Insert after header (layout-specific header size)
+                    if rs3_reply_layout == "dji_pad24":
+                        hsz = 11
+                    elif rs3_reply_layout == "dji_pad16":
+                        hsz = 10
+                    elif rs3_reply_layout == "dji_pad8":
+                        hsz = 9
+                    else:
+                        hsz = None
+                    if hsz is not None and len(out_bytes) >= hsz:
+                        out_bytes = out_bytes[:hsz] + b"\x01" + out_bytes[hsz:]
+                        if len(out_bytes) < 12:
+                            out_bytes += b"\x00" * (12 - len(out_bytes))
+                log(f"Translate: std -> {rs3_reply_layout} bytes={len(out_bytes)}")
+
+            # Send camera->RS3 bytes via ESP. Chunk if needed (ESP buffers per RAW_IN frame).
+            # All frames for one container (plus RAW_DONE after the RESPONSE) go out in a single write.
+            frames = bytearray()
+            trace = self.pcap.usb_in if self.pcap is not None else None
+            send_raw_in_chunks(self.sock, out_bytes, args.rs3_in_chunk, log, out=frames, trace=trace)
+
+            # ZLP decision must be based on what RS3 actually receives (out_bytes).
+            if (not args.no_zlp) and (len(out_bytes) % 64) == 0:
+                frame_into(frames, T_RAW_IN, b"")
+                if trace is not None:
+                    trace(b"")
+                log("ESP<-PY RAW_IN send ZLP")
+
+            if ctype == PTP_CT_RESPONSE:
+                self.pending_cam_op = None
+                self.pending_cam_tid = None
+                self.pending_rs3_layout = None
+                self.send_done(ex, frames)
+                break
+            if ex.first_reply is None:
+                ex.first_reply = now_us()
+            self.sock.sendall(frames)
+
+
 def main() -> int:
     ap = argparse.ArgumentParser(description="Raw RS3 PTP proxy (ESP <-> PC), optional camera forward.")
     ap.add_argument("--esp-host", required=True)
@@ -414,19 +812,48 @@ def main() -> int:
     ap.add_argument("--vid", type=lambda s: int(s, 0), default=None)
     ap.add_argument("--pid", type=lambda s: int(s, 0), default=None)
     ap.add_argument("--pick", type=int, default=0)
+    add_virtual_camera_args(ap)
+    ap.add_argument("--stats-every", type=int, default=0,
+                    help="Print per-op latency percentiles every N exchanges (default: only at exit).")
+    ap.add_argument("--cmd-probe-ms", type=int, default=200,
+                    help="After a COMMAND, how long to wait for a camera reply before assuming it awaits a DATA stage.")
+    ap.add_argument("--data-ops", type=lambda s: {int(x, 0) for x in s.split(",") if x}, default={0x9207},
+                    help="Comma-separated ops with a host->device DATA stage; RAW_DONE is sent right after their "
+                         "COMMAND without the read probe (default: 0x9207).")
+    ap.add_argument("--cam-read-size", type=int, default=65536,
+                    help="Bulk IN read size; one read returns a whole container (default 65536).")
+    ap.add_argument("--bench", action="store_true",
+                    help="Benchmark mode: no per-frame console output or hexdumps; report exchanges/s and the "
+                         "latency the PC adds per exchange every second and at exit.")
+    ap.add_argument("--quiet", action="store_true", help="Do not echo log lines to stdout (log file only).")
+    ap.add_argument("--heartbeat-ms", type=int, default=250,
+                    help="Heartbeat interval once the ESP sends heartbeats (0 = never send, no peer timeout).")
+    ap.add_argument("--peer-timeout-ms", type=int, default=1000,
+                    help="Treat the link as dead after this long without any frame from a heartbeating ESP.")
+    ap.add_argument("--no-reconnect", action="store_true",
+                    help="Exit when the ESP link drops instead of reconnecting and resuming the session.")
+    ap.add_argument("--pcap", default=None,
+                    help="Also write the RS3 bulk transfers as pcapng (usbmon link type, microsecond PC timestamps).")
     args = ap.parse_args()
 
-    log_f = open(args.log, "a", encoding="utf-8")
+    writer = LogWriter(args.log, echo=not (args.quiet or args.bench), hexdumps=not args.bench)
+    writer.start()
+    log = writer.log
 
-    def log(msg: str) -> None:
-        ts = time.strftime("%H:%M:%S")
-        line = f"[{ts}] {msg}"
-        print(line)
-        log_f.write(line + "\n")
-        log_f.flush()
+    def status(msg: str) -> None:
+        # Always visible, even in --bench/--quiet.
+        writer.log(msg)
+        if args.quiet or args.bench:
+            print(msg, flush=True)
 
     cam = None  # tuple: (dev, ifnum, ep_in_addr, ep_out_addr, ep_in, ep_out)
-    if args.camera:
+    if args.virtual_camera:
+        cam = virtual_camera_from_args(args)
+        log(f"Virtual camera: profile ops={len(cam[0].cam.profile)} delay={args.virtual_delay_ms}ms")
+        best_effort_close_camera_session(cam[5], cam[4], log)
+    elif args.camera:
+        if usb is None:
+            raise SystemExit("--camera needs pyusb (python3 -m pip install --user pyusb)")
         log("Opening camera USB interface...")
         cam = find_camera(args.vid, args.pid, args.pick)
         if cam is None:
@@ -436,208 +863,93 @@ def main() -> int:
             log(f"Camera: VID=0x{int(dev.idVendor):04x} PID=0x{int(dev.idProduct):04x} if={ifnum} ep_in=0x{ep_in_addr:02x} ep_out=0x{ep_out_addr:02x}")
             best_effort_close_camera_session(ep_out, ep_in, log)
 
-    log(f"Connecting to ESP raw proxy {args.esp_host}:{args.esp_port} ...")
-    sock = socket.create_connection((args.esp_host, args.esp_port), timeout=5)
-    sock.settimeout(None)
+    link = EspLink(args.esp_host, args.esp_port, args.heartbeat_ms, args.peer_timeout_ms)
+    log(f"Connecting to ESP raw proxy {args.esp_host}:{args.esp_port} (session {link.session_id:08x}) ...")
+    link.connect()
     log("Connected.")
 
-    # Some PTP operations are 2-stage: COMMAND (host->device) then DATA (host->device),
-    # then the camera replies with DATA/RESPONSE. Remember the last command so we can
-    # wrap the RS3 DATA stage into a standard PTP DATA container for the camera.
-    pending_cam_op: Optional[int] = None
-    pending_cam_tid: Optional[int] = None
-    pending_rs3_layout: Optional[str] = None
+    stats = LatencyStats()
+    bench = BenchStats(status) if args.bench else None
+    ex: Optional[Exchange] = None
+    reconnects = 0
+
+    def on_done(done: Exchange) -> None:
+        nonlocal ex
+        stats.finish(done)
+        if bench is not None:
+            bench.add(done)
+        if done is ex:
+            ex = None
+        if args.stats_every > 0 and stats.count % args.stats_every == 0:
+            status(stats.report())
+
+    pcap = PcapngWriter(args.pcap, app="rs3_ptp_raw_proxy.py") if args.pcap else None
+    fwd = CameraForwarder(args, link, cam, log, writer.hexdump, on_done, pcap)
+
+    def reconnect(why: str) -> bool:
+        nonlocal ex, reconnects
+        link.close()
+        if ex is not None:
+            on_done(ex)
+        if args.no_reconnect:
+            status(f"ESP link lost ({why}).")
+            return False
+        status(f"ESP link lost ({why}); reconnecting...")
+        delay = 0.05
+        t0 = time.monotonic()
+        while True:
+            try:
+                link.connect(timeout_s=2.0)
+                break
+            except OSError:
+                time.sleep(delay)
+                delay = min(delay * 2, 1.0)
+        reconnects += 1
+        # Camera session, pending DATA-stage op and stats carry over: the RS3 never saw the drop
+        # beyond DeviceBusy replies, so it continues where it left off.
+        status(f"Reconnected after {(time.monotonic() - t0) * 1000:.0f} ms; session {link.session_id:08x} "
+               f"resumed (reconnect #{reconnects}, pending_op="
+               f"{'none' if fwd.pending_cam_op is None else hex(fwd.pending_cam_op)})")
+        return True
 
     try:
         while True:
-            ftype, payload = recv_frame(sock)
-            if ftype != T_RAW_OUT:
-                log(f"Unexpected frame type=0x{ftype:02x} len={len(payload)}")
-                continue
-
-            log(f"RS3->ESP RAW_OUT bytes={len(payload)}")
-            log_f.write(hexdump(payload, prefix="  ") + "\n")
-            log_f.flush()
-
-            if cam is None:
-                continue
-
-            dev, ifnum, ep_in_addr, ep_out_addr, ep_in, ep_out = cam
-
-            if len(payload) >= 4:
-                log(f"RAW_OUT head: {payload[:8].hex(' ')}")
-
-            cam_out = payload
-            rs3_layout = None
-            last_op = None
-            rs3_stage = None  # "cmd" | "data" | None
-            if args.translate:
-                try:
-                    rs3_layout, ctype, code, tid, tail = parse_rs3_container(payload, align_tail_u32=True)
-                except Exception as e:
-                    log(f"Translate: cannot parse RS3 container: {e}")
-                    send_frame(sock, T_RAW_DONE, b"")
-                    log("ESP<-PY RAW_DONE")
+            try:
+                ftype, payload = link.recv_frame()
+                t_recv = now_us()
+                if ftype == T_RAW_TS:
+                    # Log-only mode never sends RAW_DONE: close the exchange so the ESP stamps still land.
+                    if ex is not None:
+                        on_done(ex)
+                    seq = stats.on_esp_ts(payload)
+                    log(f"ESP RAW_TS seq={seq}")
                     continue
-
-                if ctype == PTP_CT_COMMAND:
-                    cam_out = build_std_command_container(code, tid, tail)
-                    last_op = code
-                    pending_cam_op = code
-                    pending_cam_tid = tid
-                    pending_rs3_layout = rs3_layout
-                    rs3_stage = "cmd"
-                    log(f"Translate: {rs3_layout} -> std_len CMD op=0x{code:04x} tid={tid} bytes={len(cam_out)}")
-                elif ctype == PTP_CT_DATA:
-                    # Re-parse without alignment to preserve DATA payload bytes.
-                    rs3_layout, _, code2, tid2, data_tail = parse_rs3_container(payload, align_tail_u32=False)
-                    op = pending_cam_op if pending_cam_op is not None else code2
-                    tid_use = pending_cam_tid if pending_cam_tid is not None else tid2
-                    rs3_layout = pending_rs3_layout if pending_rs3_layout is not None else rs3_layout
-                    cam_out = build_std_data_container(op, tid_use, data_tail)
-                    last_op = op
-                    rs3_stage = "data"
-                    log(f"Translate: {rs3_layout} -> std_len DATA op=0x{op:04x} tid={tid_use} bytes={len(cam_out)} payload={len(data_tail)}")
-                else:
-                    log(f"Translate: ignoring container type={ctype}")
-                    send_frame(sock, T_RAW_DONE, b"")
-                    log("ESP<-PY RAW_DONE")
+                if ftype != T_RAW_OUT:
+                    log(f"Unexpected frame type=0x{ftype:02x} len={len(payload)}")
                     continue
 
-            # Forward bytes to camera bulk OUT.
-            try:
-                ep_out.write(cam_out, timeout=2000)
-            except Exception as e:
-                log(f"Camera write failed: {e}")
-                try:
-                    dev.clear_halt(ep_out_addr)
-                    log("Cleared camera OUT halt.")
-                except Exception:
-                    pass
-                send_frame(sock, T_RAW_DONE, b"")
-                log("ESP<-PY RAW_DONE")
-                continue
-
-            # IMPORTANT:
-            # For operations that require host->device DATA, the camera will not reply until it receives DATA.
-            # We must NOT block for seconds after COMMAND, because that prevents ESP from re-arming the OUT endpoint
-            # and RS3 cannot send the DATA stage. So after COMMAND we only probe briefly; on timeout we send RAW_DONE
-            # immediately and wait for the next RS3 OUT (DATA stage).
-            cam_read_timeout_ms = 4000
-            if rs3_stage == "cmd":
-                cam_read_timeout_ms = 200
-
-            # Read full PTP containers and relay them back as RAW_IN.
-            # Stop when we get RESPONSE (type=3). Also send ZLP to RS3 if container size is multiple of 64.
-            for _ in range(8):
-                try:
-                    cont = read_ptp_container(ep_in, timeout_ms=cam_read_timeout_ms)
-                except usb.core.USBError as e:
-                    # After some commands the camera expects a host->device DATA stage.
-                    # Treat timeouts as "waiting for DATA", not as an error.
-                    msg = str(e).lower()
-                    if "timed out" in msg or "timeout" in msg:
-                        if rs3_stage == "cmd":
-                            log(f"Camera awaiting RS3 DATA stage (no reply after CMD): {e}")
-                            # Let ESP re-arm OUT so RS3 can send DATA.
-                            send_frame(sock, T_RAW_DONE, b"")
-                            log("ESP<-PY RAW_DONE")
-                            break
-                        log(f"Camera read timeout: {e}")
-                        send_frame(sock, T_RAW_DONE, b"")
-                        log("ESP<-PY RAW_DONE")
-                        break
-                    log(f"Camera read failed: {e}")
-                    try:
-                        dev.clear_halt(ep_in_addr)
-                        log("Cleared camera IN halt.")
-                    except Exception:
-                        pass
-                    send_frame(sock, T_RAW_DONE, b"")
-                    log("ESP<-PY RAW_DONE")
-                    break
-                except Exception as e:
-                    log(f"Camera read failed: {e}")
-                    send_frame(sock, T_RAW_DONE, b"")
-                    log("ESP<-PY RAW_DONE")
+                if ex is not None:
+                    on_done(ex)
+                ex = Exchange(exchange_op_label(payload), t_recv)
+
+                # One copy out of the reader's buffer: the log queue and the camera path keep it.
+                out = bytes(payload)
+                if pcap is not None:
+                    pcap.usb_out(out)
+                log(f"RS3->ESP RAW_OUT bytes={len(out)}")
+                writer.hexdump(out)
+                fwd.exchange(out, ex)
+            except EspLinkDown as e:
+                if not reconnect(str(e)):
                     break
 
-                try:
-                    total_len, ctype, code, tid = parse_ptp_container_header(cont)
-                except Exception:
-                    total_len, ctype, code, tid = (len(cont), -1, -1, -1)
-
-                log(f"CAM->RS3 RAW_IN PTP bytes={len(cont)} type={ctype} code=0x{code:04x} tid={tid}")
-                log_f.write(hexdump(cont, prefix="  ") + "\n")
-                log_f.flush()
-                out_bytes = cont
-                if args.translate and rs3_layout is not None:
-                    # Convert standard camera container to RS3-side format.
-                    payload_bytes = cont[12:]
-                    send_code = code
-                    # Some cameras reply SessionAlreadyOpen to OpenSession if a previous session exists.
-                    # RS3 expects OpenSession OK; treat this as OK on the RS3-facing side to proceed.
-                    if ctype == PTP_CT_RESPONSE and last_op == 0x1002 and code == PTP_RC_SESSION_ALREADY_OPEN:
-                        send_code = PTP_RC_OK
-                        # IMPORTANT: camera may include response parameters (len=16). RS3 expects OpenSession OK
-                        # without response parameters, so drop them when overriding.
-                        payload_bytes = b""
-                        log("Translate: overriding OpenSession SessionAlreadyOpen -> OK for RS3")
-                    # Decide which RS3-facing format to send.
-                    rs3_reply_layout = rs3_layout
-                    if args.rs3_in_layout != "auto":
-                        rs3_reply_layout = args.rs3_in_layout
-
-                    if rs3_reply_layout == "camera":
-                        # Send camera bytes as-is (but still allow overriding response code, e.g. OpenSession).
-                        if send_code == code:
-                            out_bytes = cont
-                        else:
-                            # Rebuild standard container with modified response code.
-                            out_bytes = build_rs3_container("std_len", ctype, send_code, tid, payload_bytes)
-                    else:
-                        out_bytes = build_rs3_container(rs3_reply_layout, ctype, send_code, tid, payload_bytes)
-                    # Optional quirk: add 0x01 after tid for RESPONSE only (before zero padding)
-                    if args.rs3_resp_pad01 and ctype == PTP_CT_RESPONSE and len(payload_bytes) == 0:
-                        # Insert after header (layout-specific header size)
-                        if rs3_reply_layout == "dji_pad24":
-                            hsz = 11
-                        elif rs3_reply_layout == "dji_pad16":
-                            hsz = 10
-                        elif rs3_reply_layout == "dji_pad8":
-                            hsz = 9
-                        else:
-                            hsz = None
-                        if hsz is not None and len(out_bytes) >= hsz:
-                            out_bytes = out_bytes[:hsz] + b"\x01" + out_bytes[hsz:]
-                            if len(out_bytes) < 12:
-                                out_bytes += b"\x00" * (12 - len(out_bytes))
-                    log(f"Translate: std -> {rs3_reply_layout} bytes={len(out_bytes)}")
-
-                # Send camera->RS3 bytes via ESP. Chunk if needed (ESP buffers per RAW_IN frame).
-                send_raw_in_chunks(sock, out_bytes, args.rs3_in_chunk, log)
-
-                # ZLP decision must be based on what RS3 actually receives (out_bytes).
-                if (not args.no_zlp) and (len(out_bytes) % 64) == 0:
-                    send_frame(sock, T_RAW_IN, b"")
-                    log("ESP<-PY RAW_IN send ZLP")
-
-                if ctype == PTP_CT_RESPONSE:
-                    pending_cam_op = None
-                    pending_cam_tid = None
-                    pending_rs3_layout = None
-                    send_frame(sock, T_RAW_DONE, b"")
-                    log("ESP<-PY RAW_DONE")
-                    break
-
-    except EOFError:
-        log("ESP disconnected.")
+    except KeyboardInterrupt:
+        log("Interrupted.")
     finally:
-        try:
-            sock.close()
-        except Exception:
-            pass
-        if cam is not None:
+        if ex is not None:
+            on_done(ex)
+        link.stop()
+        if cam is not None and not args.virtual_camera:
             dev, ifnum, ep_in_addr, ep_out_addr, ep_in, ep_out = cam
             try:
                 usb.util.release_interface(dev, ifnum)
@@ -647,12 +959,17 @@ def main() -> int:
                 usb.util.dispose_resources(dev)
             except Exception:
                 pass
-        log_f.close()
+        if bench is not None:
+            bench.summary()
+        if stats.samples:
+            status(stats.report())
+        if pcap is not None:
+            pcap.close()
+            status(f"pcapng: {pcap.packets} URB records in {args.pcap}")
+        writer.close()
 
     return 0
 
 
 if __name__ == "__main__":
     raise SystemExit(main())
-
-
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""
+Read-only tap client for the ESP raw PTP proxy (CONFIG_RS3_USB_PTP_PROXY_TAP).
+
+Connects to the tap port (default 1236) and records every proxy frame while another PC runs
+rs3_ptp_raw_proxy.py on the proxy port. The tap never sends anything and cannot slow the proxy:
+if it falls a full ring behind, the ESP disconnects it (counted as dropped_slow in its TCP log).
+
+Tap framing:
+  uint32_be length (type + timestamp + payload)
+  uint8     type (0x10 RAW_OUT, 0x11 RAW_IN, 0x12 RAW_DONE, 0x13 RAW_TS)
+  uint64_be esp_timer_get_time() in microseconds
+  payload...
+
+The --log file uses the rs3_ptp_raw_proxy.py log format (RAW_OUT lines + hexdumps), so a tap
+capture can be replayed with rs3_load_gen.py --replay.
+
+--pcap writes the RS3 bulk transfers as pcapng (see rs3_pcapng.py) stamped with the ESP's own
+esp_timer microseconds, offset so the first frame lands at the PC's wall clock: gaps between
+packets are ESP-side times, without Wi-Fi jitter.
+
+--clock-sync first runs rs3_clock_sync.py against the RPC port (default 1237) and maps every
+esp_timer stamp onto the PC wall clock through the fitted offset and drift, so pcap and log
+times line up with captures taken on the PC itself (accuracy is printed; typically a few hundred
+us on Wi-Fi). The RPC port takes one client: this replaces any other RPC session.
+"""
+
+from __future__ import annotations
+
+import argparse
+import datetime
+import socket
+import struct
+import sys
+from typing import Optional
+
+import rs3_clock_sync
+from rs3_pcapng import PcapngWriter, now_epoch_us
+from rs3_ptp_common import T_RAW_DONE, T_RAW_IN, T_RAW_OUT, T_RAW_TS, exchange_op_label, hexdump, recv_exact
+
+TYPE_NAMES = {T_RAW_OUT: "RAW_OUT", T_RAW_IN: "RAW_IN", T_RAW_DONE: "RAW_DONE", T_RAW_TS: "RAW_TS"}
+TAP_HDR = struct.Struct(">IBQ")
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Passive tap on the ESP raw PTP proxy.")
+    ap.add_argument("--esp-host", required=True)
+    ap.add_argument("--tap-port", type=int, default=1236)
+    ap.add_argument("--log", default=None, help="Write frames in rs3_ptp_raw_proxy.py log format")
+    ap.add_argument("--pcap", default=None, help="Write RS3 bulk transfers as pcapng with ESP timestamps")
+    ap.add_argument("--quiet", action="store_true", help="Only print the summary")
+    ap.add_argument("--clock-sync", action="store_true", help="Map ESP timestamps onto the PC wall clock first")
+    ap.add_argument("--rpc-port", type=int, default=rs3_clock_sync.DEFAULT_PORT)
+    args = ap.parse_args()
+
+    model: Optional[rs3_clock_sync.ClockModel] = None
+    if args.clock_sync:
+        model, report = rs3_clock_sync.sync(args.esp_host, args.rpc_port, samples=32)
+        print(rs3_clock_sync.describe(model, report), flush=True)
+
+    log_f = open(args.log, "a", encoding="utf-8") if args.log else None
+    pcap = PcapngWriter(args.pcap, app="rs3_ptp_tap.py") if args.pcap else None
+    epoch_offset_us = 0
+
+    def log(msg: str, data: Optional[bytes] = None, ts_us: Optional[int] = None) -> None:
+        if log_f:
+            if model is not None and ts_us is not None:
+                wall = datetime.datetime.fromtimestamp(model.to_wall(ts_us) / 1e6).strftime("%H:%M:%S.%f")
+            else:
+                wall = datetime.datetime.now().strftime("%H:%M:%S.%f")
+            log_f.write(f"[{wall}] {msg}\n")
+            if data:
+                log_f.write(hexdump(data, prefix="  ") + "\n")
+
+    sock = socket.create_connection((args.esp_host, args.tap_port), timeout=5)
+    sock.settimeout(None)
+    print(f"Tapping {args.esp_host}:{args.tap_port}", flush=True)
+
+    counts = {t: 0 for t in TYPE_NAMES}
+    n_bytes = 0
+    t0_esp: Optional[int] = None
+    try:
+        while True:
+            length, ftype, ts_us = TAP_HDR.unpack(recv_exact(sock, TAP_HDR.size))
+            payload = recv_exact(sock, length - 9) if length > 9 else b""
+            counts[ftype] = counts.get(ftype, 0) + 1
+            n_bytes += TAP_HDR.size + len(payload)
+            if t0_esp is None:
+                t0_esp = ts_us
+                epoch_offset_us = now_epoch_us() - ts_us
+            wall_us = model.to_wall(ts_us) if model is not None else ts_us + epoch_offset_us
+
+            name = TYPE_NAMES.get(ftype, f"0x{ftype:02x}")
+            if not args.quiet:
+                extra = f" op={exchange_op_label(payload)}" if ftype == T_RAW_OUT else ""
+                print(f"[+{(ts_us - t0_esp) / 1000:10.3f} ms] {name:<8} {len(payload):5d}B{extra} "
+                      f"{payload[:8].hex(' ')}", flush=True)
+            if ftype == T_RAW_OUT:
+                log(f"RS3->ESP RAW_OUT bytes={len(payload)} esp_us={ts_us}", payload, ts_us)
+                if pcap:
+                    pcap.usb_out(payload, wall_us)
+            elif ftype == T_RAW_IN:
+                log(f"ESP<-PY RAW_IN bytes={len(payload)} esp_us={ts_us}", payload, ts_us)
+                if pcap:
+                    pcap.usb_in(payload, wall_us)
+            elif ftype == T_RAW_DONE:
+                log(f"ESP<-PY RAW_DONE esp_us={ts_us}", None, ts_us)
+    except EOFError:
+        print("Tap closed by ESP (disconnected, or dropped for falling behind).", file=sys.stderr)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        sock.close()
+        if log_f:
+            log_f.close()
+        if pcap:
+            pcap.close()
+        summary = " ".join(f"{TYPE_NAMES.get(t, hex(t))}={n}" for t, n in counts.items() if n)
+        print(f"Frames: {summary or 'none'}, {n_bytes} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
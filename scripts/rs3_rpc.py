@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+"""
+Client for the ESP binary RPC port (CONFIG_RS3_RPC_ENABLE, port 1237).
+
+Frames are uint32_be length + one CBOR item; requests are [id, method, params], responses
+[id, status, result] with status 0 for ESP_OK or the esp_err_t code (result is then the error
+name). Requests may be pipelined; responses come back in order. See main/rpc_server.h.
+
+Library use:
+
+  from rs3_rpc import RpcClient
+  with RpcClient("192.168.1.91") as rpc:
+      rpc.call("shutter")
+      print(rpc.call("stats"))
+      rpc.call("config.set", {"key": "log.raw", "value": "debug"})
+      results = rpc.pipeline([("ping", None)] * 10)
+
+Command line:
+
+  python3 scripts/rs3_rpc.py --esp-host 192.168.1.91 stats
+  python3 scripts/rs3_rpc.py --esp-host 192.168.1.91 config.set key=log.raw value=debug
+  python3 scripts/rs3_rpc.py --esp-host 192.168.1.91 --bench 200
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+from typing import Any, Dict, List, Optional, Sequence, Tuple
+
+DEFAULT_PORT = 1237
+CONSOLE_PORT = 1234
+
+
+# ---- minimal CBOR (the subset main/cbor_lite.c speaks) ----
+
+def _head(major: int, v: int) -> bytes:
+    if v < 24:
+        return bytes([major << 5 | v])
+    if v <= 0xFF:
+        return bytes([major << 5 | 24, v])
+    if v <= 0xFFFF:
+        return bytes([major << 5 | 25]) + struct.pack(">H", v)
+    if v <= 0xFFFFFFFF:
+        return bytes([major << 5 | 26]) + struct.pack(">I", v)
+    return bytes([major << 5 | 27]) + struct.pack(">Q", v)
+
+
+def cbor_encode(v: Any) -> bytes:
+    if v is None:
+        return b"\xf6"
+    if v is True:
+        return b"\xf5"
+    if v is False:
+        return b"\xf4"
+    if isinstance(v, int):
+        return _head(0, v) if v >= 0 else _head(1, -1 - v)
+    if isinstance(v, (bytes, bytearray)):
+        return _head(2, len(v)) + bytes(v)
+    if isinstance(v, str):
+        b = v.encode()
+        return _head(3, len(b)) + b
+    if isinstance(v, (list, tuple)):
+        return _head(4, len(v)) + b"".join(cbor_encode(x) for x in v)
+    if isinstance(v, dict):
+        return _head(5, len(v)) + b"".join(cbor_encode(k) + cbor_encode(x) for k, x in v.items())
+    raise TypeError(f"cannot encode {type(v).__name__}")
+
+
+def cbor_decode(b: bytes, i: int = 0) -> Tuple[Any, int]:
+    ib = b[i]
+    major, info = ib >> 5, ib & 0x1F
+    i += 1
+    if major == 7:
+        if info == 20:
+            return False, i
+        if info == 21:
+            return True, i
+        if info in (22, 23):
+            return None, i
+        raise ValueError(f"unsupported simple value 0x{ib:02x}")
+    if info < 24:
+        arg = info
+    elif info <= 27:
+        n = 1 << (info - 24)
+        arg = int.from_bytes(b[i : i + n], "big")
+        i += n
+    else:
+        raise ValueError(f"unsupported length encoding 0x{ib:02x}")
+    if major == 0:
+        return arg, i
+    if major == 1:
+        return -1 - arg, i
+    if major in (2, 3):
+        data = b[i : i + arg]
+        return (bytes(data) if major == 2 else data.decode(errors="replace")), i + arg
+    if major == 4:
+        out = []
+        for _ in range(arg):
+            x, i = cbor_decode(b, i)
+            out.append(x)
+        return out, i
+    if major == 5:
+        d = {}
+        for _ in range(arg):
+            k, i = cbor_decode(b, i)
+            d[k], i = cbor_decode(b, i)
+        return d, i
+    raise ValueError(f"unsupported major type {major}")
+
+
+# ---- client ----
+
+class RpcError(Exception):
+    def __init__(self, method: str, status: int, name: str) -> None:
+        super().__init__(f"{method}: {name} (0x{status:x})")
+        self.method = method
+        self.status = status
+        self.name = name
+
+
+class RpcClient:
+    def __init__(self, host: str, port: int = DEFAULT_PORT, timeout: float = 5.0) -> None:
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self._next_id = 1
+        self._buf = bytearray()
+
+    def close(self) -> None:
+        self.sock.close()
+
+    def __enter__(self) -> "RpcClient":
+        return self
+
+    def __exit__(self, *exc: Any) -> None:
+        self.close()
+
+    def _frame(self, method: str, params: Any) -> Tuple[int, bytes]:
+        rid = self._next_id
+        self._next_id = (self._next_id + 1) & 0xFFFFFFFF or 1
+        req = [rid, method] if params is None else [rid, method, params]
+        body = cbor_encode(req)
+        return rid, struct.pack(">I", len(body)) + body
+
+    def _recv_response(self) -> Tuple[int, int, Any]:
+        while True:
+            if len(self._buf) >= 4:
+                (n,) = struct.unpack_from(">I", self._buf)
+                if len(self._buf) >= 4 + n:
+                    body = bytes(self._buf[4 : 4 + n])
+                    del self._buf[: 4 + n]
+                    (rid, status, result), _ = cbor_decode(body)
+                    return rid, status, result
+            chunk = self.sock.recv(65536)
+            if not chunk:
+                raise ConnectionError("RPC connection closed")
+            self._buf += chunk
+
+    def pipeline(self, calls: Sequence[Tuple[str, Any]]) -> List[Tuple[int, Any]]:
+        """Send every request first, then collect [(status, result)] in request order."""
+        ids = []
+        out = bytearray()
+        for method, params in calls:
+            rid, frame = self._frame(method, params)
+            ids.append(rid)
+            out += frame
+        self.sock.sendall(out)
+        results: List[Tuple[int, Any]] = []
+        for want in ids:
+            rid, status, result = self._recv_response()
+            if rid != want:
+                raise ValueError(f"response id {rid}, expected {want}")
+            results.append((status, result))
+        return results
+
+    def call(self, method: str, params: Any = None) -> Any:
+        ((status, result),) = self.pipeline([(method, params)])
+        if status != 0:
+            raise RpcError(method, status, str(result))
+        return result
+
+
+# ---- round-trip benchmark: RPC vs the text console ----
+
+def _percentiles(samples: List[float]) -> str:
+    s = sorted(samples)
+    pick = lambda q: s[min(len(s) - 1, int(q * len(s)))]  # noqa: E731
+    return f"p50={pick(0.5):7.2f} ms  p90={pick(0.9):7.2f} ms  max={s[-1]:7.2f} ms"
+
+
+def bench(host: str, port: int, console_port: int, n: int) -> None:
+    with RpcClient(host, port) as rpc:
+        rtt = []
+        for _ in range(n):
+            t0 = time.perf_counter()
+            rpc.call("ping")
+            rtt.append((time.perf_counter() - t0) * 1e3)
+        print(f"rpc ping       (n={n}): {_percentiles(rtt)}")
+
+        t0 = time.perf_counter()
+        for status, _ in rpc.pipeline([("ping", None)] * n):
+            if status != 0:
+                raise RuntimeError("ping failed")
+        total = (time.perf_counter() - t0) * 1e3
+        print(f"rpc pipelined  (n={n}): {total:7.2f} ms total, {total / n:6.3f} ms per call")
+
+    # Text console: `loglevel` answers with one "LOG: ..." line, mixed into the log stream.
+    sock = socket.create_connection((host, console_port), timeout=5)
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    buf = bytearray()
+    time.sleep(0.3)  # let the crash-log replay / backlog arrive first
+    sock.setblocking(False)
+    try:
+        while sock.recv(65536):
+            pass
+    except BlockingIOError:
+        pass
+    sock.setblocking(True)
+    rtt = []
+    for _ in range(n):
+        t0 = time.perf_counter()
+        sock.sendall(b"loglevel\n")
+        while True:
+            k = buf.find(b"LOG: ")
+            e = buf.find(b"\n", k) if k >= 0 else -1
+            if e >= 0:
+                del buf[: e + 1]
+                break
+            chunk = sock.recv(65536)
+            if not chunk:
+                raise ConnectionError("console closed")
+            buf += chunk
+        rtt.append((time.perf_counter() - t0) * 1e3)
+    sock.close()
+    print(f"text loglevel  (n={n}): {_percentiles(rtt)}")
+
+
+def _parse_value(s: str) -> Any:
+    try:
+        return json.loads(s)
+    except ValueError:
+        return s
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Call methods on the ESP binary RPC port.")
+    ap.add_argument("--esp-host", required=True)
+    ap.add_argument("--port", type=int, default=DEFAULT_PORT)
+    ap.add_argument("--console-port", type=int, default=CONSOLE_PORT, help="Text console port (for --bench)")
+    ap.add_argument("--bench", type=int, metavar="N", help="Compare N round trips: RPC ping vs text console")
+    ap.add_argument("method", nargs="?", help="methods, ping, stats, shutter, pair, config.get, config.set, seq.run, ...")
+    ap.add_argument("params", nargs="*", help="key=value pairs (values parsed as JSON when possible)")
+    args = ap.parse_args()
+
+    if args.bench:
+        bench(args.esp_host, args.port, args.console_port, args.bench)
+        return 0
+    if not args.method:
+        ap.error("method required (or --bench)")
+    params: Optional[Dict[str, Any]] = None
+    if args.params:
+        params = {}
+        for kv in args.params:
+            k, sep, v = kv.partition("=")
+            if not sep:
+                ap.error(f"expected key=value, got {kv!r}")
+            params[k] = _parse_value(v)
+    try:
+        with RpcClient(args.esp_host, args.port) as rpc:
+            result = rpc.call(args.method, params)
+    except RpcError as e:
+        print(f"rs3_rpc: {e}", file=sys.stderr)
+        return 1
+    print(json.dumps(result, indent=2, default=lambda b: b.hex()))
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""
+Receive the compressed TCP console (`zlog on`) and write the plain log stream to stdout.
+
+With --esp-host the script connects to the console (port 1234) and sends `zlog on` itself; a raw
+capture of a session where `zlog on` was typed (`nc <esp> 1234 > rs3.zlog`) can be decoded too.
+The output is byte-for-byte what the plain console would have sent, so it pipes straight into
+rs3_log_analyze.py (text log) or rs3_blog_decode.py (CONFIG_RS3_LOG_BINARY):
+
+  python3 scripts/rs3_zlog.py --esp-host 192.168.1.91 | tee rs3.log
+  python3 scripts/rs3_zlog.py --esp-host 192.168.1.91 | python3 scripts/rs3_blog_decode.py --dict build/rs3_blog_dict.json
+
+Stream: plain text up to the "ZLOG: on\\r\\n" reply, then frames of u16 LE compressed length,
+u16 LE raw length and one LZ4 block whose matches may reach back into earlier output
+(main/lz4_stream.h). A frame with both lengths 0 switches back to plain text. The compression
+ratio is printed to stderr at the end.
+"""
+
+from __future__ import annotations
+
+import argparse
+import socket
+import struct
+import sys
+from typing import BinaryIO, Callable, Iterator
+
+ON_MARKER = b"ZLOG: on\r\n"
+HISTORY = 65536  # LZ4 offsets are 16-bit: this much output is enough as the dictionary
+
+
+class ZlogError(Exception):
+    pass
+
+
+def lz4_block_decode(src: bytes, out: bytearray) -> None:
+    """Append one LZ4 block to out; matches may refer to anything already in out."""
+    i = 0
+    n = len(src)
+    while i < n:
+        token = src[i]
+        i += 1
+        lit = token >> 4
+        if lit == 15:
+            while True:
+                b = src[i]
+                i += 1
+                lit += b
+                if b != 255:
+                    break
+        out += src[i : i + lit]
+        i += lit
+        if i >= n:
+            break  # last sequence: literals only
+        off = src[i] | (src[i + 1] << 8)
+        i += 2
+        ml = token & 15
+        if ml == 15:
+            while True:
+                b = src[i]
+                i += 1
+                ml += b
+                if b != 255:
+                    break
+        ml += 4
+        start = len(out) - off
+        if off == 0 or start < 0:
+            raise ZlogError(f"bad match offset {off}")
+        if off >= ml:
+            out += out[start : start + ml]
+        else:
+            # Overlapping copy (runs): repeat the last `off` bytes.
+            for k in range(ml):
+                out.append(out[start + k])
+
+
+class Decoder:
+    def __init__(self) -> None:
+        self.compressed = False
+        self.buf = bytearray()
+        self.hist = bytearray()
+        self.wire = 0  # compressed-mode bytes received, headers included
+        self.raw = 0   # bytes they expanded to
+
+    def feed(self, chunks: Iterator[bytes], write: Callable[[bytes], None]) -> None:
+        for chunk in chunks:
+            self.buf += chunk
+            while self._step(write):
+                pass
+        if self.buf and not self.compressed:
+            write(bytes(self.buf))
+
+    def _step(self, write: Callable[[bytes], None]) -> bool:
+        if not self.compressed:
+            k = self.buf.find(ON_MARKER)
+            if k < 0:
+                # Keep a possible partial marker for the next chunk.
+                keep = len(ON_MARKER) - 1
+                if len(self.buf) > keep:
+                    write(bytes(self.buf[:-keep]))
+                    del self.buf[:-keep]
+                return False
+            write(bytes(self.buf[: k + len(ON_MARKER)]))
+            del self.buf[: k + len(ON_MARKER)]
+            self.compressed = True
+            self.hist = bytearray()
+            return True
+
+        if len(self.buf) < 4:
+            return False
+        clen, rlen = struct.unpack_from("<HH", self.buf)
+        if len(self.buf) < 4 + clen:
+            return False
+        block = bytes(self.buf[4 : 4 + clen])
+        del self.buf[: 4 + clen]
+        self.wire += 4 + clen
+        if clen == 0 and rlen == 0:
+            self.compressed = False
+            return True
+        before = len(self.hist)
+        lz4_block_decode(block, self.hist)
+        if len(self.hist) - before != rlen:
+            raise ZlogError(f"block expanded to {len(self.hist) - before} bytes, header says {rlen}")
+        write(bytes(self.hist[before:]))
+        self.raw += rlen
+        if len(self.hist) > 2 * HISTORY:
+            del self.hist[:-HISTORY]
+        return True
+
+
+def _read_file(f: BinaryIO) -> Iterator[bytes]:
+    while True:
+        chunk = f.read(65536)
+        if not chunk:
+            return
+        yield chunk
+
+
+def _read_sock(sock: socket.socket) -> Iterator[bytes]:
+    while True:
+        chunk = sock.recv(65536)
+        if not chunk:
+            return
+        yield chunk
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="Decode the ESP compressed TCP console (zlog) into the plain stream.")
+    ap.add_argument("--esp-host", default=None, help="Connect to the ESP console and send `zlog on`")
+    ap.add_argument("--port", type=int, default=1234)
+    ap.add_argument("capture", nargs="?", default="-", help="Raw capture file ('-' = stdin)")
+    args = ap.parse_args()
+
+    dec = Decoder()
+    out = sys.stdout.buffer
+
+    try:
+        if args.esp_host:
+            sock = socket.create_connection((args.esp_host, args.port), timeout=5)
+            sock.settimeout(None)
+            sock.sendall(b"zlog on\n")
+            dec.feed(_read_sock(sock), lambda b: (out.write(b), out.flush()))
+        elif args.capture == "-":
+            dec.feed(_read_file(sys.stdin.buffer), out.write)
+        else:
+            with open(args.capture, "rb") as f:
+                dec.feed(_read_file(f), out.write)
+    except KeyboardInterrupt:
+        pass
+    except ZlogError as e:
+        print(f"rs3_zlog: {e}", file=sys.stderr)
+        return 1
+    finally:
+        out.flush()
+    if dec.wire:
+        print(f"rs3_zlog: {dec.wire} B on the wire -> {dec.raw} B of log (x{dec.raw / dec.wire:.2f})", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+"""Latency leg checks for rs3_ptp_raw_proxy.py (python3 -m unittest discover -s scripts)."""
+
+import struct
+import unittest
+
+from rs3_ptp_raw_proxy import Exchange, LatencyStats
+
+
+def raw_ts(seq: int, out_us: int, send_us: int, reply_us: int, in_done_us: int) -> bytes:
+    return struct.pack(">IQQQQ", seq, out_us, send_us, reply_us, in_done_us)
+
+
+class WifiLegTest(unittest.TestCase):
+    WIFI_US = 600  # both directions
+
+    def run_exchange(self, op: str, pc_first_us: int, pc_done_us: int) -> dict:
+        # PC clock: RAW_OUT arrives at 1000; ESP clock: OUT complete at 0, RAW_OUT sent at 50.
+        ex = Exchange(op, 1000)
+        ex.cam_write = 1100
+        ex.cam_read = pc_first_us - 100
+        ex.first_reply = pc_first_us
+        ex.reply = pc_done_us
+        stats = LatencyStats()
+        stats.finish(ex)
+        reply_us = 50 + (pc_first_us - 1000) + self.WIFI_US
+        stats.on_esp_ts(raw_ts(1, 0, 50, reply_us, reply_us + 5000))
+        return stats.samples[op]
+
+    def test_data_phase(self) -> None:
+        # GetObject-like: first RAW_IN after 4.2 ms, RAW_DONE 4 ms of data frames later.
+        legs = self.run_exchange("0x1009", 5200, 9200)
+        self.assertEqual(legs["wifi"], [self.WIFI_US])
+        self.assertEqual(legs["pc"], [8200])
+
+    def test_response_only(self) -> None:
+        # RESPONSE and RAW_DONE leave in one write: first reply and done coincide.
+        legs = self.run_exchange("0x1002", 1400, 1400)
+        self.assertEqual(legs["wifi"], [self.WIFI_US])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,304 @@
+#!/usr/bin/env python3
+"""
+Virtual Sony PTP camera (no USB hardware).
+
+Answers standard PTP containers from a captured profile so the proxies can be run and
+load-tested on a machine without a camera (or without libusb/pyusb at all):
+
+  find_virtual_camera(...) -> (dev, ifnum, ep_in_addr, ep_out_addr, ep_in, ep_out)
+
+The tuple matches rs3_ptp_raw_proxy.find_camera(): write a COMMAND/DATA container to
+ep_out.write(), read the camera's DATA/RESPONSE containers back with ep_in.read(size, timeout).
+A read returns at most one container (like a bulk transfer ending on a short packet/ZLP) and
+raises a USBError "Operation timed out" if nothing is ready within `timeout` ms.
+
+Profile:
+  The C arrays `static const uint8_t k_<name>_<op>[N] = { ... };` in main/usb_ptp_cam.c
+  (default) or any header/source with arrays in the same format. The op is the 4-hex-digit
+  group in the array name (k_devinfo_payload_1001, k_vendor_9209_payload, ...); the bytes are
+  the DATA payload (after the 12-byte header) the camera returns for that op. A second group
+  (k_propdesc_1014_5004, written by ptp_getdeviceinfo.py --profile) makes the array the answer
+  for that op with that first parameter only.
+
+Behaviour:
+  - ops with a profile payload (for the first parameter, or for any): DATA + RESPONSE OK
+  - OpenSession / CloseSession: OK, SessionAlreadyOpen / SessionNotOpen like a real Sony body
+  - GetStorageInfo / GetNumObjects / GetObjectHandles: same synthetic answers as the firmware emulator
+  - 0x9207: waits for the host->device DATA stage, then RESPONSE OK (tracks recording state)
+  - anything else: OperationNotSupported
+  Each reply becomes readable after delay_ms (+ per-op override, + uniform jitter).
+
+Run standalone to list the ops of a profile:
+  python3 scripts/virtual_ptp_camera.py [--profile main/usb_ptp_cam.c]
+"""
+
+from __future__ import annotations
+
+import array
+import argparse
+import os
+import random
+import re
+import struct
+import threading
+import time
+from typing import Dict, List, Optional, Tuple, Union
+
+try:
+    import usb.core
+
+    USBError = usb.core.USBError
+    USBTimeoutError = getattr(usb.core, "USBTimeoutError", usb.core.USBError)
+except ImportError:  # the virtual camera works without pyusb/libusb
+
+    class USBError(IOError):
+        pass
+
+    class USBTimeoutError(USBError):
+        pass
+
+
+from rs3_ptp_common import (
+    PTP_CT_COMMAND,
+    PTP_CT_DATA,
+    PTP_CT_RESPONSE,
+    PTP_HDR,
+    PTP_OC_CLOSE_SESSION,
+    PTP_OC_OPEN_SESSION,
+    PTP_RC_OK,
+    PTP_RC_SESSION_ALREADY_OPEN,
+    U32_LE,
+    build_ptp_container,
+)
+
+PTP_OC_GET_STORAGE_INFO = 0x1005
+PTP_OC_GET_NUM_OBJECTS = 0x1006
+PTP_OC_GET_OBJECT_HANDLES = 0x1007
+PTP_OC_SONY_9207 = 0x9207
+
+PTP_RC_SESSION_NOT_OPEN = 0x2003
+PTP_RC_OPERATION_NOT_SUPPORTED = 0x2005
+
+SONY_VID = 0x054C
+EP_IN_ADDR = 0x81
+EP_OUT_ADDR = 0x02
+MAX_PACKET = 512
+
+DEFAULT_PROFILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "main", "usb_ptp_cam.c")
+
+_ARRAY_RE = re.compile(r"static\s+const\s+uint8_t\s+(k_\w+)\s*\[\s*(\d*)\s*\]\s*=\s*\{([^}]*)\}\s*;", re.S)
+_OP_RE = re.compile(r"(?:^|_)([0-9A-Fa-f]{4})(?:_([0-9A-Fa-f]{4,8}))?(?=_|$)")
+
+ProfileKey = Union[int, Tuple[int, int]]
+
+
+def load_profile(path: str = DEFAULT_PROFILE) -> Dict[ProfileKey, bytes]:
+    """Parse `k_<name>_<op>[_<param>]` byte arrays from a C file into {op or (op, param): payload}."""
+    with open(path, "r", encoding="utf-8", errors="replace") as f:
+        text = f.read()
+    profile: Dict[int, bytes] = {}
+    for name, size, body in _ARRAY_RE.findall(text):
+        m = _OP_RE.search(name[2:])
+        if m is None:
+            continue
+        body = re.sub(r"//[^\n]*|/\*.*?\*/", "", body, flags=re.S)
+        vals = [int(tok, 0) for tok in body.replace("\n", " ").split(",") if tok.strip()]
+        n = int(size) if size else len(vals)
+        key: ProfileKey = int(m.group(1), 16) if m.group(2) is None else (int(m.group(1), 16), int(m.group(2), 16))
+        # C semantics: `= { 0 }` zero-fills the rest of the array.
+        profile[key] = bytes(vals[:n]) + b"\x00" * max(0, n - len(vals))
+    return profile
+
+
+def _ptp_string(s: str) -> bytes:
+    if not s:
+        return b"\x00"
+    u = (s + "\x00").encode("utf-16-le")
+    return bytes([len(s) + 1]) + u
+
+
+def build_storage_info() -> bytes:
+    # Same dataset as build_storage_info() in main/usb_ptp_cam.c.
+    return (struct.pack("<HHHQQI", 0x0002, 0x0002, 0x0000, 32 << 30, 31 << 30, 0xFFFFFFFF)
+            + _ptp_string("Internal Storage") + _ptp_string("SONY"))
+
+
+class VirtualCamera:
+    """PTP responder state machine shared by the virtual endpoints."""
+
+    def __init__(self, profile: Dict[ProfileKey, bytes], delay_ms: float = 0.0,
+                 op_delay_ms: Optional[Dict[int, float]] = None, jitter_ms: float = 0.0) -> None:
+        self.profile = profile
+        self.delay_ms = delay_ms
+        self.op_delay_ms = dict(op_delay_ms or {})
+        self.jitter_ms = jitter_ms
+        self.session_id = 0
+        self.recording = False
+        self._waiting_data: Optional[tuple] = None  # (op, tid, p0)
+        # FIFO of [ready_at, bytes left]: each reply keeps the latency it was queued with.
+        self._pending: List[list] = []
+        self._cv = threading.Condition()  # RLock: guards session/recording/_waiting_data/_pending
+
+    def _reply_delay_s(self, op: int) -> float:
+        ms = self.op_delay_ms.get(op, self.delay_ms)
+        if self.jitter_ms > 0:
+            ms += random.uniform(0.0, self.jitter_ms)
+        return ms / 1000.0
+
+    def _respond(self, op: int, tid: int, data: Optional[bytes], rc: int) -> None:
+        out = []
+        if data is not None:
+            out.append(bytearray(build_ptp_container(PTP_CT_DATA, op, tid, data)))
+        out.append(bytearray(build_ptp_container(PTP_CT_RESPONSE, rc, tid)))
+        with self._cv:
+            ready_at = time.perf_counter() + self._reply_delay_s(op)
+            self._pending.extend([ready_at, buf] for buf in out)
+            self._cv.notify_all()
+
+    def handle_out(self, data: bytes) -> None:
+        if len(data) < 12:
+            return
+        with self._cv:
+            self._handle_out_locked(data)
+
+    def _handle_out_locked(self, data: bytes) -> None:
+        _, ctype, code, tid = PTP_HDR.unpack_from(data, 0)
+        params = [U32_LE.unpack_from(data, off)[0] for off in range(12, len(data) - 3, 4)]
+
+        if ctype == PTP_CT_DATA:
+            if self._waiting_data is None:
+                return
+            op, _, p0 = self._waiting_data
+            self._waiting_data = None
+            # 0x9207 DATA payload[0]: 0x02 start / 0x01 stop, only for a full press (p0=0xD2C8).
+            if op == PTP_OC_SONY_9207 and p0 == 0xD2C8 and len(data) > 12:
+                if data[12] == 0x02:
+                    self.recording = True
+                elif data[12] == 0x01:
+                    self.recording = False
+            self._respond(op, tid, None, PTP_RC_OK)
+            return
+        if ctype != PTP_CT_COMMAND:
+            return
+
+        if code == PTP_OC_OPEN_SESSION:
+            if self.session_id:
+                self._respond(code, tid, None, PTP_RC_SESSION_ALREADY_OPEN)
+            else:
+                self.session_id = params[0] if params else 1
+                self._respond(code, tid, None, PTP_RC_OK)
+        elif code == PTP_OC_CLOSE_SESSION:
+            rc = PTP_RC_OK if self.session_id else PTP_RC_SESSION_NOT_OPEN
+            self.session_id = 0
+            self._respond(code, tid, None, rc)
+        elif code == PTP_OC_SONY_9207:
+            # Host->device DATA stage follows; no reply until it arrives.
+            self._waiting_data = (code, tid, params[0] if params else 0)
+        elif params and (code, params[0]) in self.profile:
+            self._respond(code, tid, self.profile[(code, params[0])], PTP_RC_OK)
+        elif code in self.profile:
+            self._respond(code, tid, self.profile[code], PTP_RC_OK)
+        elif code == PTP_OC_GET_STORAGE_INFO:
+            self._respond(code, tid, build_storage_info(), PTP_RC_OK)
+        elif code in (PTP_OC_GET_NUM_OBJECTS, PTP_OC_GET_OBJECT_HANDLES):
+            self._respond(code, tid, b"\x00\x00\x00\x00", PTP_RC_OK)
+        else:
+            self._respond(code, tid, None, PTP_RC_OPERATION_NOT_SUPPORTED)
+
+    def read_in(self, size: int, timeout_ms: int) -> bytes:
+        deadline = time.perf_counter() + timeout_ms / 1000.0
+        with self._cv:
+            while True:
+                now = time.perf_counter()
+                ready_at = self._pending[0][0] if self._pending else deadline
+                if self._pending and now >= ready_at:
+                    cur = self._pending[0][1]
+                    out = bytes(cur[:size])
+                    del cur[:size]
+                    if not cur:
+                        self._pending.pop(0)
+                    return out
+                if now >= deadline:
+                    raise USBTimeoutError("Operation timed out")
+                wait_until = min(deadline, ready_at)
+                self._cv.wait(max(0.0, wait_until - now))
+
+
+class VirtualEndpoint:
+    def __init__(self, cam: VirtualCamera, addr: int) -> None:
+        self.cam = cam
+        self.bEndpointAddress = addr
+        self.bmAttributes = 0x02  # bulk
+        self.wMaxPacketSize = MAX_PACKET
+
+    def write(self, data, timeout: Optional[int] = None) -> int:
+        data = bytes(data)
+        self.cam.handle_out(data)
+        return len(data)
+
+    def read(self, size: int, timeout: Optional[int] = None) -> array.array:
+        return array.array("B", self.cam.read_in(size, 5000 if timeout is None else timeout))
+
+
+class VirtualDevice:
+    def __init__(self, cam: VirtualCamera, vid: int, pid: int) -> None:
+        self.cam = cam
+        self.idVendor = vid
+        self.idProduct = pid
+
+    def clear_halt(self, ep) -> None:
+        pass
+
+
+def parse_op_delays(spec: str) -> Dict[int, float]:
+    """'0x9209=20,0x1001=5' -> {0x9209: 20.0, 0x1001: 5.0}"""
+    out: Dict[int, float] = {}
+    for item in spec.split(","):
+        if not item.strip():
+            continue
+        op, ms = item.split("=", 1)
+        out[int(op, 0)] = float(ms)
+    return out
+
+
+def find_virtual_camera(profile_path: Optional[str] = None, delay_ms: float = 0.0,
+                        op_delay_ms: Optional[Dict[int, float]] = None, jitter_ms: float = 0.0,
+                        vid: Optional[int] = None, pid: Optional[int] = None):
+    """Drop-in for find_camera(): (dev, ifnum, ep_in_addr, ep_out_addr, ep_in, ep_out)."""
+    cam = VirtualCamera(load_profile(profile_path or DEFAULT_PROFILE), delay_ms, op_delay_ms, jitter_ms)
+    dev = VirtualDevice(cam, SONY_VID if vid is None else vid, 0 if pid is None else pid)
+    ep_in = VirtualEndpoint(cam, EP_IN_ADDR)
+    ep_out = VirtualEndpoint(cam, EP_OUT_ADDR)
+    return dev, 0, EP_IN_ADDR, EP_OUT_ADDR, ep_in, ep_out
+
+
+def add_virtual_camera_args(ap: argparse.ArgumentParser) -> None:
+    ap.add_argument("--virtual-camera", action="store_true",
+                    help="Use the built-in virtual Sony camera instead of USB (no hardware/pyusb needed).")
+    ap.add_argument("--virtual-profile", default=None,
+                    help="C file with k_<name>_<op> payload arrays (default: main/usb_ptp_cam.c).")
+    ap.add_argument("--virtual-delay-ms", type=float, default=0.0, help="Virtual camera reply delay (ms).")
+    ap.add_argument("--virtual-op-delay", type=parse_op_delays, default={},
+                    help="Per-op reply delay overrides, e.g. 0x9209=20,0x1001=5 (ms).")
+    ap.add_argument("--virtual-jitter-ms", type=float, default=0.0, help="Uniform random extra delay (ms).")
+
+
+def virtual_camera_from_args(args):
+    return find_virtual_camera(args.virtual_profile, args.virtual_delay_ms, args.virtual_op_delay,
+                               args.virtual_jitter_ms, getattr(args, "vid", None), getattr(args, "pid", None))
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description="List the ops a virtual camera profile answers.")
+    ap.add_argument("--profile", default=DEFAULT_PROFILE)
+    args = ap.parse_args()
+    profile = load_profile(args.profile)
+    for key in sorted(profile, key=lambda k: k if isinstance(k, tuple) else (k, -1)):
+        payload = profile[key]
+        label = f"0x{key[0]:04x}:0x{key[1]:x}" if isinstance(key, tuple) else f"0x{key:04x}"
+        print(f"{label:<16} {len(payload):5d} bytes  {payload[:16].hex(' ')}")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())